@@ -149,6 +149,8 @@ local flexCallIns = {
   'UnitDecloaked',
   'UnitMoveFailed',
   'UnitHarvestStorageFull',
+  'UnitDamagedBatch',
+  'UnitEnteredLosBatch',
   'RecvLuaMsg',
   'StockpileChanged',
   'DrawGenesis',
@@ -1923,6 +1925,15 @@ function widgetHandler:UnitDamaged(unitID, unitDefID, unitTeam, damage, paralyze
   return
 end
 
+-- one array per argument of UnitDamaged, shared by all widgets and refilled
+-- by the next call, so they must not be modified or kept
+function widgetHandler:UnitDamagedBatch(count, unitIDs, unitDefIDs, unitTeams, damages, paralyzers, weaponDefIDs, projectileIDs)
+  for _,w in ipairs(self.UnitDamagedBatchList) do
+    w:UnitDamagedBatch(count, unitIDs, unitDefIDs, unitTeams, damages, paralyzers, weaponDefIDs, projectileIDs)
+  end
+  return
+end
+
 function widgetHandler:UnitStunned(unitID, unitDefID, unitTeam, stunned)
   for _,w in ipairs(self.UnitStunnedList) do
     w:UnitStunned(unitID, unitDefID, unitTeam, stunned)
@@ -1947,6 +1958,14 @@ function widgetHandler:UnitEnteredLos(unitID, unitTeam)
 end
 
 
+function widgetHandler:UnitEnteredLosBatch(count, unitIDs, unitTeams)
+  for _,w in ipairs(self.UnitEnteredLosBatchList) do
+    w:UnitEnteredLosBatch(count, unitIDs, unitTeams)
+  end
+  return
+end
+
+
 function widgetHandler:UnitLeftRadar(unitID, unitTeam)
   for _,w in ipairs(self.UnitLeftRadarList) do
     w:UnitLeftRadar(unitID, unitTeam)
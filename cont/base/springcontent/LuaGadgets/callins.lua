@@ -80,6 +80,8 @@ CALLIN_LIST = {
 	"UnitLeftUnderwater",
 	"UnitCommand",
 	"UnitHarvestStorageFull",
+	"UnitDamagedBatch",
+	"UnitEnteredLosBatch",
 
 	-- weapon callins
 	"StockpileChanged",
@@ -94,6 +96,7 @@ CALLIN_LIST = {
 	-- projectile callins
 	"ProjectileCreated",
 	"ProjectileDestroyed",
+	"ProjectileCreatedBatch",
 
 	-- shield callins
 	"ShieldPreDamaged",
@@ -1682,6 +1682,36 @@ function gadgetHandler:UnitHarvestStorageFull(unitID, unitDefID, unitTeam)
   end
 end
 
+
+-- the batch call-ins pass one array per argument of their per-event
+-- counterpart, gadgets must not modify them as all receive the same tables
+-- and the engine refills them on its next call
+function gadgetHandler:UnitDamagedBatch(
+  count,
+  unitIDs,
+  unitDefIDs,
+  unitTeams,
+  damages,
+  paralyzers,
+  weaponDefIDs,
+  projectileIDs,
+  attackerIDs,
+  attackerDefIDs,
+  attackerTeams
+)
+  for _,g in r_ipairs(self.UnitDamagedBatchList) do
+    g:UnitDamagedBatch(count, unitIDs, unitDefIDs, unitTeams,
+                       damages, paralyzers, weaponDefIDs, projectileIDs,
+                       attackerIDs, attackerDefIDs, attackerTeams)
+  end
+end
+
+function gadgetHandler:UnitEnteredLosBatch(count, unitIDs, unitTeams, allyTeams, unitDefIDs)
+  for _,g in r_ipairs(self.UnitEnteredLosBatchList) do
+    g:UnitEnteredLosBatch(count, unitIDs, unitTeams, allyTeams, unitDefIDs)
+  end
+end
+
 --------------------------------------------------------------------------------
 --
 --  Feature call-ins
@@ -1765,6 +1795,12 @@ function gadgetHandler:ProjectileDestroyed(proID)
   end
 end
 
+function gadgetHandler:ProjectileCreatedBatch(count, proIDs, proOwnerIDs, proWeaponDefIDs)
+  for _,g in r_ipairs(self.ProjectileCreatedBatchList) do
+    g:ProjectileCreatedBatch(count, proIDs, proOwnerIDs, proWeaponDefIDs)
+  end
+end
+
 
 --------------------------------------------------------------------------------
 --
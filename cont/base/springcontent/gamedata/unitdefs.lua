@@ -50,6 +50,9 @@ end
 
 local fbiFiles = VFS.DirList('units/', '*.fbi', nil, true)
 
+-- read the files concurrently before they are parsed one by one
+VFS.PrefetchFiles(fbiFiles)
+
 
 for _, filename in ipairs(fbiFiles) do
   local ud, err = FBI.Parse(filename)
@@ -74,6 +77,8 @@ end
 
 local luaFiles = VFS.DirList('units/', '*.lua', nil, true)
 
+VFS.PrefetchFiles(luaFiles)
+
 for _, filename in ipairs(luaFiles) do
   local udEnv = {}
   udEnv._G = udEnv
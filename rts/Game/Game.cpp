@@ -122,12 +122,14 @@
 #include "System/FileSystem/FileSystem.h"
 #include "System/LoadSave/LoadSaveHandler.h"
 #include "System/LoadSave/DemoRecorder.h"
+#include "System/LoadSave/SimSnapshotHandler.h"
 #include "System/Log/ILog.h"
 #include "System/Platform/Misc.h"
 #include "System/Platform/Watchdog.h"
 #include "System/Sound/ISound.h"
 #include "System/Sound/ISoundChannels.h"
 #include "System/Sync/DumpState.h"
+#include "System/Sync/SyncChecker.h"
 #include "System/TimeProfiler.h"
 #include "System/LoadLock.h"
 
@@ -150,6 +152,7 @@ CONFIG(float, GuiOpacity).defaultValue(0.8f).minimumValue(0.0f).maximumValue(1.0
 CONFIG(std::string, InputTextGeo).defaultValue("");
 
 CONFIG(int, SmoothTimeOffset).defaultValue(0).headlessValue(0).description("Enables frametimeoffset smoothing, 0 = off (old version), -1 = forced 0.5,  1-20 smooth, recommended = 2-3");
+CONFIG(bool, SimFrameTaskGraph).defaultValue(false).safemodeValue(false).description("Lets independent stages of each simulation frame (e.g. LOS and team updates) run concurrently on the thread pool. Stages that call into Lua or touch synced checksums stay in their original order.");
 
 CGame* game = nullptr;
 
@@ -216,6 +219,8 @@ CR_REG_METADATA(CGame, (
 	CR_MEMBER(luaGCControl),
 
 	CR_IGNORED(jobDispatcher),
+	CR_IGNORED(simFrameGraph),
+	CR_IGNORED(simFrameGraphMT),
 	CR_IGNORED(curKeyCodeChain),
 	CR_IGNORED(curScanCodeChain),
 	CR_IGNORED(worldDrawer),
@@ -257,6 +262,7 @@ CGame::CGame(const std::string& mapFileName, const std::string& modFileName, ILo
 	showSpeed = configHandler->GetBool("ShowSpeed");
 
 	speedControl = configHandler->GetInt("SpeedControl");
+	simFrameGraphMT = configHandler->GetBool("SimFrameTaskGraph");
 
 	playerRoster.SetSortTypeByCode((PlayerRoster::SortType)configHandler->GetInt("ShowPlayerInfo"));
 
@@ -291,6 +297,8 @@ CGame::CGame(const std::string& mapFileName, const std::string& modFileName, ILo
 
 	CResourceHandler::CreateInstance();
 	CCategoryHandler::CreateInstance();
+
+	InitSimFrameGraph();
 }
 
 CGame::~CGame()
@@ -642,7 +650,7 @@ void CGame::PreLoadSimulation(LuaParser* defsParser)
 
 	loadscreen->SetLoadMessage("Creating QuadField & CEGs");
 	moveDefHandler.Init(defsParser);
-	quadField.Init(int2(mapDims.mapx, mapDims.mapy), modInfo.quadFieldQuadSizeInElmos);
+	quadField.Init(int2(mapDims.mapx, mapDims.mapy), modInfo.quadFieldQuadSizeInElmos, modInfo.quadFieldPackedPositions);
 	damageArrayHandler.Init(defsParser);
 	explGenHandler.Init();
 }
@@ -678,6 +686,7 @@ void CGame::PostLoadSimulation(LuaParser* defsParser)
 	unitHandler.Init();
 	featureHandler.Init();
 	projectileHandler.Init();
+	simSnapshotHandler.Init();
 	CLosHandler::InitStatic();
 
 	readMap->InitHeightMapDigestVectors(losHandler->los.size);
@@ -1035,6 +1044,7 @@ void CGame::KillSimulation()
 	featureHandler.Kill(); // depends on unitHandler (via ~CFeature)
 	unitHandler.Kill();
 	projectileHandler.Kill();
+	simSnapshotHandler.Kill();
 
 	LOG("[Game::%s][3]", __func__);
 	IPathManager::FreeInstance(pathManager);
@@ -1718,12 +1728,171 @@ void CGame::StartPlaying()
 
 	teamHandler.SetDefaultStartPositions(gameSetup);
 
-	if (saveFileHandler == nullptr)
+	if (saveFileHandler == nullptr) {
 		eventHandler.GameStart();
+		return;
+	}
+
+#ifdef SYNCCHECK
+	// discard the assignments made while loading; saves taken right after a
+	// checksum reset (see CSimSnapshotHandler) then continue with the same
+	// checksums as the game they were taken from
+	CSyncChecker::NewFrame();
+#endif
 }
 
 static const char* const tracingSimFrameName = "SimFrame";
 
+void CGame::InitSimFrameGraph()
+{
+	using ResourceMask = CTaskGraph::ResourceMask;
+
+	// state touched by the SimFrame stages; nodes are listed in the
+	// reference order and conflicting ones never overlap, so as long
+	// as every stage declares what it touches the frame's outcome is
+	// the same as when running them one after another
+	enum: ResourceMask {
+		SIM_RES_SYNC         = 1 << 0, // sync checksum and gsRNG, both order-dependent
+		SIM_RES_UNITS        = 1 << 1,
+		SIM_RES_FEATURES     = 1 << 2,
+		SIM_RES_PROJECTILES  = 1 << 3,
+		SIM_RES_HEIGHTMAP    = 1 << 4,
+		SIM_RES_HEIGHTBOUNDS = 1 << 5,
+		SIM_RES_SMOOTHMESH   = 1 << 6,
+		SIM_RES_PATHING      = 1 << 7,
+		SIM_RES_LOS          = 1 << 8,
+		SIM_RES_TEAMS        = 1 << 9,  // resources and statistics
+		SIM_RES_ALLIANCES    = 1 << 10, // team to allyteam mapping and alliances
+		SIM_RES_PLAYERS      = 1 << 11,
+		SIM_RES_WIND         = 1 << 12,
+		SIM_RES_SYNCED       = (1 << 13) - 1,
+
+		SIM_RES_GHOSTS       = 1 << 13,
+		SIM_RES_DECALS       = 1 << 14,
+		SIM_RES_PARTICLES    = 1 << 15, // unsynced projectiles and guRNG
+		// Lua may read or write anything reachable through its API;
+		// stages raising synced-only call-ins use SIM_RES_SYNCED
+		SIM_RES_ALL          = (1 << 16) - 1,
+	};
+
+	// stages that may raise call-ins deliver the batched ones before the next
+	// stage runs, so their *Batch call-ins see the same sim state every time
+	const auto FlushingBatches = [](CTaskGraph::TaskFunc&& f) -> CTaskGraph::TaskFunc {
+		return [f = std::move(f)]() {
+			f();
+			eventHandler.FlushEventBatches();
+		};
+	};
+
+	// GameFrame, Units, Projectiles, Scripts and GameFramePost call into Lua
+	// every frame and stay barriers, the other stages declare what they touch
+	// or narrow it on frames where they raise no call-ins; Scripts precedes
+	// the LOS stages, so those only overlap with the stages following them
+	simFrameGraph.Clear();
+	simFrameGraph.AddNode("Sim::Frame::GameFrame", FlushingBatches([this]() {
+		SCOPED_TIMER("Sim::GameFrame");
+
+		// keep garbage-collection rate tied to sim-speed
+		// (fixed 30Hz gc is not enough while catching up)
+		if (luaGCControl == 0)
+			eventHandler.CollectGarbage(false);
+
+		eventHandler.GameFrame(gs->frameNum);
+	}), SIM_RES_ALL, SIM_RES_ALL, true);
+
+	// waiting damages raise UnitDamaged etc.
+	simFrameGraph.AddNode("Sim::Frame::GameHelper", FlushingBatches([]() { helper->Update(); }), SIM_RES_ALL, SIM_RES_ALL, true, [](ResourceMask&, ResourceMask&) {
+		return helper->HasWaitingDamages();
+	});
+	simFrameGraph.AddNode("Sim::Frame::HeightBounds", []() { readMap->Update(); }, SIM_RES_HEIGHTMAP, SIM_RES_HEIGHTBOUNDS);
+	// the mesh only checks its maxima against the height bounds, but does so concurrently
+	simFrameGraph.AddNode("Sim::Frame::SmoothMesh", []() { smoothGround.UpdateSmoothMesh(); }, SIM_RES_HEIGHTMAP | SIM_RES_HEIGHTBOUNDS, SIM_RES_SMOOTHMESH);
+	simFrameGraph.AddNode("Sim::Frame::MapDamage", FlushingBatches([]() { mapDamage->Update(); }), SIM_RES_ALL, SIM_RES_ALL, true, [](ResourceMask&, ResourceMask&) {
+		return mapDamage->HasPendingUpdates();
+	});
+	simFrameGraph.AddNode("Sim::Frame::Units", FlushingBatches([]() { unitHandler.Update(); }), SIM_RES_ALL, SIM_RES_ALL, true);
+	// path searches test the blocking map and sum synced checksums
+	simFrameGraph.AddNode("Sim::Frame::Pathing", []() { pathManager->Update(); }, SIM_RES_HEIGHTMAP | SIM_RES_UNITS | SIM_RES_FEATURES | SIM_RES_PATHING, SIM_RES_PATHING | SIM_RES_SYNC, true);
+	simFrameGraph.AddNode("Sim::Frame::Projectiles", FlushingBatches([]() { projectileHandler.Update(); }), SIM_RES_ALL, SIM_RES_ALL, true);
+	// features only raise call-ins when moving or deleted, resting ones just
+	// burn, smoke and (vents) track the solid on top of them; freeing their
+	// IDs checks for reclaiming builders
+	simFrameGraph.AddNode("Sim::Frame::Features", FlushingBatches([]() { featureHandler.Update(); }), SIM_RES_ALL, SIM_RES_ALL, true, [](ResourceMask& reads, ResourceMask& writes) {
+		if (featureHandler.IsIdle())
+			return false;
+
+		if (featureHandler.UpdatesQuietly()) {
+			reads = SIM_RES_UNITS | SIM_RES_FEATURES | SIM_RES_HEIGHTMAP | SIM_RES_PARTICLES;
+			writes = SIM_RES_UNITS | SIM_RES_FEATURES | SIM_RES_PARTICLES;
+		}
+
+		return true;
+	});
+	simFrameGraph.AddNode("Sim::Frame::Scripts", FlushingBatches([]() {
+		/* The default GAME_SPEED is 30, which doesn't divide 1000 well,
+		 * so scripts will perceive 990ms per second. But this is fine,
+		 * since doing "29th February" style of extra counting would be
+		 * disruptive to sleeps that assume a constant tick length while
+		 * not being otherwise perceptible since most animations don't
+		 * run that long. */
+		static constexpr int tickMs = 1000 / GAME_SPEED;
+
+		SCOPED_TIMER("Sim::Script");
+		unitScriptEngine->Tick(tickMs);
+	}), SIM_RES_ALL, SIM_RES_ALL, true);
+
+	// new wind directions use gsRNG and generators are notified through
+	// their scripts, in between updates only the wind vector is blended
+	simFrameGraph.AddNode("Sim::Frame::EnvResources", FlushingBatches([]() { envResHandler.Update(); }), SIM_RES_ALL, SIM_RES_ALL, true, [](ResourceMask& reads, ResourceMask& writes) {
+		if (envResHandler.GetMaxWindStrength() <= 0.0f)
+			return false;
+
+		if (!envResHandler.UpdatesGenerators()) {
+			reads = SIM_RES_WIND;
+			writes = SIM_RES_WIND;
+		}
+
+		return true;
+	});
+	simFrameGraph.AddNode("Sim::Frame::Los", []() { losHandler->Update(); }, SIM_RES_UNITS | SIM_RES_HEIGHTMAP | SIM_RES_LOS, SIM_RES_LOS);
+	// dead ghosts have to be updated in sim, after los,
+	// to make sure they represent the current knowledge correctly.
+	// should probably be split from drawer
+	simFrameGraph.AddNode("Sim::Frame::Ghosts", []() { CUnitDrawer::UpdateGhostedBuildings(); }, SIM_RES_LOS | SIM_RES_GHOSTS | SIM_RES_DECALS, SIM_RES_GHOSTS | SIM_RES_DECALS);
+	// AllowWeaponInterceptTarget is synced-only; without a gadget controlling
+	// it interceptors only look at positions and add death dependencies
+	simFrameGraph.AddNode("Sim::Frame::Intercept", []() { interceptHandler.Update(false); }, SIM_RES_SYNCED, SIM_RES_SYNCED, true, [](ResourceMask& reads, ResourceMask& writes) {
+		if ((gs->frameNum % UNIT_SLOWUPDATE_RATE) != 0)
+			return false;
+
+		if (!eventHandler.HasWeaponInterceptTargetControl()) {
+			reads = SIM_RES_UNITS | SIM_RES_PROJECTILES | SIM_RES_HEIGHTMAP | SIM_RES_ALLIANCES;
+			writes = SIM_RES_UNITS | SIM_RES_PROJECTILES;
+		}
+
+		return true;
+	});
+	simFrameGraph.AddNode("Sim::Frame::Teams", []() { teamHandler.GameFrame(gs->frameNum); }, SIM_RES_TEAMS | SIM_RES_ALLIANCES, SIM_RES_TEAMS, false, [](ResourceMask&, ResourceMask&) {
+		return ((gs->frameNum % TEAM_SLOWUPDATE_RATE) == 0);
+	});
+	// FPS-controlled units are moved and fired directly
+	simFrameGraph.AddNode("Sim::Frame::Players", FlushingBatches([]() { playerHandler.GameFrame(gs->frameNum); }), SIM_RES_ALL, SIM_RES_ALL, true, [](ResourceMask&, ResourceMask&) {
+		for (int i = 0; i < playerHandler.ActivePlayers(); ++i) {
+			const CPlayer* player = playerHandler.Player(i);
+
+			if (player->active && player->fpsController.GetControllee() != nullptr)
+				return true;
+		}
+
+		return false;
+	});
+	// snapshot the frame's final positions for packed quadfield queries
+	simFrameGraph.AddNode("Sim::Frame::QuadField", []() { quadField.UpdatePackedPositions(); }, SIM_RES_UNITS | SIM_RES_FEATURES | SIM_RES_PROJECTILES, SIM_RES_UNITS | SIM_RES_FEATURES | SIM_RES_PROJECTILES, true, [](ResourceMask&, ResourceMask&) {
+		return quadField.PackedPositions();
+	});
+	simFrameGraph.AddNode("Sim::Frame::GameFramePost", FlushingBatches([]() { eventHandler.GameFramePost(gs->frameNum); }), SIM_RES_ALL, SIM_RES_ALL, true);
+}
+
 void CGame::SimFrame() {
 	ENTER_SYNCED_CODE();
 	ASSERT_SYNCED(gsRNG.GetGenState());
@@ -1789,48 +1958,9 @@ void CGame::SimFrame() {
 	{
 		SCOPED_SPECIAL_TIMER("Sim");
 
-		{
-			SCOPED_TIMER("Sim::GameFrame");
-
-			// keep garbage-collection rate tied to sim-speed
-			// (fixed 30Hz gc is not enough while catching up)
-			if (luaGCControl == 0)
-				eventHandler.CollectGarbage(false);
-
-			eventHandler.GameFrame(gs->frameNum);
-		}
-
-		helper->Update();
-		readMap->Update();
-		smoothGround.UpdateSmoothMesh();
-		mapDamage->Update();
-		unitHandler.Update();
-		pathManager->Update();
-		projectileHandler.Update();
-		featureHandler.Update();
-		{
-			/* The default GAME_SPEED is 30, which doesn't divide 1000 well,
-			 * so scripts will perceive 990ms per second. But this is fine,
-			 * since doing "29th February" style of extra counting would be
-			 * disruptive to sleeps that assume a constant tick length while
-			 * not being otherwise perceptible since most animations don't
-			 * run that long. */
-			static constexpr int tickMs = 1000 / GAME_SPEED;
-
-			SCOPED_TIMER("Sim::Script");
-			unitScriptEngine->Tick(tickMs);
-		}
-		envResHandler.Update();
-		losHandler->Update();
-		// dead ghosts have to be updated in sim, after los,
-		// to make sure they represent the current knowledge correctly.
-		// should probably be split from drawer
-		CUnitDrawer::UpdateGhostedBuildings();
-		interceptHandler.Update(false);
-
-		teamHandler.GameFrame(gs->frameNum);
-		playerHandler.GameFrame(gs->frameNum);
-		eventHandler.GameFramePost(gs->frameNum);
+		// events raised since the last frame, e.g. by synced Lua messages
+		eventHandler.FlushEventBatches();
+		simFrameGraph.Run(simFrameGraphMT);
 	}
 
 	lastSimFrameTime = spring_gettime();
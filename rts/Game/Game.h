@@ -15,6 +15,7 @@
 #include "System/UnorderedMap.hpp"
 #include "System/creg/creg_cond.h"
 #include "System/Misc/SpringTime.h"
+#include "System/Threading/TaskGraph.h"
 
 class LuaParser;
 class ILoadSaveHandler;
@@ -141,6 +142,7 @@ private:
 	void ClientReadNet();
 	void UpdateNumQueuedSimFrames();
 	void UpdateNetMessageProcessingTimeLeft();
+	void InitSimFrameGraph();
 	void SimFrame();
 	void StartPlaying();
 
@@ -216,6 +218,12 @@ public:
 private:
 	JobDispatcher jobDispatcher;
 
+	/// stages of SimFrame, see InitSimFrameGraph
+	CTaskGraph simFrameGraph;
+
+	/// whether independent SimFrame stages may overlap
+	bool simFrameGraphMT = false;
+
 	CTimedKeyChain curKeyCodeChain;
 	CTimedKeyChain curScanCodeChain;
 
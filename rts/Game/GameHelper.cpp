@@ -84,6 +84,11 @@ void CGameHelper::Update()
 	waitingDamages[wdIdx].clear();
 }
 
+bool CGameHelper::HasWaitingDamages() const
+{
+	return (!waitingDamages[gs->frameNum & (waitingDamages.size() - 1)].empty());
+}
+
 
 //////////////////////////////////////////////////////////////////////
 // Explosions/Damage
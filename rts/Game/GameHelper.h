@@ -153,6 +153,8 @@ public:
 	void Init();
 	void Kill();
 	void Update();
+	// true if damages are waiting to be applied by this frame's Update
+	bool HasWaitingDamages() const;
 
 	static float CalcImpulseScale(const DamageArray& damages, const float expDistanceMod);
 
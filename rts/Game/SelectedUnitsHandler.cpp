@@ -451,6 +451,39 @@ void CSelectedUnitsHandler::ClearSelected()
 }
 
 
+void CSelectedUnitsHandler::DetachSelection()
+{
+	RECOIL_DETAILED_TRACY_ZONE;
+	for (const int unitID: selectedUnits) {
+		CUnit* u = unitHandler.GetUnit(unitID);
+
+		if (u == nullptr) {
+			assert(false);
+			continue;
+		}
+
+		u->isSelected = false;
+		DeleteDeathDependence(u, DEPENDENCE_SELECTED);
+	}
+}
+
+void CSelectedUnitsHandler::AttachSelection()
+{
+	RECOIL_DETAILED_TRACY_ZONE;
+	for (const int unitID: selectedUnits) {
+		CUnit* u = unitHandler.GetUnit(unitID);
+
+		if (u == nullptr) {
+			assert(false);
+			continue;
+		}
+
+		u->isSelected = true;
+		AddDeathDependence(u, DEPENDENCE_SELECTED);
+	}
+}
+
+
 void CSelectedUnitsHandler::SetGroup(CGroup* group, bool fromFactory, bool autoSelect)
 {
 	RECOIL_DETAILED_TRACY_ZONE;
@@ -42,6 +42,11 @@ public:
 	void RemoveUnit(CUnit* unit);
 	void ClearSelected();
 
+	/// drop (and restore) the unsynced death dependencies on selected units
+	/// without changing the selection, e.g. while the units are serialized
+	void DetachSelection();
+	void AttachSelection();
+
 	/// used by MouseHandler.cpp & MiniMap.cpp
 	void HandleUnitBoxSelection(const float4& planeRight, const float4& planeLeft, const float4& planeTop, const float4& planeBottom);
 	void HandleSingleUnitClickSelection(CUnit* unit, bool doInViewTest, bool selectType);
@@ -103,6 +103,7 @@
 #include "System/Log/ILog.h"
 #include "System/Config/ConfigHandler.h"
 #include "System/FileSystem/SimpleParser.h"
+#include "System/LoadSave/SimSnapshotHandler.h"
 #include "System/Sound/ISound.h"
 #include "System/Sound/ISoundChannels.h"
 #include "System/Sync/DumpState.h"
@@ -3560,6 +3561,28 @@ private:
 };
 
 
+class SnapshotActionExecutor : public IUnsyncedActionExecutor {
+public:
+	SnapshotActionExecutor() : IUnsyncedActionExecutor(
+		"Snapshot",
+		"Lists the in-memory snapshots of the game state, or saves the one nearest before <frame> to Saves/<name>.ssf"
+	) {
+	}
+
+	bool Execute(const UnsyncedAction& action) const final {
+		const std::vector<std::string> args = CSimpleParser::Tokenize(action.GetArgs());
+
+		switch (args.size()) {
+			case  0: { simSnapshotHandler.PrintSnapshots();                                                 return true; } break;
+			case  2: { simSnapshotHandler.SaveSnapshot(StringToInt(args[0]), "Saves/" + args[1] + ".ssf"); return true; } break;
+			default: {                                                                                                   } break;
+		}
+
+		return false;
+	}
+};
+
+
 
 class ReloadShadersActionExecutor : public IUnsyncedActionExecutor {
 public:
@@ -4059,6 +4082,7 @@ void UnsyncedGameCommands::AddDefaultActionExecutors()
 	AddActionExecutor(AllocActionExecutor<DumpRNGActionExecutor>());
 	AddActionExecutor(AllocActionExecutor<SaveActionExecutor>(true));
 	AddActionExecutor(AllocActionExecutor<SaveActionExecutor>(false));
+	AddActionExecutor(AllocActionExecutor<SnapshotActionExecutor>());
 	AddActionExecutor(AllocActionExecutor<ReloadShadersActionExecutor>());
 	AddActionExecutor(AllocActionExecutor<ReloadTexturesActionExecutor>());
 	AddActionExecutor(AllocActionExecutor<DumpAtlasActionExecutor>());
@@ -0,0 +1,276 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "LuaBytecodeCache.h"
+#include "LuaInclude.h"
+
+#include "Game/GameVersion.h"
+#include "System/FileSystem/DataDirsAccess.h"
+#include "System/FileSystem/FileHandler.h"
+#include "System/FileSystem/FileQueryFlags.h"
+#include "System/FileSystem/FileSystem.h"
+#include "System/Log/ILog.h"
+#include "System/MainDefines.h"
+#include "System/Misc/SpringTime.h"
+
+#include "lib/xxhash/xxh3.h"
+
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+// smaller chunks parse about as fast as their cache file can be read
+static constexpr size_t MIN_CODE_SIZE = 1024;
+// the cache is emptied at startup when it holds more files than this
+static constexpr size_t MAX_CACHE_FILES = 8192;
+
+static constexpr std::uint32_t CACHE_FILE_MAGIC = 0x4342554C; // "LUBC"
+static constexpr std::uint32_t CACHE_FILE_VERSION = 1;
+
+struct CacheFileHeader {
+	std::uint32_t magic;
+	std::uint32_t version;
+	/// identifies the engine build and Lua release that wrote the file
+	std::uint64_t buildHash;
+	std::uint64_t keyLo;
+	std::uint64_t keyHi;
+	std::uint64_t bytecodeSize;
+	std::uint64_t bytecodeHash;
+};
+
+
+static std::string cacheDir;
+static std::uint64_t buildHash = 0;
+
+static std::atomic<std::uint32_t> numHits = {0};
+static std::atomic<std::uint32_t> numMisses = {0};
+static std::atomic<std::uint32_t> numTempFiles = {0};
+static std::atomic<std::uint64_t> loadTime = {0};
+
+
+static int BytecodeWriter(lua_State*, const void* p, size_t size, void* ud)
+{
+	std::vector<char>* bytecode = static_cast<std::vector<char>*>(ud);
+	bytecode->insert(bytecode->end(), static_cast<const char*>(p), static_cast<const char*>(p) + size);
+	return 0;
+}
+
+
+static bool ReadCacheFile(const std::string& path, const XXH128_hash_t& key, std::vector<char>& bytecode)
+{
+	FILE* file = std::fopen(path.c_str(), "rb");
+
+	if (file == nullptr)
+		return false;
+
+	CacheFileHeader header;
+
+	bool valid = true;
+	valid = valid && (std::fread(&header, sizeof(header), 1, file) == 1);
+	valid = valid && (header.magic == CACHE_FILE_MAGIC && header.version == CACHE_FILE_VERSION && header.buildHash == buildHash);
+	valid = valid && (header.keyLo == key.low64 && header.keyHi == key.high64);
+	valid = valid && (header.bytecodeSize > 0 && header.bytecodeSize < (1u << 30));
+
+	if (valid) {
+		bytecode.resize(header.bytecodeSize);
+
+		valid = valid && (std::fread(bytecode.data(), bytecode.size(), 1, file) == 1);
+		valid = valid && (XXH3_64bits(bytecode.data(), bytecode.size()) == header.bytecodeHash);
+	}
+
+	std::fclose(file);
+	return valid;
+}
+
+static void WriteCacheFile(const std::string& path, const XXH128_hash_t& key, const std::vector<char>& bytecode)
+{
+	// concurrent writers (e.g. LuaParser threads, other engine instances) each
+	// get their own temporary file; the rename replaces the target atomically
+	const size_t threadHash = std::hash<std::thread::id>{}(std::this_thread::get_id());
+	const std::string tempPath = path + "." + std::to_string(threadHash) + "." + std::to_string(numTempFiles.fetch_add(1)) + ".tmp";
+
+	const CacheFileHeader header = {
+		CACHE_FILE_MAGIC,
+		CACHE_FILE_VERSION,
+		buildHash,
+		key.low64,
+		key.high64,
+		bytecode.size(),
+		XXH3_64bits(bytecode.data(), bytecode.size()),
+	};
+
+	FILE* file = std::fopen(tempPath.c_str(), "wb");
+
+	if (file == nullptr)
+		return;
+
+	bool written = true;
+	written = written && (std::fwrite(&header, sizeof(header), 1, file) == 1);
+	written = written && (std::fwrite(bytecode.data(), bytecode.size(), 1, file) == 1);
+	written = (std::fclose(file) == 0) && written;
+
+	std::error_code ec;
+
+	if (written)
+		std::filesystem::rename(tempPath, path, ec);
+
+	if (!written || ec)
+		std::filesystem::remove(tempPath, ec);
+}
+
+
+void LuaBytecodeCache::Init(bool enable)
+{
+	cacheDir.clear();
+
+	numHits = 0;
+	numMisses = 0;
+	loadTime = 0;
+
+	if (!enable)
+		return;
+
+	const char sep = FileSystemAbstraction::GetNativePathSeparator();
+	const std::string dir = dataDirsAccess.LocateDir(FileSystem::GetCacheDir() + sep + "luabytecode" + sep, FileQueryFlags::WRITE | FileQueryFlags::CREATE_DIRS);
+
+	if (dir.empty() || !FileSystemAbstraction::DirIsWritable(dir)) {
+		LOG_L(L_WARNING, "[LuaBytecodeCache::%s] could not create the cache directory", __func__);
+		return;
+	}
+
+	{
+		// the parser and the bytecode format can change with any engine build,
+		// not only when the embedded Lua's release is bumped
+		const std::string buildInfo = std::string(LUA_RELEASE "\n" LUA_VERSION "\n") + SpringVersion::GetFull();
+
+		buildHash = XXH3_64bits(buildInfo.data(), buildInfo.size());
+	}
+
+	{
+		std::error_code ec;
+		std::vector<std::filesystem::path> files;
+
+		for (const auto& entry: std::filesystem::directory_iterator(dir, ec)) {
+			// leftovers of interrupted writes
+			if (entry.path().extension() == ".tmp") {
+				std::filesystem::remove(entry.path(), ec);
+				continue;
+			}
+
+			if (entry.path().extension() == ".luac")
+				files.push_back(entry.path());
+		}
+
+		// stale entries are never looked up again, start over when there are too many
+		if (files.size() > MAX_CACHE_FILES) {
+			LOG("[LuaBytecodeCache::%s] clearing " _STPF_ " cached chunks", __func__, files.size());
+
+			for (const std::filesystem::path& file: files) {
+				std::filesystem::remove(file, ec);
+			}
+		}
+	}
+
+	cacheDir = FileSystem::EnsurePathSepAtEnd(dir);
+}
+
+void LuaBytecodeCache::Kill()
+{
+	if (cacheDir.empty())
+		return;
+
+	LOG("[LuaBytecodeCache::%s] %u chunks loaded from cache, %u compiled (%.1fms spent loading)", __func__, numHits.load(), numMisses.load(), loadTime.load() * 1e-3f);
+	cacheDir.clear();
+}
+
+bool LuaBytecodeCache::IsEnabled() { return !cacheDir.empty(); }
+
+
+static int LoadChunk(lua_State* L, const char* code, size_t size, const char* name, bool storeChunk)
+{
+	// precompiled chunks are loaded as they are
+	if (cacheDir.empty() || size < MIN_CODE_SIZE || code[0] == LUA_SIGNATURE[0])
+		return (luaL_loadbuffer(L, code, size, name));
+
+	const spring_time startTime = spring_gettime();
+
+	// the chunk name is stored in the bytecode (debug info), it is part of the key
+	const XXH128_hash_t key = XXH3_128bits_withSeed(code, size, XXH3_64bits(name, std::strlen(name)) ^ buildHash);
+
+	char fileName[64];
+	std::snprintf(fileName, sizeof(fileName), "%016" PRIx64 "%016" PRIx64 ".luac", key.high64, key.low64);
+
+	const std::string path = cacheDir + fileName;
+
+	std::vector<char> bytecode;
+
+	if (ReadCacheFile(path, key, bytecode)) {
+		// the undumper validates the Lua header (version, type sizes, endianness)
+		if (luaL_loadbuffer(L, bytecode.data(), bytecode.size(), name) == 0) {
+			numHits += 1;
+			loadTime += (spring_gettime() - startTime).toMicroSecsi();
+			return 0;
+		}
+
+		LOG_L(L_WARNING, "[LuaBytecodeCache::%s] ignoring invalid cache file for \"%s\" (%s)", __func__, name, lua_tostring(L, -1));
+		lua_pop(L, 1);
+	}
+
+	numMisses += 1;
+
+	const int error = luaL_loadbuffer(L, code, size, name);
+
+	if (error != 0)
+		return error;
+
+	if (!storeChunk) {
+		loadTime += (spring_gettime() - startTime).toMicroSecsi();
+		return 0;
+	}
+
+	// keep the debug info, tracebacks of cached chunks must not differ
+	bytecode.clear();
+
+	if (lua_dump(L, BytecodeWriter, &bytecode) == 0)
+		WriteCacheFile(path, key, bytecode);
+
+	loadTime += (spring_gettime() - startTime).toMicroSecsi();
+	return 0;
+}
+
+int LuaBytecodeCache::LoadBuffer(lua_State* L, const char* code, size_t size, const char* name)
+{
+	return (LoadChunk(L, code, size, name, true));
+}
+
+int LuaBytecodeCache::LoadNamedString(lua_State* L, const char* code, size_t size, const char* name)
+{
+	// anything else may be generated code (one new entry per call), and the
+	// write would happen synchronously on whichever thread runs the handle
+	const bool storeChunk = (!cacheDir.empty() && size >= MIN_CODE_SIZE && CFileHandler::FileExists(name, SPRING_VFS_ALL));
+
+	return (LoadChunk(L, code, size, name, storeChunk));
+}
+
+int LuaBytecodeCache::LoadString(lua_State* L)
+{
+	size_t size;
+	const char* code = luaL_checklstring(L, 1, &size);
+
+	// unnamed chunks are mostly generated at runtime, not worth a cache entry
+	const int error = lua_isstring(L, 2)?
+		LoadNamedString(L, code, size, lua_tostring(L, 2)):
+		luaL_loadbuffer(L, code, size, code);
+
+	if (error == 0)
+		return 1;
+
+	lua_pushnil(L);
+	lua_insert(L, -2);
+	return 2; // nil, then the error message
+}
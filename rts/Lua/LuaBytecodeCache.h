@@ -0,0 +1,40 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef LUA_BYTECODE_CACHE_H
+#define LUA_BYTECODE_CACHE_H
+
+#include <cstddef>
+
+struct lua_State;
+
+/**
+ * @brief Caches compiled Lua chunks in the cache directory
+ *
+ * Chunks are keyed by a hash of their source text and name, the cached
+ * bytecode is undumped instead of parsing the source again the next time
+ * the same code is loaded. Files written by another engine build or another
+ * version of the embedded Lua are ignored (and eventually overwritten), as
+ * are files that do not pass their checksum; any failure to use the cache
+ * falls back to compiling the source.
+ */
+class LuaBytecodeCache {
+public:
+	static void Init(bool enable);
+	static void Kill();
+
+	static bool IsEnabled();
+
+	/// drop-in replacement for luaL_loadbuffer, passes through when not enabled
+	static int LoadBuffer(lua_State* L, const char* code, size_t size, const char* name);
+	/**
+	 * like LoadBuffer, for chunks handed to loadstring at runtime: cached
+	 * bytecode is used, but only chunks named after a VFS file (widgets,
+	 * gadgets) are written to the cache, at most once per file version
+	 */
+	static int LoadNamedString(lua_State* L, const char* code, size_t size, const char* name);
+
+	/// replacement for the base library loadstring, caches only named chunks
+	static int LoadString(lua_State* L);
+};
+
+#endif // LUA_BYTECODE_CACHE_H
@@ -6,6 +6,7 @@
 #include "LuaRules.h"
 #include "LuaUI.h"
 
+#include "LuaBytecodeCache.h"
 #include "LuaCallInCheck.h"
 #include "LuaConfig.h"
 #include "LuaHashString.h"
@@ -121,11 +122,9 @@ CLuaHandle::CLuaHandle(const string& _name, int _order, bool _userMode, bool _sy
 	: CEventClient(_name, _order, _synced)
 	, userMode(_userMode)
 	, killMe(false)
-	// no shared pool for LuaIntro to protect against LoadingMT=1
-	// do not use it for LuaMenu either; too many blocks allocated
-	// by *other* states end up not being recycled which presently
-	// forces clearing the shared pool on reload
-	, D(_name != "LuaIntro" && name != "LuaMenu", true)
+	// every handle allocates from its own pool (safe with LoadingMT=1
+	// for LuaIntro), whose pages are all released at once on reload
+	, D(false, true)
 {
 	D.owner = this;
 	D.synced = _synced;
@@ -167,6 +166,7 @@ void CLuaHandle::KillLua(bool inFreeHandler)
 	// 1. unlink from eventHandler, so no new events are getting triggered
 	//FIXME when multithreaded lua is enabled, wait for all running events to finish (possible via a mutex?)
 	eventHandler.RemoveClient(this);
+	ClearEventBatches();
 
 	if (!IsValid())
 		return;
@@ -500,7 +500,7 @@ bool CLuaHandle::LoadCode(lua_State* L, std::string code, const string& debug)
 	const LuaUtils::ScopedDebugTraceBack traceBack(L);
 
 	tracy::LuaRemove(code.data());
-	const int error = luaL_loadbuffer(L, code.c_str(), code.size(), debug.c_str());
+	const int error = LuaBytecodeCache::LoadBuffer(L, code.c_str(), code.size(), debug.c_str());
 
 	if (error != 0) {
 		LOG_L(L_ERROR, "[%s::%s] error=%i (%s) debug=%s msg=%s", name.c_str(), __func__, error, LuaErrorString(error), debug.c_str(), lua_tostring(L, -1));
@@ -625,6 +625,15 @@ bool CLuaHandle::UpdateCallIn(lua_State* L, const string& name)
 	} else {
 		eventHandler.RemoveEvent(this, name);
 	}
+
+	// no longer flushed if the handle left all batch lists
+	if (name == "UnitDamagedBatch")
+		unitDamagedBatch.clear();
+	if (name == "UnitEnteredLosBatch")
+		unitEnteredLosBatch.clear();
+	if (name == "ProjectileCreatedBatch")
+		projectileCreatedBatch.clear();
+
 	return true;
 }
 
@@ -2110,6 +2119,269 @@ void CLuaHandle::ProjectileDestroyed(const CProjectile* p)
 	RunCallIn(L, cmdStr, 3, 0);
 }
 
+/******************************************************************************/
+/******************************************************************************
+ * Batched Callins
+ * @section batched_callins
+ *
+ * Opt-in alternatives to frequent call-ins. Instead of one call per event the
+ * events raised during a sim stage (or between sim frames) are delivered by a
+ * single call at its end, as arrays holding one entry per event in the order
+ * they were raised. A handle can define both variants, each receives all
+ * events. Within a flush UnitDamagedBatch comes before UnitEnteredLosBatch and
+ * ProjectileCreatedBatch.
+ *
+ * Since batches are only delivered at the end of a stage, their IDs may refer
+ * to units or projectiles that were destroyed later in the same stage (and
+ * already announced through UnitDestroyed or ProjectileDestroyed); all other
+ * entries hold the values at the time of the event.
+ *
+ * The arrays are owned by the engine and refilled by the next call of the same
+ * call-in, so they must neither be modified nor kept around.
+******************************************************************************/
+
+template<typename T, typename F, typename A>
+static void PushEventBatchArray(lua_State* L, A& array, const std::vector<T>& events, F&& get)
+{
+	if (array.ref == LUA_NOREF) {
+		lua_createtable(L, events.size(), 0);
+		lua_pushvalue(L, -1);
+		array.ref = luaL_ref(L, LUA_REGISTRYINDEX);
+	} else {
+		lua_rawgeti(L, LUA_REGISTRYINDEX, array.ref);
+	}
+
+	for (size_t i = 0; i < events.size(); i++) {
+		if constexpr (std::is_same_v<decltype(get(events[i])), bool>)
+			lua_pushboolean(L, get(events[i]));
+		else
+			lua_pushnumber(L, get(events[i]));
+
+		lua_rawseti(L, -2, i + 1);
+	}
+
+	// trim what is left of a longer previous batch
+	for (size_t i = events.size(); i < array.size; i++) {
+		lua_pushnil(L);
+		lua_rawseti(L, -2, i + 1);
+	}
+
+	array.size = events.size();
+}
+
+
+void CLuaHandle::UnitDamagedBatch(
+	const CUnit* unit,
+	const CUnit* attacker,
+	float damage,
+	int weaponDefID,
+	int projectileID,
+	bool paralyzer)
+{
+	UnitDamagedEvent& e = unitDamagedBatch.emplace_back();
+
+	e.unitID = unit->id;
+	e.unitDefID = unit->unitDef->id;
+	e.unitTeam = unit->team;
+	e.damage = damage;
+	e.paralyzer = paralyzer;
+	e.weaponDefID = weaponDefID;
+	e.projectileID = projectileID;
+	e.attackerID = -1;
+	e.attackerDefID = -1;
+	e.attackerTeam = -1;
+
+	// visibility as of now, see PushAttackerInfo
+	if (attacker == nullptr || !LuaUtils::IsUnitVisible(L, attacker))
+		return;
+
+	e.attackerID = attacker->id;
+	e.attackerDefID = LuaUtils::IsUnitTyped(L, attacker)? LuaUtils::EffectiveUnitDef(L, attacker)->id: -1;
+	e.attackerTeam = attacker->team;
+}
+
+void CLuaHandle::UnitEnteredLosBatch(const CUnit* unit, int allyTeam)
+{
+	unitEnteredLosBatch.push_back({unit->id, unit->team, allyTeam, unit->unitDef->id});
+}
+
+void CLuaHandle::ProjectileCreatedBatch(const CProjectile* p)
+{
+	// same filtering as ProjectileCreated
+	if (watchProjectileDefs.empty())
+		return;
+
+	if (!p->weapon && !p->piece)
+		return;
+
+	const CUnit* owner = p->owner();
+	const WeaponDef* wd = p->weapon? static_cast<const CWeaponProjectile*>(p)->GetWeaponDef(): nullptr;
+
+	if (p->weapon && (wd == nullptr || !watchProjectileDefs[wd->id]))
+		return;
+	if (p->piece && !watchProjectileDefs[watchProjectileDefs.size() - 1])
+		return;
+
+	projectileCreatedBatch.push_back({p->id, ((owner != nullptr)? owner->id: -1), ((wd != nullptr)? wd->id: -1)});
+}
+
+
+void CLuaHandle::FlushEventBatches()
+{
+	if (!unitDamagedBatch.empty())
+		RunUnitDamagedBatch();
+	if (!unitEnteredLosBatch.empty())
+		RunUnitEnteredLosBatch();
+	if (!projectileCreatedBatch.empty())
+		RunProjectileCreatedBatch();
+}
+
+void CLuaHandle::ClearEventBatches()
+{
+	unitDamagedBatch.clear();
+	unitEnteredLosBatch.clear();
+	projectileCreatedBatch.clear();
+}
+
+
+/*** Called at the end of a sim stage with the UnitDamaged events raised during it.
+ *
+ * @function UnitDamagedBatch
+ *
+ * Attacker entries are -1 where UnitDamaged would pass nil.
+ *
+ * @number count
+ * @tparam {number,...} unitIDs
+ * @tparam {number,...} unitDefIDs
+ * @tparam {number,...} unitTeams
+ * @tparam {number,...} damages
+ * @tparam {bool,...} paralyzers
+ * @tparam {number,...} weaponDefIDs
+ * @tparam {number,...} projectileIDs
+ * @tparam {number,...} attackerIDs
+ * @tparam {number,...} attackerDefIDs
+ * @tparam {number,...} attackerTeams
+ */
+void CLuaHandle::RunUnitDamagedBatch()
+{
+	LUA_CALL_IN_CHECK(L);
+	luaL_checkstack(L, 11 + 3, __func__);
+
+	static const LuaHashString cmdStr("UnitDamagedBatch");
+	const LuaUtils::ScopedDebugTraceBack traceBack(L);
+
+	// events raised by the call-in itself go into the next batch
+	std::vector<UnitDamagedEvent> events;
+	events.swap(unitDamagedBatch);
+
+	if (cmdStr.GetGlobalFunc(L)) {
+		auto& a = unitDamagedBatchArrays;
+
+		lua_pushnumber(L, events.size());
+		PushEventBatchArray(L, a[0], events, [](const UnitDamagedEvent& e) { return e.unitID; });
+		PushEventBatchArray(L, a[1], events, [](const UnitDamagedEvent& e) { return e.unitDefID; });
+		PushEventBatchArray(L, a[2], events, [](const UnitDamagedEvent& e) { return e.unitTeam; });
+		PushEventBatchArray(L, a[3], events, [](const UnitDamagedEvent& e) { return e.damage; });
+
+		PushEventBatchArray(L, a[4], events, [](const UnitDamagedEvent& e) { return e.paralyzer; });
+
+		PushEventBatchArray(L, a[5], events, [](const UnitDamagedEvent& e) { return e.weaponDefID; });
+		PushEventBatchArray(L, a[6], events, [](const UnitDamagedEvent& e) { return e.projectileID; });
+		PushEventBatchArray(L, a[7], events, [](const UnitDamagedEvent& e) { return e.attackerID; });
+		PushEventBatchArray(L, a[8], events, [](const UnitDamagedEvent& e) { return e.attackerDefID; });
+		PushEventBatchArray(L, a[9], events, [](const UnitDamagedEvent& e) { return e.attackerTeam; });
+
+		RunCallInTraceback(L, cmdStr, 11, 0, traceBack.GetErrFuncIdx(), false);
+	}
+
+	// reuse the buffer unless the call-in queued new events
+	if (unitDamagedBatch.empty()) {
+		events.clear();
+		events.swap(unitDamagedBatch);
+	}
+}
+
+/*** Called at the end of a sim stage with the UnitEnteredLos events raised during it.
+ *
+ * @function UnitEnteredLosBatch
+ *
+ * The last two arrays are only passed to handles with full read access, as for UnitEnteredLos.
+ *
+ * @number count
+ * @tparam {number,...} unitIDs
+ * @tparam {number,...} unitTeams
+ * @tparam {number,...} allyTeams who's LOS the units entered.
+ * @tparam {number,...} unitDefIDs
+ */
+void CLuaHandle::RunUnitEnteredLosBatch()
+{
+	LUA_CALL_IN_CHECK(L);
+	luaL_checkstack(L, 5 + 2, __func__);
+
+	static const LuaHashString cmdStr("UnitEnteredLosBatch");
+
+	std::vector<UnitLosEvent> events;
+	events.swap(unitEnteredLosBatch);
+
+	if (cmdStr.GetGlobalFunc(L)) {
+		auto& a = unitEnteredLosBatchArrays;
+
+		lua_pushnumber(L, events.size());
+		PushEventBatchArray(L, a[0], events, [](const UnitLosEvent& e) { return e.unitID; });
+		PushEventBatchArray(L, a[1], events, [](const UnitLosEvent& e) { return e.unitTeam; });
+
+		if (GetHandleFullRead(L)) {
+			PushEventBatchArray(L, a[2], events, [](const UnitLosEvent& e) { return e.allyTeam; });
+			PushEventBatchArray(L, a[3], events, [](const UnitLosEvent& e) { return e.unitDefID; });
+		}
+
+		RunCallIn(L, cmdStr, GetHandleFullRead(L)? 5: 3, 0);
+	}
+
+	if (unitEnteredLosBatch.empty()) {
+		events.clear();
+		events.swap(unitEnteredLosBatch);
+	}
+}
+
+/*** Called at the end of a sim stage with the ProjectileCreated events raised during it.
+ *
+ * @function ProjectileCreatedBatch
+ *
+ * Only for weaponDefIDs registered via Script.SetWatchWeapon, as ProjectileCreated.
+ *
+ * @number count
+ * @tparam {number,...} proIDs
+ * @tparam {number,...} proOwnerIDs -1 if the projectile has no owner
+ * @tparam {number,...} weaponDefIDs
+ */
+void CLuaHandle::RunProjectileCreatedBatch()
+{
+	LUA_CALL_IN_CHECK(L);
+	luaL_checkstack(L, 4 + 2, __func__);
+
+	static const LuaHashString cmdStr("ProjectileCreatedBatch");
+
+	std::vector<ProjectileCreatedEvent> events;
+	events.swap(projectileCreatedBatch);
+
+	if (cmdStr.GetGlobalFunc(L)) {
+		auto& a = projectileCreatedBatchArrays;
+
+		lua_pushnumber(L, events.size());
+		PushEventBatchArray(L, a[0], events, [](const ProjectileCreatedEvent& e) { return e.projectileID; });
+		PushEventBatchArray(L, a[1], events, [](const ProjectileCreatedEvent& e) { return e.ownerID; });
+		PushEventBatchArray(L, a[2], events, [](const ProjectileCreatedEvent& e) { return e.weaponDefID; });
+
+		RunCallIn(L, cmdStr, 4, 0);
+	}
+
+	if (projectileCreatedBatch.empty()) {
+		events.clear();
+		events.swap(projectileCreatedBatch);
+	}
+}
+
 /******************************************************************************/
 
 /*** Called when an explosion occurs.
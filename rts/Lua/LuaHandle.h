@@ -2,6 +2,7 @@
 
 #ifndef LUA_HANDLE_H
 #define LUA_HANDLE_H
+#include <array>
 #include <cinttypes>
 
 #include "System/EventClient.h"
@@ -190,6 +191,18 @@ class CLuaHandle : public CEventClient
 		void StockpileChanged(const CUnit* owner,
 		                      const CWeapon* weapon, int oldCount) override;
 
+		void UnitDamagedBatch(
+			const CUnit* unit,
+			const CUnit* attacker,
+			float damage,
+			int weaponDefID,
+			int projectileID,
+			bool paralyzer
+		) override;
+		void UnitEnteredLosBatch(const CUnit* unit, int allyTeam) override;
+		void ProjectileCreatedBatch(const CProjectile* p) override;
+		void FlushEventBatches() override;
+
 		void Save(zipFile archive) override;
 
 		void UnsyncedHeightMapUpdate(const SRectangle& rect) override;
@@ -315,6 +328,11 @@ class CLuaHandle : public CEventClient
 		void LosCallIn(const LuaHashString& hs, const CUnit* unit, int allyTeam);
 		void UnitCallIn(const LuaHashString& hs, const CUnit* unit);
 
+		void RunUnitDamagedBatch();
+		void RunUnitEnteredLosBatch();
+		void RunProjectileCreatedBatch();
+		void ClearEventBatches();
+
 		void RunDrawCallIn(const LuaHashString& hs);
 
 		void DrawObjectsLua(std::initializer_list<bool> bools, const char* func);
@@ -341,6 +359,47 @@ class CLuaHandle : public CEventClient
 		std::vector<bool> watchExplosionDefs;   // callin masks for Explosion
 		std::vector<bool> watchAllowTargetDefs; // callin masks for AllowWeapon*Target*
 
+		// events queued for the *Batch call-ins, in the order they were raised;
+		// attacker fields are -1 where UnitDamaged would pass nil
+		struct UnitDamagedEvent {
+			int unitID;
+			int unitDefID;
+			int unitTeam;
+			float damage;
+			bool paralyzer;
+			int weaponDefID;
+			int projectileID;
+			int attackerID;
+			int attackerDefID;
+			int attackerTeam;
+		};
+		struct UnitLosEvent {
+			int unitID;
+			int unitTeam;
+			int allyTeam;
+			int unitDefID;
+		};
+		struct ProjectileCreatedEvent {
+			int projectileID;
+			int ownerID;
+			int weaponDefID;
+		};
+
+		std::vector<UnitDamagedEvent> unitDamagedBatch;
+		std::vector<UnitLosEvent> unitEnteredLosBatch;
+		std::vector<ProjectileCreatedEvent> projectileCreatedBatch;
+
+		// registry references to the tables passed to the *Batch call-ins,
+		// one per argument, refilled by every call instead of reallocated
+		struct EventBatchArray {
+			int ref = LUA_NOREF;
+			size_t size = 0;
+		};
+
+		std::array<EventBatchArray, 10> unitDamagedBatchArrays;
+		std::array<EventBatchArray, 4> unitEnteredLosBatchArrays;
+		std::array<EventBatchArray, 3> projectileCreatedBatchArrays;
+
 	private: // call-outs
 		static int KillActiveHandle(lua_State* L);
 		static int CallOutGetName(lua_State* L);
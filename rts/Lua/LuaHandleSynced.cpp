@@ -6,6 +6,7 @@
 
 #include "LuaUtils.h"
 #include "LuaArchive.h"
+#include "LuaBytecodeCache.h"
 #include "LuaCallInCheck.h"
 #include "LuaConfig.h"
 #include "LuaConstGL.h"
@@ -2290,7 +2291,12 @@ int CSplitLuaHandle::LoadStringData(lua_State* L)
 	const char *str    = luaL_checklstring(L, 1, &len);
 	const char *chunkname = luaL_optstring(L, 2, str);
 
-	if (luaL_loadbuffer(L, str, len, chunkname) != 0) {
+	// gadgets are loaded by name, unnamed chunks are mostly generated at runtime
+	const int error = lua_isstring(L, 2)?
+		LuaBytecodeCache::LoadNamedString(L, str, len, chunkname):
+		luaL_loadbuffer(L, str, len, chunkname);
+
+	if (error != 0) {
 		lua_pushnil(L);
 		lua_insert(L, -2);
 		return 2; // nil, then the error message
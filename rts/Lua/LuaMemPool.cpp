@@ -2,7 +2,8 @@
 
 #include <algorithm> // std::min
 #include <cstdint> // std::uint8_t
-#include <cstring> // std::mem{cpy,set}
+#include <cstdlib> // std::{malloc,realloc,free}
+#include <cstring> // std::memcpy
 #include <new>
 
 #include "LuaMemPool.h"
@@ -64,10 +65,15 @@ void LuaMemPool::ReleasePtr(LuaMemPool* p, const CLuaHandle* o)
 	gCount -= (o != nullptr);
 
 	if (p == GetSharedPtr()) {
-		p->GetSharedCount() -= 1;
+		if ((p->GetSharedCount() -= 1) == 0)
+			p->Clear();
+
 		return;
 	}
 
+	// the state using p has been closed, drop all its pages at once
+	p->Clear();
+
 	gMutex.lock();
 	gIndcs.push_back(p->GetGlobalIndex());
 	gMutex.unlock();
@@ -93,131 +99,191 @@ void LuaMemPool::KillStatic()
 LuaMemPool::LuaMemPool(bool isEnabled): LuaMemPool(size_t(-1)) { assert(isEnabled == LuaMemPool::enabled); }
 LuaMemPool::LuaMemPool(size_t lmpIndex): globalIndex(lmpIndex)
 {
-	RECOIL_DETAILED_TRACY_ZONE;
-	if (!LuaMemPool::enabled)
-		return;
-
-	luaMemPoolImpl = std::make_unique<LuaMemPool::LuaMemPoolImpl>();
+	// blocks are carved from malloc'ed pages at multiples of SIZE_CLASS_STEP
+	static_assert((SIZE_CLASS_STEP % alignof(std::max_align_t)) == 0 || (alignof(std::max_align_t) % SIZE_CLASS_STEP) == 0, "pooled blocks would be misaligned");
+	static_assert(SIZE_CLASS_STEP >= sizeof(void*), "freed blocks must be able to hold a pointer");
 }
 
 void LuaMemPool::Clear()
 {
 	RECOIL_DETAILED_TRACY_ZONE;
-	//allocStats = {};
+	for (void* page: pages) {
+		std::free(page);
+	}
+
+	pages.clear();
+
+	sizeClasses = {};
+	stats = {};
 }
 
-void* LuaMemPool::Alloc(size_t size)
+
+void* LuaMemPool::AllocPooled(size_t sizeClass)
 {
-	RECOIL_DETAILED_TRACY_ZONE;
-	if (!LuaMemPool::enabled) {
-		allocStats[STAT_NAE] += 1 * (size > 0);
-		allocStats[STAT_NBE] += size;
-		auto t0 = spring_now();
-		void* ptr = ::operator new(size);
-		allocStats[STAT_NTE] += (spring_now() - t0).toMicroSecsi();
-		return ptr;
-	}
+	SizeClass& sc = sizeClasses[sizeClass];
+	SizeClassStats& scs = stats[sizeClass];
+
+	const size_t classSize = GetClassSize(sizeClass);
 
-	auto t0 = spring_now();
-	auto* ptr = luaMemPoolImpl->allocMem(size);
-	
-	if (size > NUM_BUCKETS * BUCKET_STEP) {
-		allocStats[STAT_NAE] += 1 * (size > 0);
-		allocStats[STAT_NBE] += size;
-		allocStats[STAT_NTE] += (spring_now() - t0).toMicroSecsi();
-	} else if (luaMemPoolImpl->isAllocInternal(ptr)) {
-		allocStats[STAT_NAI] += 1 * (size > 0);
-		allocStats[STAT_NBI] += size;
-		allocStats[STAT_NTI] += (spring_now() - t0).toMicroSecsi();
+	void* ptr = sc.freeList;
+
+	if (ptr != nullptr) {
+		sc.freeList = *static_cast<void**>(ptr);
 	} else {
-		allocStats[STAT_NAF] += 1 * (size > 0);
-		allocStats[STAT_NBF] += size;
-		allocStats[STAT_NTF] += (spring_now() - t0).toMicroSecsi();
+		if (static_cast<size_t>(sc.pageEnd - sc.pageCur) < classSize) {
+			uint8_t* page = static_cast<uint8_t*>(std::malloc(POOL_PAGE_SIZE));
+
+			if (page == nullptr)
+				return nullptr;
+
+			pages.push_back(page);
+
+			sc.pageCur = page;
+			sc.pageEnd = page + POOL_PAGE_SIZE;
+
+			scs.numPages += 1;
+		}
+
+		ptr = sc.pageCur;
+		sc.pageCur += classSize;
 	}
 
+	scs.numAllocs += 1;
+	scs.liveBytes += classSize;
 	return ptr;
 }
 
+void LuaMemPool::FreePooled(void* ptr, size_t sizeClass)
+{
+	SizeClass& sc = sizeClasses[sizeClass];
+	SizeClassStats& scs = stats[sizeClass];
+
+	*static_cast<void**>(ptr) = sc.freeList;
+	sc.freeList = ptr;
+
+	scs.numFrees += 1;
+	scs.liveBytes -= GetClassSize(sizeClass);
+}
+
+
+void* LuaMemPool::AllocExternal(size_t size)
+{
+	void* ptr = std::malloc(size);
+
+	if (ptr == nullptr)
+		return nullptr;
+
+	stats[NUM_SIZE_CLASSES].numAllocs += 1;
+	stats[NUM_SIZE_CLASSES].liveBytes += size;
+	return ptr;
+}
+
+void LuaMemPool::FreeExternal(void* ptr, size_t size)
+{
+	std::free(ptr);
+
+	stats[NUM_SIZE_CLASSES].numFrees += 1;
+	stats[NUM_SIZE_CLASSES].liveBytes -= size;
+}
+
+
+void* LuaMemPool::Alloc(size_t size)
+{
+	if (!LuaMemPool::enabled || size > MAX_POOLED_SIZE)
+		return (AllocExternal(size));
+
+	return (AllocPooled(GetSizeClass(size)));
+}
+
 void* LuaMemPool::Realloc(void* ptr, size_t nsize, size_t osize)
 {
-	RECOIL_DETAILED_TRACY_ZONE;
 	if (ptr == nullptr || osize == 0)
 		return Alloc(nsize);
 
-	if (!LuaMemPool::enabled) {
-		void* newPtr = ::operator new(nsize);
+	const bool oldPooled = (LuaMemPool::enabled && osize <= MAX_POOLED_SIZE);
+	const bool newPooled = (LuaMemPool::enabled && nsize <= MAX_POOLED_SIZE);
+
+	if (!oldPooled && !newPooled) {
+		void* newPtr = std::realloc(ptr, nsize);
 
 		if (newPtr == nullptr)
 			return nullptr;
 
-		allocStats[STAT_NBE] -= osize;
-		allocStats[STAT_NBE] += nsize;
-
-		auto t0 = spring_now();
-		std::memcpy(newPtr, ptr, std::min(nsize, osize));
-		std::memset(ptr, 0, osize);
-		::operator delete(ptr);
-		allocStats[STAT_NTE] += (spring_now() - t0).toMicroSecsi();
-
+		// counted as a free plus an alloc, such that allocs - frees remains the number of live blocks
+		stats[NUM_SIZE_CLASSES].numAllocs += 1;
+		stats[NUM_SIZE_CLASSES].numFrees += 1;
+		stats[NUM_SIZE_CLASSES].liveBytes -= osize;
+		stats[NUM_SIZE_CLASSES].liveBytes += nsize;
 		return newPtr;
 	}
 
-	auto t0 = spring_now();
-	auto* ret = luaMemPoolImpl->reAllocMem(ptr, nsize);
-	if (nsize > NUM_BUCKETS * BUCKET_STEP) {
-		allocStats[STAT_NAE] += 1 * (nsize > 0);
-		allocStats[STAT_NBE] += nsize;
-		allocStats[STAT_NTE] += (spring_now() - t0).toMicroSecsi();
-	}
-	else if (luaMemPoolImpl->isAllocInternal(ret)) {
-		allocStats[STAT_NAI] += 1 * (nsize > 0);
-		allocStats[STAT_NBI] += nsize;
-		allocStats[STAT_NTI] += (spring_now() - t0).toMicroSecsi();
-	}
-	else {
-		allocStats[STAT_NAF] += 1 * (nsize > 0);
-		allocStats[STAT_NBF] += nsize;
-		allocStats[STAT_NTF] += (spring_now() - t0).toMicroSecsi();
-	}
-	return ret;
+	// block already has room
+	if (oldPooled && newPooled && GetSizeClass(osize) == GetSizeClass(nsize))
+		return ptr;
+
+	void* newPtr = Alloc(nsize);
+
+	if (newPtr == nullptr)
+		return nullptr;
+
+	std::memcpy(newPtr, ptr, std::min(nsize, osize));
+	Free(ptr, osize);
+	return newPtr;
 }
 
 void LuaMemPool::Free(void* ptr, size_t size)
 {
-	RECOIL_DETAILED_TRACY_ZONE;
-	if (!LuaMemPool::enabled) {
-		::operator delete(ptr);
+	if (ptr == nullptr)
+		return;
+
+	if (!LuaMemPool::enabled || size > MAX_POOLED_SIZE) {
+		FreeExternal(ptr, size);
 		return;
 	}
 
-	luaMemPoolImpl->freeMem(ptr);
+	FreePooled(ptr, GetSizeClass(size));
+}
+
+
+uint64_t LuaMemPool::GetNumAllocs() const
+{
+	uint64_t numAllocs = 0;
+
+	for (const SizeClassStats& scs: stats) {
+		numAllocs += scs.numAllocs;
+	}
+
+	return numAllocs;
 }
 
 void LuaMemPool::LogStats(const char* handle, const char* lctype)
 {
 	RECOIL_DETAILED_TRACY_ZONE;
-	static constexpr auto one = uint64_t(1);
-	const float intPerc = 100.0f * static_cast<float>(allocStats[STAT_NAI]) / static_cast<float>(std::max(allocStats[STAT_NAI] + allocStats[STAT_NAF] + allocStats[STAT_NAE], one));
-	const float avgAllocTimeI = static_cast<float>(allocStats[STAT_NTI]) / static_cast<float>(std::max(allocStats[STAT_NAI], one));
-	const float avgAllocTimeF = static_cast<float>(allocStats[STAT_NTF]) / static_cast<float>(std::max(allocStats[STAT_NAF], one));
-	const float avgAllocTimeE = static_cast<float>(allocStats[STAT_NTE]) / static_cast<float>(std::max(allocStats[STAT_NAE], one));
+	const SizeClassStats& ext = stats[NUM_SIZE_CLASSES];
+
+	uint64_t numPooledAllocs = 0;
+	uint64_t numPooledBytes = 0;
+
+	for (size_t i = 0; i < NUM_SIZE_CLASSES; i++) {
+		numPooledAllocs += stats[i].numAllocs;
+		numPooledBytes += stats[i].liveBytes;
+	}
+
+	const float intPerc = 100.0f * static_cast<float>(numPooledAllocs) / static_cast<float>(std::max(numPooledAllocs + ext.numAllocs, uint64_t(1)));
+
 	std::string msg = fmt::sprintf(
-		"[LuaMemPool::%s][handle=%s (%s)] index=%u numAllocs{int+, int-, ext, int_p}={%u, %u, %u, %.1f} allocedSize{int+, int-, ext}={%u, %u, %u}, avgAllocTime{int+, int-, ext}={%.4f, %.4f, %.4f}",
+		"[LuaMemPool::%s][handle=%s (%s)] index=%u numAllocs{int, ext, int_p}={%u, %u, %.1f} liveSize{int, ext}={%u, %u} pages={%u, %uKB}",
 		__func__,
 		handle,
 		lctype,
 		globalIndex,
-		allocStats[STAT_NAI],
-		allocStats[STAT_NAF],
-		allocStats[STAT_NAE],
+		numPooledAllocs,
+		ext.numAllocs,
 		intPerc,
-		allocStats[STAT_NBI],
-		allocStats[STAT_NBF],
-		allocStats[STAT_NBE],
-		avgAllocTimeI,
-		avgAllocTimeF,
-		avgAllocTimeE
+		numPooledBytes,
+		ext.liveBytes,
+		pages.size(),
+		pages.size() * (POOL_PAGE_SIZE / 1024)
 	);
 	LOG("%s", msg.c_str());
-	allocStats = {};
 }
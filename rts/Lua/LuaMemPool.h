@@ -2,30 +2,47 @@
 
 #pragma once
 
+#include <array>
 #include <cstddef>
+#include <cstdint>
 #include <vector>
 #include <memory>
 
-#include "System/bitops.h"
-#include "System/MemPoolTypes.h"
-#include "System/UnorderedMap.hpp"
-
-#define LMP_USE_CHUNK_TABLE 0
-
 class CLuaHandle;
+
+/**
+ * Allocator of a Lua state (see spring_lua_alloc).
+ *
+ * Blocks of up to MAX_POOLED_SIZE bytes are rounded up to a multiple of
+ * SIZE_CLASS_STEP and carved from POOL_PAGE_SIZE pages owned by the pool, each
+ * size class keeping its own list of freed blocks; Lua passes the size of
+ * every block it frees or resizes so no per-block header is needed. Larger
+ * blocks are passed on to malloc. Pages are only returned when the pool is
+ * cleared, i.e. when the state(s) using it have been closed.
+ */
 class LuaMemPool {
 public:
-	explicit LuaMemPool(bool isEnabled);
-	explicit LuaMemPool(size_t lmpIndex);
+	static constexpr size_t SIZE_CLASS_STEP = 16;
+	static constexpr size_t NUM_SIZE_CLASSES = 32;
+	static constexpr size_t MAX_POOLED_SIZE = SIZE_CLASS_STEP * NUM_SIZE_CLASSES;
+	static constexpr size_t POOL_PAGE_SIZE = 64 * 1024;
+
+	struct SizeClassStats {
+		uint64_t numAllocs = 0;
+		uint64_t numFrees = 0;
+		/// rounded up to the class size for pooled blocks
+		uint64_t liveBytes = 0;
+		uint64_t numPages = 0;
+	};
 
-	~LuaMemPool() {
-		Clear();
+	/// one entry per size class, the last for blocks larger than MAX_POOLED_SIZE
+	using Stats = std::array<SizeClassStats, NUM_SIZE_CLASSES + 1>;
 
-		if (!LuaMemPool::enabled)
-			return;
+public:
+	explicit LuaMemPool(bool isEnabled);
+	explicit LuaMemPool(size_t lmpIndex);
 
-		luaMemPoolImpl = nullptr;
-	}
+	~LuaMemPool() { Clear(); }
 
 	LuaMemPool(const LuaMemPool& p) = delete;
 	LuaMemPool(LuaMemPool&& p) = delete;
@@ -44,7 +61,11 @@ public:
 	static void InitStatic(bool enable);
 	static void KillStatic();
 
+	static constexpr size_t GetSizeClass(size_t size) { return ((size - (size > 0)) / SIZE_CLASS_STEP); }
+	static constexpr size_t GetClassSize(size_t sizeClass) { return ((sizeClass + 1) * SIZE_CLASS_STEP); }
+
 public:
+	/// releases all pages at once, only valid when no block is in use
 	void Clear();
 	void* Alloc(size_t size);
 	void* Realloc(void* ptr, size_t nsize, size_t osize);
@@ -52,6 +73,13 @@ public:
 
 	void LogStats(const char* handle, const char* lctype);
 
+	/// number of (re)allocations made through the pool since it was acquired
+	uint64_t GetNumAllocs() const;
+
+	/// counters only grow until the pool is cleared, callers that want
+	/// rates keep their own copy of a previous call to compare against
+	const Stats& GetStats() const { return stats; }
+
 	size_t  GetGlobalIndex() const { return globalIndex; }
 	size_t  GetSharedCount() const { return sharedCount; }
 	size_t& GetSharedCount()       { return sharedCount; }
@@ -59,25 +87,24 @@ public:
 public:
 	static bool enabled;
 private:
-	static constexpr uint32_t NUM_BUCKETS = 32;
-	static constexpr uint32_t BUCKET_STEP = 16;
-	using LuaMemPoolImpl = PassThroughPool<NUM_BUCKETS, 4 * (1024 * 1024)>;
-	std::unique_ptr<LuaMemPoolImpl> luaMemPoolImpl;
-
-	enum {
-		STAT_NAI = 0, // number of internal allocs
-		STAT_NAF = 1, // number of int fail allocs
-		STAT_NAE = 2, // number of external allocs
-		STAT_NBI = 3, // number of bytes alloced (internal)
-		STAT_NBF = 4, // number of bytes alloced (int fail)
-		STAT_NBE = 5, // number of bytes alloced (external)
-		STAT_NTI = 6, // cumulative time spent on internal allocs
-		STAT_NTF = 7, // cumulative time spent on int fail allocs
-		STAT_NTE = 8, // cumulative time spent on external allocs
+	struct SizeClass {
+		void* freeList = nullptr;
+
+		uint8_t* pageCur = nullptr;
+		uint8_t* pageEnd = nullptr;
 	};
 
-	std::array<uint64_t, 9> allocStats = { 0, 0, 0, 0, 0 };
+	void* AllocPooled(size_t sizeClass);
+	void FreePooled(void* ptr, size_t sizeClass);
+
+	void* AllocExternal(size_t size);
+	void FreeExternal(void* ptr, size_t size);
+
+	std::array<SizeClass, NUM_SIZE_CLASSES> sizeClasses;
+	std::vector<void*> pages;
+
+	Stats stats;
 
 	size_t globalIndex = 0;
 	size_t sharedCount = 0;
-};
\ No newline at end of file
+};
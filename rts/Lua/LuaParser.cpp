@@ -12,6 +12,7 @@
 #include "System/float4.h"
 #include "LuaInclude.h"
 
+#include "LuaBytecodeCache.h"
 #include "LuaConstGame.h"
 #include "LuaConstEngine.h"
 #include "LuaIO.h"
@@ -188,6 +189,7 @@ void LuaParser::SetupEnv(bool isSyncedCtxt, bool isDefsParser)
 	AddFunc("Include",    Include);
 	AddFunc("LoadFile",   LoadFile);
 	AddFunc("FileExists", FileExists);
+	AddFunc("PrefetchFiles", PrefetchFiles);
 	EndTable();
 
 	GetTable("LOG");
@@ -237,7 +239,7 @@ bool LuaParser::Execute()
 	int errorNum = 0;
 
 	tracy::LuaRemove(code.data());
-	if ((errorNum = luaL_loadbuffer(L, code.c_str(), code.size(), codeLabel.c_str())) != 0) {
+	if ((errorNum = LuaBytecodeCache::LoadBuffer(L, code.c_str(), code.size(), codeLabel.c_str())) != 0) {
 		SNPRINTF(errorBuf, sizeof(errorBuf), "[loadbuf] error %d (\"%s\") in %s", errorNum, lua_tostring(L, -1), codeLabel.c_str());
 		LUA_CLOSE(&L);
 
@@ -615,6 +617,25 @@ int LuaParser::SubDirs(lua_State* L)
 
 /******************************************************************************/
 
+int LuaParser::PrefetchFiles(lua_State* L)
+{
+	const LuaParser* currentParser = GetLuaParser(L);
+
+	std::vector<std::string> fileNames;
+
+	luaL_checktype(L, 1, LUA_TTABLE);
+	LuaUtils::ParseStringVector(L, 1, fileNames);
+
+	spring::VectorEraseAllIf(fileNames, [](const std::string& fileName) { return !LuaIO::IsSimplePath(fileName); });
+
+	const std::string& modes = CFileHandler::AllowModes(luaL_optstring(L, 2, currentParser->accessModes.c_str()), currentParser->accessModes);
+
+	lua_pushnumber(L, CFileHandler::PrefetchFiles(fileNames, modes));
+	return 1;
+}
+
+/******************************************************************************/
+
 int LuaParser::Include(lua_State* L)
 {
 	const LuaParser* currentParser = GetLuaParser(L);
@@ -644,7 +665,7 @@ int LuaParser::Include(lua_State* L)
 	}
 
 	tracy::LuaRemove(code.data());
-	int error = luaL_loadbuffer(L, code.c_str(), code.size(), filename.c_str());
+	int error = LuaBytecodeCache::LoadBuffer(L, code.c_str(), code.size(), filename.c_str());
 	if (error != 0) {
 		char buf[1024];
 		SNPRINTF(buf, sizeof(buf), "error = %i, %s, %s\n", error, filename.c_str(), lua_tostring(L, -1));
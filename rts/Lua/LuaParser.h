@@ -209,6 +209,7 @@ private:
 	static int Include(lua_State* L);
 	static int LoadFile(lua_State* L);
 	static int FileExists(lua_State* L);
+	static int PrefetchFiles(lua_State* L);
 };
 
 
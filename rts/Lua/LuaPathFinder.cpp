@@ -69,6 +69,7 @@ bool LuaPathFinder::PushEntries(lua_State* L)
 	REGISTER_LUA_CFUNC(GetPathNodeCosts);
 	REGISTER_LUA_CFUNC(SetPathNodeCost);
 	REGISTER_LUA_CFUNC(GetPathNodeCost);
+	REGISTER_LUA_CFUNC(GetNumQueuedPathUpdates);
 
 	return true;
 }
@@ -410,5 +411,15 @@ int LuaPathFinder::GetPathNodeCost(lua_State* L)
 	return 1;
 }
 
+int LuaPathFinder::GetNumQueuedPathUpdates(lua_State* L)
+{
+	// HAPFS reports the outstanding (med-res, low-res) block updates, QTPFS its dirty-path rates
+	const int2 numQueuedUpdates = pathManager->GetNumQueuedUpdates();
+
+	lua_pushnumber(L, numQueuedUpdates.x);
+	lua_pushnumber(L, numQueuedUpdates.y);
+	return 2;
+}
+
 /******************************************************************************/
 /******************************************************************************/
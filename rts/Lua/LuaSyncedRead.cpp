@@ -77,6 +77,7 @@
 #include "System/FileSystem/FileSystem.h"
 #include "System/StringUtil.h"
 
+#include <array>
 #include <cctype>
 #include <type_traits>
 
@@ -231,6 +232,7 @@ bool LuaSyncedRead::PushEntries(lua_State* L)
 	REGISTER_LUA_CFUNC(GetUnitDirection);
 	REGISTER_LUA_CFUNC(GetUnitHeading);
 	REGISTER_LUA_CFUNC(GetUnitVelocity);
+	REGISTER_LUA_CFUNC(GetUnitsData);
 	REGISTER_LUA_CFUNC(GetUnitBuildFacing);
 	REGISTER_LUA_CFUNC(GetUnitIsBuilding);
 	REGISTER_LUA_CFUNC(GetUnitWorkerTask);
@@ -2909,6 +2911,103 @@ int LuaSyncedRead::GetTeamUnitCount(lua_State* L)
 		}                                                           \
 	}
 
+// pushes the table passed at <argIndex> to be overwritten by a result, or
+// a new one if none was (or a boolean if <allowBool>); returns its index
+static int PushResultTable(lua_State* L, int argIndex, size_t size, bool allowBool)
+{
+	if (lua_isnoneornil(L, argIndex) || (allowBool && lua_isboolean(L, argIndex))) {
+		lua_createtable(L, size, 0);
+	} else {
+		luaL_checktype(L, argIndex, LUA_TTABLE);
+		lua_pushvalue(L, argIndex);
+	}
+
+	return lua_gettop(L);
+}
+
+// clears the entries of a reused result table past the <size> written ones
+static void ClearTableTail(lua_State* L, int index, size_t size)
+{
+	for (size_t i = lua_objlen(L, index); i > size; i--) {
+		lua_pushnil(L);
+		lua_rawseti(L, index, i);
+	}
+}
+
+// Output of the GetUnitsIn{Rectangle,Box,Cylinder,Sphere} queries: the unitIDs
+// table, either the one passed at <argIndex> (overwritten, entries beyond the
+// result are cleared) or a new one; optionally followed by a table holding the
+// units' base positions as returned by GetUnitPosition, three entries per unit.
+// Reusing tables spares widgets polling every frame the allocations and GC
+// work of a fresh result per call, and the positions a GetUnitPosition each.
+class UnitQueryResult {
+public:
+	UnitQueryResult(lua_State* L, int argIndex, size_t maxCount): L(L) {
+		// positions are optional, a table to reuse or true for a new one
+		withPositions = lua_istable(L, argIndex + 1) || luaL_optboolean(L, argIndex + 1, false);
+
+		unitIDsIndex = PushResultTable(L, argIndex, maxCount, false);
+
+		if (!withPositions)
+			return;
+
+		positionsIndex = PushResultTable(L, argIndex + 1, maxCount * 3, true);
+		readAllyTeam = CLuaHandle::GetHandleReadAllyTeam(L);
+		fullRead = CLuaHandle::GetHandleFullRead(L);
+	}
+
+	void Push(const CUnit* unit) {
+		lua_pushnumber(L, unit->id);
+		lua_rawseti(L, unitIDsIndex, ++count);
+
+		if (!withPositions)
+			return;
+
+		float3 errorVec;
+
+		if (!LuaUtils::IsAllyUnit(L, unit))
+			errorVec = unit->GetLuaErrorVector(readAllyTeam, fullRead);
+
+		for (int i = 0; i < 3; i++) {
+			lua_pushnumber(L, unit->pos[i] + errorVec[i]);
+			lua_rawseti(L, positionsIndex, (count - 1) * 3 + i + 1);
+		}
+	}
+
+	// leaves the table(s) on top of the stack, returns their number
+	int Finish() {
+		ClearTableTail(L, unitIDsIndex, count);
+
+		if (!withPositions)
+			return 1;
+
+		ClearTableTail(L, positionsIndex, count * 3);
+		return 2;
+	}
+
+private:
+	lua_State* L;
+
+	int unitIDsIndex = 0;
+	int positionsIndex = 0;
+	int readAllyTeam = 0;
+	unsigned int count = 0;
+
+	bool withPositions = false;
+	bool fullRead = false;
+};
+
+// Macro Requirements:
+//   L, units, result
+
+#define LOOP_UNIT_QUERY(ALLEGIANCE_TEST, CUSTOM_TEST) \
+	for (const CUnit* unit: units) {                  \
+		ALLEGIANCE_TEST;                              \
+		CUSTOM_TEST;                                  \
+                                                      \
+		result.Push(unit);                            \
+	}
+
 // Macro Requirements:
 //   unit
 //   readTeam   for MY_UNIT_TEST
@@ -2945,7 +3044,11 @@ int LuaSyncedRead::GetTeamUnitCount(lua_State* L)
  * @number xmax
  * @number zmax
  * @number[opt] allegiance
+ * @tparam[opt] table unitIDs table to overwrite with the result instead of returning a new one
+ * @tparam[opt] table|bool positions when set, also return the units' base positions as
+ *   {x1, y1, z1, x2, ...}, written to this table if one is passed
  * @treturn {number,...} unitIDs
+ * @treturn[opt] {number,...} positions
  */
 int LuaSyncedRead::GetUnitsInRectangle(lua_State* L)
 {
@@ -2965,28 +3068,30 @@ int LuaSyncedRead::GetUnitsInRectangle(lua_State* L)
 	quadField.GetUnitsExact(qfQuery, mins, maxs);
 	const auto& units = (*qfQuery.units);
 
+	UnitQueryResult result(L, 6, units.size());
+
 	if (allegiance >= 0) {
 		if (LuaUtils::IsAlliedTeam(L, allegiance)) {
-			LOOP_UNIT_CONTAINER(SIMPLE_TEAM_TEST, RECTANGLE_TEST, true);
+			LOOP_UNIT_QUERY(SIMPLE_TEAM_TEST, RECTANGLE_TEST);
 		} else {
-			LOOP_UNIT_CONTAINER(VISIBLE_TEAM_TEST, RECTANGLE_TEST, true);
+			LOOP_UNIT_QUERY(VISIBLE_TEAM_TEST, RECTANGLE_TEST);
 		}
 	}
 	else if (allegiance == LuaUtils::MyUnits) {
 		const int readTeam = CLuaHandle::GetHandleReadTeam(L);
-		LOOP_UNIT_CONTAINER(MY_UNIT_TEST, RECTANGLE_TEST, true);
+		LOOP_UNIT_QUERY(MY_UNIT_TEST, RECTANGLE_TEST);
 	}
 	else if (allegiance == LuaUtils::AllyUnits) {
-		LOOP_UNIT_CONTAINER(ALLY_UNIT_TEST, RECTANGLE_TEST, true);
+		LOOP_UNIT_QUERY(ALLY_UNIT_TEST, RECTANGLE_TEST);
 	}
 	else if (allegiance == LuaUtils::EnemyUnits) {
-		LOOP_UNIT_CONTAINER(ENEMY_UNIT_TEST, RECTANGLE_TEST, true);
+		LOOP_UNIT_QUERY(ENEMY_UNIT_TEST, RECTANGLE_TEST);
 	}
 	else { // AllUnits
-		LOOP_UNIT_CONTAINER(VISIBLE_TEST, RECTANGLE_TEST, true);
+		LOOP_UNIT_QUERY(VISIBLE_TEST, RECTANGLE_TEST);
 	}
 
-	return 1;
+	return (result.Finish());
 }
 
 
@@ -3000,7 +3105,11 @@ int LuaSyncedRead::GetUnitsInRectangle(lua_State* L)
  * @number ymax
  * @number zmax
  * @number[opt] allegiance
+ * @tparam[opt] table unitIDs table to overwrite with the result instead of returning a new one
+ * @tparam[opt] table|bool positions when set, also return the units' base positions as
+ *   {x1, y1, z1, x2, ...}, written to this table if one is passed
  * @treturn {number,...} unitIDs
+ * @treturn[opt] {number,...} positions
  */
 int LuaSyncedRead::GetUnitsInBox(lua_State* L)
 {
@@ -3026,28 +3135,30 @@ int LuaSyncedRead::GetUnitsInBox(lua_State* L)
 	quadField.GetUnitsExact(qfQuery, mins, maxs);
 	const auto& units = (*qfQuery.units);
 
+	UnitQueryResult result(L, 8, units.size());
+
 	if (allegiance >= 0) {
 		if (LuaUtils::IsAlliedTeam(L, allegiance)) {
-			LOOP_UNIT_CONTAINER(SIMPLE_TEAM_TEST, BOX_TEST, true);
+			LOOP_UNIT_QUERY(SIMPLE_TEAM_TEST, BOX_TEST);
 		} else {
-			LOOP_UNIT_CONTAINER(VISIBLE_TEAM_TEST, BOX_TEST, true);
+			LOOP_UNIT_QUERY(VISIBLE_TEAM_TEST, BOX_TEST);
 		}
 	}
 	else if (allegiance == LuaUtils::MyUnits) {
 		const int readTeam = CLuaHandle::GetHandleReadTeam(L);
-		LOOP_UNIT_CONTAINER(MY_UNIT_TEST, BOX_TEST, true);
+		LOOP_UNIT_QUERY(MY_UNIT_TEST, BOX_TEST);
 	}
 	else if (allegiance == LuaUtils::AllyUnits) {
-		LOOP_UNIT_CONTAINER(ALLY_UNIT_TEST, BOX_TEST, true);
+		LOOP_UNIT_QUERY(ALLY_UNIT_TEST, BOX_TEST);
 	}
 	else if (allegiance == LuaUtils::EnemyUnits) {
-		LOOP_UNIT_CONTAINER(ENEMY_UNIT_TEST, BOX_TEST, true);
+		LOOP_UNIT_QUERY(ENEMY_UNIT_TEST, BOX_TEST);
 	}
 	else { // AllUnits
-		LOOP_UNIT_CONTAINER(VISIBLE_TEST, BOX_TEST, true);
+		LOOP_UNIT_QUERY(VISIBLE_TEST, BOX_TEST);
 	}
 
-	return 1;
+	return (result.Finish());
 }
 
 
@@ -3057,7 +3168,12 @@ int LuaSyncedRead::GetUnitsInBox(lua_State* L)
  * @number x
  * @number z
  * @number radius
+ * @number[opt] allegiance
+ * @tparam[opt] table unitIDs table to overwrite with the result instead of returning a new one
+ * @tparam[opt] table|bool positions when set, also return the units' base positions as
+ *   {x1, y1, z1, x2, ...}, written to this table if one is passed
  * @treturn {number,...} unitIDs
+ * @treturn[opt] {number,...} positions
  */
 int LuaSyncedRead::GetUnitsInCylinder(lua_State* L)
 {
@@ -3084,28 +3200,30 @@ int LuaSyncedRead::GetUnitsInCylinder(lua_State* L)
 	quadField.GetUnitsExact(qfQuery, mins, maxs);
 	const auto& units = (*qfQuery.units);
 
+	UnitQueryResult result(L, 5, units.size());
+
 	if (allegiance >= 0) {
 		if (LuaUtils::IsAlliedTeam(L, allegiance)) {
-			LOOP_UNIT_CONTAINER(SIMPLE_TEAM_TEST, CYLINDER_TEST, true);
+			LOOP_UNIT_QUERY(SIMPLE_TEAM_TEST, CYLINDER_TEST);
 		} else {
-			LOOP_UNIT_CONTAINER(VISIBLE_TEAM_TEST, CYLINDER_TEST, true);
+			LOOP_UNIT_QUERY(VISIBLE_TEAM_TEST, CYLINDER_TEST);
 		}
 	}
 	else if (allegiance == LuaUtils::MyUnits) {
 		const int readTeam = CLuaHandle::GetHandleReadTeam(L);
-		LOOP_UNIT_CONTAINER(MY_UNIT_TEST, CYLINDER_TEST, true);
+		LOOP_UNIT_QUERY(MY_UNIT_TEST, CYLINDER_TEST);
 	}
 	else if (allegiance == LuaUtils::AllyUnits) {
-		LOOP_UNIT_CONTAINER(ALLY_UNIT_TEST, CYLINDER_TEST, true);
+		LOOP_UNIT_QUERY(ALLY_UNIT_TEST, CYLINDER_TEST);
 	}
 	else if (allegiance == LuaUtils::EnemyUnits) {
-		LOOP_UNIT_CONTAINER(ENEMY_UNIT_TEST, CYLINDER_TEST, true);
+		LOOP_UNIT_QUERY(ENEMY_UNIT_TEST, CYLINDER_TEST);
 	}
 	else { // AllUnits
-		LOOP_UNIT_CONTAINER(VISIBLE_TEST, CYLINDER_TEST, true);
+		LOOP_UNIT_QUERY(VISIBLE_TEST, CYLINDER_TEST);
 	}
 
-	return 1;
+	return (result.Finish());
 }
 
 
@@ -3116,7 +3234,12 @@ int LuaSyncedRead::GetUnitsInCylinder(lua_State* L)
  * @number y
  * @number z
  * @number radius
+ * @number[opt] allegiance
+ * @tparam[opt] table unitIDs table to overwrite with the result instead of returning a new one
+ * @tparam[opt] table|bool positions when set, also return the units' base positions as
+ *   {x1, y1, z1, x2, ...}, written to this table if one is passed
  * @treturn {number,...} unitIDs
+ * @treturn[opt] {number,...} positions
  */
 int LuaSyncedRead::GetUnitsInSphere(lua_State* L)
 {
@@ -3147,28 +3270,30 @@ int LuaSyncedRead::GetUnitsInSphere(lua_State* L)
 	quadField.GetUnitsExact(qfQuery, mins, maxs);
 	const auto& units = (*qfQuery.units);
 
+	UnitQueryResult result(L, 6, units.size());
+
 	if (allegiance >= 0) {
 		if (LuaUtils::IsAlliedTeam(L, allegiance)) {
-			LOOP_UNIT_CONTAINER(SIMPLE_TEAM_TEST, SPHERE_TEST, true);
+			LOOP_UNIT_QUERY(SIMPLE_TEAM_TEST, SPHERE_TEST);
 		} else {
-			LOOP_UNIT_CONTAINER(VISIBLE_TEAM_TEST, SPHERE_TEST, true);
+			LOOP_UNIT_QUERY(VISIBLE_TEAM_TEST, SPHERE_TEST);
 		}
 	}
 	else if (allegiance == LuaUtils::MyUnits) {
 		const int readTeam = CLuaHandle::GetHandleReadTeam(L);
-		LOOP_UNIT_CONTAINER(MY_UNIT_TEST, SPHERE_TEST, true);
+		LOOP_UNIT_QUERY(MY_UNIT_TEST, SPHERE_TEST);
 	}
 	else if (allegiance == LuaUtils::AllyUnits) {
-		LOOP_UNIT_CONTAINER(ALLY_UNIT_TEST, SPHERE_TEST, true);
+		LOOP_UNIT_QUERY(ALLY_UNIT_TEST, SPHERE_TEST);
 	}
 	else if (allegiance == LuaUtils::EnemyUnits) {
-		LOOP_UNIT_CONTAINER(ENEMY_UNIT_TEST, SPHERE_TEST, true);
+		LOOP_UNIT_QUERY(ENEMY_UNIT_TEST, SPHERE_TEST);
 	}
 	else { // AllUnits
-		LOOP_UNIT_CONTAINER(VISIBLE_TEST, SPHERE_TEST, true);
+		LOOP_UNIT_QUERY(VISIBLE_TEST, SPHERE_TEST);
 	}
 
-	return 1;
+	return (result.Finish());
 }
 
 
@@ -4439,6 +4564,243 @@ int LuaSyncedRead::GetUnitVelocity(lua_State* L)
 }
 
 
+enum UnitDataField {
+	UNIT_DATA_ID       = 0,
+	UNIT_DATA_DEF_ID   = 1,
+	UNIT_DATA_TEAM     = 2,
+	UNIT_DATA_POSITION = 3,
+	UNIT_DATA_VELOCITY = 4,
+	UNIT_DATA_HEALTH   = 5,
+};
+
+static constexpr int UNIT_DATA_FIELD_SIZES[] = {1, 1, 1, 3, 4, 5};
+static constexpr int UNIT_DATA_MAX_FIELDS = 16;
+
+// writes one GetUnitsData row; all but the unitID entries are false for
+// units that do not exist or are not visible, and where the single-unit
+// getter of a field would return nil
+static void PushUnitDataRow(
+	lua_State* L,
+	int tableIndex,
+	unsigned int& count,
+	int unitID,
+	const CUnit* unit,
+	const std::array<UnitDataField, UNIT_DATA_MAX_FIELDS>& fields,
+	int numFields
+) {
+	const auto PushValue = [&](float v) {
+		lua_pushnumber(L, v);
+		lua_rawseti(L, tableIndex, ++count);
+	};
+	const auto PushFalse = [&](int n) {
+		for (int i = 0; i < n; i++) {
+			lua_pushboolean(L, false);
+			lua_rawseti(L, tableIndex, ++count);
+		}
+	};
+
+	if (unit != nullptr && !LuaUtils::IsUnitVisible(L, unit))
+		unit = nullptr;
+
+	// visibility tests are made once per unit rather than per field
+	const bool allyUnit = (unit != nullptr) && LuaUtils::IsAllyUnit(L, unit);
+	const bool inLos = (unit != nullptr) && (allyUnit || LuaUtils::IsUnitInLos(L, unit));
+
+	for (int i = 0; i < numFields; i++) {
+		const UnitDataField field = fields[i];
+
+		if (field == UNIT_DATA_ID) {
+			PushValue(unitID);
+			continue;
+		}
+
+		if (unit == nullptr) {
+			PushFalse(UNIT_DATA_FIELD_SIZES[field]);
+			continue;
+		}
+
+		switch (field) {
+			case UNIT_DATA_DEF_ID: {
+				if (allyUnit) {
+					PushValue(unit->unitDef->id);
+				} else if (LuaUtils::IsUnitTyped(L, unit)) {
+					PushValue(LuaUtils::EffectiveUnitDef(L, unit)->id);
+				} else {
+					PushFalse(1);
+				}
+			} break;
+
+			case UNIT_DATA_TEAM: {
+				PushValue(unit->team);
+			} break;
+
+			case UNIT_DATA_POSITION: {
+				float3 errorVec;
+
+				if (!allyUnit)
+					errorVec = unit->GetLuaErrorVector(CLuaHandle::GetHandleReadAllyTeam(L), CLuaHandle::GetHandleFullRead(L));
+
+				PushValue(unit->pos.x + errorVec.x);
+				PushValue(unit->pos.y + errorVec.y);
+				PushValue(unit->pos.z + errorVec.z);
+			} break;
+
+			case UNIT_DATA_VELOCITY: {
+				if (!inLos) {
+					PushFalse(4);
+					break;
+				}
+
+				PushValue(unit->speed.x);
+				PushValue(unit->speed.y);
+				PushValue(unit->speed.z);
+				PushValue(unit->speed.w);
+			} break;
+
+			case UNIT_DATA_HEALTH: {
+				if (!inLos) {
+					PushFalse(5);
+					break;
+				}
+
+				const UnitDef* ud = unit->unitDef;
+
+				if (ud->hideDamage && !allyUnit) {
+					PushFalse(3);
+				} else if (allyUnit || (ud->decoyDef == nullptr)) {
+					PushValue(unit->health);
+					PushValue(unit->maxHealth);
+					PushValue(unit->paralyzeDamage);
+				} else {
+					const float scale = (ud->decoyDef->health / ud->health);
+					PushValue(scale * unit->health);
+					PushValue(scale * unit->maxHealth);
+					PushValue(scale * unit->paralyzeDamage);
+				}
+
+				PushValue(unit->captureProgress);
+				PushValue(unit->buildProgress);
+			} break;
+
+			default: {
+				assert(false);
+			} break;
+		}
+	}
+}
+
+/***
+ *
+ * @function Spring.GetUnitsData
+ *
+ * Reads properties of many units in one call, rather than one call per unit
+ * and property. The result is a flat array with one row of `stride` entries
+ * per unit, holding the requested fields in the order they were given:
+ *
+ * - "unitID": 1 entry
+ * - "unitDefID": 1 entry, as GetUnitDefID
+ * - "team": 1 entry, as GetUnitTeam
+ * - "position": 3 entries, as GetUnitPosition
+ * - "velocity": 4 entries, as GetUnitVelocity
+ * - "health": 5 entries, as GetUnitHealth
+ *
+ * Entries are false where the single-unit getter would return nil; rows of
+ * unitIDs that are invalid or not visible are false except for the unitID.
+ *
+ * @tparam {number,...}|number|nil units unitIDs, one row each, or an allegiance
+ *   (see GetUnitsInRectangle) to get the rows of all visible units matching it
+ * @tparam {string,...} fields
+ * @tparam[opt] table result table to overwrite instead of returning a new one
+ * @treturn table result
+ * @treturn number numUnits
+ * @treturn number stride
+ */
+int LuaSyncedRead::GetUnitsData(lua_State* L)
+{
+	std::array<UnitDataField, UNIT_DATA_MAX_FIELDS> fields;
+
+	int numFields = 0;
+	int stride = 0;
+
+	luaL_checktype(L, 2, LUA_TTABLE);
+
+	for (int i = 1; ; i++) {
+		lua_rawgeti(L, 2, i);
+
+		if (lua_isnil(L, -1)) {
+			lua_pop(L, 1);
+			break;
+		}
+		if (numFields == UNIT_DATA_MAX_FIELDS)
+			luaL_error(L, "[%s] more than %d fields", __func__, UNIT_DATA_MAX_FIELDS);
+
+		const char* name = luaL_checkstring(L, -1);
+
+		switch (hashString(name)) {
+			case hashString("unitID"   ): { fields[numFields] = UNIT_DATA_ID      ; } break;
+			case hashString("unitDefID"): { fields[numFields] = UNIT_DATA_DEF_ID  ; } break;
+			case hashString("team"     ): { fields[numFields] = UNIT_DATA_TEAM    ; } break;
+			case hashString("position" ): { fields[numFields] = UNIT_DATA_POSITION; } break;
+			case hashString("velocity" ): { fields[numFields] = UNIT_DATA_VELOCITY; } break;
+			case hashString("health"   ): { fields[numFields] = UNIT_DATA_HEALTH  ; } break;
+			default: {
+				luaL_error(L, "[%s] unknown field \"%s\"", __func__, name);
+			} break;
+		}
+
+		stride += UNIT_DATA_FIELD_SIZES[fields[numFields++]];
+		lua_pop(L, 1);
+	}
+
+	unsigned int count = 0;
+	unsigned int numUnits = 0;
+
+	if (lua_istable(L, 1)) {
+		const size_t numUnitIDs = lua_objlen(L, 1);
+		const int tableIndex = PushResultTable(L, 3, numUnitIDs * stride, false);
+
+		for (size_t i = 1; i <= numUnitIDs; i++) {
+			lua_rawgeti(L, 1, i);
+			const int unitID = luaL_checkint(L, -1);
+			lua_pop(L, 1);
+
+			PushUnitDataRow(L, tableIndex, count, unitID, unitHandler.GetUnit(unitID), fields, numFields);
+		}
+
+		ClearTableTail(L, tableIndex, count);
+		lua_pushnumber(L, numUnitIDs);
+		lua_pushnumber(L, stride);
+		return 3;
+	}
+
+	const int allegiance = LuaUtils::ParseAllegiance(L, __func__, 1);
+	const int readTeam = CLuaHandle::GetHandleReadTeam(L);
+	const int readAllyTeam = CLuaHandle::GetHandleReadAllyTeam(L);
+
+	const auto& units = (allegiance >= 0)? unitHandler.GetUnitsByTeam(allegiance): unitHandler.GetActiveUnits();
+	const int tableIndex = PushResultTable(L, 3, units.size() * stride, false);
+
+	for (const CUnit* unit: units) {
+		if (allegiance == LuaUtils::MyUnits && unit->team != readTeam)
+			continue;
+		if (allegiance == LuaUtils::AllyUnits && unit->allyteam != readAllyTeam)
+			continue;
+		if (allegiance == LuaUtils::EnemyUnits && unit->allyteam == readAllyTeam)
+			continue;
+		if (!LuaUtils::IsUnitVisible(L, unit))
+			continue;
+
+		PushUnitDataRow(L, tableIndex, count, unit->id, unit, fields, numFields);
+		numUnits += 1;
+	}
+
+	ClearTableTail(L, tableIndex, count);
+	lua_pushnumber(L, numUnits);
+	lua_pushnumber(L, stride);
+	return 3;
+}
+
+
 /***
  *
  * @function Spring.GetUnitBuildFacing
@@ -6,6 +6,7 @@
 #include "LuaInclude.h"
 #include "LuaUnsyncedCtrl.h"
 #include "LuaArchive.h"
+#include "LuaBytecodeCache.h"
 #include "LuaCallInCheck.h"
 #include "LuaConstGL.h"
 #include "LuaConstCMD.h"
@@ -134,6 +135,7 @@ CLuaUI::CLuaUI()
 	lua_pushvalue(L, LUA_GLOBALSINDEX);
 
 	AddBasicCalls(L); // into Global
+	LuaPushNamedCFunc(L, "loadstring", LuaBytecodeCache::LoadString); // widgets are loaded through it
 
 	// load the spring libraries
 	if (!LoadCFunctions(L)                                                   ||
@@ -106,6 +106,7 @@ bool LuaUnsyncedRead::PushEntries(lua_State* L)
 	REGISTER_LUA_CFUNC(GetProfilerRecordNames);
 
 	REGISTER_LUA_CFUNC(GetLuaMemUsage);
+	REGISTER_LUA_CFUNC(GetLuaMemPoolStats);
 	REGISTER_LUA_CFUNC(GetVidMemUsage);
 
 	REGISTER_LUA_CFUNC(GetDrawFrame);
@@ -594,6 +595,8 @@ int LuaUnsyncedRead::GetProfilerRecordNames(lua_State* L)
  * @treturn number luaUnsyncedGlobalNumAllocs divided by 1000
  * @treturn number luaSyncedGlobalAllocedMem in kilobytes
  * @treturn number luaSyncedGlobalNumAllocs divided by 1000
+ * @treturn number luaHandlePoolNumAllocs allocations made through the handle's memory pool modulo 2^24,
+ *   which keeps it exact; the difference between two calls (modulo 2^24) counts those made in between
  */
 int LuaUnsyncedRead::GetLuaMemUsage(lua_State* L)
 {
@@ -629,7 +632,53 @@ int LuaUnsyncedRead::GetLuaMemUsage(lua_State* L)
 		lua_pushnumber(L, lgs.numLuaAllocs / 1000.0f);
 	}
 
-	return 8;
+	lua_pushnumber(L, GetLuaContextData(L)->memPool->GetNumAllocs() & ((1 << 24) - 1));
+	return 9;
+}
+
+
+/*** Memory Pool Size Class
+ *
+ * @table memPoolSizeClass
+ *
+ * Usage of one size class of a handle's memory pool, allocations are rounded
+ * up to the class size; the last class holds those too large to be pooled.
+ * The counters only grow until the handle is reloaded, rates can be derived
+ * by comparing against the result of an earlier call
+ *
+ * @number size in bytes, 0 for the unpooled class
+ * @number liveKB kilobytes in use
+ * @number pages number of pages allocated for the class
+ * @number allocs number of allocations since the handle was loaded
+ * @number frees number of deallocations since the handle was loaded
+ */
+
+
+/***
+ *
+ * @function Spring.GetLuaMemPoolStats
+ *
+ * @treturn {[memPoolSizeClass],...} sizeClasses
+ */
+int LuaUnsyncedRead::GetLuaMemPoolStats(lua_State* L)
+{
+	const LuaMemPool::Stats& stats = GetLuaContextData(L)->memPool->GetStats();
+
+	lua_createtable(L, stats.size(), 0);
+
+	for (size_t i = 0; i < stats.size(); i++) {
+		const LuaMemPool::SizeClassStats& scs = stats[i];
+
+		lua_createtable(L, 0, 5);
+		LuaPushNamedNumber(L, "size", (i < LuaMemPool::NUM_SIZE_CLASSES)? LuaMemPool::GetClassSize(i): 0);
+		LuaPushNamedNumber(L, "liveKB", scs.liveBytes / 1024.0f);
+		LuaPushNamedNumber(L, "pages", scs.numPages);
+		LuaPushNamedNumber(L, "allocs", scs.numAllocs);
+		LuaPushNamedNumber(L, "frees", scs.numFrees);
+		lua_rawseti(L, -2, i + 1);
+	}
+
+	return 1;
 }
 
 
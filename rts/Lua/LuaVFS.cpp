@@ -6,6 +6,7 @@
 
 #include "LuaVFS.h"
 #include "LuaInclude.h"
+#include "LuaBytecodeCache.h"
 #include "LuaHandle.h"
 #include "LuaHashString.h"
 #include "LuaIO.h"
@@ -79,6 +80,7 @@ bool LuaVFS::PushSynced(lua_State* L)
 	HSTR_PUSH_CFUNC(L, "FileExists", SyncFileExists);
 	HSTR_PUSH_CFUNC(L, "DirList",    SyncDirList);
 	HSTR_PUSH_CFUNC(L, "SubDirs",    SyncSubDirs);
+	HSTR_PUSH_CFUNC(L, "PrefetchFiles", SyncPrefetchFiles);
 
 	return true;
 }
@@ -93,6 +95,7 @@ bool LuaVFS::PushUnsynced(lua_State* L)
 	HSTR_PUSH_CFUNC(L, "FileExists",          UnsyncFileExists);
 	HSTR_PUSH_CFUNC(L, "DirList",             UnsyncDirList);
 	HSTR_PUSH_CFUNC(L, "SubDirs",             UnsyncSubDirs);
+	HSTR_PUSH_CFUNC(L, "PrefetchFiles",       UnsyncPrefetchFiles);
 
 	HSTR_PUSH_CFUNC(L, "GetFileAbsolutePath",      GetFileAbsolutePath);
 	HSTR_PUSH_CFUNC(L, "GetArchiveContainingFile", GetArchiveContainingFile);
@@ -173,7 +176,7 @@ int LuaVFS::Include(lua_State* L, bool synced)
 	}
 
 	tracy::LuaRemove(fileData.data());
-	if ((luaError = luaL_loadbuffer(L, fileData.c_str(), fileData.size(), fileName.c_str())) != 0) {
+	if ((luaError = LuaBytecodeCache::LoadBuffer(L, fileData.c_str(), fileData.size(), fileName.c_str())) != 0) {
 		const auto buf = fmt::format("[LuaVFS::{}(synced={})][loadbuf] file={} error={} ({}) cenv={} vfsmode={}", __func__, synced, fileName, luaError, lua_tostring(L, -1), hasCustomEnv, mode);
 		lua_pushlstring(L, buf.c_str(), buf.size());
 		lua_error(L);
@@ -329,6 +332,32 @@ int LuaVFS::UnsyncSubDirs(lua_State* L)
 }
 
 
+/******************************************************************************/
+
+int LuaVFS::PrefetchFiles(lua_State* L, bool synced)
+{
+	std::vector<std::string> fileNames;
+
+	luaL_checktype(L, 1, LUA_TTABLE);
+	LuaUtils::ParseStringVector(L, 1, fileNames);
+
+	// only changes when the contents are read, not what they are
+	lua_pushnumber(L, CFileHandler::PrefetchFiles(fileNames, GetModes(L, 2, synced)));
+	return 1;
+}
+
+
+int LuaVFS::SyncPrefetchFiles(lua_State* L)
+{
+	return PrefetchFiles(L, true);
+}
+
+int LuaVFS::UnsyncPrefetchFiles(lua_State* L)
+{
+	return PrefetchFiles(L, false);
+}
+
+
 int LuaVFS::GetFileAbsolutePath(lua_State* L)
 {
 	const std::string filename = luaL_checkstring(L, 1);
@@ -22,6 +22,7 @@ class LuaVFS {
 		static int FileExists(lua_State* L, bool synced);
 		static int DirList(lua_State* L, bool synced);
 		static int SubDirs(lua_State* L, bool synced);
+		static int PrefetchFiles(lua_State* L, bool synced);
 
 		static int GetFileAbsolutePath(lua_State* L);
 		static int GetArchiveContainingFile(lua_State* L);
@@ -31,12 +32,14 @@ class LuaVFS {
 		static int SyncFileExists(lua_State* L);
 		static int SyncDirList(lua_State* L);
 		static int SyncSubDirs(lua_State* L);
+		static int SyncPrefetchFiles(lua_State* L);
 
 		static int UnsyncInclude(lua_State* L);
 		static int UnsyncLoadFile(lua_State* L);
 		static int UnsyncFileExists(lua_State* L);
 		static int UnsyncDirList(lua_State* L);
 		static int UnsyncSubDirs(lua_State* L);
+		static int UnsyncPrefetchFiles(lua_State* L);
 
 		static int UseArchive(lua_State* L); ///< temporary
 
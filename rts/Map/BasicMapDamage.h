@@ -17,6 +17,7 @@ public:
 
 	void Init() override;
 	void Update() override;
+	bool HasPendingUpdates() const override { return !explosionUpdateQueue.empty(); }
 
 	bool Disabled() const override { return false; }
 
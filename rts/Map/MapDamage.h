@@ -21,6 +21,8 @@ public:
 
 	virtual void Init() = 0;
 	virtual void Update() = 0;
+	// true if Update has queued explosions left to apply
+	virtual bool HasPendingUpdates() const = 0;
 
 	virtual bool Disabled() const = 0;
 
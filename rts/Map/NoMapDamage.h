@@ -14,6 +14,7 @@ public:
 
 	void Init() override { mapHardness = 0.0f; }
 	void Update() override {}
+	bool HasPendingUpdates() const override { return false; }
 
 	bool Disabled() const override { return true; }
 };
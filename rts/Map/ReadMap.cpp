@@ -59,6 +59,7 @@ CR_REG_METADATA(MapDimensions, (
 CR_BIND_INTERFACE(CReadMap)
 CR_REG_METADATA(CReadMap, (
 	CR_IGNORED(hmUpdated),
+	CR_IGNORED(hmModCount),
 	CR_IGNORED(processingHeightBounds),
 	CR_IGNORED(initHeightBounds),
 	CR_IGNORED(tempHeightBounds),
@@ -290,6 +291,7 @@ void CReadMap::PostLoad()
 	}
 
 	hmUpdated = true;
+	hmModCount += 1;
 
 	mapDamage->RecalcArea(0, mapDims.mapx, 0, mapDims.mapy);
 }
@@ -225,6 +225,8 @@ public:
 	void UpdateHeightBounds();
 
 	bool GetHeightMapUpdated() const { return hmUpdated; }
+	/// incremented on every synced height change, lets callers detect modifications within a frame
+	unsigned int GetHeightMapModCount() const { return hmModCount; }
 
 	virtual int2 GetPatch(int hmx, int hmz) const = 0;
 	virtual const float3& GetUnsyncedHeightInfo(int patchX, int patchZ) const = 0;
@@ -306,6 +308,8 @@ private:
 	bool processingHeightBounds = false;
 	bool hmUpdated = false;
 
+	unsigned int hmModCount = 0;
+
 	float2 initHeightBounds; //< initial minimum- and maximum-height (before any deformations)
 	float2 tempHeightBounds; //< temporary minimum- and maximum-height
 	float2 currHeightBounds; //< current minimum- and maximum-height
@@ -332,6 +336,7 @@ inline float CReadMap::SetHeightValue(float& heightRef, const int idx, const flo
 	// add=1 <--> x = x*1 + h = x+h
 	float newHeight = heightRef * add + h;
 	hmUpdated |= (newHeight != heightRef);
+	hmModCount += (newHeight != heightRef);
 	return (heightRef = newHeight);
 }
 
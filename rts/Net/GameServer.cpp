@@ -120,7 +120,7 @@ decltype(CGameServer::commandBlacklist) CGameServer::commandBlacklist{
 	"nopause", "nohelp", "cheat", "desync", "godmode", "globallos",
 	"nocost", "forcestart", "nospectatorchat", "nospecdraw",
 	"skip", "reloadcob", "reloadcegs", "devlua", "editdefs",
-	"singlestep", "spec", "specbynum"
+	"singlestep", "spec", "specbynum", "netinfo"
 };
 
 
@@ -2532,6 +2532,16 @@ void CGameServer::PushAction(const Action& action, bool fromAutoHost)
 			}
 		} break;
 
+		case hashString("netinfo"): {
+			// connection statistics, including allocations and copies made when sending
+			for (const GameParticipant& p: players) {
+				if (p.clientLink == nullptr)
+					continue;
+
+				LOG("[%s] player %s %s\n%s", __func__, p.name.c_str(), p.clientLink->GetFullAddress().c_str(), p.clientLink->Statistics().c_str());
+			}
+		} break;
+
 		case hashString("kill"): {
 			LOG("Server killed!");
 			quitServer = true;
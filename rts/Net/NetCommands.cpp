@@ -34,6 +34,7 @@
 #include "System/SpringMath.h"
 #include "System/TimeProfiler.h"
 #include "System/LoadSave/DemoRecorder.h"
+#include "System/LoadSave/SimSnapshotHandler.h"
 #include "System/Net/UnpackPacket.h"
 #include "System/Sound/ISound.h"
 #include "System/Sync/DumpState.h"
@@ -616,6 +617,8 @@ void CGame::ClientReadNet()
 
 				SimFrame();
 
+				std::uint32_t syncChecksum = 0;
+
 #ifdef SYNCCHECK
 				// both NETMSG_SYNCRESPONSE and NETMSG_NEWFRAME are used for ping calculation by server
 				ASSERT_SYNCED(gs->frameNum);
@@ -626,10 +629,16 @@ void CGame::ClientReadNet()
 				if (haveServerDemo)
 					localSyncChecksums[gs->frameNum] = CSyncChecker::GetChecksum();
 
+				syncChecksum = CSyncChecker::GetChecksum();
+
 				// reset checksum every 4096 frames =~ 2.5 minutes
 				if ((gs->frameNum & 4095) == 0)
 					CSyncChecker::NewFrame();
 #endif
+
+				// after the reset, such that games loaded from a snapshot start with the same checksum
+				simSnapshotHandler.Update(gs->frameNum, syncChecksum);
+
 				AddTraffic(-1, packetCode, dataLength);
 			} break;
 
@@ -10,10 +10,10 @@ void Sim::ClearRegistry() {
     Sim::registry.clear();
 }
 
-void Sim::LoadComponents(std::stringstream &iss) {
+void Sim::LoadComponents(std::istream &iss) {
     saveLoadUtils.LoadComponents(iss);
 }
 
-void Sim::SaveComponents(std::stringstream &oss) {
+void Sim::SaveComponents(std::ostream &oss) {
     saveLoadUtils.SaveComponents(oss);
 }
@@ -3,15 +3,16 @@
 #ifndef SIM_ECS_HELPER_H__
 #define SIM_ECS_HELPER_H__
 
-#include <sstream>
+#include <istream>
+#include <ostream>
 
 // Functions to help work around Lua header conflicts.
 
 namespace Sim {
     void ClearRegistry();
 
-    void LoadComponents(std::stringstream &iss);
-    void SaveComponents(std::stringstream &oss);
+    void LoadComponents(std::istream &iss);
+    void SaveComponents(std::ostream &oss);
 }
 
 #endif
\ No newline at end of file
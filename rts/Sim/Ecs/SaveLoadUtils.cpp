@@ -51,7 +51,7 @@ void ProcessComponents(T&& archive, S&& snapshot) {
 
 using namespace Sim;
 
-void SaveLoadUtils::LoadComponents(std::stringstream &iss) {
+void SaveLoadUtils::LoadComponents(std::istream &iss) {
     systemUtils.NotifyPreLoad();
 
     auto archive = cereal::BinaryInputArchive{iss};
@@ -70,7 +70,7 @@ void SaveLoadUtils::LoadComponents(std::stringstream &iss) {
     systemUtils.NotifyPostLoad();
 }
 
-void SaveLoadUtils::SaveComponents(std::stringstream &oss) {
+void SaveLoadUtils::SaveComponents(std::ostream &oss) {
     auto archive = cereal::BinaryOutputArchive{oss};
     LOG_L(L_DEBUG, "%s: Entities before save is %d (%d)", __func__, (int)registry.alive(), (int)oss.tellp());
     {ProcessComponents<entt::snapshot>(archive, entt::snapshot{registry});}
@@ -3,7 +3,8 @@
 #ifndef SAVE_LOAD_UTILS_H__
 #define SAVE_LOAD_UTILS_H__
 
-#include <sstream>
+#include <istream>
+#include <ostream>
 
 #include "System/Ecs/EcsMain.h"
 #include "System/Ecs/Utils/SystemGlobalUtils.h"
@@ -25,8 +26,8 @@ public:
         , systemGlobals(systemGlobalsReference)
     {}
 
-    void LoadComponents(std::stringstream &iss);
-    void SaveComponents(std::stringstream &oss);
+    void LoadComponents(std::istream &iss);
+    void SaveComponents(std::ostream &oss);
 
 private:
     entt::registry& registry;
@@ -607,6 +607,19 @@ bool CFeature::UpdatePosition()
 	return (moveCtrl.enabled);
 }
 
+bool CFeature::IsResting() const
+{
+	if (moveCtrl.enabled || speed.SqLength() != 0.0f)
+		return false;
+	// without speed there is no drag, and standing exactly on the ground
+	// the clamp in UpdateVelocity cancels gravity (unless floating, when
+	// gravity does not apply in the first place)
+	if (pos.y != CGround::GetHeightReal(pos.x, pos.z))
+		return false;
+
+	return (IsBlocking() || !HasCollidableStateBit(CSTATE_BIT_SOLIDOBJECTS));
+}
+
 
 bool CFeature::Update()
 {
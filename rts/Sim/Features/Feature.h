@@ -80,6 +80,8 @@ public:
 	bool Update();
 	bool UpdatePosition();
 	bool UpdateVelocity(const float3& dragAccel, const float3& gravAccel, const float3& movMask, const float3& velMask);
+	// true if UpdatePosition would neither move nor (un)block us
+	bool IsResting() const;
 
 	void SetTransform(const CMatrix44f& m, bool synced) { transMatrix[synced] = m; }
 	void UpdateTransform(const float3& p, bool synced) { transMatrix[synced] = std::move(ComposeMatrix(p)); }
@@ -205,6 +205,20 @@ void CFeatureHandler::Update()
 	}
 }
 
+bool CFeatureHandler::IsIdle() const
+{
+	return (updateFeatures.empty() && (deletedFeatureIDs.empty() || (gs->frameNum & 31) != 0));
+}
+
+bool CFeatureHandler::UpdatesQuietly() const
+{
+	const auto& pred = [](const CFeature* feature) {
+		return (!feature->deleteMe && feature->fireTime != 1 && feature->IsResting());
+	};
+
+	return (std::all_of(updateFeatures.begin(), updateFeatures.end(), pred));
+}
+
 
 bool CFeatureHandler::TryFreeFeatureID(int id)
 {
@@ -55,6 +55,13 @@ public:
 
 	void Update();
 
+	// true if Update has nothing to do this frame
+	bool IsIdle() const;
+	// true if Update can not move or delete any feature this frame, i.e. it
+	// raises no call-ins and only touches the updated features, the solids
+	// on top of geothermal vents and particles
+	bool UpdatesQuietly() const;
+
 	bool UpdateFeature(CFeature* feature);
 	bool TryFreeFeatureID(int id);
 	bool AddFeature(CFeature* feature);
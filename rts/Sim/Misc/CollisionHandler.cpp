@@ -2,28 +2,33 @@
 
 #include "CollisionHandler.h"
 #include "CollisionVolume.h"
-#include "Map/ReadMap.h" // mapDims
-#include "Rendering/Models/3DModel.h"
-#include "Sim/Misc/GroundBlockingObjectMap.h"
+#ifndef UNIT_TEST
+	#include "Map/ReadMap.h" // mapDims
+	#include "Rendering/Models/3DModel.h"
+	#include "Sim/Misc/GroundBlockingObjectMap.h"
+	#include "Sim/Objects/SolidObject.h"
+#endif
 #include "Sim/Misc/GlobalConstants.h"
-#include "Sim/Objects/SolidObject.h"
 #include "System/Matrix44f.h"
 #include "System/Log/ILog.h"
 
+#include "xsimd/xsimd.hpp"
+
 #include "System/Misc/TracyDefs.h"
 
-unsigned int CCollisionHandler::numDiscTests = 0;
-unsigned int CCollisionHandler::numContTests = 0;
+std::atomic<unsigned int> CCollisionHandler::numDiscTests = {0};
+std::atomic<unsigned int> CCollisionHandler::numContTests = {0};
 
 
 
 void CCollisionHandler::PrintStats()
 {
-	LOG("[CCollisionHandler] dis-/continuous tests: %i/%i", numDiscTests, numContTests);
+	LOG("[CCollisionHandler] dis-/continuous tests: %u/%u", numDiscTests.load(), numContTests.load());
 }
 
 
 
+#ifndef UNIT_TEST
 bool CCollisionHandler::DetectHit(
 	const CSolidObject* o,
 	const CMatrix44f& m,
@@ -143,7 +148,7 @@ bool CCollisionHandler::CollisionFootPrint(const CSolidObject* o, const float3&
 bool CCollisionHandler::Collision(const CollisionVolume* v, const CMatrix44f& m, const float3& p)
 {
 	RECOIL_DETAILED_TRACY_ZONE;
-	numDiscTests += 1;
+	numDiscTests.fetch_add(1, std::memory_order_relaxed);
 
 	// get the inverse volume transformation matrix and
 	// apply it to the projectile's position, then test
@@ -354,10 +359,12 @@ inline bool CCollisionHandler::Intersect(
 	return (CCollisionHandler::Intersect(v, mr, p0, p1, cq));
 }
 
+#endif // UNIT_TEST
+
 bool CCollisionHandler::Intersect(const CollisionVolume* v, const CMatrix44f& m, const float3& p0, const float3& p1, CollisionQuery* q)
 {
 	RECOIL_DETAILED_TRACY_ZONE;
-	numContTests += 1;
+	numContTests.fetch_add(1, std::memory_order_relaxed);
 
 	const CMatrix44f mInv = m.InvertAffine();
 	const float3 pi0 = mInv.Mul(p0);
@@ -802,3 +809,376 @@ bool CCollisionHandler::IntersectBox(const CollisionVolume* v, const float3& pi0
 	return (b0 == CQ_POINT_ON_RAY || b1 == CQ_POINT_ON_RAY);
 }
 
+
+
+// batched (SIMD) counterparts of Intersect{Ellipsoid,Box}; every lane
+// performs exactly the floating-point operations (in the same order)
+// the scalar versions do, so hit results are identical bit-for-bit
+using FloatBatch = xsimd::simd_type<float>;
+using FloatMask = xsimd::simd_bool_type<float>;
+using IntBatch = xsimd::batch<int32_t, FloatBatch::size>;
+
+static constexpr size_t BATCH_SIZE = FloatBatch::size;
+
+struct BatchVec3 {
+	FloatBatch x;
+	FloatBatch y;
+	FloatBatch z;
+
+	BatchVec3 operator + (const BatchVec3& v) const { return {x + v.x, y + v.y, z + v.z}; }
+	BatchVec3 operator - (const BatchVec3& v) const { return {x - v.x, y - v.y, z - v.z}; }
+	BatchVec3 operator * (const BatchVec3& v) const { return {x * v.x, y * v.y, z * v.z}; }
+	BatchVec3 operator * (const FloatBatch& f) const { return {x * f, y * f, z * f}; }
+
+	FloatBatch dot(const BatchVec3& v) const { return ((x * v.x) + (y * v.y) + (z * v.z)); }
+	FloatBatch SqLength() const { return (x*x + y*y + z*z); }
+};
+
+static FloatBatch LoadBatch(const std::vector<float>& v, size_t i) { return (xsimd::load_unaligned(&v[i])); }
+static BatchVec3 LoadBatch(const std::vector<float> (&v)[3], size_t i) { return {LoadBatch(v[0], i), LoadBatch(v[1], i), LoadBatch(v[2], i)}; }
+
+// std::{min,max} semantics (matters only for signed zeros)
+static FloatBatch MinBatch(const FloatBatch& a, const FloatBatch& b) { return (xsimd::select(b < a, b, a)); }
+static FloatBatch MaxBatch(const FloatBatch& a, const FloatBatch& b) { return (xsimd::select(a < b, b, a)); }
+
+// math::isqrt, i.e. fastmath::isqrt2_nosse
+static FloatBatch ISqrtBatch(const FloatBatch& f) {
+	const FloatBatch xh = FloatBatch(0.5f) * f;
+
+	IntBatch i = xsimd::bitwise_cast<IntBatch>(f);
+	i = IntBatch(0x5f375a86) - (i >> 1);
+
+	FloatBatch x = xsimd::bitwise_cast<FloatBatch>(i);
+	x = x * (FloatBatch(1.5f) - xh * (x * x));
+	x = x * (FloatBatch(1.5f) - xh * (x * x));
+	return x;
+}
+
+// float3::SafeNormalize
+static BatchVec3 SafeNormalizeBatch(const BatchVec3& v) {
+	const FloatBatch sql = v.SqLength();
+	const FloatMask nrm = (sql > FloatBatch(float3::nrm_eps()));
+	const BatchVec3 n = v * ISqrtBatch(xsimd::select(nrm, sql, FloatBatch(1.0f)));
+
+	return {xsimd::select(nrm, n.x, v.x), xsimd::select(nrm, n.y, v.y), xsimd::select(nrm, n.z, v.z)};
+}
+
+// CMatrix44f::Mul(float3), w=1
+static BatchVec3 TransformBatch(const std::vector<float> (&mInv)[12], size_t i, const float3& p) {
+	const auto M = [&](int k) { return (LoadBatch(mInv[k], i)); };
+
+	return {
+		M(0) * FloatBatch(p.x) + M(3) * FloatBatch(p.y) + M(6) * FloatBatch(p.z) + M( 9),
+		M(1) * FloatBatch(p.x) + M(4) * FloatBatch(p.y) + M(7) * FloatBatch(p.z) + M(10),
+		M(2) * FloatBatch(p.x) + M(5) * FloatBatch(p.y) + M(8) * FloatBatch(p.z) + M(11),
+	};
+}
+
+// the early-out bounding-box test from Intersect; true if missed
+static FloatMask MissBoundingBoxBatch(const BatchVec3& pi0, const BatchVec3& pi1, const BatchVec3& hs) {
+	const BatchVec3 rmin = {MinBatch(pi0.x, pi1.x), MinBatch(pi0.y, pi1.y), MinBatch(pi0.z, pi1.z)};
+	const BatchVec3 rmax = {MaxBatch(pi0.x, pi1.x), MaxBatch(pi0.y, pi1.y), MaxBatch(pi0.z, pi1.z)};
+
+	FloatMask miss = (rmax.x < -hs.x) || (rmin.x > hs.x);
+	miss = miss || (rmax.y < -hs.y) || (rmin.y > hs.y);
+	miss = miss || (rmax.z < -hs.z) || (rmin.z > hs.z);
+	return miss;
+}
+
+static FloatMask IntersectEllipsoidBatch(const BatchVec3& pi0, const BatchVec3& pi1, const BatchVec3& hs, const BatchVec3& his) {
+	const BatchVec3 upi0 = pi0 * his;
+	const BatchVec3 upi1 = pi1 * his;
+
+	const FloatBatch upiSq = upi0.dot(upi0);
+	const FloatMask inVol = (upiSq <= FloatBatch(1.0f));
+
+	const BatchVec3 dir = SafeNormalizeBatch(upi1 - upi0);
+
+	const FloatBatch B = FloatBatch(2.0f) * upi0.dot(dir);
+	const FloatBatch C = upiSq - FloatBatch(1.0f);
+	const FloatBatch D = (B * B) - (FloatBatch(4.0f) * C);
+
+	const FloatBatch segLenSq = (pi1 - pi0).SqLength();
+
+	// one solution for t if D < EPS, two otherwise
+	const FloatMask one = (D < FloatBatch(COLLISION_VOLUME_EPS));
+	// keep the masked-out sqrt lanes from raising FP exceptions
+	const FloatBatch rD = xsimd::sqrt(xsimd::select(one, FloatBatch(0.0f), D));
+
+	const FloatBatch t0 = xsimd::select(one, -B * FloatBatch(0.5f), (-B - rD) * FloatBatch(0.5f));
+	const FloatBatch t1 = (-B + rD) * FloatBatch(0.5f);
+
+	const BatchVec3 p0 = (upi0 + (dir * t0)) * hs;
+	const BatchVec3 p1 = (upi0 + (dir * t1)) * hs;
+
+	const FloatMask b0 = (t0 > FloatBatch(0.0f)) && ((p0 - pi0).SqLength() <= segLenSq);
+	const FloatMask b1 = (t1 > FloatBatch(0.0f)) && ((p1 - pi0).SqLength() <= segLenSq) && !one;
+
+	return (inVol || ((D >= FloatBatch(-COLLISION_VOLUME_EPS)) && (b0 || b1)));
+}
+
+static FloatMask IntersectBoxBatch(const BatchVec3& pi0, const BatchVec3& pi1, const BatchVec3& hs) {
+	const FloatMask inVol =
+		(xsimd::abs(pi0.x) < hs.x) &&
+		(xsimd::abs(pi0.y) < hs.y) &&
+		(xsimd::abs(pi0.z) < hs.z);
+
+	const BatchVec3 dir = SafeNormalizeBatch(pi1 - pi0);
+
+	FloatBatch tn = FloatBatch(-9999999.9f);
+	FloatBatch tf = FloatBatch( 9999999.9f);
+	FloatMask miss(false);
+
+	const auto SlabTest = [&](const FloatBatch& d, const FloatBatch& p, const FloatBatch& h) {
+		const FloatMask parallel = (xsimd::abs(d) < FloatBatch(COLLISION_VOLUME_EPS));
+		const FloatBatch sd = xsimd::select(parallel, FloatBatch(1.0f), d);
+
+		const FloatBatch tmin = (-h - p) / sd;
+		const FloatBatch tmax = ( h - p) / sd;
+
+		FloatBatch t0 = xsimd::select(d > FloatBatch(0.0f), tmin, tmax);
+		FloatBatch t1 = xsimd::select(d > FloatBatch(0.0f), tmax, tmin);
+
+		const FloatMask swap = (t0 > t1);
+		const FloatBatch t2 = t1;
+		t1 = xsimd::select(swap, t0, t1);
+		t0 = xsimd::select(swap, t2, t0);
+
+		tn = xsimd::select(!parallel && (t0 > tn), t0, tn);
+		tf = xsimd::select(!parallel && (t1 < tf), t1, tf);
+
+		miss = miss || (parallel && (xsimd::abs(p) > h));
+		miss = miss || (!parallel && ((tn > tf) || (tf < FloatBatch(0.0f))));
+	};
+
+	SlabTest(dir.x, pi0.x, hs.x);
+	SlabTest(dir.y, pi0.y, hs.y);
+	SlabTest(dir.z, pi0.z, hs.z);
+
+	const BatchVec3 p0 = pi0 + (dir * tn);
+	const BatchVec3 p1 = pi0 + (dir * tf);
+
+	const FloatBatch segLenSq = (pi1 - pi0).SqLength();
+
+	const FloatMask b0 = ((p0 - pi0).SqLength() <= segLenSq);
+	const FloatMask b1 = ((p1 - pi0).SqLength() <= segLenSq);
+
+	return (inVol || (!miss && (b0 || b1)));
+}
+
+
+void CollisionVolumeBatch::Clear()
+{
+	for (Group& g: groups) {
+		g.Clear();
+	}
+
+	hits.clear();
+	hitIds.clear();
+}
+
+void CollisionVolumeBatch::Add(const CollisionVolume* v, const CMatrix44f& m, int id)
+{
+	switch (v->GetVolumeType()) {
+		case CollisionVolume::COLVOL_TYPE_ELLIPSOID:
+		case CollisionVolume::COLVOL_TYPE_SPHERE: {
+			groups[GROUP_ELLIPSOID].Add(v, m, id);
+		} break;
+		case CollisionVolume::COLVOL_TYPE_BOX: {
+			groups[GROUP_BOX].Add(v, m, id);
+		} break;
+		default: {
+			groups[GROUP_CYLINDER].Add(v, m, id);
+		} break;
+	}
+}
+
+void CollisionVolumeBatch::Group::Clear()
+{
+	for (auto& c: mInv) { c.clear(); }
+	for (auto& c: hs) { c.clear(); }
+	for (auto& c: his) { c.clear(); }
+
+	vols.clear();
+	mats.clear();
+	ids.clear();
+}
+
+void CollisionVolumeBatch::Group::Add(const CollisionVolume* v, const CMatrix44f& m, int id)
+{
+	// same inverse as the scalar Intersect computes per call
+	const CMatrix44f mi = m.InvertAffine();
+
+	// drop any padding left by a previous IntersectBatch
+	Pad(1);
+
+	for (int c = 0; c < 4; c++) {
+		mInv[c * 3 + 0].push_back(mi.m[c * 4 + 0]);
+		mInv[c * 3 + 1].push_back(mi.m[c * 4 + 1]);
+		mInv[c * 3 + 2].push_back(mi.m[c * 4 + 2]);
+	}
+	for (int a = 0; a < 3; a++) {
+		hs[a].push_back(v->GetHScales()[a]);
+		his[a].push_back(v->GetHIScales()[a]);
+	}
+
+	vols.push_back(v);
+	mats.push_back(m);
+	ids.push_back(id);
+}
+
+void CollisionVolumeBatch::Group::Pad(size_t n)
+{
+	const size_t size = ((ids.size() + n - 1) / n) * n;
+
+	if (hs[0].size() == size)
+		return;
+
+	// identity transforms and unit scales, results are masked out
+	for (int c = 0; c < 12; c++) {
+		mInv[c].resize(size, float((c / 3) == (c % 3)));
+	}
+	for (int a = 0; a < 3; a++) {
+		hs[a].resize(size, 1.0f);
+		his[a].resize(size, 1.0f);
+	}
+}
+
+
+#ifndef UNIT_TEST
+bool CCollisionHandler::CanBatchDetectHit(const CSolidObject* o, const CollisionVolume* v, bool forceTrace)
+{
+	// mirrors the branches in DetectHit
+	if (o->IsInVoid())
+		return false;
+	if (v->DefaultToPieceTree())
+		return false;
+	if (v->IgnoreHits())
+		return false;
+
+	return (forceTrace || v->UseContHitTest());
+}
+
+bool CCollisionHandler::AddToBatch(CollisionVolumeBatch& batch, const CSolidObject* o, const CMatrix44f& m, int id, bool forceTrace)
+{
+	const CollisionVolume* v = &o->collisionVolume;
+
+	if (!CanBatchDetectHit(o, v, forceTrace))
+		return false;
+
+	// same translations as Intersect(o, v, ...)
+	CMatrix44f mr = m;
+
+	mr.Translate(o->relMidPos);
+	mr.Translate(v->GetOffsets());
+
+	batch.Add(v, mr, id);
+	return true;
+}
+#endif // UNIT_TEST
+
+
+size_t CCollisionHandler::IntersectBatch(CollisionVolumeBatch& batch, const float3& p0, const float3& p1)
+{
+	RECOIL_DETAILED_TRACY_ZONE;
+	batch.hits.clear();
+	batch.hitIds.clear();
+
+	float hitLanes[BATCH_SIZE];
+
+	for (int n = CollisionVolumeBatch::GROUP_ELLIPSOID; n <= CollisionVolumeBatch::GROUP_BOX; n++) {
+		CollisionVolumeBatch::Group& g = batch.groups[n];
+
+		const size_t numVols = g.Size();
+
+		if (numVols == 0)
+			continue;
+
+		numContTests.fetch_add(numVols, std::memory_order_relaxed);
+		g.Pad(BATCH_SIZE);
+
+		for (size_t i = 0; i < numVols; i += BATCH_SIZE) {
+			const BatchVec3 pi0 = TransformBatch(g.mInv, i, p0);
+			const BatchVec3 pi1 = TransformBatch(g.mInv, i, p1);
+			const BatchVec3 hs = LoadBatch(g.hs, i);
+
+			FloatMask hit = !MissBoundingBoxBatch(pi0, pi1, hs);
+
+			if (!xsimd::any(hit))
+				continue;
+
+			if (n == CollisionVolumeBatch::GROUP_ELLIPSOID) {
+				hit = hit && IntersectEllipsoidBatch(pi0, pi1, hs, LoadBatch(g.his, i));
+			} else {
+				hit = hit && IntersectBoxBatch(pi0, pi1, hs);
+			}
+
+			xsimd::select(hit, FloatBatch(1.0f), FloatBatch(0.0f)).store_unaligned(hitLanes);
+
+			for (size_t j = 0, k = std::min(BATCH_SIZE, numVols - i); j < k; j++) {
+				if (hitLanes[j] != 0.0f)
+					batch.hits.push_back({g.ids[i + j], n, static_cast<int>(i + j)});
+			}
+		}
+	}
+
+	{
+		// no SIMD kernel for cylinders, these take the regular path
+		const CollisionVolumeBatch::Group& g = batch.groups[CollisionVolumeBatch::GROUP_CYLINDER];
+
+		for (size_t i = 0, n = g.Size(); i < n; i++) {
+			if (Intersect(g.vols[i], g.mats[i], p0, p1, nullptr))
+				batch.hits.push_back({g.ids[i], CollisionVolumeBatch::GROUP_CYLINDER, static_cast<int>(i)});
+		}
+	}
+
+	std::sort(batch.hits.begin(), batch.hits.end(), [](const CollisionVolumeBatch::Hit& a, const CollisionVolumeBatch::Hit& b) {
+		return (a.id < b.id);
+	});
+
+	for (const CollisionVolumeBatch::Hit& hit: batch.hits) {
+		batch.hitIds.push_back(hit.id);
+	}
+
+	return batch.hits.size();
+}
+
+int CCollisionHandler::IntersectBatch(CollisionVolumeBatch& batch, const float3& p0, const float3& p1, CollisionQuery* cq)
+{
+	RECOIL_DETAILED_TRACY_ZONE;
+	if (cq != nullptr)
+		cq->Reset();
+
+	if (IntersectBatch(batch, p0, p1) == 0)
+		return -1;
+
+	const float3 dir = (p1 - p0).SafeNormalize();
+
+	CollisionQuery hcq;
+
+	int nearestId = -1;
+	float nearestDist = std::numeric_limits<float>::max();
+
+	for (const CollisionVolumeBatch::Hit& hit: batch.hits) {
+		const CollisionVolumeBatch::Group& g = batch.groups[hit.group];
+
+		// hits are rare, rerun them through the scalar path to get their queries
+		hcq.Reset();
+
+		if (!Intersect(g.vols[hit.index], g.mats[hit.index], p0, p1, &hcq))
+			continue;
+
+		const float dist = hcq.GetHitPosDist(p0, dir);
+
+		if (dist >= nearestDist)
+			continue;
+
+		nearestDist = dist;
+		nearestId = hit.id;
+
+		if (cq != nullptr)
+			*cq = hcq;
+	}
+
+	return nearestId;
+}
@@ -8,6 +8,8 @@
 #include "System/Matrix44f.h"
 
 #include <algorithm>
+#include <atomic>
+#include <vector>
 
 class CSolidObject;
 struct LocalModelPiece;
@@ -86,6 +88,68 @@ private:
 	const LocalModelPiece* lmp = nullptr;
 };
 
+/**
+ * Packed (SoA) set of collision volumes, grouped by shape, which can
+ * be hit-tested against a single ray segment in one pass by
+ * CCollisionHandler::IntersectBatch. Each volume is stored with the
+ * transform the scalar Intersect would use, so batched results are
+ * identical to testing the volumes one by one.
+ */
+class CollisionVolumeBatch {
+public:
+	enum {
+		GROUP_ELLIPSOID = 0, // also spheres
+		GROUP_BOX       = 1,
+		GROUP_CYLINDER  = 2, // tested by the scalar path
+		GROUP_COUNT     = 3,
+	};
+
+	void Clear();
+	// <m> is the volume's transform as passed to Intersect (i.e.
+	// including the relMidPos and volume-offset translations)
+	void Add(const CollisionVolume* v, const CMatrix44f& m, int id);
+
+	size_t Size() const { return (groups[GROUP_ELLIPSOID].Size() + groups[GROUP_BOX].Size() + groups[GROUP_CYLINDER].Size()); }
+	bool Empty() const { return (Size() == 0); }
+
+	// ids of all volumes hit by the last IntersectBatch call, ascending
+	const std::vector<int>& GetHitIds() const { return hitIds; }
+
+private:
+	friend class CCollisionHandler;
+
+	struct Group {
+		void Clear();
+		void Add(const CollisionVolume* v, const CMatrix44f& m, int id);
+		// pad the SoA arrays up to a multiple of <n> with benign lanes
+		void Pad(size_t n);
+
+		size_t Size() const { return ids.size(); }
+
+		// upper 3x4 block of the inverse volume transforms, column-major
+		std::vector<float> mInv[12];
+		// half-scales and inverse half-scales per axis
+		std::vector<float> hs[3];
+		std::vector<float> his[3];
+
+		std::vector<const CollisionVolume*> vols;
+		std::vector<CMatrix44f> mats;
+		std::vector<int> ids;
+	};
+
+	struct Hit {
+		int id;
+		int group;
+		int index;
+	};
+
+	Group groups[GROUP_COUNT];
+
+	std::vector<Hit> hits;
+	std::vector<int> hitIds;
+};
+
+
 /**
  * Responsible for detecting hits between projectiles
  * and solid objects (units, features), each SO has a
@@ -121,6 +185,31 @@ class CCollisionHandler {
 			CollisionQuery* cq = nullptr
 		);
 
+		/**
+		 * True iff DetectHit would test <o> by a plain (scalar) volume
+		 * intersection, i.e. if <o> can be added to a CollisionVolumeBatch.
+		 */
+		static bool CanBatchDetectHit(const CSolidObject* o, const CollisionVolume* v, bool forceTrace = false);
+		/**
+		 * Add <o>'s volume to <batch> as DetectHit(o, &o->collisionVolume, m, ...)
+		 * would test it; returns false (and adds nothing) if CanBatchDetectHit fails.
+		 */
+		static bool AddToBatch(CollisionVolumeBatch& batch, const CSolidObject* o, const CMatrix44f& m, int id, bool forceTrace = false);
+
+		/**
+		 * Test ray segment p0-p1 against every volume in <batch>, several
+		 * volumes per instruction; afterwards batch.GetHitIds() lists the
+		 * volumes for which the scalar Intersect would have returned true.
+		 * @return number of volumes hit
+		 */
+		static size_t IntersectBatch(CollisionVolumeBatch& batch, const float3& p0, const float3& p1);
+		/**
+		 * As above, but returns the id of the volume whose hit-position is
+		 * nearest to p0 (lowest id on ties) or -1 if none was hit, and fills
+		 * <cq> with the same query the scalar Intersect produces for it.
+		 */
+		static int IntersectBatch(CollisionVolumeBatch& batch, const float3& p0, const float3& p1, CollisionQuery* cq);
+
 	private:
 		// HITTEST_DISC helpers for DetectHit
 		static bool Collision(
@@ -151,6 +240,10 @@ class CCollisionHandler {
 		static bool Collision(const CollisionVolume* v, const CMatrix44f& m, const float3& p);
 		static bool CollisionFootPrint(const CSolidObject* o, const float3& p);
 
+		static bool IntersectPieceTree(const CSolidObject* o, const CMatrix44f& m, const float3& p0, const float3& p1, CollisionQuery* cq);
+		static bool IntersectPiecesHelper(const CSolidObject* o, const CMatrix44f& m, const float3& p0, const float3& p1, CollisionQuery* cqp);
+
+	public:
 		/**
 		 * Test if a ray intersects a volume.
 		 * @param v volume
@@ -159,17 +252,15 @@ class CCollisionHandler {
 		 * @param p1 end of ray (in world-coordinates)
 		 */
 		static bool Intersect(const CollisionVolume* v, const CMatrix44f& m, const float3& p0, const float3& p1, CollisionQuery* cq);
-		static bool IntersectPieceTree(const CSolidObject* o, const CMatrix44f& m, const float3& p0, const float3& p1, CollisionQuery* cq);
-		static bool IntersectPiecesHelper(const CSolidObject* o, const CMatrix44f& m, const float3& p0, const float3& p1, CollisionQuery* cqp);
 
-	public:
 		static bool IntersectEllipsoid(const CollisionVolume* v, const float3& pi0, const float3& pi1, CollisionQuery* cq);
 		static bool IntersectCylinder(const CollisionVolume* v, const float3& pi0, const float3& pi1, CollisionQuery* cq);
 		static bool IntersectBox(const CollisionVolume* v, const float3& pi0, const float3& pi1, CollisionQuery* cq);
 
 	private:
-		static unsigned int numDiscTests; // number of discrete hit-tests executed
-		static unsigned int numContTests; // number of continuous hit-tests executed (inc. unsynced)
+		// atomic since hit-tests can run on worker threads (see CProjectileHandler)
+		static std::atomic<unsigned int> numDiscTests; // number of discrete hit-tests executed
+		static std::atomic<unsigned int> numContTests; // number of continuous hit-tests executed (inc. unsynced)
 };
 
 #endif // COLLISION_HANDLER_H
@@ -64,6 +64,8 @@ inline void SLosInstance::Init(int radius, int allyteam, int2 basePos, float bas
 	this->isCached = false;
 	this->isQueuedForUpdate = false;
 	this->isQueuedForTerraform = false;
+	this->occludedRaySquares.clear();
+	this->dirtyRect = {};
 }
 
 
@@ -75,6 +77,9 @@ size_t ILosType::cacheFails = 1;
 size_t ILosType::cacheHits  = 1;
 size_t ILosType::cacheRefs  = 1;
 
+std::atomic<size_t> ILosType::raysRetraced = 0;
+std::atomic<size_t> ILosType::raysReused   = 0;
+
 constexpr float CLosHandler::defBaseRadarErrorSize;
 constexpr float CLosHandler::defBaseRadarErrorMult;
 constexpr SLosInstance::RLE SLosInstance::EMPTY_RLE;
@@ -353,6 +358,11 @@ inline void ILosType::AddInstanceToCache(SLosInstance* li)
 		return;
 	}
 
+	// cached instances are deleted on overlapping terrain changes rather than
+	// recalculated, so their per-ray results would never be reused
+	li->occludedRaySquares = {};
+	li->dirtyRect = {};
+
 	li->isCached = true;
 	losCache.push_back(li);
 }
@@ -402,6 +412,7 @@ inline void ILosType::DeleteInstance(SLosInstance* li)
 	}
 
 	li->squares.clear();
+	li->occludedRaySquares.clear();
 	freeIDs.push_back(li->id);
 }
 
@@ -582,6 +593,9 @@ void ILosType::Update()
 			li->squares.clear();
 			losMaps[li->allyteam].PrepareRaycast(li);
 		});
+
+		TracyPlot("LosRaysRetraced", static_cast<int64_t>(raysRetraced.load()));
+		TracyPlot("LosRaysReused", static_cast<int64_t>(raysReused.load()));
 	}
 
 	// add sight
@@ -652,9 +666,47 @@ void ILosType::UpdateHeightMapSynced(SRectangle rect)
 		DeleteInstance(li);
 	}
 
+	// the LOS-map squares whose heights may have changed; mip heights are also
+	// updated in a one-square border around rect (see CReadMap::UpdateHeightMapSynced)
+	const SRectangle losRect = {
+		std::max(((rect.x1 - 1) >> mipLevel) - 1, 0),
+		std::max(((rect.z1 - 1) >> mipLevel) - 1, 0),
+		std::min(((rect.x2 + 1) >> mipLevel) + 2, size.x),
+		std::min(((rect.z2 + 1) >> mipLevel) + 2, size.y),
+	};
+
+	// must cover every change since the last raycast, including those that
+	// did not trigger a relos because CheckOverlap() missed the border squares
+	auto AddDirtyRect = [&](SLosInstance* li) {
+		if (li->occludedRaySquares.empty())
+			return;
+
+		const SRectangle instRect = {
+			li->basePos.x - li->radius,
+			li->basePos.y - li->radius,
+			li->basePos.x + li->radius + 1,
+			li->basePos.y + li->radius + 1,
+		};
+
+		if (!instRect.CheckOverlap(losRect))
+			return;
+
+		if (li->dirtyRect.GetArea() <= 0) {
+			li->dirtyRect = losRect;
+			return;
+		}
+
+		li->dirtyRect.x1 = std::min(li->dirtyRect.x1, losRect.x1);
+		li->dirtyRect.z1 = std::min(li->dirtyRect.z1, losRect.z1);
+		li->dirtyRect.x2 = std::max(li->dirtyRect.x2, losRect.x2);
+		li->dirtyRect.z2 = std::max(li->dirtyRect.z2, losRect.z2);
+	};
+
 	// relos used instances
 	for (auto& p: instanceHashes) {
 		for (SLosInstance* li: p.second) {
+			AddDirtyRect(li);
+
 			if (li->status & SLosInstance::TLosStatus::RECALC)
 				continue;
 			if (!CheckOverlap(li, rect))
@@ -686,6 +738,9 @@ void CLosHandler::InitStatic()
 	ILosType::cacheHits  = 1;
 	ILosType::cacheRefs  = 1;
 
+	ILosType::raysRetraced = 0;
+	ILosType::raysReused   = 0;
+
 	if (losHandler == nullptr)
 		losHandler = new (losHandlerMem) CLosHandler();
 
@@ -764,6 +819,9 @@ void CLosHandler::Kill()
 		100.0f * float(ILosType::cacheHits - ILosType::cacheRefs) / (ILosType::cacheHits + ILosType::cacheFails),
 		100.0f * float(ILosType::cacheRefs) / (ILosType::cacheHits + ILosType::cacheFails)
 	);
+	LOG("[LosHandler::%s] raycast instance rays-{retraced,reused}={%lu,%lu}",
+		__func__, static_cast<unsigned long>(ILosType::raysRetraced), static_cast<unsigned long>(ILosType::raysReused)
+	);
 
 	losTypes.fill(nullptr);
 }
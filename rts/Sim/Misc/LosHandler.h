@@ -3,6 +3,7 @@
 #ifndef LOS_HANDLER_H
 #define LOS_HANDLER_H
 
+#include <atomic>
 #include <vector>
 #include <deque>
 
@@ -65,6 +66,12 @@ public:
 	static constexpr RLE EMPTY_RLE = RLE{0,0};
 	std::vector<RLE> squares;
 
+	// occlusion results of the last raycast per (ray, quadrant, square) and the
+	// LOS-map area whose heights changed since, lets CLosMap retrace only those
+	// rays that cross it (see CLosMap::RetraceDirtyRays)
+	std::vector<bool> occludedRaySquares;
+	SRectangle dirtyRect;
+
 	// helpers
 	int hashNum;
 	enum TLosStatus {
@@ -170,6 +177,9 @@ public:
 	static size_t cacheHits;
 	static size_t cacheRefs;
 
+	static std::atomic<size_t> raysRetraced;
+	static std::atomic<size_t> raysReused;
+
 	spring::unordered_map<int, std::vector<SLosInstance*> > instanceHashes;
 
 	std::vector<CLosMap> losMaps;
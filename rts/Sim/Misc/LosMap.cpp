@@ -10,6 +10,7 @@
 #include "System/float3.h"
 #include "System/Log/ILog.h"
 #include "System/StringUtil.h"
+#include "System/XSimdOps.hpp"
 #include "System/Threading/ThreadPool.h"
 #include "Game/GlobalUnsynced.h" // for myAllyTeam
 
@@ -132,12 +133,18 @@ public:
 		return losTables[losSize].size();
 	}
 
+	// summed length of all rays in the table
+	size_t GetLosTableSquareCount(size_t losSize) {
+		return losTableSquareCounts[losSize];
+	}
+
 private:
 	// [0] is the zero-radius table
 	// NOTE:
 	//   do we even need a table for *every* possible radius?
 	//   why not precalculate only the largest and subsample?
 	std::array<LosTable, MAX_UNIT_SENSOR_RADIUS + 1> losTables;
+	std::array<size_t, MAX_UNIT_SENSOR_RADIUS + 1> losTableSquareCounts = {};
 
 private:
 	static LosLine GetRay(int x, int y);
@@ -166,6 +173,10 @@ void CLosTableHelper::GenerateForLosSize(size_t losSize)
 		return;
 
 	table = GetLosRays(losSize);
+
+	for (const LosLine& line: table) {
+		losTableSquareCounts[losSize] += line.size();
+	}
 }
 
 
@@ -419,9 +430,7 @@ void CLosMap::AddCircle(SLosInstance* instance, int amount)
 			const unsigned sx = std::clamp(instance->basePos.x - width,     0, size.x);
 			const unsigned ex = std::clamp(instance->basePos.x + width + 1, 0, size.x);
 
-			for (unsigned x_ = sx; x_ < ex; ++x_) {
-				losmap[(y_ * size.x) + x_] += amount;
-			}
+			SpanAdd(losmap.data() + (y_ * size.x) + sx, ex - sx, static_cast<unsigned short>(amount));
 		}
 	});
 }
@@ -441,29 +450,22 @@ void CLosMap::AddRaycast(SLosInstance* instance, int amount)
 
 	if ((amount > 0) && updateUnsyncedHeightMap) {
 		for (const SLosInstance::RLE rle: losSquares) {
-			for (int idx = rle.start, len = rle.length; len > 0; --len, ++idx) {
-				losmap[idx] += amount;
-
-				// skip if this los-square did not *enter* LOS
-				if (losmap[idx] != amount)
-					continue;
-
-				const int2 lm = IdxToCoord(idx, size.x);
+			// only called for los-squares that *entered* LOS
+			SpanAdd(&losmap[rle.start], rle.length, static_cast<unsigned short>(amount), [&](size_t i) {
+				const int2 lm = IdxToCoord(rle.start + i, size.x);
 				const int2 p1 = (lm             ) * LOS2HEIGHT;
 				const int2 p2 = (lm + int2(1, 1)) * LOS2HEIGHT;
 				const int2 p3 = {std::min(p2.x, mapDims.mapxm1), std::min(p2.y, mapDims.mapym1)};
 
 				readMap->UpdateLOS(SRectangle(p1.x, p1.y,  p3.x, p3.y));
-			}
+			});
 		}
 
 		return;
 	}
 
 	for (const SLosInstance::RLE rle: losSquares) {
-		for (int idx = rle.start, len = rle.length; len > 0; --len, ++idx) {
-			losmap[idx] += amount;
-		}
+		SpanAdd(&losmap[rle.start], rle.length, static_cast<unsigned short>(amount));
 	}
 }
 
@@ -501,8 +503,18 @@ void CLosMap::LosAdd(SLosInstance* li) const
 	const SRectangle fullRect(0, 0, size.x, size.y);
 	const SRectangle safeRect(li->radius, li->radius, size.x - li->radius, size.y - li->radius);
 
-	if (fullRect.Inside(li->basePos) && li->baseHeight <= ctrHeightMap[MAP_SQUARE_FULLRES(li->basePos)])
+	if (fullRect.Inside(li->basePos) && li->baseHeight <= ctrHeightMap[MAP_SQUARE_FULLRES(li->basePos)]) {
+		// no rays were cast, nothing to reuse
+		li->occludedRaySquares.clear();
+		li->dirtyRect = {};
+		return;
+	}
+
+	// only retrace the rays affected by terrain changes since the last raycast
+	if (!li->occludedRaySquares.empty() && RetraceDirtyRays(li)) {
+		li->dirtyRect = {};
 		return;
+	}
 
 	// add all squares within the instance's sight radius
 	if (safeRect.Inside(li->basePos)) {
@@ -512,6 +524,8 @@ void CLosMap::LosAdd(SLosInstance* li) const
 		// we need to check each square if it's outside of the map boundaries
 		SafeLosAdd(li);
 	}
+
+	li->dirtyRect = {};
 }
 
 
@@ -522,7 +536,22 @@ inline static constexpr size_t ToAngleMapIdx(const int2 p, const int radius)
 }
 
 
-inline void CastLos(
+// mirrors a square of a ray in the upper right sector into quadrant q
+inline static constexpr int2 ToRayQuadrant(const int2 p, const int q)
+{
+	switch (q) {
+		case 0: return int2( p.x,  p.y);
+		case 1: return int2(-p.x, -p.y);
+		case 2: return int2( p.y, -p.x);
+		default: break;
+	}
+
+	return int2(-p.y, p.x);
+}
+
+
+// returns true if the square is occluded
+inline bool CastLos(
 	float* prvAngle,
 	float* maxAngle,
 	const int2& off,
@@ -537,7 +566,7 @@ inline void CastLos(
 	// angle to square is smaller than current max-angle, so not visible
 	if (raycastAngles[oidx] < *maxAngle) {
 		losRaySquares[oidx] = false;
-		return;
+		return true;
 	}
 
 	if (raycastAngles[oidx] < *prvAngle) {
@@ -546,11 +575,12 @@ inline void CastLos(
 
 		if (raycastAngles[oidx] < (*maxAngle = angle)) {
 			losRaySquares[oidx] = false;
-			return;
+			return true;
 		}
 	}
 
 	*prvAngle = raycastAngles[oidx];
+	return false;
 }
 
 
@@ -661,7 +691,12 @@ void CLosMap::UnsafeLosAdd(SLosInstance* li) const
 
 	const size_t numRays = helper.GetLosTableSize(radius);
 
-	for (size_t i = 0; i < numRays; ++i) {
+	// remember which squares each ray occluded, see RetraceDirtyRays
+	std::vector<bool>& occludedRaySquares = li->occludedRaySquares;
+	occludedRaySquares.clear();
+	occludedRaySquares.resize(4 * helper.GetLosTableSquareCount(radius), false);
+
+	for (size_t i = 0, rayBit = 0; i < numRays; ++i) {
 		float maxAngles[4] = {-1e7, -1e7, -1e7, -1e7};
 		float prvAngles[4] = {-1e7, -1e7, -1e7, -1e7};
 
@@ -670,13 +705,17 @@ void CLosMap::UnsafeLosAdd(SLosInstance* li) const
 		for (size_t n = 0; n < numSquares; n++) {
 			const int2 square = helper.GetLosTableRaySquare(radius, i, n);
 
-			CastLos(&prvAngles[0], &maxAngles[0],       square              , losRaySquares, raycastAngles, radius, threadNum);
-			CastLos(&prvAngles[1], &maxAngles[1],      -square              , losRaySquares, raycastAngles, radius, threadNum);
-			CastLos(&prvAngles[2], &maxAngles[2], int2( square.y, -square.x), losRaySquares, raycastAngles, radius, threadNum);
-			CastLos(&prvAngles[3], &maxAngles[3], int2(-square.y,  square.x), losRaySquares, raycastAngles, radius, threadNum);
+			occludedRaySquares[rayBit + 0 * numSquares + n] = CastLos(&prvAngles[0], &maxAngles[0],       square              , losRaySquares, raycastAngles, radius, threadNum);
+			occludedRaySquares[rayBit + 1 * numSquares + n] = CastLos(&prvAngles[1], &maxAngles[1],      -square              , losRaySquares, raycastAngles, radius, threadNum);
+			occludedRaySquares[rayBit + 2 * numSquares + n] = CastLos(&prvAngles[2], &maxAngles[2], int2( square.y, -square.x), losRaySquares, raycastAngles, radius, threadNum);
+			occludedRaySquares[rayBit + 3 * numSquares + n] = CastLos(&prvAngles[3], &maxAngles[3], int2(-square.y,  square.x), losRaySquares, raycastAngles, radius, threadNum);
 		}
+
+		rayBit += 4 * numSquares;
 	}
 
+	ILosType::raysRetraced += 4 * numRays;
+
 	// translate visible square indices to map square idx + RLE
 	AddSquaresToInstance(li, losRaySquares);
 }
@@ -750,10 +789,14 @@ void CLosMap::SafeLosAdd(SLosInstance* li) const
 	// Cast the Rays
 	const size_t numRays = helper.GetLosTableSize(radius);
 
+	std::vector<bool>& occludedRaySquares = li->occludedRaySquares;
+	occludedRaySquares.clear();
+	occludedRaySquares.resize(4 * helper.GetLosTableSquareCount(radius), false);
+
 	if (safeRect.Inside(pos)) {
 		losRaySquares[ToAngleMapIdx(int2(0, 0), radius)] = true;
 
-		for (size_t i = 0; i < numRays; ++i) {
+		for (size_t i = 0, rayBit = 0; i < numRays; ++i) {
 			float maxAngles[4] = {-1e7, -1e7, -1e7, -1e7};
 			float prvAngles[4] = {-1e7, -1e7, -1e7, -1e7};
 
@@ -765,7 +808,7 @@ void CLosMap::SafeLosAdd(SLosInstance* li) const
 				if (!safeRect.Inside(pos + square))
 					break;
 
-				CastLos(&prvAngles[0], &maxAngles[0],  square,                   losRaySquares, raycastAngles, radius, threadNum);
+				occludedRaySquares[rayBit + 0 * numSquares + n] = CastLos(&prvAngles[0], &maxAngles[0],  square,                   losRaySquares, raycastAngles, radius, threadNum);
 			}
 			for (size_t n = 0; n < numSquares; n++) {
 				const int2 square = helper.GetLosTableRaySquare(radius, i, n);
@@ -773,7 +816,7 @@ void CLosMap::SafeLosAdd(SLosInstance* li) const
 				if (!safeRect.Inside(pos - square))
 					break;
 
-				CastLos(&prvAngles[1], &maxAngles[1], -square,                   losRaySquares, raycastAngles, radius, threadNum);
+				occludedRaySquares[rayBit + 1 * numSquares + n] = CastLos(&prvAngles[1], &maxAngles[1], -square,                   losRaySquares, raycastAngles, radius, threadNum);
 			}
 			for (size_t n = 0; n < numSquares; n++) {
 				const int2 square = helper.GetLosTableRaySquare(radius, i, n);
@@ -781,7 +824,7 @@ void CLosMap::SafeLosAdd(SLosInstance* li) const
 				if (!safeRect.Inside(pos + int2(square.y, -square.x)))
 					break;
 
-				CastLos(&prvAngles[2], &maxAngles[2], int2(square.y, -square.x), losRaySquares, raycastAngles, radius, threadNum);
+				occludedRaySquares[rayBit + 2 * numSquares + n] = CastLos(&prvAngles[2], &maxAngles[2], int2(square.y, -square.x), losRaySquares, raycastAngles, radius, threadNum);
 			}
 			for (size_t n = 0; n < numSquares; n++) {
 				const int2 square = helper.GetLosTableRaySquare(radius, i, n);
@@ -789,12 +832,14 @@ void CLosMap::SafeLosAdd(SLosInstance* li) const
 				if (!safeRect.Inside(pos + int2(-square.y, square.x)))
 					break;
 
-				CastLos(&prvAngles[3], &maxAngles[3], int2(-square.y, square.x), losRaySquares, raycastAngles, radius, threadNum);
+				occludedRaySquares[rayBit + 3 * numSquares + n] = CastLos(&prvAngles[3], &maxAngles[3], int2(-square.y, square.x), losRaySquares, raycastAngles, radius, threadNum);
 			}
+
+			rayBit += 4 * numSquares;
 		}
 	} else {
 		// emit position outside the map
-		for (size_t i = 0; i < numRays; ++i) {
+		for (size_t i = 0, rayBit = 0; i < numRays; ++i) {
 			float maxAngles[4] = {-1e7, -1e7, -1e7, -1e7};
 			float prvAngles[4] = {-1e7, -1e7, -1e7, -1e7};
 
@@ -804,20 +849,179 @@ void CLosMap::SafeLosAdd(SLosInstance* li) const
 				const int2 square = helper.GetLosTableRaySquare(radius, i, n);
 
 				if (safeRect.Inside(pos + square))
-					CastLos(&prvAngles[0], &maxAngles[0],  square,                   losRaySquares, raycastAngles, radius, threadNum);
+					occludedRaySquares[rayBit + 0 * numSquares + n] = CastLos(&prvAngles[0], &maxAngles[0],  square,                   losRaySquares, raycastAngles, radius, threadNum);
 
 				if (safeRect.Inside(pos - square))
-					CastLos(&prvAngles[1], &maxAngles[1], -square,                   losRaySquares, raycastAngles, radius, threadNum);
+					occludedRaySquares[rayBit + 1 * numSquares + n] = CastLos(&prvAngles[1], &maxAngles[1], -square,                   losRaySquares, raycastAngles, radius, threadNum);
 
 				if (safeRect.Inside(pos + int2(square.y, -square.x)))
-					CastLos(&prvAngles[2], &maxAngles[2], int2(square.y, -square.x), losRaySquares, raycastAngles, radius, threadNum);
+					occludedRaySquares[rayBit + 2 * numSquares + n] = CastLos(&prvAngles[2], &maxAngles[2], int2(square.y, -square.x), losRaySquares, raycastAngles, radius, threadNum);
 
 				if (safeRect.Inside(pos + int2(-square.y, square.x)))
-					CastLos(&prvAngles[3], &maxAngles[3], int2(-square.y, square.x), losRaySquares, raycastAngles, radius, threadNum);
+					occludedRaySquares[rayBit + 3 * numSquares + n] = CastLos(&prvAngles[3], &maxAngles[3], int2(-square.y, square.x), losRaySquares, raycastAngles, radius, threadNum);
+			}
+
+			rayBit += 4 * numSquares;
+		}
+	}
+
+	ILosType::raysRetraced += 4 * numRays;
+
+	// translate visible square indices to map square idx + RLE
+	AddSquaresToInstance(li, losRaySquares);
+}
+
+
+bool CLosMap::RetraceDirtyRays(SLosInstance* li) const
+{
+	RECOIL_DETAILED_TRACY_ZONE;
+	// Rays are traced independently of each other and a square's angle only depends
+	// on its own height, so every ray that does not cross the area changed since the
+	// last raycast would produce the same occlusion again. Those are reapplied from
+	// the instance, the rest is cast exactly like {Unsafe,Safe}LosAdd would.
+	const int threadNum = ThreadPool::GetThreadNum();
+
+	const int2 pos   = li->basePos;
+	const int radius = li->radius;
+	const float losHeight = li->baseHeight;
+
+	// changed area relative to the instance
+	const SRectangle dirtyRect = {
+		li->dirtyRect.x1 - pos.x,
+		li->dirtyRect.z1 - pos.y,
+		li->dirtyRect.x2 - pos.x,
+		li->dirtyRect.z2 - pos.y,
+	};
+
+	// the base square's height affects the whole instance
+	if (dirtyRect.Inside(int2(0, 0)))
+		return false;
+
+	CLosTableHelper& helper = losTableHelpers[threadNum];
+
+	std::vector< char>& losRaySquares = LOSRAY_SQUARE_TABLES[threadNum];
+	std::vector<float>& raycastAngles = RAYCAST_ANGLE_TABLES[threadNum];
+	std::vector< bool>& occludedRaySquares = li->occludedRaySquares;
+
+	helper.GenerateForLosSize(radius);
+
+	if (occludedRaySquares.size() != 4 * helper.GetLosTableSquareCount(radius))
+		return false;
+
+	losRaySquares.clear();
+	losRaySquares.resize(Square((2 * radius) + 1), false);
+	raycastAngles.clear();
+	raycastAngles.resize(Square((2 * radius) + 1), -1e8);
+
+
+	const SRectangle safeRect(0, 0, size.x, size.y);
+	const bool insideMap = safeRect.Inside(pos);
+
+	isqrtTableExpand((radius + 1) * (radius + 1), threadNum);
+
+	// every square within the radius is visible unless some ray occludes it
+	MidpointCircleAlgoPerLine(radius, [&](int width, int y) {
+		const unsigned y_ = pos.y + y;
+
+		if (y_ < size.y) {
+			const unsigned sx = std::clamp(pos.x - width,     0, size.x);
+			const unsigned ex = std::clamp(pos.x + width + 1, 0, size.x);
+			if (sx == ex)
+				return;
+
+			std::fill_n(&losRaySquares[ToAngleMapIdx(int2(sx - pos.x, y), radius)], ex - sx, true);
+		}
+	});
+
+	losRaySquares[ToAngleMapIdx(int2(0, 0), radius)] = insideMap;
+
+	const auto IsDirtyRay = [&](const int2 first, const int2 last, int q) {
+		const int2 a = ToRayQuadrant(first, q);
+		const int2 b = ToRayQuadrant(last , q);
+		const SRectangle rayRect = {
+			std::min(a.x, b.x),
+			std::min(a.y, b.y),
+			std::max(a.x, b.x) + 1,
+			std::max(a.y, b.y) + 1,
+		};
+
+		return (rayRect.CheckOverlap(dirtyRect));
+	};
+
+	const size_t numRays = helper.GetLosTableSize(radius);
+
+	// precalc the angles along the dirty rays, squares beyond the
+	// radius or map borders keep theirs at -1e8 as in the full case
+	for (size_t i = 0; i < numRays; ++i) {
+		const size_t numSquares = helper.GetLosTableRaySize(radius, i);
+
+		const int2 first = helper.GetLosTableRaySquare(radius, i, 0);
+		const int2 last  = helper.GetLosTableRaySquare(radius, i, numSquares - 1);
+
+		for (int q = 0; q < 4; ++q) {
+			if (!IsDirtyRay(first, last, q))
+				continue;
+
+			for (size_t n = 0; n < numSquares; n++) {
+				const int2 off = ToRayQuadrant(helper.GetLosTableRaySquare(radius, i, n), q);
+				const size_t oidx = ToAngleMapIdx(off, radius);
+
+				if (!losRaySquares[oidx])
+					continue;
+
+				const float invR = isqrtTableLookup(off.x*off.x + off.y*off.y, threadNum);
+				const float dh = std::max(0.0f, mipHeightMap[MAP_SQUARE(pos + off)]) - losHeight;
+
+				raycastAngles[oidx] = (dh + LOS_BONUS_HEIGHT) * invR;
+			}
+		}
+	}
+
+	size_t numRetraced = 0;
+
+	for (size_t i = 0, rayBit = 0; i < numRays; ++i) {
+		const size_t numSquares = helper.GetLosTableRaySize(radius, i);
+
+		const int2 first = helper.GetLosTableRaySquare(radius, i, 0);
+		const int2 last  = helper.GetLosTableRaySquare(radius, i, numSquares - 1);
+
+		for (int q = 0; q < 4; ++q, rayBit += numSquares) {
+			if (!IsDirtyRay(first, last, q)) {
+				for (size_t n = 0; n < numSquares; n++) {
+					if (!occludedRaySquares[rayBit + n])
+						continue;
+
+					losRaySquares[ToAngleMapIdx(ToRayQuadrant(helper.GetLosTableRaySquare(radius, i, n), q), radius)] = false;
+				}
+
+				continue;
 			}
+
+			float maxAngle = -1e7;
+			float prvAngle = -1e7;
+
+			for (size_t n = 0; n < numSquares; n++) {
+				const int2 off = ToRayQuadrant(helper.GetLosTableRaySquare(radius, i, n), q);
+
+				// same as SafeLosAdd; never true for instances handled by UnsafeLosAdd
+				if (!safeRect.Inside(pos + off)) {
+					if (insideMap)
+						break;
+
+					continue;
+				}
+
+				occludedRaySquares[rayBit + n] = CastLos(&prvAngle, &maxAngle, off, losRaySquares, raycastAngles, radius, threadNum);
+			}
+
+			numRetraced += 1;
 		}
 	}
 
+	ILosType::raysRetraced += numRetraced;
+	ILosType::raysReused   += (4 * numRays - numRetraced);
+
 	// translate visible square indices to map square idx + RLE
 	AddSquaresToInstance(li, losRaySquares);
+	return true;
 }
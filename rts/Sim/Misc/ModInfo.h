@@ -214,6 +214,12 @@ public:
 	/// Enable to reduce CPU usage, but also reduce quality of resultant paths.
 	bool qtLowerQualityPaths;
 
+	/// Maximum distance, in elmos, between the start points of two synced QTPFS searches
+	/// towards the same goal area for the later one to wait for the earlier one and only
+	/// search until it meets the earlier one's route (e.g. for group move orders). Results
+	/// that are much longer than the earlier route are discarded. 0 (default) disables it.
+	float qtGoalShareMaxSourceDist;
+
 	float pfRawDistMult;
 	float pfUpdateRateScale;
 
@@ -230,6 +236,19 @@ public:
 
 	int quadFieldQuadSizeInElmos;
 
+	/// Experimental: keep packed copies of object positions and radii in every quadfield cell
+	/// and filter the exact unit/feature/projectile queries on those, relocating projectiles in
+	/// a batch after their update. The copies are refreshed when units and projectiles report
+	/// their move to the quadfield and again at the end of each frame; queries made while a
+	/// stage is still moving objects can see some at their previous position, so results may
+	/// differ from the default path.
+	bool quadFieldPackedPositions;
+
+	/// Detect synced projectile-vs-object hits in parallel, then resolve them in projectile
+	/// order. Results detected before an earlier projectile's hit are detected again, so
+	/// the outcome is identical to the serial pass; the gain shrinks as hits get denser.
+	bool parallelProjectileCollisions;
+
 	bool allowTake;
 	bool allowEnginePlayerlist;
 };
@@ -28,6 +28,7 @@ CR_REG_METADATA(CQuadField, (
 	CR_MEMBER(quadSizeX),
 	CR_MEMBER(quadSizeZ),
 	CR_MEMBER(invQuadSize),
+	CR_IGNORED(packedPositions),
 
 	CR_IGNORED(tempUnits),
 	CR_IGNORED(tempFeatures),
@@ -43,6 +44,9 @@ CR_REG_METADATA_SUB(CQuadField, Quad, (
 	CR_MEMBER(features),
 	CR_MEMBER(projectiles),
 	CR_MEMBER(repulsers),
+	CR_IGNORED(unitSpheres),
+	CR_IGNORED(featureSpheres),
+	CR_IGNORED(projectileSpheres),
 
 	CR_POSTLOAD(PostLoad)
 ))
@@ -104,15 +108,27 @@ void CQuadField::Quad::PostLoad()
 #ifndef UNIT_TEST
 	Resize(teamHandler.ActiveAllyTeams());
 
+	unitSpheres.clear();
+	featureSpheres.clear();
+	projectileSpheres.clear();
+
 	for (CUnit* unit: units) {
 		spring::VectorInsertUnique(teamUnits[unit->allyteam], unit, false);
+		unitSpheres.emplace_back(unit->pos, unit->radius);
+	}
+	for (CFeature* feature: features) {
+		featureSpheres.emplace_back(feature->pos, feature->radius);
+	}
+	for (CProjectile* p: projectiles) {
+		projectileSpheres.emplace_back(p->pos, p->radius);
 	}
 #endif
 }
 
-void CQuadField::Init(int2 mapDims, int quadSize)
+void CQuadField::Init(int2 mapDims, int quadSize, bool packedPositions_)
 {
 	RECOIL_DETAILED_TRACY_ZONE;
+	packedPositions = packedPositions_;
 	quadSizeX = quadSize;
 	quadSizeZ = quadSize;
 	numQuadsX = (mapDims.x * SQUARE_SIZE) / quadSize;
@@ -167,6 +183,47 @@ void CQuadField::Kill()
 }
 
 
+#ifndef UNIT_TEST
+void CQuadField::UpdatePackedPositions()
+{
+	RECOIL_DETAILED_TRACY_ZONE;
+	if (!packedPositions)
+		return;
+
+	// each quad only writes its own spheres, objects are just read
+	for_mt(0, baseQuads.size(), [this](const int qi) {
+		Quad& quad = baseQuads[qi];
+
+		for (size_t i = 0, n = quad.units.size(); i < n; ++i) {
+			quad.unitSpheres[i] = {quad.units[i]->pos, quad.units[i]->radius};
+		}
+		for (size_t i = 0, n = quad.features.size(); i < n; ++i) {
+			quad.featureSpheres[i] = {quad.features[i]->pos, quad.features[i]->radius};
+		}
+		for (size_t i = 0, n = quad.projectiles.size(); i < n; ++i) {
+			quad.projectileSpheres[i] = {quad.projectiles[i]->pos, quad.projectiles[i]->radius};
+		}
+	});
+}
+
+
+template<typename T, typename RangePred, typename VisitPred>
+static void GetPackedObjects(
+	const std::vector<CQuadField::Quad>& baseQuads,
+	const std::vector<int>& quads,
+	std::vector<T*> CQuadField::Quad::* objects,
+	std::vector<float4> CQuadField::Quad::* spheres,
+	std::vector<T*>& result,
+	RangePred&& inRange,
+	VisitPred&& firstVisit
+) {
+	for (const int qi: quads) {
+		CQuadField::Quad::GetPackedObjects(baseQuads[qi].*objects, baseQuads[qi].*spheres, result, inRange, firstVisit);
+	}
+}
+#endif
+
+
 int2 CQuadField::WorldPosToQuadField(const float3 p) const
 {
 	return int2(
@@ -347,8 +404,10 @@ bool CQuadField::InsertUnitIf(CUnit* unit, const float3& wpos)
 	if (!spring::VectorInsertUnique(unit->quads, wposQuadIdx, true))
 		return false;
 
-	spring::VectorInsertUnique(baseQuads[wposQuadIdx].units, unit, false);
-	spring::VectorInsertUnique(baseQuads[wposQuadIdx].teamUnits[unit->allyteam], unit, false);
+	Quad& quad = baseQuads[wposQuadIdx];
+
+	Quad::InsertObject(quad.units, quad.unitSpheres, unit, {unit->pos, unit->radius});
+	spring::VectorInsertUnique(quad.teamUnits[unit->allyteam], unit, false);
 	return true;
 }
 
@@ -378,8 +437,10 @@ bool CQuadField::RemoveUnitIf(CUnit* unit, const float3& wpos)
 	if (!spring::VectorErase(unit->quads, wposQuadIdx))
 		return false;
 
-	spring::VectorErase(baseQuads[wposQuadIdx].units, unit);
-	spring::VectorErase(baseQuads[wposQuadIdx].teamUnits[unit->allyteam], unit);
+	Quad& quad = baseQuads[wposQuadIdx];
+
+	Quad::EraseObject(quad.units, quad.unitSpheres, unit);
+	spring::VectorErase(quad.teamUnits[unit->allyteam], unit);
 	return true;
 }
 #endif
@@ -392,31 +453,49 @@ void CQuadField::MovedUnit(CUnit* unit)
 	RECOIL_DETAILED_TRACY_ZONE;
 	QuadFieldQuery qfQuery;
 	GetQuads(qfQuery, unit->pos, unit->radius);
+	MovedUnit(unit, *qfQuery.quads);
+}
 
+void CQuadField::MovedUnit(CUnit* unit, std::vector<int>& quads)
+{
+	RECOIL_DETAILED_TRACY_ZONE;
 	// compare if the quads have changed, if not stop here
-	if (qfQuery.quads->size() == unit->quads.size()) {
-		if (std::equal(qfQuery.quads->begin(), qfQuery.quads->end(), unit->quads.begin()))
+	if (quads.size() == unit->quads.size()) {
+		if (std::equal(quads.begin(), quads.end(), unit->quads.begin())) {
+			UpdateUnitSphere(unit);
 			return;
+		}
 	}
 
 	for (const int qi: unit->quads) {
-		spring::VectorErase(baseQuads[qi].units, unit);
+		Quad::EraseObject(baseQuads[qi].units, baseQuads[qi].unitSpheres, unit);
 		spring::VectorErase(baseQuads[qi].teamUnits[unit->allyteam], unit);
 	}
 
-	for (const int qi: *qfQuery.quads) {
-		spring::VectorInsertUnique(baseQuads[qi].units, unit, false);
+	for (const int qi: quads) {
+		Quad::InsertObject(baseQuads[qi].units, baseQuads[qi].unitSpheres, unit, {unit->pos, unit->radius});
 		spring::VectorInsertUnique(baseQuads[qi].teamUnits[unit->allyteam], unit, false);
 	}
 
-	unit->quads = std::move(*qfQuery.quads);
+	unit->quads = std::move(quads);
+}
+
+void CQuadField::UpdateUnitSphere(CUnit* unit)
+{
+	RECOIL_DETAILED_TRACY_ZONE;
+	if (!packedPositions)
+		return;
+
+	for (const int qi: unit->quads) {
+		Quad::UpdateObject(baseQuads[qi].units, baseQuads[qi].unitSpheres, unit, {unit->pos, unit->radius});
+	}
 }
 
 void CQuadField::RemoveUnit(CUnit* unit)
 {
 	RECOIL_DETAILED_TRACY_ZONE;
 	for (const int qi: unit->quads) {
-		spring::VectorErase(baseQuads[qi].units, unit);
+		Quad::EraseObject(baseQuads[qi].units, baseQuads[qi].unitSpheres, unit);
 		spring::VectorErase(baseQuads[qi].teamUnits[unit->allyteam], unit);
 	}
 
@@ -485,7 +564,7 @@ void CQuadField::AddFeature(CFeature* feature)
 	GetQuads(qfQuery, feature->pos, feature->radius);
 
 	for (const int qi: *qfQuery.quads) {
-		spring::VectorInsertUnique(baseQuads[qi].features, feature, false);
+		Quad::InsertObject(baseQuads[qi].features, baseQuads[qi].featureSpheres, feature, {feature->pos, feature->radius});
 	}
 }
 
@@ -496,7 +575,7 @@ void CQuadField::RemoveFeature(CFeature* feature)
 	GetQuads(qfQuery, feature->pos, feature->radius);
 
 	for (const int qi: *qfQuery.quads) {
-		spring::VectorErase(baseQuads[qi].features, feature);
+		Quad::EraseObject(baseQuads[qi].features, baseQuads[qi].featureSpheres, feature);
 	}
 
 	#ifdef DEBUG_QUADFIELD
@@ -523,7 +602,11 @@ void CQuadField::MovedProjectile(CProjectile* p)
 	if (newQuad != p->quads.back()) {
 		RemoveProjectile(p);
 		AddProjectile(p);
+		return;
 	}
+
+	if (packedPositions)
+		Quad::UpdateObject(baseQuads[newQuad].projectiles, baseQuads[newQuad].projectileSpheres, p, {p->pos, p->radius});
 }
 
 void CQuadField::AddProjectile(CProjectile* p)
@@ -536,13 +619,13 @@ void CQuadField::AddProjectile(CProjectile* p)
 		GetQuadsOnRay(qfQuery, p->pos, p->dir, p->speed.w);
 
 		for (const int qi: *qfQuery.quads) {
-			spring::VectorInsertUnique(baseQuads[qi].projectiles, p, false);
+			Quad::InsertObject(baseQuads[qi].projectiles, baseQuads[qi].projectileSpheres, p, {p->pos, p->radius});
 		}
 
 		p->quads = std::move(*qfQuery.quads);
 	} else {
 		int newQuad = WorldPosToQuadFieldIdx(p->pos);
-		spring::VectorInsertUnique(baseQuads[newQuad].projectiles, p, false);
+		Quad::InsertObject(baseQuads[newQuad].projectiles, baseQuads[newQuad].projectileSpheres, p, {p->pos, p->radius});
 		p->quads.clear();
 		p->quads.push_back(newQuad);
 	}
@@ -554,7 +637,7 @@ void CQuadField::RemoveProjectile(CProjectile* p)
 	assert(p->synced);
 
 	for (const int qi: p->quads) {
-		spring::VectorErase(baseQuads[qi].projectiles, p);
+		Quad::EraseObject(baseQuads[qi].projectiles, baseQuads[qi].projectileSpheres, p);
 	}
 
 	p->quads.clear();
@@ -597,6 +680,19 @@ void CQuadField::GetUnitsExact(QuadFieldQuery& qfq, const float3& pos, float rad
 	const int tempNum = gs->GetMtTempNum(curThread);
 	qfq.units = tempUnits[curThread].ReserveVector();
 
+	if (packedPositions) {
+		GetPackedObjects(baseQuads, *qfQuery.quads, &Quad::units, &Quad::unitSpheres, *qfq.units, [&](const float4& s) {
+			return ((spherical? pos.SqDistance(s): pos.SqDistance2D(s)) < Square(radius + s.w));
+		}, [&](CUnit* u) {
+			if (u->mtTempNum[curThread] == tempNum)
+				return false;
+
+			u->mtTempNum[curThread] = tempNum;
+			return true;
+		});
+		return;
+	}
+
 	for (const int qi: *qfQuery.quads) {
 		for (CUnit* u: baseQuads[qi].units) {
 			if (u->mtTempNum[curThread] == tempNum)
@@ -630,6 +726,19 @@ void CQuadField::GetUnitsExact(QuadFieldQuery& qfq, const float3& mins, const fl
 	const int tempNum = gs->GetMtTempNum(curThread);
 	qfq.units = tempUnits[curThread].ReserveVector();
 
+	if (packedPositions) {
+		GetPackedObjects(baseQuads, *qfQuery.quads, &Quad::units, &Quad::unitSpheres, *qfq.units, [&](const float4& s) {
+			return (s.x >= mins.x && s.x <= maxs.x && s.z >= mins.z && s.z <= maxs.z);
+		}, [&](CUnit* u) {
+			if (u->mtTempNum[curThread] == tempNum)
+				return false;
+
+			u->mtTempNum[curThread] = tempNum;
+			return true;
+		});
+		return;
+	}
+
 	for (const int qi: *qfQuery.quads) {
 		for (CUnit* unit: baseQuads[qi].units) {
 
@@ -662,6 +771,19 @@ void CQuadField::GetFeaturesExact(QuadFieldQuery& qfq, const float3& pos, float
 	const int tempNum = gs->GetMtTempNum(curThread);
 	qfq.features = tempFeatures[curThread].ReserveVector();
 
+	if (packedPositions) {
+		GetPackedObjects(baseQuads, *qfQuery.quads, &Quad::features, &Quad::featureSpheres, *qfq.features, [&](const float4& s) {
+			return ((spherical? pos.SqDistance(s): pos.SqDistance2D(s)) < Square(radius + s.w));
+		}, [&](CFeature* f) {
+			if (f->mtTempNum[curThread] == tempNum)
+				return false;
+
+			f->mtTempNum[curThread] = tempNum;
+			return true;
+		});
+		return;
+	}
+
 	for (const int qi: *qfQuery.quads) {
 		for (CFeature* f: baseQuads[qi].features) {
 			if (f->mtTempNum[curThread] == tempNum)
@@ -695,6 +817,19 @@ void CQuadField::GetFeaturesExact(QuadFieldQuery& qfq, const float3& mins, const
 	const int tempNum = gs->GetMtTempNum(curThread);
 	qfq.features = tempFeatures[curThread].ReserveVector();
 
+	if (packedPositions) {
+		GetPackedObjects(baseQuads, *qfQuery.quads, &Quad::features, &Quad::featureSpheres, *qfq.features, [&](const float4& s) {
+			return (s.x >= mins.x && s.x <= maxs.x && s.z >= mins.z && s.z <= maxs.z);
+		}, [&](CFeature* f) {
+			if (f->mtTempNum[curThread] == tempNum)
+				return false;
+
+			f->mtTempNum[curThread] = tempNum;
+			return true;
+		});
+		return;
+	}
+
 	for (const int qi: *qfQuery.quads) {
 		for (CFeature* feature: baseQuads[qi].features) {
 			if (feature->mtTempNum[curThread] == tempNum)
@@ -725,6 +860,19 @@ void CQuadField::GetProjectilesExact(QuadFieldQuery& qfq, const float3& pos, flo
 	const int tempNum = gs->GetTempNum();
 	qfq.projectiles = tempProjectiles.ReserveVector();
 
+	if (packedPositions) {
+		GetPackedObjects(baseQuads, *qfQuery.quads, &Quad::projectiles, &Quad::projectileSpheres, *qfq.projectiles, [&](const float4& s) {
+			return (pos.SqDistance(s) < Square(radius + s.w));
+		}, [&](CProjectile* p) {
+			if (p->tempNum == tempNum)
+				return false;
+
+			p->tempNum = tempNum;
+			return true;
+		});
+		return;
+	}
+
 	for (const int qi: *qfQuery.quads) {
 		for (CProjectile* p: baseQuads[qi].projectiles) {
 			if (p->tempNum == tempNum)
@@ -750,6 +898,19 @@ void CQuadField::GetProjectilesExact(QuadFieldQuery& qfq, const float3& mins, co
 	const int tempNum = gs->GetTempNum();
 	qfq.projectiles = tempProjectiles.ReserveVector();
 
+	if (packedPositions) {
+		GetPackedObjects(baseQuads, *qfQuery.quads, &Quad::projectiles, &Quad::projectileSpheres, *qfq.projectiles, [&](const float4& s) {
+			return (s.x >= mins.x && s.x <= maxs.x && s.z >= mins.z && s.z <= maxs.z);
+		}, [&](CProjectile* p) {
+			if (p->tempNum == tempNum)
+				return false;
+
+			p->tempNum = tempNum;
+			return true;
+		});
+		return;
+	}
+
 	for (const int qi: *qfQuery.quads) {
 		for (CProjectile* p: baseQuads[qi].projectiles) {
 			if (p->tempNum == tempNum)
@@ -943,4 +1104,71 @@ void CQuadField::GetUnitsAndFeaturesColVol(
 		}
 	}
 }
+
+void CQuadField::GetUnitsAndFeaturesColVol(
+	QuadFieldQuery& qfq,
+	const float3& pos,
+	const float radius,
+	std::vector<CPlasmaRepulser*>* repulsers
+) {
+	RECOIL_DETAILED_TRACY_ZONE;
+	auto curThread = qfq.threadOwner;
+	QuadFieldQuery qfQuery;
+	qfQuery.threadOwner = curThread;
+	GetQuads(qfQuery, pos, radius);
+	const int tempNum = gs->GetMtTempNum(curThread);
+	qfq.units = tempUnits[curThread].ReserveVector();
+	qfq.features = tempFeatures[curThread].ReserveVector();
+
+	for (const int qi: *qfQuery.quads) {
+		const Quad& quad = baseQuads[qi];
+
+		for (CUnit* u: quad.units) {
+			if (u->mtTempNum[curThread] == tempNum)
+				continue;
+
+			u->mtTempNum[curThread] = tempNum;
+
+			const auto* colvol = &u->collisionVolume;
+			const float totRad = radius + colvol->GetBoundingRadius();
+
+			if (pos.SqDistance(colvol->GetWorldSpacePos(u)) >= (totRad * totRad))
+				continue;
+
+			qfq.units->push_back(u);
+		}
+
+		for (CFeature* f: quad.features) {
+			if (f->mtTempNum[curThread] == tempNum)
+				continue;
+
+			f->mtTempNum[curThread] = tempNum;
+
+			const auto* colvol = &f->collisionVolume;
+			const float totRad = radius + colvol->GetBoundingRadius();
+
+			if (pos.SqDistance(colvol->GetWorldSpacePos(f)) >= (totRad * totRad))
+				continue;
+
+			qfq.features->push_back(f);
+		}
+
+		if (repulsers == nullptr)
+			continue;
+
+		for (CPlasmaRepulser* r: quad.repulsers) {
+			// repulsers have no per-thread tempNum, but are few per query
+			if (std::find(repulsers->begin(), repulsers->end(), r) != repulsers->end())
+				continue;
+
+			const auto* colvol = &r->collisionVolume;
+			const float totRad = radius + colvol->GetBoundingRadius();
+
+			if (pos.SqDistance(r->weaponMuzzlePos) >= (totRad * totRad))
+				continue;
+
+			repulsers->push_back(r);
+		}
+	}
+}
 #endif // UNIT_TEST
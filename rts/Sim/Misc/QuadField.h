@@ -11,6 +11,7 @@
 #include "System/Threading/ThreadPool.h"
 #include "System/creg/creg_cond.h"
 #include "System/float3.h"
+#include "System/float4.h"
 #include "System/type2.h"
 
 class CUnit;
@@ -90,9 +91,23 @@ public:
 	static void Resize(int quadSize);
 	*/
 
-	void Init(int2 mapDims, int quadSize);
+	void Init(int2 mapDims, int quadSize, bool packedPositions = false);
 	void Kill();
 
+	/**
+	 * Refreshes the packed positions and radii stored next to every quad's
+	 * units, features and projectiles; called once at the end of each sim
+	 * frame. Only does anything when packed queries are enabled, in which
+	 * case the Get*Exact queries test against these snapshots rather than
+	 * the objects' current positions.
+	 * MovedUnit and MovedProjectile also refresh the moved object's copies,
+	 * UpdateUnitSphere does so for units whose quads are not recomputed on
+	 * this frame (see modInfo.unitQuadPositionUpdateRate).
+	 */
+	void UpdatePackedPositions();
+	void UpdateUnitSphere(CUnit* unit);
+	bool PackedPositions() const { return packedPositions; }
+
 	void GetQuads(QuadFieldQuery& qfq, float3 pos, float radius);
 	void GetQuadsRectangle(QuadFieldQuery& qfq, const float3& mins, const float3& maxs);
 	void GetQuadsOnRay(QuadFieldQuery& qfq, const float3& start, const float3& dir, float length);
@@ -104,6 +119,17 @@ public:
 		std::vector<CFeature*>& features,
 		std::vector<CPlasmaRepulser*>* repulsers = nullptr
 	);
+	/**
+	 * Thread-safe variant of the above for parallel callers, fills
+	 * qfq.units and qfq.features from the per-thread vector caches
+	 * of qfq.threadOwner; returns objects in the same order
+	 */
+	void GetUnitsAndFeaturesColVol(
+		QuadFieldQuery& qfq,
+		const float3& pos,
+		const float radius,
+		std::vector<CPlasmaRepulser*>* repulsers = nullptr
+	);
 
 	/**
 	 * Returns all units within @c radius of @c pos,
@@ -156,6 +182,8 @@ public:
 	bool RemoveUnitIf(CUnit* unit, const float3& wpos);
 
 	void MovedUnit(CUnit* unit);
+	// <quads> must equal what GetQuads returns for the unit's pos and radius; consumed
+	void MovedUnit(CUnit* unit, std::vector<int>& quads);
 	void RemoveUnit(CUnit* unit);
 
 	void AddFeature(CFeature* feature);
@@ -191,9 +219,74 @@ public:
 			features = std::move(q.features);
 			projectiles = std::move(q.projectiles);
 			repulsers = std::move(q.repulsers);
+			unitSpheres = std::move(q.unitSpheres);
+			featureSpheres = std::move(q.featureSpheres);
+			projectileSpheres = std::move(q.projectileSpheres);
 			return *this;
 		}
 
+		// same effect on <objects> as VectorInsertUnique and VectorErase,
+		// <spheres> is kept parallel to it so both retain the same order
+		template<typename T>
+		static void InsertObject(std::vector<T*>& objects, std::vector<float4>& spheres, T* object, const float4& sphere) {
+			assert(std::find(objects.begin(), objects.end(), object) == objects.end());
+			assert(objects.size() == spheres.size());
+
+			objects.push_back(object);
+			spheres.push_back(sphere);
+		}
+
+		template<typename T>
+		static bool UpdateObject(std::vector<T*>& objects, std::vector<float4>& spheres, const T* object, const float4& sphere) {
+			const auto iter = std::find(objects.begin(), objects.end(), object);
+
+			if (iter == objects.end())
+				return false;
+
+			assert(objects.size() == spheres.size());
+
+			spheres[iter - objects.begin()] = sphere;
+			return true;
+		}
+
+		template<typename T>
+		static bool EraseObject(std::vector<T*>& objects, std::vector<float4>& spheres, T* object) {
+			const auto iter = std::find(objects.begin(), objects.end(), object);
+
+			if (iter == objects.end())
+				return false;
+
+			const size_t idx = iter - objects.begin();
+
+			assert(objects.size() == spheres.size());
+
+			objects[idx] = objects.back();
+			spheres[idx] = spheres.back();
+			objects.pop_back();
+			spheres.pop_back();
+			return true;
+		}
+
+		// appends the objects whose packed sphere passes <inRange>; <firstVisit>
+		// marks objects s.t. those overlapping multiple quads are added only once
+		template<typename T, typename RangePred, typename VisitPred>
+		static void GetPackedObjects(
+			const std::vector<T*>& objects,
+			const std::vector<float4>& spheres,
+			std::vector<T*>& result,
+			RangePred&& inRange,
+			VisitPred&& firstVisit
+		) {
+			for (size_t i = 0, n = objects.size(); i < n; ++i) {
+				if (!inRange(spheres[i]))
+					continue;
+				if (!firstVisit(objects[i]))
+					continue;
+
+				result.push_back(objects[i]);
+			}
+		}
+
 		void PostLoad();
 		void Resize(int numAllyTeams) { teamUnits.resize(numAllyTeams); }
 		void Clear() {
@@ -206,6 +299,9 @@ public:
 			features.clear();
 			projectiles.clear();
 			repulsers.clear();
+			unitSpheres.clear();
+			featureSpheres.clear();
+			projectileSpheres.clear();
 		}
 
 	public:
@@ -214,6 +310,12 @@ public:
 		std::vector<CFeature*> features;
 		std::vector<CProjectile*> projectiles;
 		std::vector<CPlasmaRepulser*> repulsers;
+
+		// (pos, radius) of the units, features and projectiles at the same
+		// indices as of their last insertion, move or UpdatePackedPositions call
+		std::vector<float4> unitSpheres;
+		std::vector<float4> featureSpheres;
+		std::vector<float4> projectileSpheres;
 	};
 
 	const Quad& GetQuad(unsigned i) const {
@@ -255,6 +357,9 @@ private:
 
 	int quadSizeX;
 	int quadSizeZ;
+
+	// if true, Get{Units,Features,Projectiles}Exact filter on Quad::*Spheres
+	bool packedPositions = false;
 };
 
 extern CQuadField quadField;
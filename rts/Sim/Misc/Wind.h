@@ -38,6 +38,9 @@ public:
 	const float3& GetCurrentWindVec() const { return curWindVec; }
 	const float3& GetCurrentWindDir() const { return curWindDir; }
 
+	// true if the next Update will draw a new direction or notify generators (scripts)
+	bool UpdatesGenerators() const { return (maxWindStrength > 0.0f && (windDirTimer == 0 || !newGeneratorIDs.empty())); }
+
 private:
 	// update all generators every 15 seconds
 	static constexpr int WIND_UPDATE_RATE = 15 * GAME_SPEED;
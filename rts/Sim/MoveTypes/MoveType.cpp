@@ -84,18 +84,34 @@ void AMoveType::SlowUpdate()
 	UpdateGroundBlockMap();
 }
 
-void AMoveType::UpdateCollisionMap()
+void AMoveType::UpdateCollisionMap(std::vector<int>* preparedQuads)
 {
 	RECOIL_DETAILED_TRACY_ZONE;
-	if ((gs->frameNum + owner->id) % modInfo.unitQuadPositionUpdateRate)
+	if (!WantsCollisionMapUpdate()) {
+		// quads stay as they are until the next throttled update,
+		// but packed positions have to follow the unit every frame
+		quadField.UpdateUnitSphere(owner);
 		return;
+	}
 
-	if (owner->pos != oldCollisionUpdatePos){
-		oldCollisionUpdatePos = owner->pos;
+	oldCollisionUpdatePos = owner->pos;
+
+	// caller guarantees these were computed from the current pos and radius
+	if (preparedQuads != nullptr) {
+		quadField.MovedUnit(owner, *preparedQuads);
+	} else {
 		quadField.MovedUnit(owner);
 	}
 }
 
+bool AMoveType::WantsCollisionMapUpdate() const
+{
+	if ((gs->frameNum + owner->id) % modInfo.unitQuadPositionUpdateRate)
+		return false;
+
+	return (owner->pos != oldCollisionUpdatePos);
+}
+
 void AMoveType::UpdateGroundBlockMap() {
 	RECOIL_DETAILED_TRACY_ZONE;
 	if (owner->pos != oldSlowUpdatePos) {
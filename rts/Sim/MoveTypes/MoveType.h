@@ -10,6 +10,7 @@
 #include "Sim/Misc/GlobalConstants.h"
 
 #include <algorithm>
+#include <vector>
 
 class CUnit;
 
@@ -53,7 +54,8 @@ public:
 
 	virtual bool Update() = 0;
 	virtual void SlowUpdate();
-	void UpdateCollisionMap();
+	void UpdateCollisionMap(std::vector<int>* preparedQuads = nullptr);
+	bool WantsCollisionMapUpdate() const;
 	void UpdateGroundBlockMap();
 
 	virtual bool IsSkidding() const { return false; }
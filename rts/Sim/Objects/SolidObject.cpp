@@ -96,17 +96,16 @@ void CSolidObject::PostLoad()
 void CSolidObject::UpdatePhysicalState(float eps)
 {
 	RECOIL_DETAILED_TRACY_ZONE;
+	SetTerrainPhysicalState(CalcTerrainPhysicalState(eps));
+}
+
+unsigned int CSolidObject::CalcTerrainPhysicalState(float eps) const
+{
+	// NOTE: must stay free of side-effects, called from worker threads
 	const float gh = CGround::GetHeightReal(pos.x, pos.z);
 	const float wh = std::max(gh, 0.0f);
 
-	unsigned int ps = physicalState;
-
-	// clear all non-void non-special bits
-	ps &= (~PSTATE_BIT_ONGROUND   );
-	ps &= (~PSTATE_BIT_INWATER    );
-	ps &= (~PSTATE_BIT_UNDERWATER );
-	ps &= (~PSTATE_BIT_UNDERGROUND);
-	ps &= (~PSTATE_BIT_INAIR      );
+	unsigned int ps = 0;
 
 	// NOTE:
 	//   height is not in general equivalent to radius * 2.0
@@ -123,6 +122,17 @@ void CSolidObject::UpdatePhysicalState(float eps)
 	ps |= (PSTATE_BIT_INAIR       * ((    ps   & MASK_NOAIR) ==    0));
 	#undef MASK_NOAIR
 
+	return ps;
+}
+
+void CSolidObject::SetTerrainPhysicalState(unsigned int bits)
+{
+	unsigned int ps = physicalState;
+
+	// replace all non-void non-special bits
+	ps &= (~PSTATE_MASK_TERRAIN);
+	ps |= (bits & PSTATE_MASK_TERRAIN);
+
 	physicalState = static_cast<PhysicalState>(ps);
 
 	// verify mutex relations (A != B); if one
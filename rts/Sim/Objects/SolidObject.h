@@ -83,6 +83,9 @@ public:
 		PSTATE_BIT_SKIDDING = (1 <<  9),
 		PSTATE_BIT_CRASHING = (1 << 10),
 		PSTATE_BIT_BLOCKING = (1 << 11),
+
+		// bits (re)computed from terrain by UpdatePhysicalState
+		PSTATE_MASK_TERRAIN = PSTATE_BIT_ONGROUND | PSTATE_BIT_INWATER | PSTATE_BIT_UNDERWATER | PSTATE_BIT_UNDERGROUND | PSTATE_BIT_INAIR,
 	};
 	enum CollidableState {
 		CSTATE_BIT_SOLIDOBJECTS = (1 << 0), // can be set while (physicalState & PSTATE_BIT_BLOCKING) == 0!
@@ -119,6 +122,10 @@ public:
 
 	virtual void UpdatePhysicalState(float eps);
 
+	/// pure function of pos, midPos, radius and the synced heightmap; safe to call from worker threads
+	unsigned int CalcTerrainPhysicalState(float eps) const;
+	void SetTerrainPhysicalState(unsigned int bits);
+
 	void Move(const float3& v, bool relative) {
 		const float3& dv = relative? v: (v - pos);
 
@@ -4,7 +4,6 @@
 
 #include "PathCache.h"
 #include "Sim/Misc/GlobalConstants.h"
-#include "Sim/Misc/GlobalSynced.h"
 #include "System/Log/ILog.h"
 
 #include "System/Misc/TracyDefs.h"
@@ -12,9 +11,19 @@
 #define MAX_CACHE_QUEUE_SIZE   200
 #define MAX_PATH_LIFETIME_SECS   6
 #define USE_NONCOLLIDABLE_HASH   1
+// logs every request s.t. the stream can be replayed by test/other/benchmarkPathCache
+#define RECORD_CACHE_REQUESTS    0
 
 namespace HAPFS {
 
+static constexpr std::uint32_t TABLE_HASH_BITS = 9;
+static constexpr std::uint32_t INITIAL_ARENA_ITEMS_PER_ENTRY = 32;
+
+static inline std::uint32_t GetHomeSlot(std::uint64_t hash) {
+	// fibonacci hashing, the raw keys are linear indices and would cluster
+	return ((hash * 0x9E3779B97F4A7C15ull) >> (64 - TABLE_HASH_BITS));
+}
+
 CPathCache::CPathCache(int blocksX, int blocksZ)
 	: numBlocksX(blocksX)
 	, numBlocksZ(blocksZ)
@@ -25,23 +34,32 @@ CPathCache::CPathCache(int blocksX, int blocksZ)
 	, numCacheMisses(0)
 	, numHashCollisions(0)
 {
+	static_assert((1u << TABLE_HASH_BITS) == TABLE_CAPACITY, "");
+	static_assert(QUEUE_CAPACITY > (MAX_CACHE_QUEUE_SIZE + 1), "");
+	static_assert((QUEUE_CAPACITY & (QUEUE_CAPACITY - 1)) == 0, "");
+
 	LOG("Path cache (%d, %d) initialized.", numBlocksX, numBlocksZ);
-	// {result, path, strtBlock, goalBlock, goalRadius, pathType}
-	dummyCacheItem = {IPath::Error, {}, {-1, -1}, {-1, -1}, -1.0f, -1};
 
-	cachedPaths.reserve(4096);
+	cacheTable.fill({0, EMPTY_SLOT, 0});
+
+	pointsArena.resize(QUEUE_CAPACITY * INITIAL_ARENA_ITEMS_PER_ENTRY);
+	squaresArena.resize(QUEUE_CAPACITY * INITIAL_ARENA_ITEMS_PER_ENTRY);
+
+	#if (RECORD_CACHE_REQUESTS == 1)
+	LOG("[CPathCache][%p] C %u %u", static_cast<const void*>(this), numBlocksX, numBlocksZ);
+	#endif
 }
 
 CPathCache::~CPathCache()
 {
 	const char* fmt =
 #ifdef _WIN32
-		"[%s(%ux%u)] cacheHits=%u hitPercentage=%.0f%% numHashColls=%u maxCacheSize=%I64u";
+		"[%s(%ux%u)] cacheHits=%u hitPercentage=%.0f%% numHashColls=%u maxCacheSize=%I64u arenaSize=%u";
 #else
-		"[%s(%ux%u)] cacheHits=%u hitPercentage=%.0f%% numHashColls=%u maxCacheSize=%lu";
+		"[%s(%ux%u)] cacheHits=%u hitPercentage=%.0f%% numHashColls=%u maxCacheSize=%lu arenaSize=%u";
 #endif
 
-	LOG(fmt, __FUNCTION__, numBlocksX, numBlocksZ, numCacheHits, GetCacheHitPercentage(), numHashCollisions, maxCacheSize);
+	LOG(fmt, __FUNCTION__, numBlocksX, numBlocksZ, numCacheHits, GetCacheHitPercentage(), numHashCollisions, maxCacheSize, unsigned(pointsArena.size()));
 }
 
 bool CPathCache::AddPath(
@@ -50,90 +68,237 @@ bool CPathCache::AddPath(
 	const int2 strtBlock,
 	const int2 goalBlock,
 	float goalRadius,
-	int pathType
+	int pathType,
+	int frameNum
 ) {
 	RECOIL_DETAILED_TRACY_ZONE;
-	if (cacheQue.size() > MAX_CACHE_QUEUE_SIZE)
+	lastFrameNum = frameNum;
+
+	#if (RECORD_CACHE_REQUESTS == 1)
+	LOG("[CPathCache][%p] A %d %d %d %d %d %f %d %d %u %u", static_cast<const void*>(this), frameNum, strtBlock.x, strtBlock.y, goalBlock.x, goalBlock.y, goalRadius, pathType, int(result), unsigned(path->path.size()), unsigned(path->squares.size()));
+	#endif
+
+	if (queSize > MAX_CACHE_QUEUE_SIZE)
 		RemoveFrontQueItem();
 
 	const std::uint64_t hash = GetHash(strtBlock, goalBlock, goalRadius, pathType);
 	const std::uint32_t cols = numHashCollisions;
-	const auto iter = cachedPaths.find(hash);
-
-	// LOG("%llu Cache L1 added entry (%d): (%d, %d) -> (%d, %d) ~ %f for [%d] (%llu) : %llu (available? %d)"
-	// 		, numBlocks
-	// 		, result
-	// 		, strtBlock.x, strtBlock.y
-	// 		, goalBlock.x, goalBlock.y
-	// 		, goalRadius, pathType
-	// 		, currentFrameCachedPaths.size()
-	// 		, hash
-	// 		, (iter == currentFrameCachedPaths.end()));
+	const std::uint32_t slotIdx = FindSlot(hash);
 
 	// register any hash collisions
-	if (iter != cachedPaths.end())
-		return ((numHashCollisions += HashCollision(iter->second, strtBlock, goalBlock, goalRadius, pathType)) != cols);
+	if (slotIdx != EMPTY_SLOT)
+		return ((numHashCollisions += HashCollision(cacheQue[cacheTable[slotIdx].entryIdx], strtBlock, goalBlock, goalRadius, pathType)) != cols);
 
-	cachedPaths[hash] = CacheItem{result, *path, strtBlock, goalBlock, goalRadius, pathType};
+	assert(queSize < QUEUE_CAPACITY);
 
+	const std::uint32_t entryIdx = (queHead + queSize) & (QUEUE_CAPACITY - 1);
 	const int lifeTime = (result == IPath::Ok) ? GAME_SPEED * MAX_PATH_LIFETIME_SECS : GAME_SPEED * (MAX_PATH_LIFETIME_SECS / 2);
 
-	cacheQue.push_back({gs->frameNum + lifeTime, hash});
-	maxCacheSize = std::max<std::uint64_t>(maxCacheSize, cacheQue.size());
+	CacheEntry& ce = cacheQue[entryIdx];
+
+	ce.hash = hash;
+	ce.timeout = frameNum + lifeTime;
+	ce.result = result;
+	ce.strtBlock = strtBlock;
+	ce.goalBlock = goalBlock;
+	ce.goalRadius = goalRadius;
+	ce.pathType = pathType;
+
+	// must precede the queue insertion, compaction only moves live entries
+	StorePath(ce, path);
+	InsertSlot(hash, entryIdx);
+
+	queSize += 1;
+	maxCacheSize = std::max<std::uint64_t>(maxCacheSize, queSize);
 
 	return false;
 }
 
-const CPathCache::CacheItem& CPathCache::GetCachedPath(
+bool CPathCache::GetCachedPath(
 	const int2 strtBlock,
 	const int2 goalBlock,
 	float goalRadius,
-	int pathType
+	int pathType,
+	CacheItem& ci
 ) {
 	RECOIL_DETAILED_TRACY_ZONE;
 	const std::uint64_t hash = GetHash(strtBlock, goalBlock, goalRadius, pathType);
+	const std::uint32_t slotIdx = FindSlot(hash);
+
+	#if (RECORD_CACHE_REQUESTS == 1)
+	LOG("[CPathCache][%p] G %d %d %d %d %d %f %d", static_cast<const void*>(this), lastFrameNum, strtBlock.x, strtBlock.y, goalBlock.x, goalBlock.y, goalRadius, pathType);
+	#endif
+
+	if (slotIdx != EMPTY_SLOT) {
+		const CacheEntry& ce = cacheQue[cacheTable[slotIdx].entryIdx];
+
+		if (ce.strtBlock == strtBlock && ce.goalBlock == goalBlock && ce.pathType == pathType) {
+			const float3* points = pointsArena.data() + ce.pointsOffset;
+			const int2* squares = squaresArena.data() + ce.squaresOffset;
+
+			ci.result = ce.result;
+			ci.path.path.assign(points, points + ce.numPoints);
+			ci.path.squares.assign(squares, squares + ce.numSquares);
+			ci.path.desiredGoal = ce.desiredGoal;
+			ci.path.pathGoal = ce.pathGoal;
+			ci.path.goalRadius = ce.pathGoalRadius;
+			ci.path.pathCost = ce.pathCost;
+			ci.strtBlock = ce.strtBlock;
+			ci.goalBlock = ce.goalBlock;
+			ci.goalRadius = ce.goalRadius;
+			ci.pathType = ce.pathType;
 
-	// LOG("%llu Cache lookup: (%d, %d) -> (%d, %d) ~ %f for [%d] (%llu) : %llu"
-	// 		, numBlocks
-	// 		, strtBlock.x, strtBlock.y
-	// 		, goalBlock.x, goalBlock.y
-	// 		, goalRadius, pathType
-	// 		, currentFrameCachedPaths.size()
-	// 		, hash
-	// 		);
-
-	{
-		auto iter = cachedPaths.find(hash);
-		if (iter != cachedPaths.end()
-				&& (iter->second).strtBlock == strtBlock
-				&& (iter->second).goalBlock == goalBlock
-				&& (iter->second).pathType == pathType
-			) {
-			// LOG("Cache Hit %d", iter->second.path.path.size());
 			++numCacheHits;
-			return (iter->second);
+			return true;
 		}
 	}
 
+	// {result, path, strtBlock, goalBlock, goalRadius, pathType}
+	ci.result = IPath::Error;
+	ci.path.path.clear();
+	ci.path.squares.clear();
+	ci.path.desiredGoal = ZeroVector;
+	ci.path.pathGoal = ZeroVector;
+	ci.path.goalRadius = -1.0f;
+	ci.path.pathCost = -1.0f;
+	ci.strtBlock = {-1, -1};
+	ci.goalBlock = {-1, -1};
+	ci.goalRadius = -1.0f;
+	ci.pathType = -1;
+
 	++numCacheMisses;
-	return dummyCacheItem;
+	return false;
 }
 
-void CPathCache::Update()
+void CPathCache::Update(int frameNum)
 {
 	RECOIL_DETAILED_TRACY_ZONE;
-	while (!cacheQue.empty() && (cacheQue.front().timeout) < gs->frameNum)
+	lastFrameNum = frameNum;
+
+	#if (RECORD_CACHE_REQUESTS == 1)
+	LOG("[CPathCache][%p] U %d", static_cast<const void*>(this), frameNum);
+	#endif
+
+	while (queSize > 0 && (cacheQue[queHead].timeout) < frameNum)
 		RemoveFrontQueItem();
 }
 
 void CPathCache::RemoveFrontQueItem()
 {
 	RECOIL_DETAILED_TRACY_ZONE;
-	const auto it = cachedPaths.find((cacheQue.front()).hash);
+	const std::uint32_t slotIdx = FindSlot(cacheQue[queHead].hash);
+
+	assert(slotIdx != EMPTY_SLOT);
+	EraseSlot(slotIdx);
+
+	queHead = (queHead + 1) & (QUEUE_CAPACITY - 1);
+	queSize -= 1;
+
+	if (queSize != 0)
+		return;
+
+	// nothing is live anymore, restart the arenas from the front
+	pointsArenaSize = 0;
+	squaresArenaSize = 0;
+}
+
+std::uint32_t CPathCache::FindSlot(std::uint64_t hash) const
+{
+	for (std::uint32_t slotIdx = GetHomeSlot(hash); cacheTable[slotIdx].entryIdx != EMPTY_SLOT; slotIdx = (slotIdx + 1) & (TABLE_CAPACITY - 1)) {
+		if (cacheTable[slotIdx].hash == hash)
+			return slotIdx;
+	}
+
+	return EMPTY_SLOT;
+}
+
+void CPathCache::InsertSlot(std::uint64_t hash, std::uint32_t entryIdx)
+{
+	std::uint32_t slotIdx = GetHomeSlot(hash);
+
+	// never full, the table has twice as many slots as there can be entries
+	while (cacheTable[slotIdx].entryIdx != EMPTY_SLOT) {
+		slotIdx = (slotIdx + 1) & (TABLE_CAPACITY - 1);
+	}
+
+	cacheTable[slotIdx].hash = hash;
+	cacheTable[slotIdx].entryIdx = entryIdx;
+}
+
+void CPathCache::EraseSlot(std::uint32_t slotIdx)
+{
+	// backward-shift deletion, keeps every probe sequence intact without tombstones
+	for (std::uint32_t nextIdx = (slotIdx + 1) & (TABLE_CAPACITY - 1); cacheTable[nextIdx].entryIdx != EMPTY_SLOT; nextIdx = (nextIdx + 1) & (TABLE_CAPACITY - 1)) {
+		const std::uint32_t homeIdx = GetHomeSlot(cacheTable[nextIdx].hash);
+
+		// the entry can stay if its home lies cyclically within (slotIdx, nextIdx]
+		if ((slotIdx <= nextIdx)? (slotIdx < homeIdx && homeIdx <= nextIdx): (slotIdx < homeIdx || homeIdx <= nextIdx))
+			continue;
+
+		cacheTable[slotIdx] = cacheTable[nextIdx];
+		slotIdx = nextIdx;
+	}
+
+	cacheTable[slotIdx].entryIdx = EMPTY_SLOT;
+}
+
+void CPathCache::StorePath(CacheEntry& ce, const IPath::Path* path)
+{
+	const std::uint32_t numPoints = path->path.size();
+	const std::uint32_t numSquares = path->squares.size();
+
+	if ((pointsArenaSize + numPoints) > pointsArena.size() || (squaresArenaSize + numSquares) > squaresArena.size()) {
+		CompactArena();
+
+		// keep at least half of each arena free after compaction s.t. its cost stays amortized;
+		// only grows when the live paths are longer than anticipated, the size is kept afterwards
+		if (((pointsArenaSize + numPoints) * 2) > pointsArena.size())
+			pointsArena.resize((pointsArenaSize + numPoints) * 2);
+		if (((squaresArenaSize + numSquares) * 2) > squaresArena.size())
+			squaresArena.resize((squaresArenaSize + numSquares) * 2);
+	}
+
+	std::copy(path->path.begin(), path->path.end(), pointsArena.begin() + pointsArenaSize);
+	std::copy(path->squares.begin(), path->squares.end(), squaresArena.begin() + squaresArenaSize);
+
+	ce.pointsOffset = pointsArenaSize;
+	ce.numPoints = numPoints;
+	ce.squaresOffset = squaresArenaSize;
+	ce.numSquares = numSquares;
+
+	ce.desiredGoal = path->desiredGoal;
+	ce.pathGoal = path->pathGoal;
+	ce.pathGoalRadius = path->goalRadius;
+	ce.pathCost = path->pathCost;
+
+	pointsArenaSize += numPoints;
+	squaresArenaSize += numSquares;
+}
+
+void CPathCache::CompactArena()
+{
+	RECOIL_DETAILED_TRACY_ZONE;
+	std::uint32_t numPoints = 0;
+	std::uint32_t numSquares = 0;
+
+	// live ranges are in queue order, so every copy moves data towards the front
+	for (std::uint32_t i = 0; i < queSize; i++) {
+		CacheEntry& ce = cacheQue[(queHead + i) & (QUEUE_CAPACITY - 1)];
+
+		if (ce.pointsOffset != numPoints)
+			std::copy(pointsArena.begin() + ce.pointsOffset, pointsArena.begin() + ce.pointsOffset + ce.numPoints, pointsArena.begin() + numPoints);
+		if (ce.squaresOffset != numSquares)
+			std::copy(squaresArena.begin() + ce.squaresOffset, squaresArena.begin() + ce.squaresOffset + ce.numSquares, squaresArena.begin() + numSquares);
+
+		ce.pointsOffset = numPoints;
+		ce.squaresOffset = numSquares;
+
+		numPoints += ce.numPoints;
+		numSquares += ce.numSquares;
+	}
 
-	assert(it != cachedPaths.end());
-	cachedPaths.erase(it);
-	cacheQue.pop_front();
+	pointsArenaSize = numPoints;
+	squaresArenaSize = numSquares;
 }
 
 std::uint64_t CPathCache::GetHash(
@@ -175,7 +340,7 @@ std::uint64_t CPathCache::GetHash(
 }
 
 bool CPathCache::HashCollision(
-	const CacheItem& ci,
+	const CacheEntry& ce,
 	const int2 strtBlk,
 	const int2 goalBlk,
 	float goalRadius,
@@ -184,8 +349,8 @@ bool CPathCache::HashCollision(
 	RECOIL_DETAILED_TRACY_ZONE;
 	bool hashColl = false;
 
-	hashColl |= (ci.strtBlock != strtBlk || ci.goalBlock != goalBlk);
-	hashColl |= (ci.pathType != pathType || ci.goalRadius != goalRadius);
+	hashColl |= (ce.strtBlock != strtBlk || ce.goalBlock != goalBlk);
+	hashColl |= (ce.pathType != pathType || ce.goalRadius != goalRadius);
 
 	const char* fmt =
 #ifdef _WIN32
@@ -196,11 +361,11 @@ bool CPathCache::HashCollision(
 
 	if (hashColl) {
 		LOG_L(L_DEBUG, fmt,
-			__FUNCTION__, gs->frameNum,
+			__FUNCTION__, lastFrameNum,
 			GetHash(strtBlk, goalBlk, goalRadius, pathType),
-			ci.strtBlock.x, ci.strtBlock.y,
-			ci.goalBlock.x, ci.goalBlock.y,
-			ci.goalRadius, ci.pathType,
+			ce.strtBlock.x, ce.strtBlock.y,
+			ce.goalBlock.x, ce.goalBlock.y,
+			ce.goalRadius, ce.pathType,
 			strtBlk.x, strtBlk.y,
 			goalBlk.x, goalBlk.y,
 			goalRadius, pathType
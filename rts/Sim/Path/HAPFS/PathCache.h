@@ -3,12 +3,12 @@
 #ifndef HAPFS_PATHCACHE_H
 #define HAPFS_PATHCACHE_H
 
-#include <deque>
-#include <unordered_map>
+#include <array>
+#include <cinttypes>
+#include <vector>
 
 #include "IPath.h"
 #include "System/type2.h"
-#include "System/UnorderedMap.hpp"
 
 namespace HAPFS {
 
@@ -27,26 +27,44 @@ public:
 		int pathType;
 	};
 
-	void Update();
+	void Update(int frameNum);
 	bool AddPath(
 		const IPath::Path* path,
 		const IPath::SearchResult result,
 		const int2 strtBlock,
 		const int2 goalBlock,
 		float goalRadius,
-		int pathType
+		int pathType,
+		int frameNum
 	);
 
-	const CacheItem& GetCachedPath(
+	// copies a cached path into <ci> (reusing its buffers), on a miss
+	// <ci> is reset to the dummy item with pathType -1
+	bool GetCachedPath(
 		const int2 strtBlock,
 		const int2 goalBlock,
 		float goalRadius,
-		int pathType
+		int pathType,
+		CacheItem& ci
 	);
 
+	std::uint32_t GetNumCacheHits() const { return numCacheHits; }
+	std::uint32_t GetNumCacheMisses() const { return numCacheMisses; }
+	std::uint32_t GetNumHashCollisions() const { return numHashCollisions; }
+	std::uint32_t GetSize() const { return queSize; }
+
 private:
+	struct CacheEntry;
+
 	void RemoveFrontQueItem();
 
+	std::uint32_t FindSlot(std::uint64_t hash) const;
+	void InsertSlot(std::uint64_t hash, std::uint32_t entryIdx);
+	void EraseSlot(std::uint32_t slotIdx);
+
+	void StorePath(CacheEntry& entry, const IPath::Path* path);
+	void CompactArena();
+
 	std::uint64_t GetHash(
 		const int2 strtBlk,
 		const int2 goalBlk,
@@ -55,7 +73,7 @@ private:
 	) const;
 
 	bool HashCollision(
-		const CacheItem& ci,
+		const CacheEntry& ce,
 		const int2 strtBlk,
 		const int2 goalBlk,
 		float goalRadius,
@@ -70,16 +88,55 @@ private:
 	}
 
 private:
-	struct CacheQueItem {
-		std::int32_t timeout;
+	// must exceed the largest number of live entries (MAX_CACHE_QUEUE_SIZE + 1)
+	static constexpr std::uint32_t QUEUE_CAPACITY = 256;
+	// power of two, kept at most half full s.t. linear probe sequences stay short
+	static constexpr std::uint32_t TABLE_CAPACITY = QUEUE_CAPACITY * 2;
+	static constexpr std::uint32_t EMPTY_SLOT = -1u;
+
+	struct TableSlot {
 		std::uint64_t hash;
+		std::uint32_t entryIdx;
+		std::uint32_t pad;
 	};
 
-	// returned on any cache-miss
-	CacheItem dummyCacheItem;
+	struct CacheEntry {
+		std::uint64_t hash;
+		std::int32_t timeout;
 
-	std::deque<CacheQueItem> cacheQue;
-	spring::unordered_map<std::uint64_t, CacheItem> cachedPaths; // ints are sync-safe keys
+		IPath::SearchResult result;
+		int2 strtBlock;
+		int2 goalBlock;
+		float goalRadius;
+		int pathType;
+
+		// IPath::Path members, points and squares live in the arenas
+		float3 desiredGoal;
+		float3 pathGoal;
+		float pathGoalRadius;
+		float pathCost;
+
+		std::uint32_t pointsOffset;
+		std::uint32_t numPoints;
+		std::uint32_t squaresOffset;
+		std::uint32_t numSquares;
+	};
+
+	// open-addressing (linear probing) hash -> entry index, ints are sync-safe keys
+	alignas(64) std::array<TableSlot, TABLE_CAPACITY> cacheTable;
+	// ring buffer of entries in insertion order, which is also the expiry order
+	std::array<CacheEntry, QUEUE_CAPACITY> cacheQue;
+
+	// shared storage for the paths of all entries; since entries are released
+	// in queue order the live ranges stay sorted and are compacted on overflow
+	std::vector<float3> pointsArena;
+	std::vector<int2> squaresArena;
+
+	std::uint32_t pointsArenaSize = 0;
+	std::uint32_t squaresArenaSize = 0;
+
+	std::uint32_t queHead = 0;
+	std::uint32_t queSize = 0;
 
 	std::uint32_t numBlocksX;
 	std::uint32_t numBlocksZ;
@@ -89,6 +146,8 @@ private:
 	std::uint32_t numCacheHits;
 	std::uint32_t numCacheMisses;
 	std::uint32_t numHashCollisions;
+
+	int lastFrameNum = 0;
 };
 
 }
@@ -33,6 +33,8 @@ static constexpr unsigned int MEDRES_PE_BLOCKSIZE = 16;
 static constexpr unsigned int LOWRES_PE_BLOCKSIZE = 32;
 
 static constexpr unsigned int SQUARES_TO_UPDATE = 8000;
+// the per-frame block budget grows by 1x per second of continuous backlog, up to this factor
+static constexpr unsigned int MAX_BLOCK_UPDATE_BUDGET_SCALE = 4;
 static constexpr unsigned int MAX_SEARCHED_NODES_ON_REFINE = 2000;
 
 static constexpr unsigned int PATH_HEATMAP_XSCALE =  1; // wrt. mapDims.hmapx
@@ -72,7 +72,8 @@ void CPathEstimator::InitEstimator()
 const CPathCache::CacheItem& CPathEstimator::GetCache(const int2 strtBlock, const int2 goalBlock, float goalRadius, int pathType, const bool synced) const
 {
 	RECOIL_DETAILED_TRACY_ZONE;
-	tempCacheItem = pathingState->GetCache(strtBlock, goalBlock, goalRadius, pathType, synced);
+	// filled in place, the item keeps its buffers across lookups
+	pathingState->GetCache(strtBlock, goalBlock, goalRadius, pathType, synced, tempCacheItem);
 	return tempCacheItem;
 }
 
@@ -9,6 +9,7 @@
 #include "Game/LoadScreen.h"
 #include "Net/Protocol/NetProtocol.h"
 
+#include "Sim/Misc/GlobalSynced.h"
 #include "Sim/Misc/ModInfo.h"
 #include "Sim/MoveTypes/MoveDefHandler.h"
 #include "Sim/MoveTypes/MoveMath/MoveMath.h"
@@ -16,6 +17,7 @@
 #include "IPath.h"
 #include "PathConstants.h"
 #include "PathFinderDef.h"
+#include "PathHeatMap.h"
 #include "PathLog.h"
 #include "Sim/Path/HAPFS/PathGlobal.h"
 #include "PathMemPool.h"
@@ -100,6 +102,7 @@ void PathingState::Init(std::vector<IPathFinder*> pathFinderlist, PathingState*
 		BLOCKS_TO_UPDATE = (SQUARES_TO_UPDATE) / (BLOCK_SIZE * BLOCK_SIZE) + 1;
 
 		blockUpdatePenalty = 0;
+		backlogFrames = 0;
 		nextOffsetMessageIdx = 0;
 		nextCostMessageIdx = 0;
 
@@ -115,6 +118,9 @@ void PathingState::Init(std::vector<IPathFinder*> pathFinderlist, PathingState*
 		maxSpeedMods.resize(moveDefHandler.GetNumMoveDefs(), 0.001f);
 
 		updatedBlocks.clear();
+		updatedBlockHeats.clear();
+		updatedBlockHeats.resize(blockStates.GetSize(), 0);
+		updatedBlocksHeat = 0;
 		consumedBlocks.clear();
 		offsetBlocksSortedByCost.clear();
 	}
@@ -182,7 +188,7 @@ void PathingState::Terminate()
 	while (!updatedBlocks.empty()) {
 		const int2& pos = updatedBlocks.front();
 		const int idx = BlockPosToIdx(pos);
-		updatedBlocks.pop_front();
+		PopUpdatedBlock();
 		blockStates.nodeMask[idx] &= ~PATHOPT_OBSOLETE;
 		blockStates.nodeLinksObsoleteFlags[idx] = 0;
 	}
@@ -610,13 +616,13 @@ bool PathingState::WriteFile(const std::string& peFileName, const std::string& m
 
 
 /**
- * Update some obsolete blocks using the FIFO-principle
+ * Update some obsolete blocks, those on the routes of active paths first
  */
 void PathingState::Update()
 {
 	RECOIL_DETAILED_TRACY_ZONE;
-	pathCache[0]->Update();
-	pathCache[1]->Update();
+	pathCache[0]->Update(gs->frameNum);
+	pathCache[1]->Update(gs->frameNum);
 
 	//LOG("PathingState::Update %d", BLOCK_SIZE);
 
@@ -625,15 +631,22 @@ void PathingState::Update()
 	if (numMoveDefs == 0)
 		return;
 
-	if (updatedBlocks.empty())
+	if (updatedBlocks.empty()) {
+		backlogFrames = 0;
 		return;
+	}
 
 	// determine how many blocks we should update
 	int blocksToUpdate = 0;
 	{
+		// NOTE:
+		//   the costs are synced, so the budget can only depend on synced state; instead
+		//   of the (local) idle time of the workers it grows with the age of the backlog
+		const int budgetScale = std::min<int>(1 + backlogFrames / GAME_SPEED, MAX_BLOCK_UPDATE_BUDGET_SCALE);
+
 		const int progressiveUpdates = std::ceil(updatedBlocks.size() * (1.f / (BLOCKS_TO_UPDATE<<2)) * modInfo.pfUpdateRateScale);
 		const int MIN_BLOCKS_TO_UPDATE = 1;
-		const int MAX_BLOCKS_TO_UPDATE = std::max<int>(BLOCKS_TO_UPDATE >> 1, MIN_BLOCKS_TO_UPDATE);
+		const int MAX_BLOCKS_TO_UPDATE = std::max<int>(BLOCKS_TO_UPDATE >> 1, MIN_BLOCKS_TO_UPDATE) * budgetScale;
 
 		blocksToUpdate = std::clamp(progressiveUpdates, MIN_BLOCKS_TO_UPDATE, MAX_BLOCKS_TO_UPDATE) * numMoveDefs;
 	
@@ -650,6 +663,89 @@ void PathingState::Update()
 	//LOG("PathingState::Update updatedBlocksDelayActive %d", (int)updatedBlocksDelayActive);
 
 	UpdateVertexPathCosts(blocksToUpdate);
+
+	backlogFrames = (backlogFrames + 1) * (!updatedBlocks.empty());
+}
+
+std::uint32_t PathingState::GetBlockHeat(const int2 blockPos) const
+{
+	const unsigned int x1 = blockPos.x * BLOCK_SIZE;
+	const unsigned int z1 = blockPos.y * BLOCK_SIZE;
+	const unsigned int x2 = std::min(x1 + BLOCK_SIZE, unsigned(mapDims.mapx));
+	const unsigned int z2 = std::min(z1 + BLOCK_SIZE, unsigned(mapDims.mapy));
+
+	std::uint32_t heat = 0;
+
+	for (unsigned int z = z1; z < z2; z += (1 << PATH_HEATMAP_ZSCALE)) {
+		for (unsigned int x = x1; x < x2; x += (1 << PATH_HEATMAP_XSCALE)) {
+			heat += gPathHeatMap.GetHeatValue(x, z);
+		}
+	}
+
+	return heat;
+}
+
+void PathingState::PushUpdatedBlock(const int2 blockPos)
+{
+	// the heat is sampled once here instead of for every queued block on every
+	// update; blocks become obsolete where units are moving, so the heat at the
+	// time of the change is what matters for the paths that will cross them
+	const std::uint32_t heat = GetBlockHeat(blockPos);
+
+	updatedBlocks.push_back(blockPos);
+	updatedBlockHeats[BlockPosToIdx(blockPos)] = heat;
+	updatedBlocksHeat += heat;
+}
+
+void PathingState::PopUpdatedBlock()
+{
+	updatedBlocksHeat -= std::exchange(updatedBlockHeats[BlockPosToIdx(updatedBlocks.front())], 0);
+	updatedBlocks.pop_front();
+}
+
+void PathingState::PrioritizeUpdatedBlocks(size_t numBlocks)
+{
+	RECOIL_DETAILED_TRACY_ZONE;
+	// drop blocks that are no longer obsolete, they would be skipped anyway
+	updatedBlocks.erase(std::remove_if(updatedBlocks.begin(), updatedBlocks.end(), [this](const int2& pos) {
+		const int idx = BlockPosToIdx(pos);
+
+		if ((blockStates.nodeMask[idx] & PATHOPT_OBSOLETE) != 0)
+			return false;
+
+		updatedBlocksHeat -= std::exchange(updatedBlockHeats[idx], 0);
+		return true;
+	}), updatedBlocks.end());
+
+	// no heat anywhere means nothing to prefer, keep the FIFO order
+	if (updatedBlocks.size() <= numBlocks || updatedBlocksHeat == 0)
+		return;
+
+	// heat is synced, ties are resolved by queue order s.t. this stays deterministic
+	prioritizedBlocks.clear();
+	prioritizedBlocks.reserve(updatedBlocks.size());
+
+	for (size_t i = 0, n = updatedBlocks.size(); i < n; i++) {
+		prioritizedBlocks.push_back({updatedBlockHeats[BlockPosToIdx(updatedBlocks[i])], std::uint32_t(i)});
+	}
+
+	const auto cmp = [](const PrioritizedBlock& a, const PrioritizedBlock& b) {
+		return ((a.heat > b.heat) || (a.heat == b.heat && a.queueIdx < b.queueIdx));
+	};
+
+	std::nth_element(prioritizedBlocks.begin(), prioritizedBlocks.begin() + numBlocks, prioritizedBlocks.end(), cmp);
+
+	// move the chosen blocks to the front, both parts keep their relative queue order
+	std::sort(prioritizedBlocks.begin(), prioritizedBlocks.begin() + numBlocks, [](const PrioritizedBlock& a, const PrioritizedBlock& b) { return (a.queueIdx < b.queueIdx); });
+	std::sort(prioritizedBlocks.begin() + numBlocks, prioritizedBlocks.end(), [](const PrioritizedBlock& a, const PrioritizedBlock& b) { return (a.queueIdx < b.queueIdx); });
+
+	std::deque<int2> reorderedBlocks;
+
+	for (const PrioritizedBlock& b: prioritizedBlocks) {
+		reorderedBlocks.push_back(updatedBlocks[b.queueIdx]);
+	}
+
+	updatedBlocks.swap(reorderedBlocks);
 }
 
 void PathingState::UpdateVertexPathCosts(int blocksToUpdate)
@@ -670,6 +766,8 @@ void PathingState::UpdateVertexPathCosts(int blocksToUpdate)
 
 	//LOG("PathingState::Update %d", updatedBlocks.size());
 
+	PrioritizeUpdatedBlocks(consumeBlocks / numMoveDefs);
+
 	std::vector<int> blockIds;
 	blockIds.reserve(updatedBlocks.size());
 
@@ -679,7 +777,7 @@ void PathingState::UpdateVertexPathCosts(int blocksToUpdate)
 		const int idx = BlockPosToIdx(pos);
 
 		if ((blockStates.nodeMask[idx] & PATHOPT_OBSOLETE) == 0) {
-			updatedBlocks.pop_front();
+			PopUpdatedBlock();
 			continue;
 		}
 
@@ -694,7 +792,7 @@ void PathingState::UpdateVertexPathCosts(int blocksToUpdate)
 			//LOG("TK PathingState::Update: moveDef = %d %p (%p)", consumedBlocks.size(), &consumedBlocks.back(), consumedBlocks.back().moveDef);
 		}
 
-		updatedBlocks.pop_front(); // must happen _after_ last usage of the `pos` reference!
+		PopUpdatedBlock(); // must happen _after_ last usage of the `pos` reference!
 		blockStates.nodeMask[idx] &= ~PATHOPT_OBSOLETE;
 		blockIds.emplace_back(idx);
 	}
@@ -812,7 +910,7 @@ void PathingState::MapChanged(unsigned int x1, unsigned int z1, unsigned int x2,
 			if (blockOrigLinkFlags != 0)
 				continue;
 
-			updatedBlocks.emplace_back(x, z);
+			PushUpdatedBlock(int2(x, z));
 			blockStates.nodeMask[idx] |= PATHOPT_OBSOLETE;
 		}
 	}
@@ -898,7 +996,7 @@ void PathingState::AddCache(const IPath::Path* path, const IPath::SearchResult r
 {
 	RECOIL_DETAILED_TRACY_ZONE;
 	const std::lock_guard<std::mutex> lock(cacheAccessLock);
-	pathCache[synced]->AddPath(path, result, strtBlock, goalBlock, goalRadius, pathType);
+	pathCache[synced]->AddPath(path, result, strtBlock, goalBlock, goalRadius, pathType, gs->frameNum);
 }
 
 void PathingState::AddPathForCurrentFrame(const IPath::Path* path, const IPath::SearchResult result, const int2 strtBlock, const int2 goalBlock, float goalRadius, int pathType, const bool synced)
@@ -922,7 +1020,7 @@ void PathingState::PromotePathForCurrentFrame(
 	int2 strtBlock = {int(startPosition.x / BLOCK_PIXEL_SIZE), int(startPosition.z / BLOCK_PIXEL_SIZE)};;
 	int2 goalBlock = {int(goalPosition.x / BLOCK_PIXEL_SIZE), int(goalPosition.z / BLOCK_PIXEL_SIZE)};
 
-	pathCache[synced]->AddPath(path, result, strtBlock, goalBlock, goalRadius, pathType);
+	pathCache[synced]->AddPath(path, result, strtBlock, goalBlock, goalRadius, pathType, gs->frameNum);
 }
 
 std::uint32_t PathingState::CalcHash(const char* caller) const
@@ -79,15 +79,16 @@ public:
 
     // Re-entrant - return value cannot be a ref to avoid race conditions
 	//const
-	CPathCache::CacheItem GetCache(
+	bool GetCache(
 		const int2 strtBlock,
 		const int2 goalBlock,
 		float goalRadius,
 		int pathType,
-		const bool synced
+		const bool synced,
+		CPathCache::CacheItem& cacheItem
 	) const {
 		const std::lock_guard<std::mutex> lock(cacheAccessLock);
-		return pathCache[synced]->GetCachedPath(strtBlock, goalBlock, goalRadius, pathType);
+		return pathCache[synced]->GetCachedPath(strtBlock, goalBlock, goalRadius, pathType, cacheItem);
 	}
 
     // Re-entrant, but not MT sync-safe
@@ -143,6 +144,14 @@ private:
 
 	std::size_t getCountOfUpdates() const { return updatedBlocks.size(); }
 
+	// sum of the path heat over a block, i.e. how much active paths run through it
+	std::uint32_t GetBlockHeat(const int2 blockPos) const;
+	// reorders updatedBlocks s.t. the numBlocks hottest come first
+	void PrioritizeUpdatedBlocks(size_t numBlocks);
+
+	void PushUpdatedBlock(const int2 blockPos);
+	void PopUpdatedBlock();
+
 private:
 	friend class HAPFS::CPathEstimator;
 
@@ -156,6 +165,7 @@ private:
     mutable std::mutex cacheAccessLock;
 
     int blockUpdatePenalty = 0;
+	int backlogFrames = 0;
 	unsigned int instanceIndex = 0;
 
 	std::atomic<std::int64_t> offsetBlockNum = {0};
@@ -178,6 +188,9 @@ private:
     std::vector<float> maxSpeedMods;
     std::vector<float> vertexCosts;
     std::deque<int2> updatedBlocks;
+	// heat of each queued block when it was pushed, and the sum over the queue
+	std::vector<std::uint32_t> updatedBlockHeats;
+	std::uint64_t updatedBlocksHeat = 0;
 
     PathNodeStateBuffer blockStates;
 
@@ -187,7 +200,13 @@ private:
 		SingleBlock(const int2& pos, const MoveDef* md) : blockPos(pos), moveDef(md) {}
 	};
 
+	struct PrioritizedBlock {
+		std::uint32_t heat;
+		std::uint32_t queueIdx;
+	};
+
     std::vector<SingleBlock> consumedBlocks;
+	std::vector<PrioritizedBlock> prioritizedBlocks;
 	std::vector<SOffsetBlock> offsetBlocksSortedByCost;
 };
 
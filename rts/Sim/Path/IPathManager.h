@@ -178,6 +178,8 @@ public:
 	virtual const float* GetNodeExtraCosts(bool synced) const { return nullptr; }
 
 	virtual int2 GetNumQueuedUpdates() const { return (int2(0, 0)); }
+	/// @return {searches merged with others, searches completed} during the last update
+	virtual int2 GetNumMergedSearches() const { return (int2(0, 0)); }
 
 	virtual void SavePathCacheForPathId(int pathIdToSave) {};
 };
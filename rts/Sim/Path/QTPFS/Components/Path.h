@@ -30,6 +30,16 @@ struct PartialSharedPathChain {
     entt::entity next{entt::null};
 };
 
+struct GoalSharedPathChain {
+	GoalSharedPathChain() {}
+
+	GoalSharedPathChain(entt::entity initPrev, entt::entity initNext)
+		: prev(initPrev), next(initNext) {}
+
+    entt::entity prev{entt::null};
+    entt::entity next{entt::null};
+};
+
 VOID_COMPONENT(PathIsTemp);
 VOID_COMPONENT(PathIsDirty);
 VOID_COMPONENT(PathIsToBeUpdated);
@@ -0,0 +1,36 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef QTPFS_GOAL_SHARING_H_
+#define QTPFS_GOAL_SHARING_H_
+
+#include "System/float3.h"
+
+namespace QTPFS {
+	// Rules for searches that join the route of another search towards the same goal area
+	// (see PathManager::ExecuteSearch). Only searches starting within maxSrcDist of the chain
+	// head's source may join it, which bounds the detour: walking to the head's source first
+	// and following its route is at most srcDist longer than the head's path. Results longer
+	// than the head's path plus twice that distance are rejected in favour of a full search.
+	namespace GoalSharing {
+		inline bool CanShare(const float3& srcPos, const float3& headSrcPos, float maxSrcDist) {
+			return (maxSrcDist > 0.0f && srcPos.SqDistance2D(headSrcPos) <= (maxSrcDist * maxSrcDist));
+		}
+
+		inline bool IsShortEnough(float pathLength, float headPathLength, float srcDist) {
+			return (pathLength <= (headPathLength + srcDist * 2.0f));
+		}
+
+		template<typename PathType>
+		float GetPathLength(const PathType& path) {
+			float length = 0.0f;
+
+			for (unsigned int i = 1; i < path.NumPoints(); i++) {
+				length += path.GetPoint(i).distance2D(path.GetPoint(i - 1));
+			}
+
+			return length;
+		}
+	}
+}
+
+#endif
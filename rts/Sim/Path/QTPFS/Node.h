@@ -36,6 +36,19 @@ namespace QTPFS {
 			std::array<float2, QTPFS_MAX_NETPOINTS_PER_NODE_EDGE> netpoints;
 		};
 
+		// fixed-size image of a node as stored in the node-layer cache,
+		// its neighbours follow as a separate array of NeighbourPoints
+		struct CacheData {
+			unsigned int nodeNumber;
+			unsigned int index;
+			std::array<unsigned short, 4> points;
+			float moveCostAvg;
+			unsigned int childBaseIndex;
+			unsigned int numNeighbours;
+
+			unsigned int GetIndex() const { return index & NODE_INDEX_MASK; }
+		};
+
 		void SetNodeNumber(unsigned int n) { nodeNumber = n; }
 		unsigned int GetNodeNumber() const { return nodeNumber; }
 
@@ -85,6 +98,9 @@ namespace QTPFS {
 		void Tesselate(NodeLayer& nl, const SRectangle& r, unsigned int depth, const UpdateThreadData* threadData);
 		void Serialize(std::fstream& fStream, NodeLayer& nodeLayer, unsigned int* streamSize, unsigned int depth, bool readMode);
 
+		void GetCacheData(CacheData& data) const;
+		void SetCacheData(const CacheData& data, const NeighbourPoints* ngbs);
+
 		bool IsLeaf() const { return (childBaseIndex == -1u); }
 		bool CanSplit(unsigned int depth, bool forced) const;
 
@@ -156,10 +172,9 @@ namespace QTPFS {
 			bool& needSplit
 		);
 
+	public:
 		static unsigned int MIN_SIZE_X;
 		static unsigned int MIN_SIZE_Z;
-
-	public:
 		static unsigned int MAX_DEPTH;
 
 	private:
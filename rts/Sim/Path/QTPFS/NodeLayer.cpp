@@ -2,6 +2,7 @@
 
 // #undef NDEBUG
 
+#include <cstring>
 #include <limits>
 
 #if defined(_MSC_VER)
@@ -52,28 +53,7 @@ void QTPFS::NodeLayer::Init(unsigned int layerNum) {
 	RECOIL_DETAILED_TRACY_ZONE;
 	assert((QTPFS::NodeLayer::NUM_SPEEDMOD_BINS + 1) <= MaxSpeedBinTypeValue());
 
-	constexpr size_t initialNodeReserve = 256;
-	openNodes.reserve(initialNodeReserve);
-	selectedNodes.reserve(initialNodeReserve);
-
-	// pre-count the root
-	numLeafNodes = 1;
-	layerNumber = layerNum;
-
-	xsize = mapDims.mapx;
-	zsize = mapDims.mapy;
-
-	{
-		// chunks are reserved OTF
-		nodeIndcs.clear();
-		nodeIndcs.resize(POOL_TOTAL_SIZE);
-
-		std::for_each(nodeIndcs.begin(), nodeIndcs.end(), [&](const unsigned int& i) { nodeIndcs[&i - &nodeIndcs[0]] = &i - &nodeIndcs[0]; assert((size_t)(&i - &nodeIndcs[0]) < nodeIndcs.size()); });
-		std::reverse(nodeIndcs.begin(), nodeIndcs.end());
-	}
-
-	curSpeedMods.resize(xsize * zsize,  0);
-	curSpeedBins.resize(xsize * zsize, -1);
+	InitNodes(layerNum, mapDims.mapx, mapDims.mapy);
 
 	MoveDef* md = moveDefHandler.GetMoveDefByPathType(layerNum);
 	useShortestPath = md->preferShortestPath;
@@ -12,10 +12,12 @@
 
 #include "System/Rectangle.h"
 #include "Node.h"
+#include "NodeLayerCache.h"
 #include "PathDefines.h"
 #include "PathThreads.h"
 
 #include "System/Log/ILog.h"
+#include "System/Misc/TracyDefs.h"
 #include "System/Rectangle.h"
 
 #include "Registry.h"
@@ -42,6 +44,40 @@ namespace QTPFS {
 		void Init(unsigned int layerNum);
 		void Clear();
 
+		// the part of Init that does not depend on the map or the layer's MoveDef
+		void InitNodes(unsigned int layerNum, unsigned int xs, unsigned int zs) {
+			constexpr size_t initialNodeReserve = 256;
+			openNodes.reserve(initialNodeReserve);
+			selectedNodes.reserve(initialNodeReserve);
+
+			// pre-count the root
+			numLeafNodes = 1;
+			numOpenNodes = 0;
+			numClosedNodes = 0;
+			maxNodesAlloced = 0;
+			layerNumber = layerNum;
+
+			xsize = xs;
+			zsize = zs;
+
+			// chunks are reserved OTF, indices are handed out in increasing order
+			nodeIndcs.clear();
+			nodeIndcs.resize(POOL_TOTAL_SIZE);
+
+			for (size_t i = 0, n = nodeIndcs.size(); i < n; i++) {
+				nodeIndcs[i] = n - 1 - i;
+			}
+
+			curSpeedMods.resize(xsize * zsize,  0);
+			curSpeedBins.resize(xsize * zsize, -1);
+		}
+
+		// (de)serialization of the complete tesselated state for the node-layer
+		// cache, see NodeLayerCache.cpp; ReadCache expects Init to have been
+		// called and leaves the layer untouched if the data is malformed
+		void WriteCache(std::vector<std::uint8_t>& buffer) const;
+		bool ReadCache(const std::uint8_t* data, size_t size);
+
 		bool Update(UpdateThreadData& threadData);
 
 		void ExecNodeNeighborCacheUpdates(const SRectangle& ur, UpdateThreadData& threadData);
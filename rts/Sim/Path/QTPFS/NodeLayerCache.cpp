@@ -0,0 +1,191 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+// (de)serialization of tesselated node layers for the node-layer cache, kept
+// apart from NodeLayer.cpp since it does not depend on the map or sim state
+
+#include <algorithm>
+#include <vector>
+
+#include "NodeLayer.h"
+#include "NodeLayerCache.h"
+#include "Node.h"
+
+#include "System/Misc/TracyDefs.h"
+
+void QTPFS::QTNode::GetCacheData(CacheData& data) const {
+	data.nodeNumber = nodeNumber;
+	data.index = index;
+	data.points = points;
+	data.moveCostAvg = moveCostAvg;
+	data.childBaseIndex = childBaseIndex;
+	data.numNeighbours = neighbours.size();
+}
+
+void QTPFS::QTNode::SetCacheData(const CacheData& data, const NeighbourPoints* ngbs) {
+	nodeNumber = data.nodeNumber;
+	index = data.index;
+	points = data.points;
+	moveCostAvg = data.moveCostAvg;
+	childBaseIndex = data.childBaseIndex;
+
+	neighbours.assign(ngbs, ngbs + data.numNeighbours);
+}
+
+
+// every index the restored layer will follow has to point into the nodes that
+// were read, the checksum alone does not protect against a broken writer
+static bool IsValidLayerData(
+	const QTPFS::NodeLayerCache::LayerHeader& header,
+	const std::vector<QTPFS::INode::CacheData>& nodeData,
+	const std::vector<QTPFS::INode::NeighbourPoints>& ngbData,
+	const std::vector<unsigned int>& freeIndcs
+) {
+	const unsigned int numNodes = header.maxNodesAlloced;
+
+	size_t numNeighbours = 0;
+
+	for (unsigned int i = 0; i < numNodes; i++) {
+		const QTPFS::INode::CacheData& data = nodeData[i];
+
+		if (data.GetIndex() != i)
+			return false;
+
+		// children are allocated as one block, see QTNode::Split
+		if (data.childBaseIndex != -1u && (data.childBaseIndex >= numNodes || (numNodes - data.childBaseIndex) < QTNODE_CHILD_COUNT))
+			return false;
+
+		numNeighbours += data.numNeighbours;
+	}
+
+	if (numNeighbours != ngbData.size())
+		return false;
+
+	for (const QTPFS::INode::NeighbourPoints& ngb: ngbData) {
+		if (ngb.nodeId < 0 || ngb.nodeId >= header.maxNodesAlloced)
+			return false;
+	}
+
+	// an index freed twice would later be handed out to two nodes
+	std::vector<bool> isFree(numNodes, false);
+
+	for (const unsigned int idx: freeIndcs) {
+		if (idx >= numNodes || isFree[idx])
+			return false;
+
+		isFree[idx] = true;
+	}
+
+	return true;
+}
+
+
+void QTPFS::NodeLayer::WriteCache(std::vector<std::uint8_t>& buffer) const {
+	RECOIL_DETAILED_TRACY_ZONE;
+	// nodeIndcs still starts with the indices handed out by Init that were never allocated
+	const size_t numUntouchedIndcs = POOL_TOTAL_SIZE - maxNodesAlloced;
+	assert(nodeIndcs.size() >= numUntouchedIndcs);
+
+	std::vector<INode::CacheData> nodeData(maxNodesAlloced);
+	std::vector<INode::NeighbourPoints> ngbData;
+
+	for (int32_t i = 0; i < maxNodesAlloced; i++) {
+		const INode* node = GetPoolNode(i);
+		const auto& ngbs = node->GetNeighbours();
+
+		node->GetCacheData(nodeData[i]);
+		ngbData.insert(ngbData.end(), ngbs.begin(), ngbs.end());
+	}
+
+	NodeLayerCache::LayerHeader header;
+	header.numLeafNodes = numLeafNodes;
+	header.numOpenNodes = numOpenNodes;
+	header.numClosedNodes = numClosedNodes;
+	header.maxNodesAlloced = maxNodesAlloced;
+	header.numRootNodes = numRootNodes;
+	header.xRootNodes = xRootNodes;
+	header.zRootNodes = zRootNodes;
+	header.rootNodeSize = rootNodeSize;
+	header.rootMask = rootMask;
+	header.numNeighbours = ngbData.size();
+	header.numFreeIndcs = nodeIndcs.size() - numUntouchedIndcs;
+	header.numSquares = curSpeedMods.size();
+	header.payloadChecksum = 0;
+
+	const size_t headerPos = buffer.size();
+
+	NodeLayerCache::AppendSection(buffer, &header, sizeof(header));
+	NodeLayerCache::AppendSection(buffer, nodeData.data(), nodeData.size() * sizeof(INode::CacheData));
+	NodeLayerCache::AppendSection(buffer, ngbData.data(), ngbData.size() * sizeof(INode::NeighbourPoints));
+	NodeLayerCache::AppendSection(buffer, nodeIndcs.data() + numUntouchedIndcs, header.numFreeIndcs * sizeof(unsigned int));
+	NodeLayerCache::AppendSection(buffer, curSpeedMods.data(), curSpeedMods.size() * sizeof(SpeedModType));
+	NodeLayerCache::AppendSection(buffer, curSpeedBins.data(), curSpeedBins.size() * sizeof(SpeedBinType));
+	NodeLayerCache::SetPayloadChecksum(buffer, headerPos);
+}
+
+bool QTPFS::NodeLayer::ReadCache(const std::uint8_t* data, size_t size) {
+	RECOIL_DETAILED_TRACY_ZONE;
+	const std::uint8_t* end = data + size;
+
+	NodeLayerCache::LayerHeader header;
+
+	if ((data = NodeLayerCache::ReadSection(data, end, &header, sizeof(header))) == nullptr)
+		return false;
+
+	if (header.payloadChecksum != NodeLayerCache::GetPayloadChecksum(data, end))
+		return false;
+
+	if (!NodeLayerCache::IsValidLayerHeader(header, end - data, curSpeedMods.size(), POOL_TOTAL_SIZE, sizeof(INode::CacheData), sizeof(INode::NeighbourPoints)))
+		return false;
+
+	// parse everything into temporaries first, s.t. a rejected cache leaves the layer as Init made it
+	std::vector<INode::CacheData> nodeData(header.maxNodesAlloced);
+	std::vector<INode::NeighbourPoints> ngbData(header.numNeighbours);
+	std::vector<unsigned int> freeIndcs(header.numFreeIndcs);
+	std::vector<SpeedModType> speedMods(curSpeedMods.size());
+	std::vector<SpeedBinType> speedBins(curSpeedBins.size());
+
+	data = NodeLayerCache::ReadSection(data, end, nodeData.data(), nodeData.size() * sizeof(INode::CacheData));
+	data = NodeLayerCache::ReadSection(data, end, ngbData.data(), ngbData.size() * sizeof(INode::NeighbourPoints));
+	data = NodeLayerCache::ReadSection(data, end, freeIndcs.data(), freeIndcs.size() * sizeof(unsigned int));
+	data = NodeLayerCache::ReadSection(data, end, speedMods.data(), speedMods.size() * sizeof(SpeedModType));
+	data = NodeLayerCache::ReadSection(data, end, speedBins.data(), speedBins.size() * sizeof(SpeedBinType));
+
+	if (data == nullptr)
+		return false;
+
+	if (!IsValidLayerData(header, nodeData, ngbData, freeIndcs))
+		return false;
+
+	// rebuild the free-list exactly, future allocations depend on its order
+	nodeIndcs.resize(POOL_TOTAL_SIZE - header.maxNodesAlloced + header.numFreeIndcs);
+
+	for (size_t i = 0, n = POOL_TOTAL_SIZE - header.maxNodesAlloced; i < n; i++) {
+		nodeIndcs[i] = POOL_TOTAL_SIZE - 1 - i;
+	}
+
+	std::copy(freeIndcs.begin(), freeIndcs.end(), nodeIndcs.begin() + POOL_TOTAL_SIZE - header.maxNodesAlloced);
+
+	curSpeedMods.swap(speedMods);
+	curSpeedBins.swap(speedBins);
+
+	for (unsigned int i = 0, n = (header.maxNodesAlloced - 1) / POOL_CHUNK_SIZE; i <= n; i++) {
+		poolNodes[i].resize(POOL_CHUNK_SIZE);
+	}
+
+	size_t ngbIndex = 0;
+
+	for (int32_t i = 0; i < header.maxNodesAlloced; i++) {
+		GetPoolNode(i)->SetCacheData(nodeData[i], ngbData.data() + ngbIndex);
+		ngbIndex += nodeData[i].numNeighbours;
+	}
+
+	numLeafNodes = header.numLeafNodes;
+	numOpenNodes = header.numOpenNodes;
+	numClosedNodes = header.numClosedNodes;
+	maxNodesAlloced = header.maxNodesAlloced;
+	rootMask = header.rootMask;
+
+	SetRootNodeCountAndDimensions(header.numRootNodes, header.xRootNodes, header.zRootNodes, header.rootNodeSize);
+
+	return true;
+}
@@ -0,0 +1,207 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef QTPFS_NODELAYER_CACHE_H_
+#define QTPFS_NODELAYER_CACHE_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "lib/xxhash/xxh3.h"
+
+namespace QTPFS {
+	// File format of the node-layer cache (see PathManager::{Read,Write}NodeLayerCache):
+	// a FileHeader holding the complete Key, then per layer a 64-bit section size
+	// followed by NodeLayer::WriteCache's output. Every section is 4-byte aligned.
+	namespace NodeLayerCache {
+		// everything the initial tesselation depends on; stored as a whole and
+		// compared on load, the file name only carries a hash of it
+		struct Key {
+			std::uint32_t version;
+			std::uint32_t heightmapChecksum;
+			std::uint32_t typemapChecksum;
+			std::uint32_t blockingChecksum;
+			std::uint32_t moveDefChecksum;
+			std::uint32_t numSpeedModBins;
+			float minSpeedMod;
+			float maxSpeedMod;
+			std::uint32_t minNodeSizeX;
+			std::uint32_t minNodeSizeZ;
+			std::uint32_t maxNodeDepth;
+			std::uint32_t rootSize;
+			std::uint32_t mapx;
+			std::uint32_t mapy;
+
+			bool operator == (const Key& k) const { return (std::memcmp(this, &k, sizeof(Key)) == 0); }
+
+			std::uint64_t GetHash() const { return XXH3_64bits(this, sizeof(Key)); }
+		};
+
+		struct FileHeader {
+			char magic[8];
+			Key key;
+			std::uint32_t numLayers;
+			std::uint32_t maxDepth;
+		};
+
+		struct LayerHeader {
+			std::uint32_t numLeafNodes;
+			std::uint32_t numOpenNodes;
+			std::uint32_t numClosedNodes;
+			std::int32_t maxNodesAlloced;
+			std::int32_t numRootNodes;
+			std::int32_t xRootNodes;
+			std::int32_t zRootNodes;
+			std::int32_t rootNodeSize;
+			std::uint32_t rootMask;
+			std::uint32_t numNeighbours;
+			// entries pushed onto nodeIndcs since Init, i.e. excluding
+			// the untouched indices in [maxNodesAlloced, POOL_TOTAL_SIZE)
+			std::uint32_t numFreeIndcs;
+			std::uint32_t numSquares;
+			// XXH3 of everything following the header in the layer's section
+			std::uint64_t payloadChecksum;
+		};
+
+		static constexpr char MAGIC[8] = "QTPFSNL";
+
+		// sections are 4-byte aligned s.t. the records can be used in place
+		inline void AppendSection(std::vector<std::uint8_t>& buffer, const void* data, size_t size) {
+			const size_t pos = buffer.size();
+
+			buffer.resize(pos + ((size + 3) & ~size_t(3)), 0);
+			std::memcpy(buffer.data() + pos, data, size);
+		}
+
+		// returns the start of the next section, nullptr if <data> is or the section would be out of bounds
+		inline const std::uint8_t* ReadSection(const std::uint8_t* data, const std::uint8_t* end, void* dest, size_t size) {
+			if (data == nullptr || size_t(end - data) < size)
+				return nullptr;
+
+			std::memcpy(dest, data, size);
+			return std::min(end, data + ((size + 3) & ~size_t(3)));
+		}
+
+		inline std::uint64_t GetPayloadChecksum(const std::uint8_t* data, const std::uint8_t* end) {
+			return XXH3_64bits(data, end - data);
+		}
+
+		// fills in the checksum of the layer whose header was appended at <headerPos>
+		inline void SetPayloadChecksum(std::vector<std::uint8_t>& buffer, size_t headerPos) {
+			const size_t payloadPos = headerPos + ((sizeof(LayerHeader) + 3) & ~size_t(3));
+			const std::uint64_t checksum = GetPayloadChecksum(buffer.data() + payloadPos, buffer.data() + buffer.size());
+
+			std::memcpy(buffer.data() + headerPos + offsetof(LayerHeader, payloadChecksum), &checksum, sizeof(checksum));
+		}
+
+		/**
+		 * Checks the counts of a layer header against the layer's dimensions and
+		 * the <numBytes> following it, before they are used to size any buffer.
+		 * Nodes can only neighbour others across their edges and corners, so a
+		 * layer has at most four entries per square plus four per node.
+		 */
+		inline bool IsValidLayerHeader(
+			const LayerHeader& header,
+			size_t numBytes,
+			size_t numSquares,
+			size_t poolSize,
+			size_t nodeDataSize,
+			size_t ngbDataSize
+		) {
+			if (header.maxNodesAlloced <= 0 || size_t(header.maxNodesAlloced) > poolSize)
+				return false;
+			if (header.numFreeIndcs > std::uint32_t(header.maxNodesAlloced))
+				return false;
+			if (header.numSquares != numSquares)
+				return false;
+			if (header.numNeighbours > (numSquares + size_t(header.maxNodesAlloced)) * 4)
+				return false;
+			if (header.numRootNodes <= 0 || header.numRootNodes > header.maxNodesAlloced || header.rootNodeSize <= 0)
+				return false;
+			if (header.xRootNodes <= 0 || header.zRootNodes <= 0 || (std::int64_t(header.xRootNodes) * header.zRootNodes) != header.numRootNodes)
+				return false;
+
+			const std::uint64_t minBytes =
+				std::uint64_t(header.maxNodesAlloced) * nodeDataSize +
+				std::uint64_t(header.numNeighbours) * ngbDataSize +
+				std::uint64_t(header.numFreeIndcs) * sizeof(std::uint32_t);
+
+			return (minBytes <= numBytes);
+		}
+
+
+		inline void WriteFileHeader(std::vector<std::uint8_t>& buffer, const Key& key, std::uint32_t numLayers, std::uint32_t maxDepth) {
+			FileHeader header;
+
+			std::memcpy(header.magic, MAGIC, sizeof(header.magic));
+			header.key = key;
+			header.numLayers = numLayers;
+			header.maxDepth = maxDepth;
+
+			AppendSection(buffer, &header, sizeof(header));
+		}
+
+		// reserves the section size, returns the position to pass to EndLayer
+		inline size_t BeginLayer(std::vector<std::uint8_t>& buffer) {
+			const size_t sizePos = buffer.size();
+
+			buffer.resize(sizePos + sizeof(std::uint64_t), 0);
+			return sizePos;
+		}
+
+		inline void EndLayer(std::vector<std::uint8_t>& buffer, size_t sizePos) {
+			const std::uint64_t size = buffer.size() - (sizePos + sizeof(std::uint64_t));
+			std::memcpy(buffer.data() + sizePos, &size, sizeof(size));
+		}
+
+		/**
+		 * Validates the file header against <key> and splits the rest of <buffer>
+		 * into one (data, size) section per layer.
+		 */
+		inline bool ReadFile(
+			const std::vector<std::uint8_t>& buffer,
+			const Key& key,
+			size_t numLayers,
+			FileHeader& header,
+			std::vector<std::pair<const std::uint8_t*, size_t>>& sections
+		) {
+			if (buffer.size() < sizeof(header))
+				return false;
+
+			std::memcpy(&header, buffer.data(), sizeof(header));
+
+			if (std::memcmp(header.magic, MAGIC, sizeof(header.magic)) != 0)
+				return false;
+			if (!(header.key == key) || header.numLayers != numLayers)
+				return false;
+
+			sections.clear();
+			sections.resize(numLayers, {nullptr, 0});
+
+			size_t pos = sizeof(header);
+
+			for (size_t i = 0; i < numLayers; i++) {
+				std::uint64_t size = 0;
+
+				if ((buffer.size() - pos) < sizeof(size))
+					return false;
+
+				std::memcpy(&size, buffer.data() + pos, sizeof(size));
+				pos += sizeof(size);
+
+				if ((buffer.size() - pos) < size)
+					return false;
+
+				sections[i] = {buffer.data() + pos, size};
+				pos += size;
+			}
+
+			return true;
+		}
+	}
+}
+
+#endif
@@ -93,6 +93,7 @@ namespace QTPFS {
 
 			hash   = other.hash;
 			virtualHash = other.virtualHash;
+			goalHash = other.goalHash;
 			radius = other.radius;
 			synced = other.synced;
 			haveFullPath = other.haveFullPath;
@@ -125,6 +126,7 @@ namespace QTPFS {
 
 			hash   = other.hash;
 			virtualHash = other.virtualHash;
+			goalHash = other.goalHash;
 			radius = other.radius;
 			synced = other.synced;
 			haveFullPath = other.haveFullPath;
@@ -157,6 +159,7 @@ namespace QTPFS {
 
 		void SetHash(PathHashType hash) { this->hash = hash; }
 		void SetVirtualHash(PathHashType virtualHash) { this->virtualHash = virtualHash; }
+		void SetGoalHash(PathHashType goalHash) { this->goalHash = goalHash; }
 		void SetRadius(float radius) { this->radius = radius; }
 		void SetSynced(bool synced) { this->synced = synced; }
 		void SetHasFullPath(bool fullPath) { this->haveFullPath = fullPath; }
@@ -165,6 +168,7 @@ namespace QTPFS {
 		float GetRadius() const { return radius; }
 		PathHashType GetHash() const { return hash; }
 		PathHashType GetVirtualHash() const { return virtualHash; }
+		PathHashType GetGoalHash() const { return goalHash; }
 		bool IsSynced() const { return synced; }
 		bool IsFullPath() const { return haveFullPath; }
 		bool IsPartialPath() const { return havePartialPath; }
@@ -352,6 +356,10 @@ namespace QTPFS {
 		// start and/or end in different, but close, quads. This is used to handle partially-
 		// shared path searches.
 		PathHashType virtualHash = BAD_HASH;
+
+		// Only identifies the layer and the virtual target quad, i.e. matches searches from
+		// anywhere towards the same goal area. This is used to coalesce group move orders.
+		PathHashType goalHash = BAD_HASH;
 		float radius = 0.f;
 		bool synced = true;
 		bool haveFullPath = true;
@@ -37,6 +37,9 @@
 
 #define QTPFS_MAP_DAMAGE_SIZE 16
 
+// bump whenever the tesselation or the layout of the node-layer cache changes
+#define QTPFS_NODE_LAYER_CACHE_VERSION 3
+
 // Though there are four quads per level, having nothing is like a 5th state. So 3 bits, not 2, is needed per level.
 #define QTPFS_NODE_NUMBER_SHIFT_STEP 3
 
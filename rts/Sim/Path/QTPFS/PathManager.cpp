@@ -7,12 +7,15 @@
 #include <algorithm>
 #include <chrono>
 #include <cinttypes>
+#include <cstring>
 #include <deque>
+#include <fstream>
 #include <functional>
 
 #include "System/Threading/ThreadPool.h"
 #include "System/Threading/SpringThreading.h"
 
+#include "GoalSharing.h"
 #include "PathDefines.h"
 #include "PathManager.h"
 
@@ -21,8 +24,10 @@
 #include "Game/GameSetup.h"
 #include "Game/LoadScreen.h"
 #include "Map/MapInfo.h"
+#include "Map/ReadMap.h"
 
 #include "Sim/Misc/GlobalSynced.h"
+#include "Sim/Misc/GroundBlockingObjectMap.h"
 #include "Sim/Misc/ModInfo.h"
 #include "Sim/Misc/TeamHandler.h"
 #include "Sim/MoveTypes/MoveDefHandler.h"
@@ -30,10 +35,13 @@
 #include "Sim/Objects/SolidObject.h"
 #include "System/Config/ConfigHandler.h"
 #include "System/FileSystem/ArchiveScanner.h"
+#include "System/FileSystem/DataDirsAccess.h"
+#include "System/FileSystem/FileQueryFlags.h"
 #include "System/FileSystem/FileSystem.h"
 #include "System/Log/ILog.h"
 #include "System/Platform/Threading.h"
 #include "System/Rectangle.h"
+#include "System/SpringFormat.h"
 #include "System/TimeProfiler.h"
 #include "System/StringUtil.h"
 
@@ -57,8 +65,18 @@
 #define MAP_RECTANGLE SRectangle(0, 0,  mapDims.mapx, mapDims.mapy)
 
 CONFIG(int, PathingThreadCount).defaultValue(0).safemodeValue(1).minimumValue(0);
+CONFIG(bool, QTPFSNodeLayerCache).defaultValue(true).safemodeValue(false)
+	.description("Store the initial QTPFS node-layers on disk, later games with the same map, game and starting terrain skip building them.");
 
 namespace QTPFS {
+	static const std::string GetNodeLayerCacheDir() {
+		return (FileSystem::GetCacheDir() + FileSystemAbstraction::GetNativePathSeparator() + "paths" + FileSystemAbstraction::GetNativePathSeparator());
+	}
+
+	static const std::string GetNodeLayerCacheFileName(const NodeLayerCache::Key& key) {
+		return (GetNodeLayerCacheDir() + mapInfo->map.name + ".qtpfs-" + spring::format("%016" PRIx64, key.GetHash()) + ".bin");
+	}
+
 	struct PMLoadScreen {
 	public:
 		PMLoadScreen() { loadMessages.reserve(8); }
@@ -189,6 +207,7 @@ QTPFS::PathManager::~PathManager() {
 	nodeLayersMapDamageTrack.mapChangeTrackers.clear();
 	sharedPaths.clear();
 	partialSharedPaths.clear();
+	goalSharedPaths.clear();
 
 	// numCurrExecutedSearches.clear();
 	// numPrevExecutedSearches.clear();
@@ -236,6 +255,9 @@ void QTPFS::PathManager::InitStatic() {
 	{ auto view = registry.view<PartialSharedPathChain>();
 	  if (view.size() > 0) { LOG("%s: PartialSharedPathChain is unexpectedly greater than 0.", __func__); }
 	}
+	{ auto view = registry.view<GoalSharedPathChain>();
+	  if (view.size() > 0) { LOG("%s: GoalSharedPathChain is unexpectedly greater than 0.", __func__); }
+	}
 	{ auto view = registry.view<IPath>();
 	  if (view.size() > 0) { LOG("%s: IPath is unexpectedly greater than 0.", __func__); }
 	}
@@ -388,6 +410,7 @@ std::uint64_t QTPFS::PathManager::GetMemFootPrint() const {
 	memFootPrint += pathTraces.size() * sizeof(decltype(pathTraces)::value_type);
 	memFootPrint += sharedPaths.size() * sizeof(decltype(sharedPaths)::value_type);
 	memFootPrint += partialSharedPaths.size() * sizeof(decltype(partialSharedPaths)::value_type);
+	memFootPrint += goalSharedPaths.size() * sizeof(decltype(goalSharedPaths)::value_type);
 
 	memFootPrint += sizeof(nodeLayersMapDamageTrack);
 	memFootPrint += nodeLayersMapDamageTrack.mapChangeTrackers.size()
@@ -428,6 +451,13 @@ void QTPFS::PathManager::InitNodeLayersThreaded(const SRectangle& rect) {
 	// const char* pstFmtStr = "  initialized node-layer %u (%u MB, %u leafs, ratio %f)";
 	// #endif
 
+	nodeLayerCacheKey = CalcNodeLayerCacheKey();
+
+	if (ReadNodeLayerCache()) {
+		streflop::streflop_init<streflop::Simple>();
+		return;
+	}
+
 	for_mt(0, nodeLayers.size(), [this,&loadMsg, &rect](const int layerNum){
 		int currentThread = ThreadPool::GetThreadNum();
 		// #ifndef NDEBUG
@@ -464,9 +494,138 @@ void QTPFS::PathManager::InitNodeLayersThreaded(const SRectangle& rect) {
 		updateThreadData[i].Reset();
 	}
 
+	WriteNodeLayerCache();
+
 	streflop::streflop_init<streflop::Simple>();
 }
 
+QTPFS::NodeLayerCache::Key QTPFS::PathManager::CalcNodeLayerCacheKey() const {
+	RECOIL_DETAILED_TRACY_ZONE;
+	const auto& constants = mapInfo->pfs.qtpfs_constants;
+
+	// the trees are built from the synced state at the time of loading, which Lua
+	// and map features can have modified, so the raw archive checksums would not do
+	NodeLayerCache::Key key;
+	key.version = QTPFS_NODE_LAYER_CACHE_VERSION;
+	key.heightmapChecksum = readMap->CalcHeightmapChecksum();
+	key.typemapChecksum = readMap->CalcTypemapChecksum();
+	key.blockingChecksum = groundBlockingObjectMap.CalcChecksum();
+	key.moveDefChecksum = moveDefHandler.GetCheckSum();
+
+	key.numSpeedModBins = NodeLayer::NUM_SPEEDMOD_BINS;
+	key.minSpeedMod = NodeLayer::MIN_SPEEDMOD_VALUE;
+	key.maxSpeedMod = NodeLayer::MAX_SPEEDMOD_VALUE;
+	key.minNodeSizeX = constants.minNodeSizeX;
+	key.minNodeSizeZ = constants.minNodeSizeZ;
+	key.maxNodeDepth = constants.maxNodeDepth;
+	key.rootSize = rootSize;
+	key.mapx = mapDims.mapx;
+	key.mapy = mapDims.mapy;
+
+	LOG("[QTPFS::%s] node-layer cache hash=%016" PRIx64, __func__, key.GetHash());
+
+	return key;
+}
+
+bool QTPFS::PathManager::ReadNodeLayerCache() {
+	RECOIL_DETAILED_TRACY_ZONE;
+	if (!configHandler->GetBool("QTPFSNodeLayerCache"))
+		return false;
+
+	const std::string cacheFileName = GetNodeLayerCacheFileName(nodeLayerCacheKey);
+
+	if (!FileSystem::FileExists(cacheFileName))
+		return false;
+
+	std::vector<std::uint8_t> buffer;
+
+	{
+		std::ifstream file(dataDirsAccess.LocateFile(cacheFileName), std::ios::binary | std::ios::ate);
+
+		if (!file.is_open())
+			return false;
+
+		buffer.resize(file.tellg());
+		file.seekg(0, std::ios::beg);
+
+		if (!file.read(reinterpret_cast<char*>(buffer.data()), buffer.size()))
+			return false;
+	}
+
+	pmLoadScreen.AddMessage("[PathManager::" + std::string(__func__) + "] reading node-layer cache");
+
+	NodeLayerCache::FileHeader header;
+	std::vector<std::pair<const std::uint8_t*, size_t>> sections;
+
+	// find the per-layer sections first, s.t. the layers can be restored in parallel
+	if (!NodeLayerCache::ReadFile(buffer, nodeLayerCacheKey, nodeLayers.size(), header, sections)) {
+		LOG_L(L_WARNING, "[QTPFS::%s] removing invalid node-layer cache \"%s\"", __func__, cacheFileName.c_str());
+		FileSystem::Remove(cacheFileName);
+		return false;
+	}
+
+	std::vector<std::uint8_t> layerRead(nodeLayers.size(), 0);
+
+	for_mt(0, nodeLayers.size(), [this, &sections, &layerRead](const int layerNum) {
+		NodeLayer& layer = nodeLayers[layerNum];
+
+		layer.Init(layerNum);
+		layerRead[layerNum] = layer.ReadCache(sections[layerNum].first, sections[layerNum].second);
+	});
+
+	if (std::find(layerRead.begin(), layerRead.end(), 0) != layerRead.end()) {
+		LOG_L(L_WARNING, "[QTPFS::%s] removing corrupt node-layer cache \"%s\"", __func__, cacheFileName.c_str());
+		FileSystem::Remove(cacheFileName);
+
+		// the layers are rebuilt from scratch by our caller, Init resets them again
+		return false;
+	}
+
+	QTNode::MAX_DEPTH = header.maxDepth;
+
+	LOG("[QTPFS::%s] read node-layer cache \"%s\"", __func__, cacheFileName.c_str());
+	return true;
+}
+
+bool QTPFS::PathManager::WriteNodeLayerCache() const {
+	RECOIL_DETAILED_TRACY_ZONE;
+	if (!configHandler->GetBool("QTPFSNodeLayerCache"))
+		return false;
+
+	if (!FileSystem::CreateDirectory(GetNodeLayerCacheDir()))
+		return false;
+
+	const std::string cacheFileName = GetNodeLayerCacheFileName(nodeLayerCacheKey);
+
+	std::vector<std::uint8_t> buffer;
+
+	NodeLayerCache::WriteFileHeader(buffer, nodeLayerCacheKey, nodeLayers.size(), QTNode::MAX_DEPTH);
+
+	for (const NodeLayer& layer: nodeLayers) {
+		const size_t sizePos = NodeLayerCache::BeginLayer(buffer);
+		layer.WriteCache(buffer);
+		NodeLayerCache::EndLayer(buffer, sizePos);
+	}
+
+	{
+		std::ofstream file(dataDirsAccess.LocateFile(cacheFileName, FileQueryFlags::WRITE), std::ios::binary | std::ios::trunc);
+
+		if (!file.is_open() || !file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size())) {
+			file.close();
+			FileSystem::Remove(cacheFileName);
+			return false;
+		}
+	}
+
+	LOG("[QTPFS::%s] written node-layer cache \"%s\" (%uKB)", __func__, cacheFileName.c_str(), unsigned(buffer.size() / 1024));
+	return true;
+}
+
+void QTPFS::PathManager::RemoveCacheFiles() {
+	RECOIL_DETAILED_TRACY_ZONE;
+	FileSystem::Remove(GetNodeLayerCacheFileName(nodeLayerCacheKey));
+}
+
 void QTPFS::PathManager::InitRootSize(const SRectangle& r) {
 	RECOIL_DETAILED_TRACY_ZONE;
 	// setup the root node system
@@ -752,6 +911,7 @@ void QTPFS::PathManager::Update() {
 				//if (dirtyPathDetail.clearSharing) {
 					RemovePathFromShared(pathEntity);
 					RemovePathFromPartialShared(pathEntity);
+					RemovePathFromGoalShared(pathEntity);
 				}
 
 					// The path may still be fine for owner, even if it can't be shared any more.
@@ -816,6 +976,7 @@ bool QTPFS::PathManager::InitializeSearch(entt::entity searchEntity) {
 		search->Initialize(&nodeLayer, path->GetSourcePoint(), path->GetGoalPosition(), path->GetOwner());
 		path->SetHash(search->GetHash());
 		path->SetVirtualHash(search->GetPartialSearchHash());
+		path->SetGoalHash(search->GetGoalSearchHash());
 
 		// LOG("%s: search vhash %x%x", __func__, int(search->GetPartialSearchHash() >> 32), int(search->GetPartialSearchHash() & 32));
 		// LOG("%s: path vhash %x%x", __func__, int(path->GetVirtualHash() >> 32), int(path->GetVirtualHash() & 32));
@@ -843,6 +1004,16 @@ bool QTPFS::PathManager::InitializeSearch(entt::entity searchEntity) {
 					linkedListHelper.InsertChain<PartialSharedPathChain>(partialSharedPaths[path->GetVirtualHash()], pathEntity);
 				}
 			}
+			if (search->GetGoalSearchHash() != QTPFS::BAD_HASH) {
+				assert(!registry.all_of<GoalSharedPathChain>(pathEntity));
+				GoalSharedPathMap::iterator goalSharedPathsIt = goalSharedPaths.find(path->GetGoalHash());
+				if (goalSharedPathsIt == goalSharedPaths.end()) {
+					registry.emplace<GoalSharedPathChain>(pathEntity, pathEntity, pathEntity);
+					goalSharedPaths[path->GetGoalHash()] = pathEntity;
+				} else {
+					linkedListHelper.InsertChain<GoalSharedPathChain>(goalSharedPaths[path->GetGoalHash()], pathEntity);
+				}
+			}
 		}
 
 		search->initialized = true;
@@ -912,9 +1083,12 @@ void QTPFS::PathManager::ExecuteQueuedSearches() {
 		if (!path->IsBoundingBoxOverriden() || path->GetNodeList().size() == 0) {
 			RemovePathFromShared(pathEntity);
 			RemovePathFromPartialShared(pathEntity);
+			RemovePathFromGoalShared(pathEntity);
 		}
 	};
 
+	searchStats = {};
+
 	// TODO: make a function?
 	for (auto pathSearchEntity : pathView) {
 		assert(registry.valid(pathSearchEntity));
@@ -927,6 +1101,11 @@ void QTPFS::PathManager::ExecuteQueuedSearches() {
 			if (path != nullptr) {
 				if (search->PathWasFound()) {
 					completePath(pathEntity, path);
+
+					searchStats.numSearches += 1;
+					searchStats.numFullShared += search->fullyShared;
+					searchStats.numGoalShared += search->goalShared;
+					searchStats.numPartialShared += (search->doPartialSearch && !search->goalShared);
 					// LOG("%s: %x - path found", __func__, entt::to_integral(pathEntity));
 				} else {
 					if (search->rawPathCheck) {
@@ -1016,6 +1195,8 @@ bool QTPFS::PathManager::ExecuteSearch(
 		if (search->doPartialSearch)
 			search->doPartialSearch = false;
 
+		search->goalShared = false;
+
 		if (search->allowPartialSearch)
 		{
 			PartialSharedPathMap::const_iterator partialSharedPathsIt = partialSharedPaths.find(path->GetVirtualHash());
@@ -1062,6 +1243,7 @@ bool QTPFS::PathManager::ExecuteSearch(
 						auto& headChainPath = registry.get<IPath>(chainHeadEntity);
 						search->SharedFinalize(&headChainPath, path);
 						search->pathRequestWaiting = false;
+						search->fullyShared = true;
 
 						// if (search->Getowner() != nullptr && 2102 == search->Getowner()->id)
 						// 	LOG("%s: full shared (%d)", __func__, search->GetID());
@@ -1096,6 +1278,40 @@ bool QTPFS::PathManager::ExecuteSearch(
 				}
 			}
 		}
+
+		// Searches from near the same place towards the same goal area (e.g. a group move order)
+		// wait for the first of them and then only search until they meet its path, which is loaded
+		// the same way as the head of a partial share. A path that others are already waiting on
+		// must not wait itself, otherwise the chains could deadlock.
+		if (search->allowPartialSearch && !search->doPartialSearch && !forceFullPath)
+		{
+			GoalSharedPathMap::const_iterator goalSharedPathsIt = goalSharedPaths.find(path->GetGoalHash());
+			if (goalSharedPathsIt != goalSharedPaths.end() && goalSharedPathsIt->second != pathEntity) {
+				assert(path->GetGoalHash() != QTPFS::BAD_HASH);
+				entt::entity goalChainHeadEntity = goalSharedPathsIt->second;
+
+				const IPath& goalHeadPath = registry.get<IPath>(goalChainHeadEntity);
+				const bool nearGoalHead = GoalSharing::CanShare(path->GetSourcePoint(), goalHeadPath.GetSourcePoint(), modInfo.qtGoalShareMaxSourceDist);
+
+				bool pathIsCopyable = !registry.all_of<PathSearchRef>(goalChainHeadEntity);
+				if (!pathIsCopyable) {
+					const bool leadsFullShare = (chainHeadEntity == pathEntity
+							&& registry.get<SharedPathChain>(pathEntity).next != pathEntity);
+					const bool leadsPartialShare = (partialChainHeadEntity == pathEntity
+							&& registry.get<PartialSharedPathChain>(pathEntity).next != pathEntity);
+
+					if (nearGoalHead && !leadsFullShare && !leadsPartialShare) {
+						search->pathRequestWaiting = true;
+						return false;
+					}
+				} else if (nearGoalHead && goalHeadPath.IsFullPath()) {
+					partialChainHeadEntity = goalChainHeadEntity;
+					search->pathRequestWaiting = false;
+					search->doPartialSearch = true;
+					search->goalShared = true;
+				}
+			}
+		}
 	}
 
 	// Only the head of a partial path share is allowed to attempt a path repair. It doesn't make sense for a
@@ -1115,6 +1331,16 @@ bool QTPFS::PathManager::ExecuteSearch(
 	if (search->Execute(searchStateOffset)) {
 		search->Finalize(path);
 
+		if (search->goalShared) {
+			const IPath& goalHeadPath = registry.get<IPath>(partialChainHeadEntity);
+			const float srcDist = path->GetSourcePoint().distance2D(goalHeadPath.GetSourcePoint());
+
+			// the route may not lead back along most of the head's path; any such
+			// result is replaced by a full search during the next update
+			if (!GoalSharing::IsShortEnough(GoalSharing::GetPathLength(*path), GoalSharing::GetPathLength(goalHeadPath), srcDist))
+				search->RejectPartialResult();
+		}
+
 		#ifdef QTPFS_TRACE_PATH_SEARCHES
 		pathTraces[path->GetID()] = search->GetExecutionTrace();
 		#endif
@@ -1291,6 +1517,7 @@ unsigned int QTPFS::PathManager::RequeueSearch(
 
 	RemovePathFromShared(pathEntity);
 	RemovePathFromPartialShared(pathEntity);
+	RemovePathFromGoalShared(pathEntity);
 
 	oldPath->SetHash(QTPFS::BAD_HASH);
 	// oldPath->SetNextPointIndex(0); - don't clear, will mess up active units.
@@ -1357,6 +1584,7 @@ void QTPFS::PathManager::DeletePathEntity(entt::entity pathEntity) {
 
 	RemovePathFromShared(pathEntity);
 	RemovePathFromPartialShared(pathEntity);
+	RemovePathFromGoalShared(pathEntity);
 
 	// if (registry.valid(pathEntity)) - check is already done.
 	RemovePathSearch(pathEntity);
@@ -1412,6 +1640,27 @@ void QTPFS::PathManager::RemovePathFromPartialShared(entt::entity entity) {
 	linkedListHelper.RemoveChain<PartialSharedPathChain>(entity);
 }
 
+void QTPFS::PathManager::RemovePathFromGoalShared(entt::entity entity) {
+	RECOIL_DETAILED_TRACY_ZONE;
+	if (!registry.all_of<GoalSharedPathChain>(entity)) return;
+
+	IPath* path = &registry.get<IPath>(entity);
+	auto iter = goalSharedPaths.find(path->GetGoalHash());
+
+	// case: when entity is at the head of the chain.
+	if (iter != goalSharedPaths.end() && iter->second == entity) {
+		assert(path->GetGoalHash() != QTPFS::BAD_HASH);
+		auto& chain = registry.get<GoalSharedPathChain>(entity);
+		if (chain.next == entity) {
+			goalSharedPaths.erase(path->GetGoalHash());
+		} else {
+			goalSharedPaths[path->GetGoalHash()] = chain.next;
+		}
+	}
+
+	linkedListHelper.RemoveChain<GoalSharedPathChain>(entity);
+}
+
 void QTPFS::PathManager::RemovePathSearch(entt::entity pathEntity) {
 	RECOIL_DETAILED_TRACY_ZONE;
 
@@ -1680,3 +1929,7 @@ int2 QTPFS::PathManager::GetNumQueuedUpdates() const {
 
 	return data;
 }
+
+int2 QTPFS::PathManager::GetNumMergedSearches() const {
+	return {searchStats.GetNumMerged(), searchStats.numSearches};
+}
@@ -43,6 +43,8 @@ namespace QTPFS {
 		std::int32_t GetPathFinderType() const override { return QTPFS_TYPE; }
 		std::uint32_t GetPathCheckSum() const override { return pfsCheckSum; }
 
+		void RemoveCacheFiles() override;
+
 		std::int64_t Finalize() override;
 
 		bool PathUpdated(unsigned int pathID) override;
@@ -84,6 +86,7 @@ namespace QTPFS {
 		) const override;
 
 		int2 GetNumQueuedUpdates() const override;
+		int2 GetNumMergedSearches() const override;
 
 
 		const NodeLayer& GetNodeLayer(unsigned int pathType) const { return nodeLayers[pathType]; }
@@ -112,6 +115,7 @@ namespace QTPFS {
 		typedef spring::unordered_map<PathHashType, entt::entity>::iterator SharedPathMapIt;
 		typedef spring::unordered_map<PathHashType, entt::entity> PartialSharedPathMap;
 		typedef spring::unordered_map<PathHashType, entt::entity>::iterator PartialSharedPathMapIt;
+		typedef spring::unordered_map<PathHashType, entt::entity> GoalSharedPathMap;
 
 		typedef std::vector<PathSearch*> PathSearchVect;
 		typedef std::vector<PathSearch*>::iterator PathSearchVectIt;
@@ -121,9 +125,14 @@ namespace QTPFS {
 		void InitRootSize(const SRectangle& r);
 		void UpdateNodeLayer(unsigned int layerNum, const SRectangle& r, int currentThread);
 
+		NodeLayerCache::Key CalcNodeLayerCacheKey() const;
+		bool ReadNodeLayerCache();
+		bool WriteNodeLayerCache() const;
+
 		bool InitializeSearch(entt::entity searchEntity);
 		void RemovePathFromShared(entt::entity entity);
 		void RemovePathFromPartialShared(entt::entity entity);
+		void RemovePathFromGoalShared(entt::entity entity);
 		void RemovePathSearch(entt::entity pathEntity);
 
 		void ReadyQueuedSearches();
@@ -173,6 +182,20 @@ namespace QTPFS {
 		PathTraceMap pathTraces;
 		SharedPathMap sharedPaths;
 		PartialSharedPathMap partialSharedPaths;
+		GoalSharedPathMap goalSharedPaths;
+
+		// searches completed during the last update and how many
+		// of them were served from, or towards, another path
+		struct SearchStats {
+			int numSearches = 0;
+			int numFullShared = 0;
+			int numPartialShared = 0;
+			int numGoalShared = 0;
+
+			int GetNumMerged() const { return (numFullShared + numPartialShared + numGoalShared); }
+		};
+
+		SearchStats searchStats;
 
 		// std::vector<unsigned int> numCurrExecutedSearches;
 		// std::vector<unsigned int> numPrevExecutedSearches;
@@ -194,6 +217,7 @@ namespace QTPFS {
 		std::int32_t updateDirtyPathRemainder = 0;
 
 		std::uint32_t pfsCheckSum;
+		NodeLayerCache::Key nodeLayerCacheKey = {};
 
 		entt::entity systemEntity = entt::null;
 
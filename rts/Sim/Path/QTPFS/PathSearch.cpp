@@ -134,8 +134,11 @@ void QTPFS::PathSearch::Initialize(
 
 	pathSearchHash = GenerateHash(srcNode, tgtNode);
 	pathPartialSearchHash = GenerateVirtualHash(srcNode, tgtNode);
+	pathGoalSearchHash = GenerateGoalHash(tgtNode);
 
 	doPartialSearch = false;
+	fullyShared = false;
+	goalShared = false;
 	pathRequestWaiting = false;
 	rejectPartialSearch = false;
 
@@ -2604,6 +2607,29 @@ const QTPFS::PathHashType QTPFS::PathSearch::GenerateVirtualHash(const INode* sr
 	return GenerateHash2(vSrcNodeId, vTgtNodeId);
 }
 
+const QTPFS::PathHashType QTPFS::PathSearch::GenerateGoalHash(const INode* tgtNode) const {
+	RECOIL_DETAILED_TRACY_ZONE;
+
+	if (rawPathCheck || modInfo.qtGoalShareMaxSourceDist <= 0.0f)
+		return BAD_HASH;
+
+	MoveDef* md = moveDefHandler.GetMoveDefByPathType(nodeLayer->GetNodelayer());
+	int shift = GetNextBitShift(md->xsize);
+
+	// same limit as for partially shared paths, goal sharing works the same way
+	if ((1<<shift) > QTPFS_PARTIAL_SHARE_PATH_MAX_SIZE)
+		return BAD_HASH;
+
+	int tgtX = tgtNode->xmid();
+	int tgtZ = tgtNode->zmid();
+	INode* tgtRootNode = nodeLayer->GetRootNode(tgtX, tgtZ);
+
+	std::uint32_t vTgtNodeId = GenerateVirtualNodeNumber(*nodeLayer, tgtRootNode, QTPFS_PARTIAL_SHARE_PATH_MAX_SIZE, tgtX, tgtZ);
+
+	// the source is left out, any start position matches
+	return GenerateHash2(0, vTgtNodeId);
+}
+
 const QTPFS::PathHashType QTPFS::PathSearch::GenerateHash2(uint32_t src, uint32_t dest) const {
 	RECOIL_DETAILED_TRACY_ZONE;
 	std::uint64_t k = nodeLayer->GetNodelayer();
@@ -122,8 +122,11 @@ namespace QTPFS {
 
 		const PathHashType GetHash() const { return pathSearchHash; };
 		const PathHashType GetPartialSearchHash() const { return pathPartialSearchHash; };
+		const PathHashType GetGoalSearchHash() const { return pathGoalSearchHash; };
 
 		bool PathWasFound() const { return haveFullPath | havePartPath; }
+		// discards the result, the path is then requeued as a full search
+		void RejectPartialResult() { haveFullPath = havePartPath = false; rejectPartialSearch = true; }
 
 		void SetPathType(int newPathType) { pathType = newPathType; }
 		int GetPathType() const { return pathType; }
@@ -190,6 +193,7 @@ namespace QTPFS {
 		const PathHashType GenerateHash2(uint32_t p1, uint32_t p2) const;
 
 		const PathHashType GenerateVirtualHash(const INode* srcNode, const INode* tgtNode) const;
+		const PathHashType GenerateGoalHash(const INode* tgtNode) const;
 
 		public:
 		static const std::uint32_t GenerateVirtualNodeNumber(const QTPFS::NodeLayer& nodeLayer, const INode* startNode, int nodeMaxSize, int x, int z, uint32_t* depth = nullptr);
@@ -208,6 +212,10 @@ namespace QTPFS {
 		// shared path searches.
 		PathHashType pathPartialSearchHash;
 
+		// Like the partial hash, but without the source quad. Searches with the same goal hash
+		// can reuse each other's routes no matter where they start from.
+		PathHashType pathGoalSearchHash;
+
 		const CSolidObject* pathOwner;
 		NodeLayer* nodeLayer;
 		int pathType;
@@ -252,6 +260,9 @@ public:
 		bool synced = false;
 		bool pathRequestWaiting = false;
 		bool doPartialSearch = false;
+		// set when the result was copied from, or searched towards, another path
+		bool fullyShared = false;
+		bool goalShared = false;
 		bool tryPathRepair = false;
 		bool rejectPartialSearch = false;
 		bool allowPartialSearch = false;
@@ -11,6 +11,7 @@
 #include "Map/ReadMap.h"
 #include "Sim/MoveTypes/MoveDefHandler.h"
 #include "System/Rectangle.h"
+#include "System/Misc/TracyDefs.h"
 
 namespace QTPFS {
     typedef unsigned char SpeedModType;
@@ -15,6 +15,7 @@
 #include "Sim/Misc/CollisionHandler.h"
 #include "Sim/Misc/CollisionVolume.h"
 #include "Sim/Misc/GlobalSynced.h"
+#include "Sim/Misc/ModInfo.h"
 #include "Sim/Misc/QuadField.h"
 #include "Sim/Misc/TeamHandler.h"
 #include "Rendering/Env/Particles/Classes/NanoProjectile.h"
@@ -191,6 +192,8 @@ void CProjectileHandler::UpdateProjectilesImpl()
 
 	// WARNING: same as above but for p->Update()
 	if constexpr (synced) {
+		const bool deferQuadUpdates = quadField.PackedPositions();
+
 		for (size_t i = 0; i < pc.size(); ++i) {
 			CProjectile* p = pc[i];
 			assert(p != nullptr);
@@ -198,10 +201,20 @@ void CProjectileHandler::UpdateProjectilesImpl()
 			MAPPOS_SANITY_CHECK(p->pos);
 
 			p->Update();
-			quadField.MovedProjectile(p);
+
+			if (!deferQuadUpdates)
+				quadField.MovedProjectile(p);
 
 			MAPPOS_SANITY_CHECK(p->pos);
 		}
+
+		// relocate in one pass, queries made during the updates
+		// see the cells (and packed positions) of the last frame
+		if (deferQuadUpdates) {
+			for (CProjectile* p: pc) {
+				quadField.MovedProjectile(p);
+			}
+		}
 	}
 	else {
 		for_mt_chunk(0, pc.size(), [&pc](int i) {
@@ -418,49 +431,126 @@ static bool CheckProjectileCollisionFlags(const CProjectile* p, const CUnit* u)
 	return true;
 }
 
+static bool CheckProjectileCollision(const CProjectile* p, const CUnit* unit)
+{
+	// if this unit fired this projectile, always ignore
+	if (unit == p->owner())
+		return false;
+	if (!unit->HasCollidableStateBit(CSolidObject::CSTATE_BIT_PROJECTILES))
+		return false;
 
-void CProjectileHandler::CheckUnitCollisions(
-	CProjectile* p,
-	std::vector<CUnit*>& tempUnits,
+	return (CheckProjectileCollisionFlags(p, unit));
+}
+
+static bool CheckProjectileCollision(const CProjectile* p, const CFeature* feature)
+{
+	return (feature->HasCollidableStateBit(CSolidObject::CSTATE_BIT_PROJECTILES));
+}
+
+
+// per-thread since DetectObjectHit also runs on workers (CheckUnitFeatureCollisionsMT)
+static std::array<CollisionVolumeBatch, ThreadPool::MAX_THREADS> collisionBatches;
+
+// below this many candidates batching costs more than it saves
+static constexpr size_t MIN_BATCHED_HIT_TESTS = 4;
+
+
+// returns the first object in <objects> that <p> hits, or nullptr
+// if <deferred> is non-null, piece-tree tests (which lazily update piece
+// matrices and are therefore not thread-safe) are skipped and flagged
+template<typename T>
+static T* DetectObjectHit(
+	const CProjectile* p,
+	const std::vector<T*>& objects,
 	const float3 ppos0,
-	const float3 ppos1
+	const float3 ppos1,
+	CollisionQuery* cq,
+	bool* deferred
 ) {
-	RECOIL_DETAILED_TRACY_ZONE;
-	if (!p->checkCol)
-		return;
+	CollisionVolumeBatch* batch = nullptr;
 
-	CollisionQuery cq;
+	if (objects.size() >= MIN_BATCHED_HIT_TESTS) {
+		// hit-test all plain volumes at once, the loop below then only
+		// needs to rerun DetectHit for those the batch reports as hit
+		batch = &collisionBatches[ThreadPool::GetThreadNum()];
+		batch->Clear();
 
-	for (CUnit* unit: tempUnits) {
-		assert(unit != nullptr);
+		for (size_t i = 0; i < objects.size(); i++) {
+			if (!CheckProjectileCollision(p, objects[i]))
+				continue;
 
-		// if this unit fired this projectile, always ignore
-		if (unit == p->owner())
-			continue;
-		if (!unit->HasCollidableStateBit(CSolidObject::CSTATE_BIT_PROJECTILES))
-			continue;
+			CCollisionHandler::AddToBatch(*batch, objects[i], objects[i]->GetTransformMatrix(true), i);
+		}
 
-		if (!CheckProjectileCollisionFlags(p, unit))
+		CCollisionHandler::IntersectBatch(*batch, ppos0, ppos1);
+	}
+
+	size_t batchHitIdx = 0;
+
+	for (size_t i = 0; i < objects.size(); i++) {
+		T* object = objects[i];
+
+		assert(object != nullptr);
+
+		if (!CheckProjectileCollision(p, object))
 			continue;
 
-		if (CCollisionHandler::DetectHit(unit, unit->GetTransformMatrix(true), ppos0, ppos1, &cq)) {
-			if (cq.GetHitPiece() != nullptr)
-				unit->SetLastHitPiece(cq.GetHitPiece(), gs->frameNum, p->synced);
+		if (batch != nullptr && CCollisionHandler::CanBatchDetectHit(object, &object->collisionVolume)) {
+			const std::vector<int>& hitIds = batch->GetHitIds();
 
-			if (!cq.InsideHit()) {
-				p->SetPosition(cq.GetHitPos());
-				p->Collision(unit);
-				p->SetPosition(ppos0);
-			} else {
-				p->Collision(unit);
-			}
+			if (batchHitIdx == hitIds.size() || hitIds[batchHitIdx] != static_cast<int>(i))
+				continue;
 
-			break;
+			batchHitIdx++;
+		} else if (deferred != nullptr && object->collisionVolume.DefaultToPieceTree()) {
+			*deferred = true;
+			return nullptr;
 		}
+
+		if (CCollisionHandler::DetectHit(object, object->GetTransformMatrix(true), ppos0, ppos1, cq))
+			return object;
+	}
+
+	return nullptr;
+}
+
+template<typename T>
+static void ResolveObjectHit(CProjectile* p, T* object, const CollisionQuery& cq, const float3 ppos0)
+{
+	if (cq.GetHitPiece() != nullptr)
+		object->SetLastHitPiece(cq.GetHitPiece(), gs->frameNum, p->synced);
+
+	if (!cq.InsideHit()) {
+		p->SetPosition(cq.GetHitPos());
+		p->Collision(object);
+		p->SetPosition(ppos0);
+	} else {
+		p->Collision(object);
 	}
 }
 
-void CProjectileHandler::CheckFeatureCollisions(
+
+bool CProjectileHandler::CheckUnitCollisions(
+	CProjectile* p,
+	std::vector<CUnit*>& tempUnits,
+	const float3 ppos0,
+	const float3 ppos1
+) {
+	RECOIL_DETAILED_TRACY_ZONE;
+	if (!p->checkCol)
+		return false;
+
+	CollisionQuery cq;
+	CUnit* unit = DetectObjectHit(p, tempUnits, ppos0, ppos1, &cq, nullptr);
+
+	if (unit == nullptr)
+		return false;
+
+	ResolveObjectHit(p, unit, cq, ppos0);
+	return true;
+}
+
+bool CProjectileHandler::CheckFeatureCollisions(
 	CProjectile* p,
 	std::vector<CFeature*>& tempFeatures,
 	const float3 ppos0,
@@ -469,38 +559,23 @@ void CProjectileHandler::CheckFeatureCollisions(
 	RECOIL_DETAILED_TRACY_ZONE;
 	// already collided with unit?
 	if (!p->checkCol)
-		return;
+		return false;
 
 	if ((p->GetCollisionFlags() & Collision::NOFEATURES) != 0)
-		return;
+		return false;
 
 	CollisionQuery cq;
+	CFeature* feature = DetectObjectHit(p, tempFeatures, ppos0, ppos1, &cq, nullptr);
 
-	for (CFeature* feature: tempFeatures) {
-		assert(feature != nullptr);
-
-		if (!feature->HasCollidableStateBit(CSolidObject::CSTATE_BIT_PROJECTILES))
-			continue;
-
-		if (CCollisionHandler::DetectHit(feature, feature->GetTransformMatrix(true), ppos0, ppos1, &cq)) {
-			if (cq.GetHitPiece() != nullptr)
-				feature->SetLastHitPiece(cq.GetHitPiece(), gs->frameNum, p->synced);
-
-			if (!cq.InsideHit()) {
-				p->SetPosition(cq.GetHitPos());
-				p->Collision(feature);
-				p->SetPosition(ppos0);
-			} else {
-				p->Collision(feature);
-			}
+	if (feature == nullptr)
+		return false;
 
-			break;
-		}
-	}
+	ResolveObjectHit(p, feature, cq, ppos0);
+	return true;
 }
 
 
-void CProjectileHandler::CheckShieldCollisions(
+bool CProjectileHandler::CheckShieldCollisions(
 	CProjectile* p,
 	std::vector<CPlasmaRepulser*>& tempRepulsers,
 	const float3 ppos0,
@@ -508,10 +583,10 @@ void CProjectileHandler::CheckShieldCollisions(
 ) {
 	RECOIL_DETAILED_TRACY_ZONE;
 	if (!p->checkCol)
-		return;
+		return false;
 	// skip unsynced and non-weapon projectiles
 	if (!p->weapon)
-		return;
+		return false;
 
 	CWeaponProjectile* wpro = static_cast<CWeaponProjectile*>(p);
 	const WeaponDef* wdef = wpro->GetWeaponDef();
@@ -521,9 +596,10 @@ void CProjectileHandler::CheckShieldCollisions(
 
 	// bail early
 	if (interceptType == 0)
-		return;
+		return false;
 
 	CollisionQuery cq;
+	bool hit = false;
 
 	for (CPlasmaRepulser* repulser: tempRepulsers) {
 		assert(repulser != nullptr);
@@ -549,18 +625,46 @@ void CProjectileHandler::CheckShieldCollisions(
 		if (cq.InsideHit() && repulser->IgnoreInteriorHit(wpro))
 			continue;
 
+		// changes the shield and possibly the projectile, even if not intercepted
+		hit = true;
+
 		if (repulser->IncomingProjectile(wpro, cq.GetHitPos()))
-			return;
+			return true;
 	}
+
+	return hit;
 }
 
-void CProjectileHandler::CheckUnitFeatureCollisions(bool synced)
+bool CProjectileHandler::CheckUnitFeatureCollisions(CProjectile* p)
 {
 	RECOIL_DETAILED_TRACY_ZONE;
 	static std::vector<CUnit*> tempUnits;
 	static std::vector<CFeature*> tempFeatures;
 	static std::vector<CPlasmaRepulser*> tempRepulsers;
 
+	const float3 ppos0 = p->pos;
+	const float3 ppos1 = p->pos + p->speed;
+	// const float3 ppos1 = p->pos + p->dir * (p->speed.w + p->radius);
+
+	quadField.GetUnitsAndFeaturesColVol(p->pos, p->speed.w + p->radius, tempUnits, tempFeatures, &tempRepulsers);
+
+	bool hit = false;
+
+	hit |= CheckShieldCollisions (p, tempRepulsers, ppos0, ppos1); tempRepulsers.clear();
+	hit |= CheckUnitCollisions   (p, tempUnits    , ppos0, ppos1); tempUnits.clear();
+	hit |= CheckFeatureCollisions(p, tempFeatures , ppos0, ppos1); tempFeatures.clear();
+
+	return hit;
+}
+
+void CProjectileHandler::CheckUnitFeatureCollisions(bool synced)
+{
+	RECOIL_DETAILED_TRACY_ZONE;
+	if (synced && modInfo.parallelProjectileCollisions && ThreadPool::HasThreads()) {
+		CheckUnitFeatureCollisionsMT();
+		return;
+	}
+
 	//can't use iterators here, because instructions inside the loop modify projectiles[synced]
 	for (size_t i = 0; i < projectiles[synced].size(); ++i) {
 		CProjectile* p = projectiles[synced][i];
@@ -568,15 +672,147 @@ void CProjectileHandler::CheckUnitFeatureCollisions(bool synced)
 		if (!p->checkCol) continue;
 		if ( p->deleteMe) continue;
 
-		const float3 ppos0 = p->pos;
-		const float3 ppos1 = p->pos + p->speed;
-		// const float3 ppos1 = p->pos + p->dir * (p->speed.w + p->radius);
+		CheckUnitFeatureCollisions(p);
+	}
+}
+
+void CProjectileHandler::CheckUnitFeatureCollisionsMT()
+{
+	RECOIL_DETAILED_TRACY_ZONE;
+	// per-projectile results of the parallel detection phase; persist
+	// across frames so the inner repulser vectors keep their capacity
+	struct HitTest {
+		float3 ppos0;
+		float3 ppos1;
+
+		CUnit* unit = nullptr;
+		CFeature* feature = nullptr;
+
+		CollisionQuery unitQuery;
+		CollisionQuery featureQuery;
+
+		// candidates, kept for retesting after a hit within the same projectile
+		std::vector<CUnit*> units;
+		std::vector<CFeature*> features;
+		std::vector<CPlasmaRepulser*> repulsers;
+
+		bool deferred = false;
+	};
+
+	// projectiles are detected in windows of twice the number the last
+	// one resolved before a hit invalidated the rest of its results
+	constexpr size_t MIN_WINDOW_SIZE = 64;
+	constexpr size_t MAX_WINDOW_SIZE = 8192;
+
+	static std::vector<HitTest> hitTests;
+	static size_t windowSize = MIN_WINDOW_SIZE;
+
+	auto& pc = projectiles[true];
+
+	// projectiles spawned while resolving hits are appended, never
+	// inserted, so indices below numTests stay valid throughout
+	const size_t numTests = pc.size();
+
+	if (hitTests.size() < numTests)
+		hitTests.resize(numTests);
 
-		quadField.GetUnitsAndFeaturesColVol(p->pos, p->speed.w + p->radius, tempUnits, tempFeatures, &tempRepulsers);
+	const auto DetectHits = [&](const int i) {
+		const CProjectile* p = pc[i];
+		HitTest& ht = hitTests[i];
+
+		ht.unit = nullptr;
+		ht.feature = nullptr;
+		ht.units.clear();
+		ht.features.clear();
+		ht.repulsers.clear();
+
+		if (!p->checkCol || p->deleteMe)
+			return;
+
+		ht.ppos0 = p->pos;
+		ht.ppos1 = p->pos + p->speed;
+		ht.deferred = false;
+
+		QuadFieldQuery qfQuery;
+		qfQuery.threadOwner = ThreadPool::GetThreadNum();
+		quadField.GetUnitsAndFeaturesColVol(qfQuery, p->pos, p->speed.w + p->radius, &ht.repulsers);
+
+		ht.units.assign(qfQuery.units->begin(), qfQuery.units->end());
+		ht.features.assign(qfQuery.features->begin(), qfQuery.features->end());
+
+		ht.unit = DetectObjectHit(p, ht.units, ht.ppos0, ht.ppos1, &ht.unitQuery, &ht.deferred);
+
+		if ((p->GetCollisionFlags() & Collision::NOFEATURES) == 0)
+			ht.feature = DetectObjectHit(p, ht.features, ht.ppos0, ht.ppos1, &ht.featureQuery, &ht.deferred);
+	};
+
+	// returns true if the hit had side-effects (explosions, damage,
+	// Lua call-ins, ...) which any other result might depend on
+	const auto ResolveHits = [&](const size_t i) {
+		CProjectile* p = pc[i];
+		HitTest& ht = hitTests[i];
+
+		if (!p->checkCol) return false;
+		if ( p->deleteMe) return false;
+
+		// piece-tree tests lazily update piece matrices, these stay serial
+		if (ht.deferred)
+			return CheckUnitFeatureCollisions(p);
+
+		// mirrors CheckUnitFeatureCollisions(p); each test after a hit is
+		// redone against the current state with the same candidates
+		if (CheckShieldCollisions(p, ht.repulsers, ht.ppos0, ht.ppos1)) {
+			CheckUnitCollisions(p, ht.units, ht.ppos0, ht.ppos1);
+			CheckFeatureCollisions(p, ht.features, ht.ppos0, ht.ppos1);
+			return true;
+		}
+
+		if (p->checkCol && ht.unit != nullptr) {
+			ResolveObjectHit(p, ht.unit, ht.unitQuery, ht.ppos0);
+			CheckFeatureCollisions(p, ht.features, ht.ppos0, ht.ppos1);
+			return true;
+		}
+
+		if (p->checkCol && ht.feature != nullptr) {
+			ResolveObjectHit(p, ht.feature, ht.featureQuery, ht.ppos0);
+			return true;
+		}
+
+		return false;
+	};
+
+	// a result is only used if no hit was resolved between its detection
+	// and its resolution, i.e. if it was detected in exactly the state the
+	// serial pass would see; after a hit the rest of the window is stale
+	// and detected again, so the outcome is identical to the serial pass
+	for (size_t idxBeg = 0; idxBeg < numTests; ) {
+		const size_t idxWin = idxBeg;
+		const size_t idxEnd = std::min(numTests, idxBeg + windowSize);
+
+		{
+			SCOPED_TIMER("Sim::Projectiles::Collisions::Detect");
+			for_mt_chunk(idxBeg, idxEnd, DetectHits);
+		}
+		{
+			SCOPED_TIMER("Sim::Projectiles::Collisions::Resolve");
+
+			bool hit = false;
+
+			while (idxBeg < idxEnd && !hit) {
+				hit = ResolveHits(idxBeg++);
+			}
+
+			windowSize = std::clamp((idxBeg - idxWin) * 2, MIN_WINDOW_SIZE, MAX_WINDOW_SIZE);
+		}
+	}
+
+	for (size_t i = numTests; i < pc.size(); ++i) {
+		CProjectile* p = pc[i];
+
+		if (!p->checkCol) continue;
+		if ( p->deleteMe) continue;
 
-		CheckShieldCollisions (p, tempRepulsers, ppos0, ppos1); tempRepulsers.clear();
-		CheckUnitCollisions   (p, tempUnits    , ppos0, ppos1); tempUnits.clear();
-		CheckFeatureCollisions(p, tempFeatures , ppos0, ppos1); tempFeatures.clear();
+		CheckUnitFeatureCollisions(p);
 	}
 }
 
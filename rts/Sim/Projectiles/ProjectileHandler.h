@@ -43,10 +43,14 @@ public:
 		return projectiles[synced];
 	}
 
-	void CheckUnitCollisions(CProjectile*, std::vector<CUnit*>&, const float3, const float3);
-	void CheckFeatureCollisions(CProjectile*, std::vector<CFeature*>&, const float3, const float3);
-	void CheckShieldCollisions(CProjectile*, std::vector<CPlasmaRepulser*>&, const float3, const float3);
+	// these return true if a hit was resolved, i.e. if the state
+	// other projectiles are tested against might have changed
+	bool CheckUnitCollisions(CProjectile*, std::vector<CUnit*>&, const float3, const float3);
+	bool CheckFeatureCollisions(CProjectile*, std::vector<CFeature*>&, const float3, const float3);
+	bool CheckShieldCollisions(CProjectile*, std::vector<CPlasmaRepulser*>&, const float3, const float3);
+	bool CheckUnitFeatureCollisions(CProjectile* p);
 	void CheckUnitFeatureCollisions(bool synced);
+	void CheckUnitFeatureCollisionsMT();
 	void CheckGroundCollisions(bool synced);
 	void CheckCollisions();
 
@@ -66,6 +66,7 @@
 #include "System/creg/STL_List.h"
 #include "System/Sound/ISoundChannels.h"
 #include "System/Sync/SyncedPrimitive.h"
+#include "System/Threading/ThreadPool.h"
 
 #undef near
 
@@ -647,12 +648,49 @@ void CUnit::DisableScriptMoveType()
 }
 
 
+void CUnit::PrepareUpdate(UnitUpdatePrep& prep) const
+{
+	prep.pos = pos;
+	prep.midPos = midPos;
+	prep.radius = radius;
+	prep.hmModCount = readMap->GetHeightMapModCount();
+	prep.terrainState = CalcTerrainPhysicalState(0.1f);
+
+	if ((prep.hasQuads = moveType->WantsCollisionMapUpdate())) {
+		QuadFieldQuery qfQuery;
+		qfQuery.threadOwner = ThreadPool::GetThreadNum();
+		quadField.GetQuads(qfQuery, pos, radius);
+		prep.quads.assign(qfQuery.quads->begin(), qfQuery.quads->end());
+	}
+}
+
+bool CUnit::IsPreparedUpdateCurrent(const UnitUpdatePrep& prep) const
+{
+	// anything the update of a preceding unit (or a Lua call-in it
+	// triggered) changed makes the prepared state stale, including
+	// transportees moved by their transporter
+	if (!prep.pos.same(pos))
+		return false;
+	if (!prep.midPos.same(midPos))
+		return false;
+	if (prep.radius != radius)
+		return false;
+
+	return (prep.hmModCount == readMap->GetHeightMapModCount());
+}
+
 void CUnit::Update()
 {
 	RECOIL_DETAILED_TRACY_ZONE;
 	ASSERT_SYNCED(pos);
 
-	UpdatePhysicalState(0.1f);
+	// stale results are recomputed s.t. both paths are bit-identical
+	if (preparedUpdate != nullptr && IsPreparedUpdateCurrent(*preparedUpdate)) {
+		ApplyTerrainPhysicalState(preparedUpdate->terrainState);
+	} else {
+		UpdatePhysicalState(0.1f);
+	}
+
 	UpdatePosErrorParams(true, false);
 	UpdateTransportees(); // none if already dead
 
@@ -1802,11 +1840,16 @@ void CUnit::DependentDied(CObject* o)
 void CUnit::UpdatePhysicalState(float eps)
 {
 	RECOIL_DETAILED_TRACY_ZONE;
+	ApplyTerrainPhysicalState(CalcTerrainPhysicalState(eps));
+}
+
+void CUnit::ApplyTerrainPhysicalState(unsigned int bits)
+{
 	const bool inAir      = IsInAir();
 	const bool inWater    = IsInWater();
 	const bool underWater = IsUnderWater();
 
-	CSolidObject::UpdatePhysicalState(eps);
+	SetTerrainPhysicalState(bits);
 
 	if (IsInAir() != inAir) {
 		if (IsInAir()) {
@@ -2924,6 +2967,7 @@ CR_REG_METADATA(CUnit, (
 	CR_MEMBER(lastMuzzleFlameSize),
 
 	CR_MEMBER(preFramePos),
+	CR_IGNORED(preparedUpdate),
 	CR_MEMBER(lastMuzzleFlameDir),
 	CR_MEMBER(flankingBonusDir),
 
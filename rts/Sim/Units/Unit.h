@@ -65,6 +65,23 @@ static constexpr uint8_t LOS_ALL_MASK_BITS = \
 	(LOS_INLOS_MASK | LOS_INRADAR_MASK | LOS_PREVLOS_MASK | LOS_CONTRADAR_MASK);
 
 
+// result of the thread-safe first phase of CUnit::Update (see
+// CUnitHandler::UpdateUnits) plus the inputs it was evaluated
+// from, s.t. the ordered second phase can detect stale results
+struct UnitUpdatePrep {
+	float3 pos;
+	float3 midPos;
+	float radius = 0.0f;
+	unsigned int hmModCount = 0;
+
+	unsigned int terrainState = 0;
+
+	// quads overlapped by {pos, radius}; only valid if hasQuads
+	std::vector<int> quads;
+	bool hasQuads = false;
+};
+
+
 class CUnit : public CSolidObject
 {
 public:
@@ -77,6 +94,10 @@ public:
 
 	void SanityCheck() const;
 	void PreUpdate() { preFramePos = pos; }
+	/// thread-safe first phase of Update, must not modify any (synced) state
+	void PrepareUpdate(UnitUpdatePrep& prep) const;
+	bool IsPreparedUpdateCurrent(const UnitUpdatePrep& prep) const;
+	void SetPreparedUpdate(UnitUpdatePrep* prep) { preparedUpdate = prep; }
 
 	virtual void PreInit(const UnitLoadParams& params);
 	virtual void PostInit(const CUnit* builder);
@@ -146,6 +167,7 @@ public:
 	void CalculateTerrainType();
 	void UpdateTerrainType();
 	void UpdatePhysicalState(float eps);
+	void ApplyTerrainPhysicalState(unsigned int bits);
 
 	float3 GetErrorVector(int allyteam) const;
 	float3 GetErrorPos(int allyteam, bool aiming = false) const { return (aiming? aimPos: midPos) + GetErrorVector(allyteam); }
@@ -349,6 +371,10 @@ public:
 	// move along vectors other than its velocity
 	float3 preFramePos;
 
+	// set by CUnitHandler for the duration of Update if the unit was
+	// prepared in parallel, consumed only if its inputs are current
+	UnitUpdatePrep* preparedUpdate = nullptr;
+
 	float3 lastMuzzleFlameDir = UpVector;
 	// units take less damage when attacked from this dir (encourage flanking fire)
 	float3 flankingBonusDir = RgtVector;
@@ -35,6 +35,7 @@
 
 #include "System/Config/ConfigHandler.h"
 CONFIG(bool, UpdateWeaponVectorsMT).defaultValue(true).safemodeValue(false).minimumValue(false).description("Enable multithreaded update of weapon vectors");
+CONFIG(bool, UpdateUnitsMT).defaultValue(false).safemodeValue(false).minimumValue(false).description("Enable two-phase multithreaded unit update (parallel evaluation into per-unit buffers, ordered serial commit); sync-identical to the serial path");
 CONFIG(bool, UpdateBoundingVolumeMT).defaultValue(true).safemodeValue(false).minimumValue(false).description("Enable multithreaded update of unit bounding volumes");
 
 
@@ -408,13 +409,42 @@ void CUnitHandler::UpdateUnits()
 {
 	SCOPED_TIMER("Sim::Unit::Update");
 
+	// per-unit results of the parallel phase, indexed like activeUnits
+	static std::vector<UnitUpdatePrep> updatePreps;
+
 	size_t activeUnitCount = activeUnits.size();
+	bool preparedUpdates = false;
+
+	if ((preparedUpdates = configHandler->GetBool("UpdateUnitsMT"))) {
+		// phase one evaluates the side-effect free parts of the update
+		// (terrain state, collision-map quads) into private buffers; the
+		// ordered loop below commits them and does everything else, i.e.
+		// Lua call-ins, transportee moves and quadfield changes
+		ZoneScopedN("Sim::Unit::PrepareUpdateMT");
+
+		if (updatePreps.size() < activeUnitCount)
+			updatePreps.resize(activeUnitCount);
+
+		for_mt_chunk(0, activeUnitCount, [&](const int idx) {
+			activeUnits[idx]->PrepareUpdate(updatePreps[idx]);
+		});
+	}
+
 	for (size_t i = 0; i < activeUnitCount; ++i) {
 		CUnit* unit = activeUnits[i];
+		UnitUpdatePrep* prep = preparedUpdates? &updatePreps[i]: nullptr;
 
 		unit->SanityCheck();
+		unit->SetPreparedUpdate(prep);
 		unit->Update();
-		unit->moveType->UpdateCollisionMap();
+		unit->SetPreparedUpdate(nullptr);
+
+		if (prep != nullptr && prep->hasQuads && unit->IsPreparedUpdateCurrent(*prep)) {
+			unit->moveType->UpdateCollisionMap(&prep->quads);
+		} else {
+			unit->moveType->UpdateCollisionMap();
+		}
+
 		// unsynced; done on-demand when drawing unit
 		// unit->UpdateLocalModel();
 		unit->SanityCheck();
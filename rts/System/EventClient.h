@@ -198,6 +198,20 @@ class CEventClient
 		virtual void StockpileChanged(const CUnit* unit,
 		                              const CWeapon* weapon, int oldCount) {}
 
+		/// queue the event for the client's next FlushEventBatches
+		virtual void UnitDamagedBatch(
+			const CUnit* unit,
+			const CUnit* attacker,
+			float damage,
+			int weaponDefID,
+			int projectileID,
+			bool paralyzer) {}
+		virtual void UnitEnteredLosBatch(const CUnit* unit, int allyTeam) {}
+		virtual void ProjectileCreatedBatch(const CProjectile* proj) {}
+
+		/// deliver the events queued by the *Batch events
+		virtual void FlushEventBatches() {}
+
 		virtual bool Explosion(int weaponID, int projectileID, const float3& pos, const CUnit* owner) { return false; }
 
 
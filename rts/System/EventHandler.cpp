@@ -625,6 +625,26 @@ void CEventHandler::UnitHarvestStorageFull(const CUnit* unit)
 /******************************************************************************/
 /******************************************************************************/
 
+void CEventHandler::FlushEventBatches()
+{
+	if (listUnitDamagedBatch.empty() && listUnitEnteredLosBatch.empty() && listProjectileCreatedBatch.empty())
+		return;
+
+	ZoneScoped;
+
+	// clients are flushed once per batch list they are part of, any but
+	// the first call are no-ops; the same order on every synced client
+	for (EventClientList* list: {&listUnitDamagedBatch, &listUnitEnteredLosBatch, &listProjectileCreatedBatch}) {
+		for (size_t i = 0; i < list->size(); ) {
+			CEventClient* ec = (*list)[i];
+			ec->FlushEventBatches();
+
+			// the call-in may remove itself from the list
+			i += (i < list->size() && ec == (*list)[i]);
+		}
+	}
+}
+
 void CEventHandler::CollectGarbage(bool forced)
 {
 	ZoneScoped;
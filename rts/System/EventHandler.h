@@ -29,6 +29,8 @@ class CEventHandler
 		bool HasClient(CEventClient* ec) const {
 			return (std::find(handles.begin(), handles.end(), ec) != handles.end());
 		}
+		/// true if any client may veto interceptor targets (see AllowWeaponInterceptTarget)
+		bool HasWeaponInterceptTargetControl() const { return !listAllowWeaponInterceptTarget.empty(); }
 
 		bool InsertEvent(CEventClient* ec, const std::string& ciName);
 		bool RemoveEvent(CEventClient* ec, const std::string& ciName);
@@ -139,6 +141,15 @@ class CEventHandler
 		void StockpileChanged(const CUnit* unit,
 		                      const CWeapon* weapon, int oldCount);
 
+		/**
+		 * UnitDamaged, UnitEnteredLos and ProjectileCreated are also queued for
+		 * the clients of their *Batch events; this delivers them, in the order
+		 * they were raised, at the end of every sim stage that may raise them
+		 * (and once before the sim frame for events raised between frames)
+		 * so their IDs may refer to units or projectiles destroyed since
+		 */
+		void FlushEventBatches();
+
 		bool CommandFallback(const CUnit* unit, const Command& cmd);
 		bool AllowCommand(const CUnit* unit, const Command& cmd, int playerNum, bool fromSynced, bool fromLua);
 
@@ -458,10 +469,19 @@ UNIT_CALLIN_INT_PARAMS(Given)
 	}
 
 UNIT_CALLIN_LOS_PARAM(EnteredRadar)
-UNIT_CALLIN_LOS_PARAM(EnteredLos)
 UNIT_CALLIN_LOS_PARAM(LeftRadar)
 UNIT_CALLIN_LOS_PARAM(LeftLos)
 
+inline void CEventHandler::UnitEnteredLos(const CUnit* unit, int at)
+{
+	ITERATE_ALLYTEAM_EVENTCLIENTLIST(UnitEnteredLos, at, unit, at)
+
+	for (CEventClient* ec: listUnitEnteredLosBatch) {
+		if (ec->CanReadAllyTeam(at))
+			ec->UnitEnteredLosBatch(unit, at);
+	}
+}
+
 
 
 inline void CEventHandler::UnitFromFactory(const CUnit* unit,
@@ -540,6 +560,12 @@ inline void CEventHandler::UnitDamaged(
 	bool paralyzer)
 {
 	ITERATE_UNIT_ALLYTEAM_EVENTCLIENTLIST(UnitDamaged, unit, attacker, damage, weaponDefID, projectileID, paralyzer)
+
+	// only queued, the lists can not change
+	for (CEventClient* ec: listUnitDamagedBatch) {
+		if (ec->CanReadAllyTeam(unitAllyTeam))
+			ec->UnitDamagedBatch(unit, attacker, damage, weaponDefID, projectileID, paralyzer);
+	}
 }
 
 inline void CEventHandler::UnitStunned(
@@ -666,6 +692,11 @@ inline void CEventHandler::ProjectileCreated(const CProjectile* proj, int allyTe
 			ec->ProjectileCreated(proj);
 		}
 	}
+
+	for (CEventClient* ec: listProjectileCreatedBatch) {
+		if ((allyTeam < 0) || ec->CanReadAllyTeam(allyTeam))
+			ec->ProjectileCreatedBatch(proj);
+	}
 }
 
 
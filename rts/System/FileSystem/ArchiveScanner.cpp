@@ -19,6 +19,7 @@
 #include "FileSystem.h"
 #include "FileQueryFlags.h"
 #include "Lua/LuaParser.h"
+#include "System/Config/ConfigHandler.h"
 #include "System/ContainerUtil.h"
 #include "System/StringUtil.h"
 #include "System/Exceptions.h"
@@ -55,6 +56,10 @@ LOG_REGISTER_SECTION_GLOBAL(LOG_SECTION_ARCHIVESCANNER)
 
 constexpr static int INTERNAL_VER = 16;
 
+CONFIG(bool, ArchiveCacheExportLua)
+	.defaultValue(false)
+	.description("Also write the archive cache in the legacy Lua format (ArchiveCache.lua) next to the binary one, for inspection by external tools.");
+
 
 /*
  * Engine known (and used?) tags in [map|mod]info.lua
@@ -390,7 +395,8 @@ CArchiveScanner::CArchiveScanner()
 {
 	Clear();
 	// the "cache" dir is created in DataDirLocater
-	ReadCacheData(cachefile = FileSystem::EnsurePathSepAtEnd(FileSystem::GetCacheDir()) + IntToString(INTERNAL_VER, "ArchiveCache%i.lua"));
+	luaCacheFile = FileSystem::EnsurePathSepAtEnd(FileSystem::GetCacheDir()) + IntToString(INTERNAL_VER, "ArchiveCache%i.lua");
+	ReadCacheData(cachefile = FileSystem::EnsurePathSepAtEnd(FileSystem::GetCacheDir()) + IntToString(INTERNAL_VER, "ArchiveCache%i.bin"));
 	ScanAllDirs();
 }
 
@@ -421,6 +427,7 @@ void CArchiveScanner::Clear()
 	brokenArchivesIndex.clear();
 	brokenArchivesIndex.reserve(16);
 	cachefile.clear();
+	luaCacheFile.clear();
 }
 
 void CArchiveScanner::Reload()
@@ -434,7 +441,8 @@ void CArchiveScanner::Reload()
 
 	// ctor
 	Clear();
-	ReadCacheData(cachefile = FileSystem::EnsurePathSepAtEnd(FileSystem::GetCacheDir()) + IntToString(INTERNAL_VER, "ArchiveCache%i.lua"));
+	luaCacheFile = FileSystem::EnsurePathSepAtEnd(FileSystem::GetCacheDir()) + IntToString(INTERNAL_VER, "ArchiveCache%i.lua");
+	ReadCacheData(cachefile = FileSystem::EnsurePathSepAtEnd(FileSystem::GetCacheDir()) + IntToString(INTERNAL_VER, "ArchiveCache%i.bin"));
 	ScanAllDirs();
 }
 
@@ -1013,18 +1021,278 @@ bool CArchiveScanner::GetArchiveChecksum(const std::string& archiveName, Archive
 }
 
 
+/*
+ * Layout of the binary ArchiveCache: header, archive records, broken-archive
+ * records, info-item records, dependency string offsets and finally a table
+ * of NUL-terminated strings that all records refer to by offset. Records are
+ * fixed-size and in native byte order (the cache never leaves this machine),
+ * so the whole file is read in one go and decoded without any parsing.
+ */
+namespace {
+	constexpr char BINARY_CACHE_MAGIC[8] = "SPRARCH";
+
+	struct BinaryCacheHeader {
+		char magic[8];
+		std::uint32_t internalVer;
+		std::uint32_t numArchives;
+		std::uint32_t numBrokenArchives;
+		std::uint32_t numInfoItems;
+		std::uint32_t numDependencies;
+		std::uint32_t stringTableSize;
+	};
+
+	struct BinaryArchiveRecord {
+		std::uint32_t origName;
+		std::uint32_t path;
+		std::uint32_t archiveDataPath;
+		std::uint32_t modified;
+		std::uint32_t modifiedArchiveData;
+		std::uint32_t firstInfoItem;
+		std::uint32_t numInfoItems;
+		std::uint32_t firstDependency;
+		std::uint32_t numDependencies;
+		std::uint8_t checksum[sha512::SHA_LEN];
+	};
+
+	struct BinaryBrokenArchiveRecord {
+		std::uint32_t name;
+		std::uint32_t path;
+		std::uint32_t problem;
+		std::uint32_t modified;
+	};
+
+	struct BinaryInfoItemRecord {
+		std::uint32_t key;
+		std::uint32_t valueType;
+		std::uint32_t value; // string offset for INFO_VALUE_TYPE_STRING, raw bits otherwise
+	};
+
+	struct BinaryStringTable {
+		std::uint32_t Add(const std::string& str) {
+			const auto it = offsets.find(str);
+
+			if (it != offsets.end())
+				return it->second;
+
+			const std::uint32_t offset = data.size();
+
+			data.insert(data.end(), str.begin(), str.end());
+			data.push_back(0);
+			offsets.insert(str, offset);
+			return offset;
+		}
+
+		std::vector<char> data;
+		spring::unordered_map<std::string, std::uint32_t> offsets;
+	};
+
+	template<typename T>
+	const std::uint8_t* ReadBinaryCacheSection(const std::uint8_t* data, std::vector<T>& records, std::uint32_t numRecords) {
+		records.resize(numRecords);
+
+		if (numRecords > 0)
+			std::memcpy(records.data(), data, numRecords * sizeof(T));
+
+		return (data + numRecords * sizeof(T));
+	}
+
+	template<typename T>
+	bool WriteBinaryCacheSection(FILE* out, const T* records, size_t numRecords) {
+		return (numRecords == 0 || fwrite(records, sizeof(T), numRecords, out) == numRecords);
+	}
+}
+
+
 void CArchiveScanner::ReadCacheData(const std::string& filename)
 {
 	std::lock_guard<decltype(scannerMutex)> lck(scannerMutex);
+
+	if (ReadBinaryCacheData(filename)) {
+		isDirty = false;
+		return;
+	}
+
+	// no usable binary cache (yet), migrate from the Lua one if there is
+	// any and mark the data dirty so the binary cache gets (re)written
+	isDirty = ReadLuaCacheData(luaCacheFile);
+}
+
+bool CArchiveScanner::ReadBinaryCacheData(const std::string& filename)
+{
 	if (!FileSystem::FileExists(filename)) {
 		LOG_L(L_INFO, "[AS::%s] ArchiveCache %s doesn't exist", __func__, filename.c_str());
-		return;
+		return false;
+	}
+
+	std::vector<std::uint8_t> buffer;
+
+	{
+		FILE* in = fopen(filename.c_str(), "rb");
+
+		if (in == nullptr) {
+			LOG_L(L_ERROR, "[AS::%s] failed to read from \"%s\"!", __func__, filename.c_str());
+			return false;
+		}
+
+		fseek(in, 0, SEEK_END);
+		buffer.resize(std::max(ftell(in), 0L));
+		fseek(in, 0, SEEK_SET);
+
+		const size_t numBytesRead = fread(buffer.data(), 1, buffer.size(), in);
+
+		fclose(in);
+
+		if (numBytesRead != buffer.size()) {
+			LOG_L(L_ERROR, "[AS::%s] failed to read from \"%s\"!", __func__, filename.c_str());
+			return false;
+		}
+	}
+
+	BinaryCacheHeader header;
+
+	if (buffer.size() < sizeof(header))
+		return false;
+
+	std::memcpy(&header, buffer.data(), sizeof(header));
+
+	// do not load old version caches
+	if (std::memcmp(header.magic, BINARY_CACHE_MAGIC, sizeof(header.magic)) != 0 || header.internalVer != INTERNAL_VER)
+		return false;
+
+	const std::uint64_t stringTablePos =
+		sizeof(header) +
+		std::uint64_t(header.numArchives) * sizeof(BinaryArchiveRecord) +
+		std::uint64_t(header.numBrokenArchives) * sizeof(BinaryBrokenArchiveRecord) +
+		std::uint64_t(header.numInfoItems) * sizeof(BinaryInfoItemRecord) +
+		std::uint64_t(header.numDependencies) * sizeof(std::uint32_t);
+
+	// the table must end in a NUL s.t. every in-range offset yields a terminated string
+	if ((stringTablePos + header.stringTableSize) != buffer.size() || header.stringTableSize == 0 || buffer.back() != 0) {
+		LOG_L(L_ERROR, "[AS::%s] ArchiveCache %s is malformed", __func__, filename.c_str());
+		return false;
+	}
+
+	std::vector<BinaryArchiveRecord> archiveRecs;
+	std::vector<BinaryBrokenArchiveRecord> brokenRecs;
+	std::vector<BinaryInfoItemRecord> infoItemRecs;
+	std::vector<std::uint32_t> dependencyRecs;
+
+	const std::uint8_t* data = buffer.data() + sizeof(header);
+	data = ReadBinaryCacheSection(data, archiveRecs, header.numArchives);
+	data = ReadBinaryCacheSection(data, brokenRecs, header.numBrokenArchives);
+	data = ReadBinaryCacheSection(data, infoItemRecs, header.numInfoItems);
+	data = ReadBinaryCacheSection(data, dependencyRecs, header.numDependencies);
+
+	const char* strings = reinterpret_cast<const char*>(data);
+
+	// validate all offsets and ranges before touching any scanner state
+	{
+		const auto IsString = [&](std::uint32_t offset) { return (offset < header.stringTableSize); };
+
+		bool valid = true;
+
+		for (const BinaryArchiveRecord& rec: archiveRecs) {
+			valid &= (IsString(rec.origName) && IsString(rec.path) && IsString(rec.archiveDataPath));
+			valid &= ((std::uint64_t(rec.firstInfoItem) + rec.numInfoItems) <= header.numInfoItems);
+			valid &= ((std::uint64_t(rec.firstDependency) + rec.numDependencies) <= header.numDependencies);
+		}
+		for (const BinaryBrokenArchiveRecord& rec: brokenRecs) {
+			valid &= (IsString(rec.name) && IsString(rec.path) && IsString(rec.problem));
+		}
+		for (const BinaryInfoItemRecord& rec: infoItemRecs) {
+			valid &= (IsString(rec.key) && rec.valueType <= INFO_VALUE_TYPE_BOOL);
+			valid &= (rec.valueType != INFO_VALUE_TYPE_STRING || IsString(rec.value));
+		}
+		for (const std::uint32_t rec: dependencyRecs) {
+			valid &= IsString(rec);
+		}
+
+		if (!valid) {
+			LOG_L(L_ERROR, "[AS::%s] ArchiveCache %s is malformed", __func__, filename.c_str());
+			return false;
+		}
+	}
+
+	for (const BinaryArchiveRecord& rec: archiveRecs) {
+		const std::string curArchiveName = strings + rec.origName;
+
+		ArchiveInfo& ai = GetAddArchiveInfo(StringToLower(curArchiveName));
+		ArchiveInfo tmp; // used to compare against all-zero hash
+
+		ai.origName        = curArchiveName;
+		ai.path            = strings + rec.path;
+		ai.archiveDataPath = strings + rec.archiveDataPath;
+
+		ai.modified = rec.modified;
+		ai.modifiedArchiveData = rec.modifiedArchiveData;
+
+		std::memcpy(ai.checksum, rec.checksum, sha512::SHA_LEN);
+
+		ai.updated = false;
+		ai.hashed = (memcmp(ai.checksum, tmp.checksum, sha512::SHA_LEN) != 0);
+
+		ArchiveData& ad = (ai.archiveData = {});
+
+		for (std::uint32_t i = rec.firstInfoItem, n = rec.firstInfoItem + rec.numInfoItems; i < n; i++) {
+			const BinaryInfoItemRecord& iiRec = infoItemRecs[i];
+			const char* key = strings + iiRec.key;
+
+			switch (iiRec.valueType) {
+				case INFO_VALUE_TYPE_STRING: {
+					ad.SetInfoItemValueString(key, strings + iiRec.value);
+				} break;
+				case INFO_VALUE_TYPE_INTEGER: {
+					int value = 0;
+					std::memcpy(&value, &iiRec.value, sizeof(value));
+					ad.SetInfoItemValueInteger(key, value);
+				} break;
+				case INFO_VALUE_TYPE_FLOAT: {
+					float value = 0.0f;
+					std::memcpy(&value, &iiRec.value, sizeof(value));
+					ad.SetInfoItemValueFloat(key, value);
+				} break;
+				case INFO_VALUE_TYPE_BOOL: {
+					ad.SetInfoItemValueBool(key, iiRec.value != 0);
+				} break;
+			}
+		}
+
+		for (std::uint32_t i = rec.firstDependency, n = rec.firstDependency + rec.numDependencies; i < n; i++) {
+			ad.GetDependencies().emplace_back(strings + dependencyRecs[i]);
+		}
+
+		if (ad.IsMap()) {
+			AddDependency(ad.GetDependencies(), GetMapHelperContentName());
+		} else if (ad.IsGame()) {
+			AddDependency(ad.GetDependencies(), GetSpringBaseContentName());
+		}
+	}
+
+	for (const BinaryBrokenArchiveRecord& rec: brokenRecs) {
+		const std::string name = StringToLower(strings + rec.name);
+
+		BrokenArchive& ba = GetAddBrokenArchive(name);
+		ba.name = name;
+		ba.path = strings + rec.path;
+		ba.modified = rec.modified;
+		ba.updated = false;
+		ba.problem = strings + rec.problem;
+	}
+
+	return true;
+}
+
+bool CArchiveScanner::ReadLuaCacheData(const std::string& filename)
+{
+	if (!FileSystem::FileExists(filename)) {
+		LOG_L(L_INFO, "[AS::%s] ArchiveCache %s doesn't exist", __func__, filename.c_str());
+		return false;
 	}
 
 	LuaParser p(filename, SPRING_VFS_RAW, SPRING_VFS_BASE);
 	if (!p.Execute()) {
 		LOG_L(L_ERROR, "[AS::%s] failed to parse ArchiveCache: %s", __func__, p.GetErrorLog().c_str());
-		return;
+		return false;
 	}
 
 	const LuaTable& archiveCacheTbl = p.GetRoot();
@@ -1034,7 +1302,7 @@ void CArchiveScanner::ReadCacheData(const std::string& filename)
 	// Do not load old version caches
 	const int ver = archiveCacheTbl.GetInt("internalver", (INTERNAL_VER + 1));
 	if (ver != INTERNAL_VER)
-		return;
+		return false;
 
 	for (int i = 1; archivesTbl.KeyExists(i); ++i) {
 		const LuaTable& curArchiveTbl = archivesTbl.SubTable(i);
@@ -1090,7 +1358,7 @@ void CArchiveScanner::ReadCacheData(const std::string& filename)
 		ba.problem = curArchive.GetString("problem", "unknown");
 	}
 
-	isDirty = false;
+	return true;
 }
 
 static inline void SafeStr(FILE* out, const char* prefix, const std::string& str)
@@ -1117,12 +1385,6 @@ void CArchiveScanner::WriteCacheData(const std::string& filename)
 	if (!isDirty)
 		return;
 
-	FILE* out = fopen(filename.c_str(), "wt");
-	if (out == nullptr) {
-		LOG_L(L_ERROR, "[AS::%s] failed to write to \"%s\"!", __func__, filename.c_str());
-		return;
-	}
-
 	// First delete all outdated information
 	{
 		std::stable_sort(archiveInfos.begin(), archiveInfos.end(), [](const ArchiveInfo& a, const ArchiveInfo& b) { return (a.origName < b.origName); });
@@ -1146,6 +1408,129 @@ void CArchiveScanner::WriteCacheData(const std::string& filename)
 		}
 	}
 
+	if (!WriteBinaryCacheData(filename))
+		return;
+
+	// the Lua format is no longer read back unless the binary cache is unusable,
+	// but stays available as a human-readable export for tools and debugging
+	if (configHandler != nullptr && configHandler->GetBool("ArchiveCacheExportLua"))
+		WriteLuaCacheData(luaCacheFile);
+
+	isDirty = false;
+}
+
+bool CArchiveScanner::WriteBinaryCacheData(const std::string& filename) const
+{
+	BinaryStringTable strings;
+	BinaryCacheHeader header;
+
+	std::vector<BinaryArchiveRecord> archiveRecs;
+	std::vector<BinaryBrokenArchiveRecord> brokenRecs;
+	std::vector<BinaryInfoItemRecord> infoItemRecs;
+	std::vector<std::uint32_t> dependencyRecs;
+
+	archiveRecs.reserve(archiveInfos.size());
+	brokenRecs.reserve(brokenArchives.size());
+	infoItemRecs.reserve(archiveInfos.size() * 16);
+
+	for (const ArchiveInfo& arcInfo: archiveInfos) {
+		BinaryArchiveRecord rec = {};
+
+		rec.origName = strings.Add(arcInfo.origName);
+		rec.path = strings.Add(arcInfo.path);
+		rec.archiveDataPath = strings.Add(arcInfo.archiveDataPath);
+		rec.modified = arcInfo.modified;
+		rec.modifiedArchiveData = arcInfo.modifiedArchiveData;
+		rec.firstInfoItem = infoItemRecs.size();
+		rec.firstDependency = dependencyRecs.size();
+
+		std::memcpy(rec.checksum, arcInfo.checksum, sha512::SHA_LEN);
+
+		// same as the Lua cache, unnamed archive-data is not stored
+		const ArchiveData& archData = arcInfo.archiveData;
+		if (!archData.GetName().empty()) {
+			for (const auto& ii: archData.GetInfo()) {
+				BinaryInfoItemRecord iiRec = {strings.Add(ii.first), std::uint32_t(ii.second.valueType), 0};
+
+				switch (ii.second.valueType) {
+					case INFO_VALUE_TYPE_STRING: {
+						iiRec.value = strings.Add(ii.second.valueTypeString);
+					} break;
+					case INFO_VALUE_TYPE_INTEGER: {
+						std::memcpy(&iiRec.value, &ii.second.value.typeInteger, sizeof(iiRec.value));
+					} break;
+					case INFO_VALUE_TYPE_FLOAT: {
+						std::memcpy(&iiRec.value, &ii.second.value.typeFloat, sizeof(iiRec.value));
+					} break;
+					case INFO_VALUE_TYPE_BOOL: {
+						iiRec.value = ii.second.value.typeBool;
+					} break;
+				}
+
+				infoItemRecs.push_back(iiRec);
+			}
+
+			std::vector<std::string> deps = archData.GetDependencies();
+			if (archData.IsMap()) {
+				FilterDep(deps, GetMapHelperContentName());
+			} else if (archData.IsGame()) {
+				FilterDep(deps, GetSpringBaseContentName());
+			}
+
+			for (const auto& dep: deps) {
+				dependencyRecs.push_back(strings.Add(dep));
+			}
+		}
+
+		rec.numInfoItems = infoItemRecs.size() - rec.firstInfoItem;
+		rec.numDependencies = dependencyRecs.size() - rec.firstDependency;
+
+		archiveRecs.push_back(rec);
+	}
+
+	for (const BrokenArchive& ba: brokenArchives) {
+		brokenRecs.push_back({strings.Add(ba.name), strings.Add(ba.path), strings.Add(ba.problem), ba.modified});
+	}
+
+	// guarantees a non-empty, NUL-terminated table
+	strings.Add("");
+
+	std::memcpy(header.magic, BINARY_CACHE_MAGIC, sizeof(header.magic));
+	header.internalVer = INTERNAL_VER;
+	header.numArchives = archiveRecs.size();
+	header.numBrokenArchives = brokenRecs.size();
+	header.numInfoItems = infoItemRecs.size();
+	header.numDependencies = dependencyRecs.size();
+	header.stringTableSize = strings.data.size();
+
+	FILE* out = fopen(filename.c_str(), "wb");
+	if (out == nullptr) {
+		LOG_L(L_ERROR, "[AS::%s] failed to write to \"%s\"!", __func__, filename.c_str());
+		return false;
+	}
+
+	bool ret = true;
+	ret &= WriteBinaryCacheSection(out, &header, 1);
+	ret &= WriteBinaryCacheSection(out, archiveRecs.data(), archiveRecs.size());
+	ret &= WriteBinaryCacheSection(out, brokenRecs.data(), brokenRecs.size());
+	ret &= WriteBinaryCacheSection(out, infoItemRecs.data(), infoItemRecs.size());
+	ret &= WriteBinaryCacheSection(out, dependencyRecs.data(), dependencyRecs.size());
+	ret &= WriteBinaryCacheSection(out, strings.data.data(), strings.data.size());
+	ret &= (fclose(out) != EOF);
+
+	if (!ret)
+		LOG_L(L_ERROR, "[AS::%s] failed to write to \"%s\"!", __func__, filename.c_str());
+
+	return ret;
+}
+
+bool CArchiveScanner::WriteLuaCacheData(const std::string& filename) const
+{
+	FILE* out = fopen(filename.c_str(), "wt");
+	if (out == nullptr) {
+		LOG_L(L_ERROR, "[AS::%s] failed to write to \"%s\"!", __func__, filename.c_str());
+		return false;
+	}
 
 	fprintf(out, "local archiveCache = {\n\n");
 	fprintf(out, "\tinternalver = %i,\n\n", INTERNAL_VER);
@@ -1219,10 +1604,12 @@ void CArchiveScanner::WriteCacheData(const std::string& filename)
 	fprintf(out, "}\n\n"); // close 'archiveCache'
 	fprintf(out, "return archiveCache\n");
 
-	if (fclose(out) == EOF)
+	if (fclose(out) == EOF) {
 		LOG_L(L_ERROR, "[AS::%s] failed to write to \"%s\"!", __func__, filename.c_str());
+		return false;
+	}
 
-	isDirty = false;
+	return true;
 }
 
 
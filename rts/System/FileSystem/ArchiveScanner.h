@@ -202,9 +202,15 @@ private:
 	std::string SearchMapFile(const IArchive* ar, std::string& error);
 
 
+	/// reads the binary cache, falls back to the Lua cache if it is missing or invalid
 	void ReadCacheData(const std::string& filename);
 	void WriteCacheData(const std::string& filename);
 
+	bool ReadBinaryCacheData(const std::string& filename);
+	bool ReadLuaCacheData(const std::string& filename);
+	bool WriteBinaryCacheData(const std::string& filename) const;
+	bool WriteLuaCacheData(const std::string& filename) const;
+
 	IFileFilter* CreateIgnoreFilter(IArchive* ar);
 
 	/**
@@ -244,6 +250,7 @@ private:
 	std::vector<BrokenArchive> brokenArchives;
 
 	std::string cachefile;
+	std::string luaCacheFile; // legacy format, read if the binary cache is unusable and written only if ArchiveCacheExportLua is set
 
 	bool isDirty = false;
 	bool isInScan = false;
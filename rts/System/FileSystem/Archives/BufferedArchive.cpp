@@ -66,3 +66,101 @@ bool CBufferedArchive::GetFile(unsigned int fid, std::vector<std::uint8_t>& buff
 	std::copy(fb.data.begin(), fb.data.end(), buffer.begin());
 	return true;
 }
+
+void CBufferedArchive::GetFiles(const std::vector<unsigned int>& fids, std::vector<std::vector<std::uint8_t>>& buffers, std::vector<bool>& results)
+{
+	buffers.resize(fids.size());
+	results.clear();
+	results.resize(fids.size(), false);
+
+	// indices into fids of the files that have to be read
+	std::vector<size_t> readIndices;
+	// subset of readIndices whose contents go into the cache
+	std::vector<size_t> cacheIndices;
+
+	const bool useCache = (globalConfig.vfsCacheArchiveFiles && !noCache);
+
+	{
+		std::scoped_lock lck(archiveLock);
+
+		if (useCache && fileCache.empty())
+			fileCache.resize(NumFiles());
+
+		for (size_t i = 0, n = fids.size(); i < n; i++) {
+			assert(IsFileId(fids[i]));
+
+			if (!useCache) {
+				readIndices.push_back(i);
+				continue;
+			}
+
+			// same policy as GetFile
+			FileBuffer& fb = fileCache.at(fids[i]);
+
+			if ((fb.numAccessed++) == 0) {
+				readIndices.push_back(i);
+				continue;
+			}
+			if (!fb.populated) {
+				readIndices.push_back(i);
+				cacheIndices.push_back(i);
+				continue;
+			}
+
+			if ((results[i] = fb.exists))
+				buffers[i].assign(fb.data.begin(), fb.data.end());
+		}
+	}
+
+	if (readIndices.empty())
+		return;
+
+	std::vector<unsigned int> readFids;
+	std::vector<std::vector<std::uint8_t>*> readBuffers;
+	std::vector<int> readResults(readIndices.size(), 0);
+
+	readFids.reserve(readIndices.size());
+	readBuffers.reserve(readIndices.size());
+
+	for (const size_t i: readIndices) {
+		readFids.push_back(fids[i]);
+		readBuffers.push_back(&buffers[i]);
+	}
+
+	GetFilesImpl(readFids, readBuffers, readResults);
+
+	for (size_t j = 0, n = readIndices.size(); j < n; j++) {
+		if (!(results[readIndices[j]] = (readResults[j] == 1)))
+			LOG_L(L_WARNING, "[BufferedArchive::%s(fid=%u)] name=%s ret=%d", __func__, readFids[j], archiveFile.c_str(), readResults[j]);
+	}
+
+	if (cacheIndices.empty())
+		return;
+
+	std::scoped_lock lck(archiveLock);
+
+	for (const size_t i: cacheIndices) {
+		FileBuffer& fb = fileCache.at(fids[i]);
+
+		// duplicate fids or a concurrent GetFile may have filled it already
+		if (fb.populated)
+			continue;
+
+		fb.exists = results[i];
+		fb.populated = true;
+
+		if (fb.exists)
+			fb.data.assign(buffers[i].begin(), buffers[i].end());
+
+		cacheSize += fb.data.size();
+		fileCount += fb.exists;
+	}
+}
+
+void CBufferedArchive::GetFilesImpl(const std::vector<unsigned int>& fids, std::vector<std::vector<std::uint8_t>*>& buffers, std::vector<int>& results)
+{
+	for (size_t i = 0, n = fids.size(); i < n; i++) {
+		std::scoped_lock lck(archiveLock);
+		results[i] = GetFileImpl(fids[i], *buffers[i]);
+	}
+}
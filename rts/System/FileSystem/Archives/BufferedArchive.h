@@ -22,9 +22,19 @@ public:
 	virtual int GetType() const override { return ARCHIVE_TYPE_BUF; }
 
 	bool GetFile(unsigned int fid, std::vector<std::uint8_t>& buffer) override;
+	/// serves cached files like GetFile, the others are read by GetFilesImpl
+	void GetFiles(const std::vector<unsigned int>& fids, std::vector<std::vector<std::uint8_t>>& buffers, std::vector<bool>& results) override;
 
 protected:
 	virtual int GetFileImpl(unsigned int fid, std::vector<std::uint8_t>& buffer) = 0;
+	/**
+	 * Reads the files of a GetFiles batch that were not cached, returning
+	 * GetFileImpl's result for each. Called without archiveLock held, which
+	 * the default implementation takes around each GetFileImpl; overrides
+	 * that read concurrently must only modify state shared with GetFileImpl
+	 * while holding it.
+	 */
+	virtual void GetFilesImpl(const std::vector<unsigned int>& fids, std::vector<std::vector<std::uint8_t>*>& buffers, std::vector<int>& results);
 
 	struct FileBuffer {
 		FileBuffer() = default;
@@ -39,3 +39,14 @@ bool IArchive::GetFile(const std::string& name, std::vector<std::uint8_t>& buffe
 	return true;
 }
 
+void IArchive::GetFiles(const std::vector<unsigned int>& fids, std::vector<std::vector<std::uint8_t>>& buffers, std::vector<bool>& results)
+{
+	buffers.resize(fids.size());
+	results.clear();
+	results.resize(fids.size(), false);
+
+	for (size_t i = 0, n = fids.size(); i < n; i++) {
+		results[i] = GetFile(fids[i], buffers[i]);
+	}
+}
+
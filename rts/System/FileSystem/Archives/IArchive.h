@@ -81,6 +81,17 @@ public:
 	 * @see GetFile(unsigned int fid, std::vector<std::uint8_t>& buffer)
 	 */
 	bool GetFile(const std::string& name, std::vector<std::uint8_t>& buffer);
+	/**
+	 * Fetches the contents of several files at once, archives which can
+	 * read files concurrently override this.
+	 * @param fids unique file IDs in [0, NumFiles())
+	 * @param buffers resized to fids.size(), buffers[i] receives the
+	 *   contents of fids[i]
+	 * @param results resized to fids.size(), results[i] is true if the
+	 *   contents of fids[i] have been successfully read into buffers[i]
+	 * @see GetFile(unsigned int fid, std::vector<std::uint8_t>& buffer)
+	 */
+	virtual void GetFiles(const std::vector<unsigned int>& fids, std::vector<std::vector<std::uint8_t>>& buffers, std::vector<bool>& results);
 
 	std::pair<std::string, int> FileInfo(unsigned int fid) const {
 		std::pair<std::string, int> info;
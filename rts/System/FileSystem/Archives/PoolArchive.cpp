@@ -4,6 +4,7 @@
 #include "PoolArchive.h"
 
 #include <algorithm>
+#include <atomic>
 #include <stdexcept>
 #include <sstream>
 #include <string>
@@ -16,6 +17,7 @@
 #include "System/Exceptions.h"
 #include "System/StringUtil.h"
 #include "System/Log/ILog.h"
+#include "System/Threading/ThreadPool.h"
 
 
 CPoolArchiveFactory::CPoolArchiveFactory(): IArchiveFactory("sdp")
@@ -109,6 +111,14 @@ CPoolArchive::~CPoolArchive()
 
 	LOG_L(L_INFO, "[%s] archiveFile=\"%s\" numZipFiles=%lu sumInflSize=%lukb sumReadTime=%lums", __func__, archiveFile.c_str(), numZipFiles, sumInflSize, sumReadTime);
 
+	if (numBatches > 0) {
+		const unsigned long numBatchCalls = numBatches;
+		const unsigned long numBatchFiles = numBatchedFiles;
+		const unsigned long sumBatchMsecs = sumBatchTime / (1000 * 1000);
+
+		LOG_L(L_INFO, "[%s] archiveFile=\"%s\" numBatches=%lu numBatchedFiles=%lu sumBatchTime=%lums", __func__, archiveFile.c_str(), numBatchCalls, numBatchFiles, sumBatchMsecs);
+	}
+
 	std::partial_sort(stats.begin(), stats.begin() + std::min(stats.size(), size_t(10)), stats.end());
 
 	// show top-10 worst access times
@@ -127,8 +137,20 @@ int CPoolArchive::GetFileImpl(unsigned int fid, std::vector<std::uint8_t>& buffe
 {
 	assert(IsFileId(fid));
 
-	FileData* f = &files[fid];
-	FileStat* s = &stats[fid];
+	std::array<uint8_t, sha512::SHA_LEN> shasum;
+	const int ret = ReadFile(fid, buffer, shasum, stats[fid].readTime);
+
+	if (ret == 1)
+		files[fid].shasum = shasum;
+
+	return ret;
+}
+
+int CPoolArchive::ReadFile(unsigned int fid, std::vector<std::uint8_t>& buffer, std::array<uint8_t, sha512::SHA_LEN>& shasum, uint64_t& readTime) const
+{
+	assert(IsFileId(fid));
+
+	const FileData* f = &files[fid];
 
 	constexpr const char table[] = "0123456789abcdef";
 	char c_hex[32];
@@ -186,7 +208,7 @@ int CPoolArchive::GetFileImpl(unsigned int fid, std::vector<std::uint8_t>& buffe
 		std::this_thread::sleep_for(std::chrono::microseconds(100));
 	}
 
-	s->readTime = (spring_now() - startTime).toNanoSecsi();
+	readTime = (spring_now() - startTime).toNanoSecsi();
 
 	if (bytesRead != buffer.size()) {
 		LOG_L(L_ERROR, "[PoolArchive::%s] failed to read file \"%s\" after %d tries", __func__, path.c_str(), readRetries);
@@ -197,6 +219,55 @@ int CPoolArchive::GetFileImpl(unsigned int fid, std::vector<std::uint8_t>& buffe
 		LOG_L(L_WARNING, "[PoolArchive::%s] could read file \"%s\" only after %d tries", __func__, path.c_str(), readTry);
 	}
 
-	sha512::calc_digest(buffer.data(), buffer.size(), f->shasum.data());
+	sha512::calc_digest(buffer.data(), buffer.size(), shasum.data());
 	return 1;
 }
+
+void CPoolArchive::GetFilesImpl(const std::vector<unsigned int>& fids, std::vector<std::vector<std::uint8_t>*>& buffers, std::vector<int>& results)
+{
+	std::vector<std::array<uint8_t, sha512::SHA_LEN>> shasums(fids.size());
+	std::vector<uint64_t> readTimes(fids.size(), 0);
+	std::atomic<size_t> nextIndex = {0};
+
+	// every pool entry is a separate .gz file and ReadFile only reads the
+	// immutable name and size of each, so the reads need no archiveLock;
+	// the hashes and read-times are stored under it once all are done
+	const auto ReadFiles = [&]() {
+		for (size_t i = nextIndex.fetch_add(1); i < fids.size(); i = nextIndex.fetch_add(1)) {
+			results[i] = ReadFile(fids[i], *buffers[i], shasums[i], readTimes[i]);
+		}
+	};
+
+	const spring_time startTime = spring_now();
+
+#if !defined(DEDICATED) && !defined(UNITSYNC)
+	std::vector<std::shared_ptr<std::future<void>>> tasks;
+	tasks.reserve(ThreadPool::GetNumThreads());
+
+	for (size_t i = 1, n = std::min(size_t(ThreadPool::GetNumThreads()), fids.size()); i < n; i++) {
+		tasks.emplace_back(ThreadPool::Enqueue(ReadFiles));
+	}
+
+	// the calling thread takes part, s.t. the batch completes even if all workers are busy
+	ReadFiles();
+
+	for (const auto& task: tasks) {
+		task->wait();
+	}
+#else
+	ReadFiles();
+#endif
+
+	std::scoped_lock lck(archiveLock);
+
+	for (size_t i = 0, n = fids.size(); i < n; i++) {
+		stats[fids[i]].readTime = readTimes[i];
+
+		if (results[i] == 1)
+			files[fids[i]].shasum = shasums[i];
+	}
+
+	numBatches += 1;
+	numBatchedFiles += fids.size();
+	sumBatchTime += (spring_now() - startTime).toNanoSecsi();
+}
@@ -103,6 +103,11 @@ public:
 
 protected:
 	int GetFileImpl(unsigned int fid, std::vector<std::uint8_t>& buffer) override;
+	// opens and inflates the pool entries on the thread-pool
+	void GetFilesImpl(const std::vector<unsigned int>& fids, std::vector<std::vector<std::uint8_t>*>& buffers, std::vector<int>& results) override;
+
+	// GetFileImpl without storing the hash and read-time, safe to call concurrently
+	int ReadFile(unsigned int fid, std::vector<std::uint8_t>& buffer, std::array<uint8_t, sha512::SHA_LEN>& shasum, uint64_t& readTime) const;
 
 	std::pair<uint64_t, uint64_t> GetSums() const {
 		std::pair<uint64_t, uint64_t> p;
@@ -139,6 +144,12 @@ private:
 
 	std::vector<FileData> files;
 	std::vector<FileStat> stats;
+
+	// GetFiles metrics; wall-clock time versus the summed readTime's
+	// of the batched files shows what the concurrent reads saved
+	uint64_t numBatches = 0;
+	uint64_t numBatchedFiles = 0;
+	uint64_t sumBatchTime = 0;
 };
 
 #endif // _POOL_ARCHIVE_H
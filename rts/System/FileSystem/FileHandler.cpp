@@ -311,6 +311,18 @@ std::string CFileHandler::GetArchiveContainingFile(const std::string& filePath,
 	return "";
 }
 
+size_t CFileHandler::PrefetchFiles(const std::vector<std::string>& filePaths, const std::string& modes)
+{
+#ifndef TOOLS
+	if (vfsHandler == nullptr)
+		return 0;
+
+	return (vfsHandler->PrefetchFiles(filePaths, modes));
+#else
+	return 0;
+#endif
+}
+
 /******************************************************************************/
 
 std::vector<string> CFileHandler::FindFiles(const string& path, const string& pattern)
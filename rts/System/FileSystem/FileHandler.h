@@ -48,6 +48,8 @@ public:
 	std::string GetFileExt() const;
 	static std::string GetFileAbsolutePath(const std::string& filePath, const std::string& modes);
 	static std::string GetArchiveContainingFile(const std::string& filePath, const std::string& modes);
+	// reads files ahead of their Open, see CVFSHandler::PrefetchFiles
+	static size_t PrefetchFiles(const std::vector<std::string>& filePaths, const std::string& modes);
 
 	std::vector<std::uint8_t>& GetBuffer() { return fileBuffer; }
 
@@ -230,6 +230,8 @@ bool CVFSHandler::RemoveArchive(const std::string& archiveName)
 	if (!removeAllowed)
 		return false;
 
+	prefetchedFiles.clear();
+
 	const CArchiveScanner::ArchiveData& archiveData = archiveScanner->GetArchiveData(archiveName);
 	const std::string& archivePath = GetArchivePath(archiveName);
 	const Section section = GetModTypeSection(archiveData.GetModType());
@@ -309,6 +311,8 @@ void CVFSHandler::DeleteArchives(Section section)
 
 	archives[section].clear();
 	files[section].clear();
+
+	prefetchedFiles.clear();
 }
 
 void CVFSHandler::ReserveArchives()
@@ -454,10 +458,111 @@ int CVFSHandler::LoadFile(const std::string& filePath, std::vector<std::uint8_t>
 	if (fileData.ar == nullptr)
 		return -1;
 
+	{
+		std::lock_guard<decltype(vfsMutex)> lck(vfsMutex);
+
+		const auto iter = prefetchedFiles.find(normalizedPath);
+
+		if (iter != prefetchedFiles.end() && iter->second.ready && iter->second.ar == fileData.ar && iter->second.section == section) {
+			const int ret = iter->second.loaded;
+
+			buffer = std::move(iter->second.data);
+			prefetchedFiles.erase(iter);
+			return ret;
+		}
+	}
+
 	// 0 or 1
 	return (fileData.ar->GetFile(normalizedPath, buffer));
 }
 
+size_t CVFSHandler::PrefetchFiles(const std::vector<std::string>& filePaths, const std::string& modes)
+{
+	struct ArchiveBatch {
+		IArchive* ar;
+
+		std::vector<unsigned int> fids;
+		std::vector<std::string> paths;
+	};
+
+	std::vector<ArchiveBatch> batches;
+	std::vector<std::vector<std::uint8_t>> buffers;
+	std::vector<bool> results;
+
+	size_t numBytes = 0;
+	size_t numFiles = 0;
+
+	{
+		std::lock_guard<decltype(vfsMutex)> lck(vfsMutex);
+
+		prefetchedFiles.clear();
+
+		for (const std::string& filePath: filePaths) {
+			std::string normalizedPath = GetNormalizedPath(filePath);
+
+			FileData fileData = {nullptr, 0};
+			Section section = Section::Error;
+
+			// same search order as CFileHandler::Open
+			for (const char mode: modes) {
+				if ((section = GetModeSection(mode)) == Section::Error)
+					break;
+				if ((fileData = GetFileData(normalizedPath, section)).ar != nullptr)
+					break;
+			}
+
+			if (fileData.ar == nullptr)
+				continue;
+
+			const unsigned int fid = fileData.ar->FindFile(normalizedPath);
+
+			if (!fileData.ar->IsFileId(fid))
+				continue;
+			if ((numBytes + fileData.size) > MAX_PREFETCH_BYTES)
+				break;
+
+			// duplicates would be read concurrently
+			if (!prefetchedFiles.emplace(normalizedPath, PrefetchedFile{fileData.ar, section, false, false, {}}).second)
+				continue;
+
+			const auto pred = [&](const ArchiveBatch& b) { return (b.ar == fileData.ar); };
+			const auto iter = std::find_if(batches.begin(), batches.end(), pred);
+
+			ArchiveBatch& batch = (iter != batches.end())? *iter: batches.emplace_back(ArchiveBatch{fileData.ar, {}, {}});
+
+			batch.fids.push_back(fid);
+			batch.paths.emplace_back(std::move(normalizedPath));
+
+			numBytes += fileData.size;
+		}
+	}
+
+	// like LoadFile, the archives are read without holding the VFS lock
+	for (const ArchiveBatch& batch: batches) {
+		batch.ar->GetFiles(batch.fids, buffers, results);
+
+		std::lock_guard<decltype(vfsMutex)> lck(vfsMutex);
+
+		for (size_t i = 0, n = batch.fids.size(); i < n; i++) {
+			const auto iter = prefetchedFiles.find(batch.paths[i]);
+
+			// cleared by a concurrent prefetch or a removed archive
+			if (iter == prefetchedFiles.end() || iter->second.ar != batch.ar)
+				continue;
+
+			iter->second.data = std::move(buffers[i]);
+			iter->second.ready = true;
+			iter->second.loaded = results[i];
+
+			numFiles += 1;
+		}
+	}
+
+	LOG_L(L_DEBUG, "[%s::%s<this=%p>(#filePaths=" _STPF_ ", modes=\"%s\")] #files=" _STPF_ " #bytes=" _STPF_ " #archives=" _STPF_, vfsName, __func__, this, filePaths.size(), modes.c_str(), numFiles, numBytes, batches.size());
+
+	return numFiles;
+}
+
 int CVFSHandler::FileExists(const std::string& filePath, Section section)
 {
 	LOG_L(L_DEBUG, "[%s::%s<this=%p>(filePath=\"%s\", section=%d)]", vfsName, __func__, this, filePath.c_str(), section);
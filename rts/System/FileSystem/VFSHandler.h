@@ -104,6 +104,18 @@ public:
 	 */
 	int LoadFile(const std::string& filePath, std::vector<std::uint8_t>& buffer, Section section);
 
+	/**
+	 * Reads the contents of several files ahead of LoadFile, archives that
+	 * support it (see IArchive::GetFiles) do so concurrently. Each file is
+	 * taken from the first VFS section in modes that contains it; at most
+	 * MAX_PREFETCH_BYTES are read ahead and files not loaded before the
+	 * next call are dropped.
+	 * @param filePaths raw file paths, case-insensitive
+	 * @param modes see CFileHandler, non-VFS modes end the search for a file
+	 * @return the number of files that were read ahead
+	 */
+	size_t PrefetchFiles(const std::vector<std::string>& filePaths, const std::string& modes);
+
 
 	/**
 	 * Returns all the files in the given (virtual) directory without the
@@ -165,6 +177,17 @@ private:
 	};
 	typedef std::pair<std::string, FileData> FileEntry;
 
+	struct PrefetchedFile {
+		IArchive* ar;
+		Section section;
+		bool ready; // false while the archive is still being read
+		bool loaded;
+
+		std::vector<std::uint8_t> data;
+	};
+
+	static constexpr size_t MAX_PREFETCH_BYTES = 64 * 1024 * 1024;
+
 	std::string GetNormalizedPath(const std::string& rawPath);
 	FileData GetFileData(const std::string& normalizedFilePath, Section section) const;
 
@@ -172,6 +195,9 @@ private:
 	std::array<std::vector<FileEntry>, Section::Count> files;
 	std::array<spring::unordered_map<std::string, IArchive*>, Section::Count> archives;
 
+	// normalized path -> contents, consumed by LoadFile
+	spring::unordered_map<std::string, PrefetchedFile> prefetchedFiles;
+
 	const char* vfsName = "";
 
 	bool insertAllowed = true;
@@ -1,11 +1,12 @@
 /* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
 
+#include <algorithm>
 #include <sstream>
-#include <zlib.h>
 
 #include "ExternalAI/SkirmishAIHandler.h"
 #include "ExternalAI/EngineOutHandler.h"
 #include "CregLoadSaveHandler.h"
+#include "SaveGameStream.h"
 #include "Map/ReadMap.h"
 #include "Game/Game.h"
 #include "Game/GameSetup.h"
@@ -48,7 +49,9 @@
 #include "System/creg/SerializeLuaState.h"
 #include "System/creg/Serializer.h"
 #include "System/Exceptions.h"
+#include "System/MainDefines.h"
 #include "System/Log/ILog.h"
+#include "System/Misc/SpringTime.h"
 
 #define MAX_STRING_SIZE (1 << 19) // 512kB excluding null-term
 
@@ -224,7 +227,7 @@ static void ReadString(std::istream& s, std::string& str)
 }
 
 
-static void SaveLuaState(CSplitLuaHandle* handle, creg::COutputStreamSerializer& os, std::stringstream& oss)
+static void SaveLuaState(CSplitLuaHandle* handle, creg::COutputStreamSerializer& os, std::ostream& oss)
 {
 	CLuaStateCollector lsc;
 	lsc.Read(handle);
@@ -232,7 +235,7 @@ static void SaveLuaState(CSplitLuaHandle* handle, creg::COutputStreamSerializer&
 }
 
 
-static void LoadLuaState(CSplitLuaHandle* handle, creg::CInputStreamSerializer& is, std::stringstream& iss)
+static void LoadLuaState(CSplitLuaHandle* handle, creg::CInputStreamSerializer& is, std::istream& iss)
 {
 	void* plsc;
 	creg::Class* plsccls = nullptr;
@@ -250,76 +253,90 @@ static void LoadLuaState(CSplitLuaHandle* handle, creg::CInputStreamSerializer&
 }
 
 
-void CCregLoadSaveHandler::SaveGame(const std::string& path)
+void CCregLoadSaveHandler::WriteState(std::ostream& oss)
 {
 #ifdef USING_CREG
-	LOG("[LSH::%s] saving game to \"%s\"", __func__, path.c_str());
+	// write our own header. SavePackage() will add its own
+	WriteString(oss, SpringVersion::GetSync());
+	WriteString(oss, gameSetup->setupText);
+	WriteString(oss, modName);
+	WriteString(oss, mapName);
 
-	// NB: Selection leaves CObject reference as Unit's listener,
-	//     But isn't serialized - leak on load.
-	selectedUnitsHandler.ClearSelected();
 
-	try {
-		std::stringstream oss;
+	{
+		Sim::SaveComponents(oss);
 
-		// write our own header. SavePackage() will add its own
-		WriteString(oss, SpringVersion::GetSync());
-		WriteString(oss, gameSetup->setupText);
-		WriteString(oss, modName);
-		WriteString(oss, mapName);
+		creg::COutputStreamSerializer os;
 
+		// save lua state first as lua unit scripts depend on it
+		const int luaStart = oss.tellp();
+		SaveLuaState(luaGaia, os, oss);
+		SaveLuaState(luaRules, os, oss);
+		PrintSize("Lua", ((int)oss.tellp()) - luaStart);
 
-		{
-			Sim::SaveComponents(oss);
+		// save creg state
+		const int gameStart = oss.tellp();
+		CGameStateCollector gsc;
+		os.SavePackage(&oss, &gsc, gsc.GetClass());
+		PrintSize("Game", ((int)oss.tellp()) - gameStart);
 
-			creg::COutputStreamSerializer os;
 
-			// save lua state first as lua unit scripts depend on it
-			const int luaStart = oss.tellp();
-			SaveLuaState(luaGaia, os, oss);
-			SaveLuaState(luaRules, os, oss);
-			PrintSize("Lua", ((int)oss.tellp()) - luaStart);
+		// save AI state
+		const int aiStart = oss.tellp();
 
-			// save creg state
-			const int gameStart = oss.tellp();
-			CGameStateCollector gsc;
-			os.SavePackage(&oss, &gsc, gsc.GetClass());
-			PrintSize("Game", ((int)oss.tellp()) - gameStart);
+		for (const auto& ai: skirmishAIHandler.GetAllSkirmishAIs()) {
+			std::stringstream aiData;
+			eoh->Save(&aiData, ai.first);
 
+			std::uint64_t aiSize = aiData.tellp();
+			creg::WriteUInt(&oss, aiSize);
+			if (aiSize > 0)
+				oss << aiData.rdbuf();
+		}
+		PrintSize("AIs", ((int)oss.tellp()) - aiStart);
+	}
+#endif //USING_CREG
+}
 
-			// save AI state
-			const int aiStart = oss.tellp();
 
-			for (const auto& ai: skirmishAIHandler.GetAllSkirmishAIs()) {
-				std::stringstream aiData;
-				eoh->Save(&aiData, ai.first);
+void CCregLoadSaveHandler::SaveGame(const std::string& path)
+{
+#ifdef USING_CREG
+	LOG("[LSH::%s] saving game to \"%s\"", __func__, path.c_str());
 
-				std::uint64_t aiSize = aiData.tellp();
-				creg::WriteUInt(&oss, aiSize);
-				if (aiSize > 0)
-					oss << aiData.rdbuf();
-			}
-			PrintSize("AIs", ((int)oss.tellp()) - aiStart);
-		}
+	// NB: Selection leaves CObject reference as Unit's listener,
+	//     But isn't serialized - leak on load.
+	selectedUnitsHandler.ClearSelected();
 
-		{
-			gzFile file = gzopen(dataDirsAccess.LocateFile(path, FileQueryFlags::WRITE).c_str(), "wb5");
+	// compresses while serializing, the file is removed if that throws
+	std::shared_ptr<CSaveGameStreamWriter> saveStream = std::make_shared<CSaveGameStreamWriter>(
+		dataDirsAccess.LocateFile(path, FileQueryFlags::WRITE),
+		SAVEFILE_BLOCK_SIZE,
+		SAVEFILE_COMPRESSION_LEVEL,
+		std::max(2, ThreadPool::GetNumThreads() * 2)
+	);
+
+	if (!saveStream->IsOpen()) {
+		LOG_L(L_ERROR, "[LSH::%s] could not open save-file", __func__);
+		return;
+	}
+
+	try {
+		const spring_time startTime = spring_gettime();
+
+		std::ostream oss(saveStream.get());
 
-			if (file == nullptr) {
-				LOG_L(L_ERROR, "[LSH::%s] could not open save-file", __func__);
-				return;
-			}
+		WriteState(oss);
 
-			std::string data = oss.str();
-			std::function<void(gzFile, std::string&&)> func = [](gzFile file, std::string&& data) {
-				gzwrite(file, data.c_str(), data.size());
-				gzflush(file, Z_FINISH);
-				gzclose(file);
-			};
+		if (!oss)
+			throw std::runtime_error("failed to write save stream");
 
-			// gzFile is just a plain typedef (struct gzFile_s {}* gzFile), can be copied
+		LOG("[LSH::%s] serialized in %.1fms (%.1fms waiting for compression)", __func__, (spring_gettime() - startTime).toMilliSecsf(), saveStream->GetStallTime());
+
+		{
+			// the last blocks are compressed and the index is written off the main thread
 			// need to keep a reference to the future around or its destructor will block
-			ThreadPool::AddExtJob(std::move(std::async(std::launch::async, std::move(func), file, std::move(data))));
+			ThreadPool::AddExtJob(std::move(std::async(std::launch::async, [saveStream]() { saveStream->Finish(); })));
 		}
 
 		//FIXME add lua state
@@ -342,16 +359,30 @@ void CCregLoadSaveHandler::SaveGame(const std::string& path)
 /// loads the data (map&mod-name,setup-script) needed by PreGame
 bool CCregLoadSaveHandler::LoadGameStartInfo(const std::string& path)
 {
-	CGZFileHandler saveFile(dataDirsAccess.LocateFile(FindSaveFile(path)), SPRING_VFS_RAW_FIRST);
+	const std::string saveFilePath = dataDirsAccess.LocateFile(FindSaveFile(path));
 
-	std::stringbuf* sbuf = iss.rdbuf();
+	std::unique_ptr<CSaveGameStreamReader> saveStream = std::make_unique<CSaveGameStreamReader>(saveFilePath, ThreadPool::GetNumThreads());
 	std::string saveVersion;
 	std::string syncVersion = SpringVersion::GetSync();
 
-	char buf[4096];
-	int len;
-	while ((len = saveFile.Read(buf, sizeof(buf))) > 0)
-		sbuf->sputn(buf, len);
+	if (saveStream->IsOpen()) {
+		LOG("[LSH::%s] streaming " _STPF_ " blocks (%.1fMB) from \"%s\"", __func__, saveStream->GetNumBlocks(), saveStream->GetStreamSize() / (1024.0f * 1024.0f), path.c_str());
+		issBuffer = std::move(saveStream);
+	} else {
+		// saves written before blocks were compressed separately are a single gzip stream
+		CGZFileHandler saveFile(saveFilePath, SPRING_VFS_RAW_FIRST);
+
+		std::unique_ptr<std::stringbuf> sbuf = std::make_unique<std::stringbuf>();
+
+		char buf[4096];
+		int len;
+		while ((len = saveFile.Read(buf, sizeof(buf))) > 0)
+			sbuf->sputn(buf, len);
+
+		issBuffer = std::move(sbuf);
+	}
+
+	iss.rdbuf(issBuffer.get());
 
 	ReadString(iss, saveVersion);
 
@@ -422,7 +453,8 @@ void CCregLoadSaveHandler::LoadAIData()
 	}
 
 	// cleanup
-	iss.str("");
+	iss.rdbuf(nullptr);
+	issBuffer.reset();
 
 	gs->paused = false;
 	if (gameServer != nullptr) {
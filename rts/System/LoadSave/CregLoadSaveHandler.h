@@ -3,8 +3,11 @@
 #ifndef CREG_LOAD_SAVE_HANDLER_H
 #define CREG_LOAD_SAVE_HANDLER_H
 
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <streambuf>
 #include <string>
-#include <sstream>
 #include "LoadSaveHandler.h"
 
 class CCregLoadSaveHandler : public ILoadSaveHandler
@@ -18,8 +21,13 @@ public:
 	void LoadAIData() override;
 	void SaveGame(const std::string& path) override;
 
+	/// serializes the synced game state as SaveGame does, throws on errors
+	void WriteState(std::ostream& oss);
+
 protected:
-	std::stringstream iss;
+	// a CSaveGameStreamReader, or the whole decompressed file for older saves
+	std::unique_ptr<std::streambuf> issBuffer;
+	std::istream iss{nullptr};
 };
 
 #endif // CREG_LOAD_SAVE_HANDLER_H
@@ -15,6 +15,7 @@ CONFIG(bool, DisableDemoVersionCheck).defaultValue(false).description("Allow to
 #include "System/Log/ILog.h"
 #include "System/Net/RawPacket.h"
 
+#include <algorithm>
 #include <array>
 #include <climits>
 #include <stdexcept>
@@ -100,6 +101,8 @@ CDemoReader::CDemoReader(const std::string& filename, float curTime): playbackDe
 		bytesRemaining = playbackDemoSize - curPos;
 	}
 	playbackDemo->Seek(curPos);
+
+	LoadKeyFrameIndex();
 }
 
 
@@ -147,6 +150,35 @@ netcode::RawPacket* CDemoReader::GetData(const float readTime)
 	return nullptr;
 }
 
+int CDemoReader::SeekToKeyFrame(int targetFrameNum)
+{
+	const auto pred = [](int frameNum, const DemoKeyFrame& keyFrame) { return (frameNum < keyFrame.frameNum); };
+	const auto iter = std::upper_bound(keyFrames.begin(), keyFrames.end(), targetFrameNum, pred);
+
+	if (iter == keyFrames.begin())
+		return -1;
+
+	const DemoKeyFrame& keyFrame = *(iter - 1);
+	const int streamEnd = fileHeader.headerSize + fileHeader.scriptSize + fileHeader.demoStreamSize;
+
+	DemoStreamChunkHeader keyChunkHeader;
+
+	playbackDemo->Seek(keyFrame.fileOffset);
+
+	if (playbackDemo->Read((char*)&keyChunkHeader, sizeof(keyChunkHeader)) < sizeof(keyChunkHeader)) {
+		bytesRemaining = 0;
+		return -1;
+	}
+
+	chunkHeader = keyChunkHeader;
+	chunkHeader.swab();
+
+	// same accounting as after reading the first chunk header in the ctor
+	nextDemoReadTime = chunkHeader.modGameTime + demoTimeOffset;
+	bytesRemaining = streamEnd - keyFrame.fileOffset;
+	return keyFrame.frameNum;
+}
+
 bool CDemoReader::ReachedEnd()
 {
 	return (bytesRemaining <= 0 || playbackDemo->Eof() || (playbackDemo->GetPos() > playbackDemoSize));
@@ -200,3 +232,50 @@ void CDemoReader::LoadStats()
 
 	playbackDemo->Seek(curPos);
 }
+
+
+void CDemoReader::LoadKeyFrameIndex()
+{
+	// the index is only written when the demo was closed cleanly
+	if (fileHeader.demoStreamSize == 0)
+		return;
+
+	const int curPos = playbackDemo->GetPos();
+	const int streamBeg = fileHeader.headerSize + fileHeader.scriptSize;
+	const int streamEnd = streamBeg + fileHeader.demoStreamSize;
+	const int indexPos = streamEnd + fileHeader.winningAllyTeamsSize + fileHeader.playerStatSize + fileHeader.teamStatSize;
+
+	DemoKeyFrameIndexHeader indexHeader;
+
+	playbackDemo->Seek(indexPos);
+
+	if (playbackDemo->Read((char*)&indexHeader, sizeof(indexHeader)) == sizeof(indexHeader) && memcmp(indexHeader.magic, DEMOFILE_KEYFRAME_INDEX_MAGIC, sizeof(indexHeader.magic)) == 0) {
+		indexHeader.swab();
+
+		const int indexSize = (playbackDemoSize - indexPos - int(sizeof(indexHeader))) / int(sizeof(DemoKeyFrame));
+
+		if (indexHeader.numKeyFrames > 0 && indexHeader.numKeyFrames <= indexSize) {
+			keyFrames.resize(indexHeader.numKeyFrames);
+			playbackDemo->Read((char*)keyFrames.data(), keyFrames.size() * sizeof(DemoKeyFrame));
+
+			for (DemoKeyFrame& keyFrame: keyFrames) {
+				keyFrame.swab();
+			}
+
+			// discard the whole index if any entry points outside the stream or is out of order
+			const auto pred = [&](const DemoKeyFrame& keyFrame) {
+				const int prevFrameNum = (&keyFrame == &keyFrames[0])? -1: (&keyFrame)[-1].frameNum;
+				return (keyFrame.frameNum <= prevFrameNum || keyFrame.fileOffset < streamBeg || keyFrame.fileOffset > (streamEnd - int(sizeof(DemoStreamChunkHeader))));
+			};
+
+			if (std::find_if(keyFrames.begin(), keyFrames.end(), pred) == keyFrames.end()) {
+				keyFrameInterval = indexHeader.keyFrameInterval;
+			} else {
+				LOG_L(L_WARNING, "[DemoReader::%s] ignoring malformed keyframe index", __func__);
+				keyFrames.clear();
+			}
+		}
+	}
+
+	playbackDemo->Seek(curPos);
+}
@@ -55,6 +55,19 @@ public:
 	/// Not needed for normal demo watching
 	void LoadStats();
 
+	/**
+	@brief Continue reading at the last indexed frame not after targetFrameNum
+	@return The frame started by the next packet read (so frame counters must
+	continue from one less), or -1 if the demo has no keyframe up to targetFrameNum
+	*/
+	int SeekToKeyFrame(int targetFrameNum);
+
+	const std::vector<DemoKeyFrame>& GetKeyFrames() const { return keyFrames; }
+	int GetKeyFrameInterval() const { return keyFrameInterval; }
+
+private:
+	void LoadKeyFrameIndex();
+
 private:
 	CFileHandler* playbackDemo;
 
@@ -70,6 +83,9 @@ private:
 	std::vector<PlayerStatistics> playerStats; // one stat per player
 	std::vector< std::vector<TeamStatistics> > teamStats; // many stats per team
 	std::vector<unsigned char> winningAllyTeams;
+
+	std::vector<DemoKeyFrame> keyFrames; // empty if the demo has no index
+	int keyFrameInterval = 0;
 };
 
 #endif
@@ -8,7 +8,10 @@
 #include "DemoRecorder.h"
 #include "base64.h"
 #include "Game/GameVersion.h"
+#include "Net/Protocol/BaseNetProtocol.h"
+#include "Sim/Misc/GlobalConstants.h"
 #include "Sim/Misc/TeamStatistics.h"
+#include "System/Config/ConfigHandler.h"
 #include "System/TimeUtil.h"
 #include "System/StringUtil.h"
 #include "System/FileSystem/DataDirsAccess.h"
@@ -27,42 +30,47 @@
 #endif
 
 
-// server and client memory-streams
-static std::string demoStreams[2];
-static spring::mutex demoMutex;
+CONFIG(int, DemoKeyFrameInterval)
+	.defaultValue(GAME_SPEED * 60)
+	.minimumValue(0)
+	.description("Number of frames between the entries of the keyframe index appended to recorded demos, 0 disables the index.");
+
+CONFIG(int, DemoCompressionLevel)
+	.defaultValue(9)
+	.minimumValue(0)
+	.maximumValue(9)
+	.description("zlib compression level of recorded demos, lower levels take less time on the background writer thread.");
+
+CONFIG(int, DemoWriterBufferSize)
+	.defaultValue(4096)
+	.minimumValue(64)
+	.description("Size in KB of the buffer between demo recording and the background writer thread, recording waits while it is full.");
 
 
 CDemoRecorder::CDemoRecorder(const std::string& mapName, const std::string& modName, bool serverDemo): isServerDemo(serverDemo)
 {
-	std::lock_guard<spring::mutex> lock(demoMutex);
+	keyFrameInterval = configHandler->GetInt("DemoKeyFrameInterval");
 
-	SetStream();
 	SetName(mapName, modName);
 	SetFileHeader();
-	WriteFileHeader(false);
 
-	file = gzopen(demoName.c_str(), "wb9");
+	if (demoName.empty())
+		return;
+
+	writer = std::make_shared<CDemoStreamWriter>(demoName, sizeof(DemoFileHeader), configHandler->GetInt("DemoWriterBufferSize") * 1024, configHandler->GetInt("DemoCompressionLevel"));
+	// NOTE: runs until WriteDemoFile, can not be a ThreadPool task
+	writerJob = std::async(std::launch::async, [w = writer]() { w->Run(); });
 }
 
 CDemoRecorder::~CDemoRecorder()
 {
-	if (file == nullptr)
+	if (writer == nullptr)
 		return;
 
-	WriteWinnerList();
-	WritePlayerStats();
-	WriteTeamStats();
-	WriteFileHeader(true);
 	WriteDemoFile();
 }
 
 
-void CDemoRecorder::SetStream()
-{
-	demoStreams[isServerDemo].clear();
-	demoStreams[isServerDemo].reserve(8 * 1024 * 1024);
-}
-
 void CDemoRecorder::SetFileHeader()
 {
 	memset(&fileHeader, 0, sizeof(DemoFileHeader));
@@ -79,29 +87,28 @@ void CDemoRecorder::SetFileHeader()
 
 void CDemoRecorder::WriteDemoFile()
 {
-	// zlib FAQ claims the lib is thread-safe, "however any library routines that zlib uses and
-	// any application-provided memory allocation routines must also be thread-safe. zlib's gz*
-	// functions use stdio library routines, and most of zlib's functions use the library memory
-	// allocation routines by default" (so code below should be OK)
-	// gz* should usually be finished before ctor runs again when reloading, but take no chances
-	std::string& data = demoStreams[isServerDemo];
-	std::function<void(gzFile, std::string&)> func = [](gzFile file, std::string& data) {
-		std::lock_guard<spring::mutex> lock(demoMutex);
-
-		gzwrite(file, data.c_str(), data.size());
-		gzflush(file, Z_FINISH);
-		gzclose(file);
-	};
-
-	LOG("[DemoRecorder::%s] writing %s-demo \"%s\" (" _STPF_ " bytes)", __func__, (isServerDemo? "server": "client"), demoName.c_str(), data.size());
-
-	#ifndef _WIN32
-	// NOTE: can not use ThreadPool for this directly here, workers are already gone
-	// FIXME: does not currently (august 2017) compile on Windows mingw buildbots
-	ThreadPool::AddExtJob(spring::thread(std::move(func), file, std::ref(data)));
-	#else
-	ThreadPool::AddExtJob(std::move(std::async(std::launch::async, std::move(func), file, std::ref(data))));
-	#endif
+	std::string fileHead;
+	std::string fileTail;
+
+	// the sizes of these sections are stored in the header, write them first
+	WriteWinnerList(fileTail);
+	WritePlayerStats(fileTail);
+	WriteTeamStats(fileTail);
+	WriteFileHeader(fileHead);
+
+	LOG(
+		"[DemoRecorder::%s] writing %s-demo \"%s\" (" _STPF_ " bytes)",
+		__func__, (isServerDemo? "server": "client"), demoName.c_str(), fileHead.size() + writer->GetNumStreamBytes() + fileTail.size()
+	);
+
+	// the header replaces its placeholder, the script and stream are already with the writer
+	writer->Finish(std::move(fileHead), std::move(fileTail), keyFrameInterval);
+
+	// the writer only has to compress what it has not caught up with yet
+	// NOTE: workers are gone when this runs on reload, ext-jobs are waited for
+	ThreadPool::AddExtJob(std::move(writerJob));
+
+	writer.reset();
 }
 
 void CDemoRecorder::WriteSetupText(const std::string& text)
@@ -119,19 +126,36 @@ void CDemoRecorder::WriteSetupText(const std::string& text)
 		throw std::runtime_error("Invalid game setup text");
 	}
 
+	// always written right after construction, i.e. directly behind the header
+	assert(writer == nullptr || writer->GetNumStreamBytes() == 0);
+
 	fileHeader.scriptSize = length;
-	demoStreams[isServerDemo].append(text.c_str(), length);
+
+	if (writer != nullptr)
+		writer->Write(text.c_str(), length);
 }
 
 void CDemoRecorder::SaveToDemo(const unsigned char* buf, const unsigned length, const float modGameTime)
 {
+	if (writer == nullptr)
+		return;
+
 	DemoStreamChunkHeader chunkHeader;
 
+	// index the chunk of every keyFrameInterval'th frame by its offset
+	if (length > 0 && (buf[0] == NETMSG_NEWFRAME || buf[0] == NETMSG_KEYFRAME)) {
+		const int frameNum = numFrames++;
+
+		if (keyFrameInterval > 0 && (frameNum % keyFrameInterval) == 0) {
+			writer->AddKeyFrame({frameNum, modGameTime, fileHeader.headerSize + fileHeader.scriptSize + fileHeader.demoStreamSize, 0});
+		}
+	}
+
 	chunkHeader.modGameTime = modGameTime;
 	chunkHeader.length = length;
 	chunkHeader.swab();
-	demoStreams[isServerDemo].append(reinterpret_cast<const char*>(&chunkHeader), sizeof(chunkHeader));
-	demoStreams[isServerDemo].append(reinterpret_cast<const char*>(buf), length);
+	writer->Write(&chunkHeader, sizeof(chunkHeader));
+	writer->Write(buf, length);
 	fileHeader.demoStreamSize += (length + sizeof(chunkHeader));
 }
 
@@ -173,7 +197,6 @@ void CDemoRecorder::SetName(const std::string& mapName, const std::string& modNa
 void CDemoRecorder::SetGameID(const unsigned char* buf)
 {
 	memcpy(&fileHeader.gameID, buf, sizeof(fileHeader.gameID));
-	WriteFileHeader(false);
 }
 
 void CDemoRecorder::SetTime(int gameTime, int wallclockTime)
@@ -229,85 +252,74 @@ void CDemoRecorder::SetWinningAllyTeams(const std::vector<unsigned char>& winnin
 }
 
 /** @brief Write DemoFileHeader
-Write the DemoFileHeader at the start of the file and restores the original
-position in the file afterwards. */
-unsigned int CDemoRecorder::WriteFileHeader(bool updateStreamLength)
+Append the (final) DemoFileHeader to <data>, which goes at the start of the file. */
+void CDemoRecorder::WriteFileHeader(std::string& data) const
 {
 	DemoFileHeader tmpHeader;
 	memcpy(&tmpHeader, &fileHeader, sizeof(fileHeader));
 
-	if (!updateStreamLength)
-		tmpHeader.demoStreamSize = 0;
-
 	// to little endian
 	tmpHeader.swab();
 
-	if (demoStreams[isServerDemo].empty()) {
-		demoStreams[isServerDemo].append(reinterpret_cast<const char*>(&tmpHeader), sizeof(tmpHeader));
-	} else {
-		assert(demoStreams[isServerDemo].size() >= sizeof(tmpHeader));
-		memcpy(&demoStreams[isServerDemo][0], reinterpret_cast<const char*>(&tmpHeader), sizeof(tmpHeader)); // no non-const .data() until C++17
-	}
-
-	return (demoStreams[isServerDemo].size());
+	data.append(reinterpret_cast<const char*>(&tmpHeader), sizeof(tmpHeader));
 }
 
-/** @brief Write the CPlayer::Statistics at the current position in the file. */
-void CDemoRecorder::WritePlayerStats()
+/** @brief Write the CPlayer::Statistics at the end of <data>. */
+void CDemoRecorder::WritePlayerStats(std::string& data)
 {
-	const size_t pos = demoStreams[isServerDemo].size();
+	const size_t pos = data.size();
 
 	for (PlayerStatistics& stats: playerStats) {
 		stats.swab();
-		demoStreams[isServerDemo].append(reinterpret_cast<const char*>(&stats), sizeof(PlayerStatistics));
+		data.append(reinterpret_cast<const char*>(&stats), sizeof(PlayerStatistics));
 	}
 
 	fileHeader.numPlayers = playerStats.size();
-	fileHeader.playerStatSize = int(demoStreams[isServerDemo].size() - pos);
+	fileHeader.playerStatSize = int(data.size() - pos);
 
 	playerStats.clear();
 }
 
 
 
-/** @brief Write the winningAllyTeams at the current position in the file. */
-void CDemoRecorder::WriteWinnerList()
+/** @brief Write the winningAllyTeams at the end of <data>. */
+void CDemoRecorder::WriteWinnerList(std::string& data)
 {
 	if (fileHeader.numTeams == 0)
 		return;
 
-	const size_t pos = demoStreams[isServerDemo].size();
+	const size_t pos = data.size();
 
 	// Write the array of winningAllyTeams.
 	for (size_t i = 0; i < winningAllyTeams.size(); i++) { // NOLINT{modernize-loop-convert}
-		demoStreams[isServerDemo].append(reinterpret_cast<const char*>(&winningAllyTeams[i]), sizeof(unsigned char));
+		data.append(reinterpret_cast<const char*>(&winningAllyTeams[i]), sizeof(unsigned char));
 	}
 
 	winningAllyTeams.clear();
 
-	fileHeader.winningAllyTeamsSize = int(demoStreams[isServerDemo].size() - pos);
+	fileHeader.winningAllyTeamsSize = int(data.size() - pos);
 }
 
-/** @brief Write the TeamStatistics at the current position in the file. */
-void CDemoRecorder::WriteTeamStats()
+/** @brief Write the TeamStatistics at the end of <data>. */
+void CDemoRecorder::WriteTeamStats(std::string& data)
 {
-	const size_t pos = demoStreams[isServerDemo].size();
+	const size_t pos = data.size();
 
 	// Write array of dwords indicating number of TeamStatistics per team.
 	for (std::vector<TeamStatistics>& history: teamStats) {
 		unsigned int c = swabDWord(history.size());
-		demoStreams[isServerDemo].append(reinterpret_cast<const char*>(&c), sizeof(unsigned int));
+		data.append(reinterpret_cast<const char*>(&c), sizeof(unsigned int));
 	}
 
 	// Write big array of TeamStatistics.
 	for (std::vector<TeamStatistics>& history: teamStats) {
 		for (TeamStatistics& stats: history) {
 			stats.swab();
-			demoStreams[isServerDemo].append(reinterpret_cast<const char*>(&stats), sizeof(TeamStatistics));
+			data.append(reinterpret_cast<const char*>(&stats), sizeof(TeamStatistics));
 		}
 	}
 
-	fileHeader.teamStatSize = int(demoStreams[isServerDemo].size() - pos);
+	fileHeader.teamStatSize = int(data.size() - pos);
 
 	teamStats.clear();
 }
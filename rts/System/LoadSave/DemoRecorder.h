@@ -3,11 +3,13 @@
 #ifndef DEMO_RECORDER
 #define DEMO_RECORDER
 
+#include <future>
+#include <memory>
 #include <vector>
 #include <sstream>
-#include <zlib.h>
 
 #include "Demo.h"
+#include "DemoStreamWriter.h"
 #include "Game/Players/PlayerStatistics.h"
 #include "Sim/Misc/TeamStatistics.h"
 
@@ -32,24 +34,27 @@ public:
 		memcpy(&fileHeader, &r.fileHeader, sizeof(fileHeader));
 		memset(&r.fileHeader, 0, sizeof(fileHeader));
 
-		std::swap(file, r.file);
+		std::swap(writer, r.writer);
+		std::swap(writerJob, r.writerJob);
 
 		std::swap(demoName, r.demoName);
 		std::swap(playerStats, r.playerStats);
 		std::swap(teamStats, r.teamStats);
 		std::swap(winningAllyTeams, r.winningAllyTeams);
 
+		std::swap(keyFrameInterval, r.keyFrameInterval);
+		std::swap(numFrames, r.numFrames);
+
 		std::swap(isServerDemo, r.isServerDemo);
 		return *this;
 	}
 
 
-	bool IsValid() const { return (file != nullptr); }
+	bool IsValid() const { return (writer != nullptr); }
 
 	void WriteSetupText(const std::string& text);
 	void SaveToDemo(const unsigned char* buf, const unsigned length, const float modGameTime);
 
-	void SetStream();
 	void SetName(const std::string& mapName, const std::string& modName);
 	const std::string& GetName() const { return demoName; }
 
@@ -63,20 +68,25 @@ public:
 	void SetWinningAllyTeams(const std::vector<unsigned char>& winningAllyTeams);
 
 private:
-	unsigned int WriteFileHeader(bool updateStreamLength);
+	void WriteFileHeader(std::string& data) const;
 	void SetFileHeader();
-	void WritePlayerStats();
-	void WriteTeamStats();
-	void WriteWinnerList();
+	void WritePlayerStats(std::string& data);
+	void WriteTeamStats(std::string& data);
+	void WriteWinnerList(std::string& data);
 	void WriteDemoFile();
 
 private:
-	gzFile file = nullptr;
+	// compresses the stream while recording, shared with the job running it
+	std::shared_ptr<CDemoStreamWriter> writer;
+	std::future<void> writerJob;
 
 	std::vector<PlayerStatistics> playerStats;
 	std::vector< std::vector<TeamStatistics> > teamStats;
 	std::vector<unsigned char> winningAllyTeams;
 
+	int keyFrameInterval = 0;
+	int numFrames = 0;
+
 	bool isServerDemo = false;
 };
 
@@ -0,0 +1,297 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "DemoStreamWriter.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstring>
+#include <mutex>
+
+#include "System/MainDefines.h"
+#include "System/Log/ILog.h"
+#include "System/Misc/SpringTime.h"
+
+// gzip member header (RFC 1952) without optional fields, followed by the
+// header of the stored deflate block (RFC 1951) holding the demo header
+static constexpr size_t GZIP_HEADER_SIZE = 10;
+static constexpr size_t STORED_BLOCK_HEADER_SIZE = 5;
+
+
+CDemoStreamWriter::CDemoStreamWriter(const std::string& fileName, size_t headSize, size_t ringSize, int level)
+	: ring(std::bit_ceil(std::max<size_t>(ringSize, 4096)))
+	, ringMask(ring.size() - 1)
+	, ringWakeFill(ring.size() / 4)
+	, demoFileName(fileName)
+	, compressionLevel(level)
+	, fileHeadSize(headSize)
+{
+	assert(fileHeadSize <= 0xFFFF);
+	memset(&deflateStream, 0, sizeof(deflateStream));
+
+	// raw deflate, the gzip header and trailer are written by hand
+	deflateInit2(&deflateStream, compressionLevel, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+	deflatedCRC = crc32(0L, Z_NULL, 0);
+}
+
+CDemoStreamWriter::~CDemoStreamWriter()
+{
+	if (demoFile != nullptr)
+		fclose(demoFile);
+
+	deflateEnd(&deflateStream);
+}
+
+
+void CDemoStreamWriter::Write(const void* data, size_t size)
+{
+	const std::uint8_t* bytes = static_cast<const std::uint8_t*>(data);
+
+	size_t head = ringHead.load(std::memory_order_relaxed);
+	bool stalled = false;
+
+	while (size > 0) {
+		const size_t fill = head - ringTail.load(std::memory_order_acquire);
+		const size_t free = ring.size() - fill;
+
+		maxRingFill = std::max(maxRingFill, fill);
+
+		if (free == 0) {
+			// writer can not keep up; wait for it rather than drop data
+			const spring_time t0 = spring_gettime();
+
+			{
+				std::unique_lock<spring::mutex> lock(ringMutex);
+
+				producerWaiting.store(true);
+				spaceCond.wait(lock, [&]() { return ((head - ringTail.load()) < ring.size()); });
+				producerWaiting.store(false, std::memory_order_relaxed);
+			}
+
+			numStalls += (!stalled);
+			stallTime += (spring_gettime() - t0).toMilliSecsf();
+			stalled = true;
+			continue;
+		}
+
+		const size_t pos = head & ringMask;
+		const size_t num = std::min(size, free);
+		const size_t numTillWrap = std::min(num, ring.size() - pos);
+
+		memcpy(&ring[pos], bytes, numTillWrap);
+		memcpy(&ring[0], bytes + numTillWrap, num - numTillWrap);
+
+		head += num;
+		bytes += num;
+		size -= num;
+
+		ringHead.store(head);
+
+		if (!consumerWaiting.load() || (head - ringTail.load(std::memory_order_relaxed)) < ringWakeFill)
+			continue;
+
+		std::lock_guard<spring::mutex> lock(ringMutex);
+		dataCond.notify_one();
+	}
+}
+
+void CDemoStreamWriter::AddKeyFrame(const DemoKeyFrame& keyFrame)
+{
+	std::lock_guard<spring::mutex> lock(ringMutex);
+	pendingKeyFrames.emplace_back(ringHead.load(std::memory_order_relaxed), keyFrame);
+}
+
+void CDemoStreamWriter::Finish(std::string&& fileHead, std::string&& fileTail, int keyFrameInterval)
+{
+	assert(fileHead.size() == fileHeadSize);
+
+	std::lock_guard<spring::mutex> lock(ringMutex);
+
+	demoFileHead = std::move(fileHead);
+	demoFileTail = std::move(fileTail);
+	demoKeyFrameInterval = keyFrameInterval;
+
+	// publishes the above and every byte written so far to Run
+	finishing = true;
+	dataCond.notify_one();
+}
+
+
+void CDemoStreamWriter::Run()
+{
+	if ((demoFile = fopen(demoFileName.c_str(), "wb")) == nullptr)
+		LOG_L(L_ERROR, "[DemoStreamWriter::%s] failed to open \"%s\"", __func__, demoFileName.c_str());
+
+	WriteFileHead();
+
+	while (true) {
+		{
+			std::unique_lock<spring::mutex> lock(ringMutex);
+
+			consumerWaiting.store(true);
+			dataCond.wait(lock, [&]() { return (finishing || (ringHead.load() - ringTail.load(std::memory_order_relaxed)) >= ringWakeFill); });
+			consumerWaiting.store(false, std::memory_order_relaxed);
+
+			if (finishing)
+				break;
+		}
+
+		Drain();
+	}
+
+	Drain();
+	WriteFileTail();
+}
+
+void CDemoStreamWriter::Drain()
+{
+	const size_t head = ringHead.load(std::memory_order_acquire);
+
+	size_t tail = ringTail.load(std::memory_order_relaxed);
+
+	while (true) {
+		size_t next = head;
+		bool flush = false;
+
+		DemoKeyFrame keyFrame;
+
+		{
+			std::lock_guard<spring::mutex> lock(ringMutex);
+
+			if (!pendingKeyFrames.empty() && pendingKeyFrames.front().first <= head) {
+				next = pendingKeyFrames.front().first;
+				keyFrame = pendingKeyFrames.front().second;
+				flush = true;
+
+				pendingKeyFrames.pop_front();
+			}
+		}
+
+		while (tail != next) {
+			const size_t pos = tail & ringMask;
+			const size_t num = std::min(next - tail, ring.size() - pos);
+
+			Deflate(&ring[pos], num, Z_NO_FLUSH);
+
+			tail += num;
+
+			ringTail.store(tail);
+
+			if (!producerWaiting.load())
+				continue;
+
+			std::lock_guard<spring::mutex> lock(ringMutex);
+			spaceCond.notify_one();
+		}
+
+		if (!flush)
+			break;
+
+		// after a full flush inflating can start from scratch at this offset
+		Deflate(nullptr, 0, Z_FULL_FLUSH);
+
+		keyFrame.gzipOffset = numCompressedBytes;
+		keyFrames.push_back(keyFrame);
+	}
+}
+
+void CDemoStreamWriter::Deflate(const std::uint8_t* data, size_t size, int flush)
+{
+	std::uint8_t buffer[16384];
+
+	if (size > 0)
+		deflatedCRC = crc32(deflatedCRC, data, size);
+
+	numDeflatedBytes += size;
+
+	deflateStream.next_in = const_cast<Bytef*>(data);
+	deflateStream.avail_in = size;
+
+	do {
+		deflateStream.next_out = buffer;
+		deflateStream.avail_out = sizeof(buffer);
+
+		deflate(&deflateStream, flush);
+		WriteOutput(buffer, sizeof(buffer) - deflateStream.avail_out);
+	} while (deflateStream.avail_out == 0);
+}
+
+void CDemoStreamWriter::WriteOutput(const void* data, size_t size)
+{
+	// keep consuming the ring if the file is gone, recording must not block
+	if (demoFile != nullptr)
+		writeError |= (fwrite(data, 1, size, demoFile) != size);
+
+	numCompressedBytes += size;
+}
+
+void CDemoStreamWriter::WriteFileHead()
+{
+	const std::uint8_t gzipHeader[GZIP_HEADER_SIZE] = {0x1f, 0x8b, Z_DEFLATED, 0, 0, 0, 0, 0, 0, 0xff};
+	const std::uint8_t storedHeader[STORED_BLOCK_HEADER_SIZE] = {
+		0, // BFINAL=0, BTYPE=00 (stored), padded to the byte boundary
+		std::uint8_t(fileHeadSize), std::uint8_t(fileHeadSize >> 8),
+		std::uint8_t(~fileHeadSize), std::uint8_t(~fileHeadSize >> 8),
+	};
+
+	// placeholder, overwritten by the real header in WriteFileTail
+	const std::vector<std::uint8_t> fileHead(fileHeadSize, 0);
+
+	WriteOutput(gzipHeader, sizeof(gzipHeader));
+	WriteOutput(storedHeader, sizeof(storedHeader));
+	WriteOutput(fileHead.data(), fileHead.size());
+}
+
+void CDemoStreamWriter::WriteFileTail()
+{
+	// every key frame was added before Finish, so its flush point has been reached
+	assert(pendingKeyFrames.empty());
+
+	if (!keyFrames.empty()) {
+		DemoKeyFrameIndexHeader indexHeader;
+
+		memset(&indexHeader, 0, sizeof(indexHeader));
+		strcpy(indexHeader.magic, DEMOFILE_KEYFRAME_INDEX_MAGIC);
+		indexHeader.numKeyFrames = keyFrames.size();
+		indexHeader.keyFrameInterval = demoKeyFrameInterval;
+		indexHeader.swab();
+
+		demoFileTail.append(reinterpret_cast<const char*>(&indexHeader), sizeof(indexHeader));
+
+		for (DemoKeyFrame keyFrame: keyFrames) {
+			keyFrame.swab();
+			demoFileTail.append(reinterpret_cast<const char*>(&keyFrame), sizeof(keyFrame));
+		}
+	}
+
+	Deflate(reinterpret_cast<const std::uint8_t*>(demoFileTail.data()), demoFileTail.size(), Z_FINISH);
+
+	// the trailer covers the real header, which precedes everything deflated
+	const uLong headCRC = crc32(0L, reinterpret_cast<const Bytef*>(demoFileHead.data()), demoFileHead.size());
+	const uLong fileCRC = crc32_combine(headCRC, deflatedCRC, numDeflatedBytes);
+	const std::uint32_t fileSize = fileHeadSize + numDeflatedBytes;
+
+	const std::uint8_t gzipTrailer[8] = {
+		std::uint8_t(fileCRC), std::uint8_t(fileCRC >> 8), std::uint8_t(fileCRC >> 16), std::uint8_t(fileCRC >> 24),
+		std::uint8_t(fileSize), std::uint8_t(fileSize >> 8), std::uint8_t(fileSize >> 16), std::uint8_t(fileSize >> 24),
+	};
+
+	WriteOutput(gzipTrailer, sizeof(gzipTrailer));
+
+	if (demoFile == nullptr)
+		return;
+
+	writeError |= (fseek(demoFile, GZIP_HEADER_SIZE + STORED_BLOCK_HEADER_SIZE, SEEK_SET) != 0);
+	writeError |= (fwrite(demoFileHead.data(), 1, demoFileHead.size(), demoFile) != demoFileHead.size());
+	writeError |= (fclose(demoFile) != 0);
+
+	demoFile = nullptr;
+
+	if (writeError)
+		LOG_L(L_ERROR, "[DemoStreamWriter::%s] failed to write \"%s\"", __func__, demoFileName.c_str());
+
+	LOG(
+		"[DemoStreamWriter::%s] \"%s\": " _STPF_ " bytes compressed to " _STPF_ ", %u producer stalls (%.1fms), peak ring fill %.1f%%",
+		__func__, demoFileName.c_str(), fileHeadSize + numDeflatedBytes, numCompressedBytes, numStalls, stallTime, (maxRingFill * 100.0f) / ring.size()
+	);
+}
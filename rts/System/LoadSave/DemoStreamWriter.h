@@ -0,0 +1,109 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef DEMO_STREAM_WRITER_H
+#define DEMO_STREAM_WRITER_H
+
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+#include <zlib.h>
+
+#include "demofile.h"
+#include "System/Threading/SpringThreading.h"
+
+/**
+ * @brief Compresses a demo stream on a dedicated thread
+ *
+ * The recording thread copies chunks into a lock-free single-producer single-
+ * consumer byte ring, Run() deflates them straight into the demo file while
+ * the game is running. The file is a single gzip stream whose first deflate
+ * block stores the demo header uncompressed; it is written as a placeholder
+ * and overwritten in place by Finish(), which also hands over the statistics
+ * that are only known at the end.
+ */
+class CDemoStreamWriter
+{
+public:
+	CDemoStreamWriter(const std::string& fileName, size_t fileHeadSize, size_t ringSize, int compressionLevel);
+	~CDemoStreamWriter();
+
+	CDemoStreamWriter(const CDemoStreamWriter&) = delete;
+	CDemoStreamWriter& operator = (const CDemoStreamWriter&) = delete;
+
+	/// producer-side, copies data into the ring and waits while it is full
+	void Write(const void* data, size_t size);
+	/// producer-side, fully flushes the stream before the next byte written
+	/// and indexes that point under <keyFrame> (gzipOffset is filled in here)
+	void AddKeyFrame(const DemoKeyFrame& keyFrame);
+
+	/// producer-side, <fileHead> replaces the placeholder at the start of the file
+	void Finish(std::string&& fileHead, std::string&& fileTail, int keyFrameInterval);
+
+	/// writer-thread loop, returns once the file is written after Finish
+	void Run();
+
+	size_t GetNumStreamBytes() const { return ringHead.load(std::memory_order_relaxed); }
+	/// only valid once Run has returned
+	size_t GetNumCompressedBytes() const { return numCompressedBytes; }
+
+private:
+	void Drain();
+	void Deflate(const std::uint8_t* data, size_t size, int flush);
+	void WriteOutput(const void* data, size_t size);
+	void WriteFileHead();
+	void WriteFileTail();
+
+private:
+	std::vector<std::uint8_t> ring;
+	size_t ringMask = 0;
+	// fill level at which an idle writer is woken up
+	size_t ringWakeFill = 0;
+
+	// total number of bytes written to and read from the ring
+	alignas(64) std::atomic<size_t> ringHead = {0};
+	alignas(64) std::atomic<size_t> ringTail = {0};
+
+	// set while the respective side sleeps on its condition; each side only
+	// takes ringMutex to notify the other when it sees the flag raised
+	alignas(64) std::atomic<bool> producerWaiting = {false};
+	alignas(64) std::atomic<bool> consumerWaiting = {false};
+
+	spring::mutex ringMutex;
+	spring::condition_variable dataCond;
+	spring::condition_variable spaceCond;
+
+	// guarded by ringMutex; ring positions to flush at and their index entries
+	std::deque<std::pair<size_t, DemoKeyFrame>> pendingKeyFrames;
+
+	// guarded by ringMutex, set by Finish
+	std::string demoFileHead;
+	std::string demoFileTail;
+	int demoKeyFrameInterval = 0;
+	bool finishing = false;
+
+	// writer-thread state
+	std::string demoFileName;
+	FILE* demoFile = nullptr;
+
+	z_stream deflateStream;
+	int compressionLevel = Z_DEFAULT_COMPRESSION;
+
+	std::vector<DemoKeyFrame> keyFrames;
+
+	size_t fileHeadSize = 0;
+	size_t numCompressedBytes = 0;
+	size_t numDeflatedBytes = 0;
+	uLong deflatedCRC = 0;
+	bool writeError = false;
+
+	// back-pressure accounting, updated by the producer
+	unsigned int numStalls = 0;
+	float stallTime = 0.0f;
+	size_t maxRingFill = 0;
+};
+
+#endif
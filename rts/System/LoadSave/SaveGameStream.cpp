@@ -0,0 +1,554 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "SaveGameStream.h"
+
+#include <algorithm>
+#include <cstring>
+#include <zlib.h>
+
+#include "System/MainDefines.h"
+#include "System/Log/ILog.h"
+#include "System/Misc/SpringTime.h"
+#include "System/Threading/ThreadPool.h"
+
+
+CSaveGameStreamWriter::CSaveGameStreamWriter(const std::string& _fileName, size_t blockSize, int level, size_t maxPending)
+	: fileName(_fileName)
+	, buffer(std::clamp<size_t>(blockSize, 1, 1 << 30))
+	, compressionLevel(level)
+	, maxPendingBlocks(std::max<size_t>(maxPending, 1))
+{
+	if ((file = fopen(fileName.c_str(), "wb")) == nullptr)
+		return;
+
+	SaveFileHeader header;
+
+	memcpy(header.magic, SAVEFILE_MAGIC, sizeof(header.magic));
+	header.version = SAVEFILE_VERSION;
+	header.blockSize = buffer.size();
+	header.swab();
+
+	writeError |= (fwrite(&header, sizeof(header), 1, file) != 1);
+
+	setp(reinterpret_cast<char_type*>(buffer.data()), reinterpret_cast<char_type*>(buffer.data() + buffer.size()));
+}
+
+CSaveGameStreamWriter::~CSaveGameStreamWriter()
+{
+	for (const auto& block: pendingBlocks) {
+		if (block->task != nullptr)
+			block->task->wait();
+	}
+
+	if (file == nullptr)
+		return;
+
+	// not finished, e.g. because serialization threw
+	fclose(file);
+	remove(fileName.c_str());
+}
+
+
+size_t CSaveGameStreamWriter::GetBufferFill() const
+{
+	return std::max(bufferFill, size_t(pptr() - pbase()));
+}
+
+std::uint64_t CSaveGameStreamWriter::GetStreamSize() const
+{
+	return (bufferOffset + GetBufferFill());
+}
+
+
+CSaveGameStreamWriter::int_type CSaveGameStreamWriter::overflow(int_type c)
+{
+	if (traits_type::eq_int_type(c, traits_type::eof()))
+		return traits_type::not_eof(c);
+
+	const char_type ch = traits_type::to_char_type(c);
+
+	if (xsputn(&ch, 1) != 1)
+		return traits_type::eof();
+
+	return c;
+}
+
+std::streamsize CSaveGameStreamWriter::xsputn(const char_type* s, std::streamsize n)
+{
+	std::streamsize numWritten = 0;
+
+	while (numWritten < n) {
+		if (patching) {
+			const size_t num = std::min<std::uint64_t>(n - numWritten, bufferOffset - patchOffset);
+
+			AddPatch(s + numWritten, num);
+			numWritten += num;
+
+			// caught up with the current block, continue in it
+			if (patchOffset == bufferOffset)
+				seekpos(bufferOffset, std::ios_base::out);
+
+			continue;
+		}
+
+		if (pptr() == epptr()) {
+			if (file == nullptr)
+				break;
+
+			SubmitBlock();
+		}
+
+		const size_t num = std::min<size_t>(n - numWritten, epptr() - pptr());
+
+		memcpy(pptr(), s + numWritten, num);
+		pbump(num);
+
+		numWritten += num;
+	}
+
+	return numWritten;
+}
+
+CSaveGameStreamWriter::pos_type CSaveGameStreamWriter::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+	if ((which & std::ios_base::out) == 0)
+		return pos_type(off_type(-1));
+
+	const std::uint64_t curPos = patching? patchOffset: (bufferOffset + (pptr() - pbase()));
+
+	switch (dir) {
+		case std::ios_base::beg: { return seekpos(pos_type(off), which); } break;
+		case std::ios_base::end: { return seekpos(pos_type(GetStreamSize() + off), which); } break;
+		default: {} break;
+	}
+
+	// tellp
+	if (off == 0)
+		return pos_type(curPos);
+
+	return seekpos(pos_type(curPos + off), which);
+}
+
+CSaveGameStreamWriter::pos_type CSaveGameStreamWriter::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+	const off_type newPos = off_type(pos);
+
+	if ((which & std::ios_base::out) == 0 || newPos < 0 || std::uint64_t(newPos) > GetStreamSize())
+		return pos_type(off_type(-1));
+
+	bufferFill = GetBufferFill();
+
+	if (std::uint64_t(newPos) < bufferOffset) {
+		patching = true;
+		patchOffset = newPos;
+
+		setp(nullptr, nullptr);
+		return pos;
+	}
+
+	patching = false;
+
+	setp(reinterpret_cast<char_type*>(buffer.data()), reinterpret_cast<char_type*>(buffer.data() + buffer.size()));
+	pbump(newPos - bufferOffset);
+	return pos;
+}
+
+
+void CSaveGameStreamWriter::AddPatch(const char_type* s, size_t n)
+{
+	if (patches.empty() || (patches.back().offset + patches.back().data.size()) != patchOffset)
+		patches.push_back({patchOffset, {}});
+
+	patches.back().data.insert(patches.back().data.end(), s, s + n);
+	patchOffset += n;
+}
+
+void CSaveGameStreamWriter::SubmitBlock()
+{
+	std::shared_ptr<PendingBlock> block = std::make_shared<PendingBlock>();
+
+	block->size = GetBufferFill();
+	block->data = std::move(buffer);
+
+	bufferOffset += block->size;
+	bufferFill = 0;
+
+	if (!freeBuffers.empty()) {
+		buffer = std::move(freeBuffers.back());
+		freeBuffers.pop_back();
+	} else {
+		buffer.resize(block->data.size());
+	}
+
+	setp(reinterpret_cast<char_type*>(buffer.data()), reinterpret_cast<char_type*>(buffer.data() + buffer.size()));
+
+	// raw pointer, the future of the task owns the lambda (which would make a cycle)
+	const auto CompressBlock = [block = block.get(), level = compressionLevel]() {
+		uLongf compressedSize = compressBound(block->size);
+
+		block->compressedData.resize(compressedSize);
+
+		if (compress2(block->compressedData.data(), &compressedSize, block->data.data(), block->size, level) != Z_OK)
+			compressedSize = 0;
+
+		block->compressedData.resize(compressedSize);
+	};
+
+#ifdef THREADPOOL
+	block->task = ThreadPool::Enqueue(CompressBlock);
+#else
+	CompressBlock();
+#endif
+
+	pendingBlocks.push_back(block);
+	maxPendingBytes = std::max(maxPendingBytes, (pendingBlocks.size() + 1) * buffer.size());
+
+	WriteBlocks(false);
+}
+
+void CSaveGameStreamWriter::WriteBlocks(bool wait)
+{
+	while (!pendingBlocks.empty()) {
+		PendingBlock& block = *pendingBlocks.front();
+
+		if (block.task != nullptr && block.task->wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			if (!wait && pendingBlocks.size() <= maxPendingBlocks)
+				break;
+
+			const spring_time t0 = spring_gettime();
+
+			block.task->wait();
+
+			if (!wait)
+				stallTime += (spring_gettime() - t0).toMilliSecsf();
+		}
+
+		WriteBlock(block);
+		pendingBlocks.pop_front();
+	}
+}
+
+void CSaveGameStreamWriter::WriteBlock(PendingBlock& block)
+{
+	SaveFileBlock indexEntry;
+
+	indexEntry.compressedSize = block.compressedData.size();
+	indexEntry.size = block.size;
+
+	writeError |= (block.compressedData.empty() && block.size > 0);
+	writeError |= (fwrite(block.compressedData.data(), 1, block.compressedData.size(), file) != block.compressedData.size());
+
+	blockIndex.push_back(indexEntry);
+	numCompressedBytes += block.compressedData.size();
+
+	freeBuffers.push_back(std::move(block.data));
+}
+
+bool CSaveGameStreamWriter::Finish()
+{
+	if (file == nullptr)
+		return false;
+
+	const spring_time t0 = spring_gettime();
+
+	if (GetBufferFill() > 0)
+		SubmitBlock();
+
+	WriteBlocks(true);
+
+	SaveFileTrailer trailer;
+
+	memcpy(trailer.magic, SAVEFILE_MAGIC, sizeof(trailer.magic));
+	trailer.indexOffset = sizeof(SaveFileHeader) + numCompressedBytes;
+	trailer.streamSize = bufferOffset;
+	trailer.numBlocks = blockIndex.size();
+	trailer.numPatches = patches.size();
+	trailer.swab();
+
+	for (SaveFileBlock indexEntry: blockIndex) {
+		indexEntry.swab();
+		writeError |= (fwrite(&indexEntry, sizeof(indexEntry), 1, file) != 1);
+	}
+
+	for (const Patch& patch: patches) {
+		SaveFilePatch patchHeader = {patch.offset, patch.data.size()};
+
+		patchHeader.swab();
+		writeError |= (fwrite(&patchHeader, sizeof(patchHeader), 1, file) != 1);
+		writeError |= (fwrite(patch.data.data(), 1, patch.data.size(), file) != patch.data.size());
+	}
+
+	writeError |= (fwrite(&trailer, sizeof(trailer), 1, file) != 1);
+	writeError |= (fclose(file) != 0);
+
+	file = nullptr;
+	finished = !writeError;
+
+	if (!finished) {
+		LOG_L(L_ERROR, "[SaveGameStreamWriter::%s] failed to write \"%s\"", __func__, fileName.c_str());
+		remove(fileName.c_str());
+		return false;
+	}
+
+	LOG(
+		"[SaveGameStreamWriter::%s] \"%s\": %.1fMB compressed to %.1fMB in " _STPF_ " blocks (" _STPF_ " patches), %.1fms stalled while writing, %.1fms to finish, %.1fMB peak buffer memory",
+		__func__, fileName.c_str(), bufferOffset / (1024.0f * 1024.0f), numCompressedBytes / (1024.0f * 1024.0f), blockIndex.size(), patches.size(),
+		stallTime, (spring_gettime() - t0).toMilliSecsf(), maxPendingBytes / (1024.0f * 1024.0f)
+	);
+
+	return true;
+}
+
+
+
+CSaveGameStreamReader::CSaveGameStreamReader(const std::string& fileName, size_t _readAhead)
+	: file(fileName, std::ios::in | std::ios::binary)
+	, readAhead(_readAhead)
+{
+	if (!file.is_open())
+		return;
+
+	valid = ReadIndex();
+}
+
+CSaveGameStreamReader::~CSaveGameStreamReader()
+{
+	// read-ahead tasks access the patches
+	for (const auto& p: blocks) {
+		if (p.second->task != nullptr)
+			p.second->task->wait();
+	}
+}
+
+
+bool CSaveGameStreamReader::ReadIndex()
+{
+	SaveFileHeader header;
+	SaveFileTrailer trailer;
+
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+		return false;
+	// not an error, legacy saves are plain gzip
+	if (memcmp(header.magic, SAVEFILE_MAGIC, sizeof(header.magic)) != 0)
+		return false;
+
+	header.swab();
+
+	if (header.version != SAVEFILE_VERSION || header.blockSize == 0) {
+		LOG_L(L_ERROR, "[SaveGameStreamReader::%s] unsupported save file version %u", __func__, header.version);
+		return false;
+	}
+
+	if (!file.seekg(-std::streamoff(sizeof(trailer)), std::ios::end) || !file.read(reinterpret_cast<char*>(&trailer), sizeof(trailer)) || memcmp(trailer.magic, SAVEFILE_MAGIC, sizeof(trailer.magic)) != 0) {
+		LOG_L(L_ERROR, "[SaveGameStreamReader::%s] save file is incomplete", __func__);
+		return false;
+	}
+
+	trailer.swab();
+
+	// everything the trailer describes lies between the header and itself;
+	// check the counts against that before they size any allocation
+	const std::uint64_t trailerOffset = std::uint64_t(file.tellg()) - sizeof(trailer);
+
+	if (trailer.indexOffset < sizeof(header) || trailer.indexOffset > trailerOffset || (trailerOffset - trailer.indexOffset) / sizeof(SaveFileBlock) < trailer.numBlocks) {
+		LOG_L(L_ERROR, "[SaveGameStreamReader::%s] save file index is corrupt", __func__);
+		return false;
+	}
+
+	blockIndex.resize(trailer.numBlocks);
+	blockFileOffsets.resize(trailer.numBlocks);
+
+	file.seekg(trailer.indexOffset);
+	file.read(reinterpret_cast<char*>(blockIndex.data()), blockIndex.size() * sizeof(SaveFileBlock));
+
+	std::uint64_t blockFileOffset = sizeof(SaveFileHeader);
+	std::uint64_t blockStreamOffset = 0;
+
+	for (size_t i = 0; i < blockIndex.size(); i++) {
+		SaveFileBlock& indexEntry = blockIndex[i];
+
+		indexEntry.swab();
+
+		// block positions are derived from blockSize
+		if (indexEntry.size != header.blockSize && i != (blockIndex.size() - 1))
+			return false;
+
+		blockFileOffsets[i] = blockFileOffset;
+		blockFileOffset += indexEntry.compressedSize;
+		blockStreamOffset += indexEntry.size;
+	}
+
+	for (std::uint32_t i = 0; i < trailer.numPatches && file; i++) {
+		SaveFilePatch patchHeader;
+
+		file.read(reinterpret_cast<char*>(&patchHeader), sizeof(patchHeader));
+		patchHeader.swab();
+
+		if (!file || patchHeader.size > trailer.streamSize || patchHeader.size > (trailerOffset - std::uint64_t(file.tellg())))
+			return false;
+
+		patches.push_back({patchHeader.offset, std::vector<std::uint8_t>(patchHeader.size)});
+		file.read(reinterpret_cast<char*>(patches.back().data.data()), patchHeader.size);
+	}
+
+	if (!file || blockStreamOffset != trailer.streamSize || blockFileOffset != trailer.indexOffset) {
+		LOG_L(L_ERROR, "[SaveGameStreamReader::%s] save file index is corrupt", __func__);
+		return false;
+	}
+
+	streamSize = trailer.streamSize;
+	blockSize = header.blockSize;
+	return true;
+}
+
+
+std::shared_ptr<CSaveGameStreamReader::Block> CSaveGameStreamReader::ReadBlock(size_t blockNum, bool async)
+{
+	std::shared_ptr<Block> block = std::make_shared<Block>();
+
+	block->compressedData.resize(blockIndex[blockNum].compressedSize);
+
+	// blocks are read sequentially from disk, only inflating them runs in parallel
+	if (!file.seekg(blockFileOffsets[blockNum]) || !file.read(reinterpret_cast<char*>(block->compressedData.data()), block->compressedData.size())) {
+		file.clear();
+		return block;
+	}
+
+	numReadBlocks += 1;
+
+#ifdef THREADPOOL
+	if (async) {
+		block->task = ThreadPool::Enqueue([this, block = block.get(), blockNum]() { InflateBlock(*block, blockNum); });
+		return block;
+	}
+#endif
+
+	InflateBlock(*block, blockNum);
+	return block;
+}
+
+void CSaveGameStreamReader::InflateBlock(Block& block, size_t blockNum) const
+{
+	uLongf size = blockIndex[blockNum].size;
+
+	block.data.resize(size);
+	block.valid = (uncompress(block.data.data(), &size, block.compressedData.data(), block.compressedData.size()) == Z_OK && size == block.data.size());
+	block.compressedData = {};
+
+	const std::uint64_t blockBeg = std::uint64_t(blockNum) * blockSize;
+	const std::uint64_t blockEnd = blockBeg + size;
+
+	// in the order they were written, later ones win
+	for (const Patch& patch: patches) {
+		const std::uint64_t beg = std::max(blockBeg, patch.offset);
+		const std::uint64_t end = std::min(blockEnd, patch.offset + patch.data.size());
+
+		if (beg >= end)
+			continue;
+
+		memcpy(&block.data[beg - blockBeg], &patch.data[beg - patch.offset], end - beg);
+	}
+}
+
+bool CSaveGameStreamReader::LoadBlock(size_t blockNum)
+{
+	const size_t endBlockNum = std::min(blockNum + readAhead + 1, blockIndex.size());
+
+	// drop blocks behind the read position or outside of the window after a seek
+	for (auto it = blocks.begin(); it != blocks.end(); ) {
+		if (it->first < blockNum || it->first >= endBlockNum) {
+			if (it->second->task != nullptr)
+				it->second->task->wait();
+
+			it = blocks.erase(it);
+		} else {
+			++it;
+		}
+	}
+
+	for (size_t i = blockNum; i < endBlockNum; i++) {
+		if (blocks.find(i) == blocks.end())
+			blocks[i] = ReadBlock(i, i != blockNum);
+	}
+
+	const std::shared_ptr<Block>& block = blocks[blockNum];
+
+	if (block->task != nullptr)
+		block->task->wait();
+
+	if (!block->valid) {
+		LOG_L(L_ERROR, "[SaveGameStreamReader::%s] failed to read block " _STPF_ "/" _STPF_, __func__, blockNum, blockIndex.size());
+		return false;
+	}
+
+	curBlock = block;
+	curBlockNum = blockNum;
+
+	char_type* data = reinterpret_cast<char_type*>(curBlock->data.data());
+
+	setg(data, data, data + curBlock->data.size());
+	return true;
+}
+
+std::uint64_t CSaveGameStreamReader::GetPosition() const
+{
+	return (std::uint64_t(curBlockNum) * blockSize + (gptr() - eback()));
+}
+
+
+CSaveGameStreamReader::int_type CSaveGameStreamReader::underflow()
+{
+	if (gptr() < egptr())
+		return traits_type::to_int_type(*gptr());
+
+	// nothing loaded yet or after seeking to a block boundary at the end
+	const size_t blockNum = curBlockNum + (curBlock != nullptr);
+
+	if (blockNum >= blockIndex.size() || !LoadBlock(blockNum))
+		return traits_type::eof();
+
+	return traits_type::to_int_type(*gptr());
+}
+
+CSaveGameStreamReader::pos_type CSaveGameStreamReader::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+	if ((which & std::ios_base::in) == 0 || !valid)
+		return pos_type(off_type(-1));
+
+	switch (dir) {
+		case std::ios_base::beg: { return seekpos(pos_type(off), which); } break;
+		case std::ios_base::end: { return seekpos(pos_type(streamSize + off), which); } break;
+		default: {} break;
+	}
+
+	// tellg
+	if (off == 0)
+		return pos_type(GetPosition());
+
+	return seekpos(pos_type(GetPosition() + off), which);
+}
+
+CSaveGameStreamReader::pos_type CSaveGameStreamReader::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+	const off_type newPos = off_type(pos);
+
+	if ((which & std::ios_base::in) == 0 || !valid || newPos < 0 || std::uint64_t(newPos) > streamSize)
+		return pos_type(off_type(-1));
+
+	const size_t blockNum = newPos / blockSize;
+	const size_t blockOffset = newPos - std::uint64_t(blockNum) * blockSize;
+
+	if (blockNum >= blockIndex.size()) {
+		curBlock.reset();
+		curBlockNum = blockNum;
+
+		setg(nullptr, nullptr, nullptr);
+		return pos;
+	}
+
+	if ((curBlock == nullptr || blockNum != curBlockNum) && !LoadBlock(blockNum))
+		return pos_type(off_type(-1));
+
+	setg(eback(), eback() + blockOffset, egptr());
+	return pos;
+}
@@ -0,0 +1,261 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef SAVE_GAME_STREAM_H
+#define SAVE_GAME_STREAM_H
+
+#include "System/Platform/byteorder.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <map>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#define SAVEFILE_MAGIC "SPRSAVEZ"
+#define SAVEFILE_VERSION 1
+
+// each block is compressed by its own thread-pool task
+#define SAVEFILE_BLOCK_SIZE (1 << 20)
+#define SAVEFILE_COMPRESSION_LEVEL 5
+
+#pragma pack(push, 1)
+
+/**
+ * @brief Save file header
+ *
+ * A save file holds the (uncompressed) save stream cut into blocks of
+ * blockSize bytes, each compressed on its own s.t. they can be (de)compressed
+ * in parallel and read in any order. The blocks are followed by the block
+ * index, the patches and the trailer.
+ */
+struct SaveFileHeader
+{
+	char magic[8];                ///< SAVEFILE_MAGIC
+	std::uint32_t version;        ///< SAVEFILE_VERSION
+	std::uint32_t blockSize;      ///< Uncompressed size of every block but the last.
+
+	/// Change structure from host endian to little endian or vice versa.
+	void swab() {
+		swabDWordInPlace(version);
+		swabDWordInPlace(blockSize);
+	}
+};
+
+/// Block index entry, blocks are stored back to back after the header.
+struct SaveFileBlock
+{
+	std::uint32_t compressedSize; ///< Size of the zlib stream.
+	std::uint32_t size;           ///< Uncompressed size.
+
+	void swab() {
+		swabDWordInPlace(compressedSize);
+		swabDWordInPlace(size);
+	}
+};
+
+/**
+ * @brief Bytes to overwrite in the save stream when reading
+ *
+ * Written where the stream was changed after the block holding the bytes had
+ * been compressed (creg fills in package headers once a package is complete),
+ * followed by <size> bytes of data.
+ */
+struct SaveFilePatch
+{
+	std::uint64_t offset;
+	std::uint64_t size;
+
+	void swab() {
+		swab64InPlace(offset);
+		swab64InPlace(size);
+	}
+};
+
+/// Last bytes of the file.
+struct SaveFileTrailer
+{
+	std::uint64_t indexOffset;    ///< File offset of the block index.
+	std::uint64_t streamSize;     ///< Uncompressed size of the save stream.
+	std::uint32_t numBlocks;
+	std::uint32_t numPatches;
+	char magic[8];                ///< SAVEFILE_MAGIC
+
+	void swab() {
+		swab64InPlace(indexOffset);
+		swab64InPlace(streamSize);
+		swabDWordInPlace(numBlocks);
+		swabDWordInPlace(numPatches);
+	}
+};
+
+#pragma pack(pop)
+
+
+/**
+ * @brief Compresses a save stream in blocks while it is being written
+ *
+ * Every full block is handed to a thread-pool task for compression while the
+ * serializer continues in a fresh buffer; the compressed blocks are written to
+ * the file in order. At most maxPendingBlocks are in flight, the writer waits
+ * for the oldest one beyond that which bounds memory use independent of the
+ * size of the save. Supports seeking back (as creg does to fill in headers),
+ * writes to already compressed blocks are stored as patches.
+ */
+class CSaveGameStreamWriter: public std::streambuf
+{
+public:
+	CSaveGameStreamWriter(const std::string& fileName, size_t blockSize, int compressionLevel, size_t maxPendingBlocks);
+	~CSaveGameStreamWriter();
+
+	CSaveGameStreamWriter(const CSaveGameStreamWriter&) = delete;
+	CSaveGameStreamWriter& operator = (const CSaveGameStreamWriter&) = delete;
+
+	bool IsOpen() const { return (file != nullptr); }
+
+	/// compresses the last block, waits for all and writes the index; files
+	/// destroyed before their writer is finished are removed as incomplete
+	bool Finish();
+
+	std::uint64_t GetStreamSize() const;
+	std::uint64_t GetNumCompressedBytes() const { return numCompressedBytes; }
+	size_t GetNumBlocks() const { return blockIndex.size(); }
+	size_t GetNumPatches() const { return patches.size(); }
+	/// time the serializing thread spent waiting for blocks to be compressed
+	float GetStallTime() const { return stallTime; }
+
+protected:
+	int_type overflow(int_type c) override;
+	std::streamsize xsputn(const char_type* s, std::streamsize n) override;
+	pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+	pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+
+private:
+	struct PendingBlock {
+		std::vector<std::uint8_t> data;
+		std::vector<std::uint8_t> compressedData;
+		size_t size = 0;
+
+		// nullptr if compressed on the writing thread
+		std::shared_ptr< std::future<void> > task;
+	};
+
+	struct Patch {
+		std::uint64_t offset;
+		std::vector<std::uint8_t> data;
+	};
+
+	size_t GetBufferFill() const;
+
+	void SubmitBlock();
+	void WriteBlocks(bool wait);
+	void WriteBlock(PendingBlock& block);
+	void AddPatch(const char_type* s, size_t n);
+
+private:
+	std::string fileName;
+	FILE* file = nullptr;
+
+	std::vector<std::uint8_t> buffer;
+	std::vector< std::vector<std::uint8_t> > freeBuffers;
+
+	// stream offset of buffer[0], and how much of it has been written so far
+	std::uint64_t bufferOffset = 0;
+	size_t bufferFill = 0;
+
+	// set while writing before bufferOffset, s.t. every write goes through xsputn
+	bool patching = false;
+	std::uint64_t patchOffset = 0;
+
+	std::deque< std::shared_ptr<PendingBlock> > pendingBlocks;
+	std::vector<SaveFileBlock> blockIndex;
+	std::vector<Patch> patches;
+
+	int compressionLevel = 0;
+	size_t maxPendingBlocks = 0;
+	size_t maxPendingBytes = 0;
+
+	std::uint64_t numCompressedBytes = 0;
+	float stallTime = 0.0f;
+
+	bool finished = false;
+	bool writeError = false;
+};
+
+
+/**
+ * @brief Reads a save stream written by CSaveGameStreamWriter
+ *
+ * Only the blocks around the read position are kept in memory; reading a block
+ * also schedules decompression of the next readAhead blocks on the thread pool.
+ * Seeking is supported as creg jumps between the parts of a package.
+ */
+class CSaveGameStreamReader: public std::streambuf
+{
+public:
+	CSaveGameStreamReader(const std::string& fileName, size_t readAhead);
+	~CSaveGameStreamReader();
+
+	CSaveGameStreamReader(const CSaveGameStreamReader&) = delete;
+	CSaveGameStreamReader& operator = (const CSaveGameStreamReader&) = delete;
+
+	/// false if the file does not exist or was not written by the stream writer
+	bool IsOpen() const { return valid; }
+
+	std::uint64_t GetStreamSize() const { return streamSize; }
+	size_t GetNumBlocks() const { return blockIndex.size(); }
+	size_t GetNumReadBlocks() const { return numReadBlocks; }
+
+protected:
+	int_type underflow() override;
+	pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+	pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+
+private:
+	struct Block {
+		std::vector<std::uint8_t> compressedData;
+		std::vector<std::uint8_t> data;
+		bool valid = false;
+
+		std::shared_ptr< std::future<void> > task;
+	};
+
+	struct Patch {
+		std::uint64_t offset;
+		std::vector<std::uint8_t> data;
+	};
+
+	bool ReadIndex();
+	bool LoadBlock(size_t blockNum);
+
+	std::shared_ptr<Block> ReadBlock(size_t blockNum, bool async);
+	void InflateBlock(Block& block, size_t blockNum) const;
+
+	std::uint64_t GetPosition() const;
+
+private:
+	std::ifstream file;
+
+	std::vector<SaveFileBlock> blockIndex;
+	std::vector<std::uint64_t> blockFileOffsets;
+	std::vector<Patch> patches;
+
+	std::uint64_t streamSize = 0;
+	std::uint32_t blockSize = 0;
+
+	// blocks in [curBlockNum, curBlockNum + readAhead], decompressed or in progress
+	std::map< size_t, std::shared_ptr<Block> > blocks;
+	std::shared_ptr<Block> curBlock;
+
+	size_t curBlockNum = 0;
+	size_t readAhead = 0;
+	size_t numReadBlocks = 0;
+
+	bool valid = false;
+};
+
+#endif // SAVE_GAME_STREAM_H
@@ -0,0 +1,173 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "SimSnapshotHandler.h"
+#include "CregLoadSaveHandler.h"
+#include "SaveGameStream.h"
+#include "Game/GameSetup.h"
+#include "Game/SelectedUnitsHandler.h"
+#include "System/Config/ConfigHandler.h"
+#include "System/FileSystem/DataDirsAccess.h"
+#include "System/FileSystem/FileQueryFlags.h"
+#include "System/FileSystem/FileSystem.h"
+#include "System/Log/ILog.h"
+#include "System/MainDefines.h"
+#include "System/Misc/SpringTime.h"
+
+#include <sstream>
+
+// NetCommands resets the sync checksum every 4096 frames
+#define SYNC_CHECKSUM_PERIOD 4096
+
+// snapshots are taken while the game runs, favor speed
+#define SNAPSHOT_COMPRESSION_LEVEL 1
+
+CONFIG(int, SimSnapshotInterval)
+	.defaultValue(0)
+	.minimumValue(0)
+	.description("Number of frames between in-memory snapshots of the synced game state, rounded up to a multiple of 4096 (the sync checksum period). 0 disables snapshots.");
+
+CONFIG(int, SimSnapshotMemory)
+	.defaultValue(512)
+	.minimumValue(16)
+	.description("Memory in MB to keep snapshots of the synced game state in, the oldest are dropped beyond it.");
+
+
+CSimSnapshotHandler simSnapshotHandler;
+
+
+void CSimSnapshotHandler::Init()
+{
+	WaitForPendingAdd();
+	store.reset();
+
+	if ((interval = configHandler->GetInt("SimSnapshotInterval")) <= 0)
+		return;
+
+#ifdef USING_CREG
+	interval = ((interval + SYNC_CHECKSUM_PERIOD - 1) / SYNC_CHECKSUM_PERIOD) * SYNC_CHECKSUM_PERIOD;
+	// filled off the main thread, see Update
+	store = std::make_unique<CSnapshotStore>(configHandler->GetInt("SimSnapshotMemory") * size_t(1024 * 1024), SNAPSHOT_COMPRESSION_LEVEL, false);
+
+	LOG("[SimSnapshotHandler::%s] taking a snapshot every %d frames", __func__, interval);
+#else
+	LOG_L(L_WARNING, "[SimSnapshotHandler::%s] snapshots require creg", __func__);
+#endif
+}
+
+void CSimSnapshotHandler::Kill()
+{
+	WaitForPendingAdd();
+	store.reset();
+}
+
+void CSimSnapshotHandler::WaitForPendingAdd() const
+{
+	if (pendingAdd.valid())
+		pendingAdd.wait();
+}
+
+
+void CSimSnapshotHandler::Update(int frameNum, std::uint32_t syncChecksum)
+{
+	if (store == nullptr)
+		return;
+	if (frameNum <= 0 || (frameNum % interval) != 0)
+		return;
+
+	const spring_time startTime = spring_gettime();
+
+	std::stringstream stateStream;
+	std::string state;
+
+	// NB: see CCregLoadSaveHandler::SaveGame, selections are unit listeners
+	// that are not serialized; detach them instead of clearing the selection
+	selectedUnitsHandler.DetachSelection();
+
+	try {
+		CCregLoadSaveHandler lsh;
+		lsh.SaveInfo(gameSetup->mapName, gameSetup->modName);
+		lsh.WriteState(stateStream);
+
+		state = stateStream.str();
+	} catch (const std::exception& ex) {
+		LOG_L(L_ERROR, "[SimSnapshotHandler::%s] snapshot at frame %d failed: \"%s\"", __func__, frameNum, ex.what());
+	}
+
+	selectedUnitsHandler.AttachSelection();
+
+	if (state.empty())
+		return;
+
+	const float serializeTime = (spring_gettime() - startTime).toMilliSecsf();
+
+	// at most one snapshot is added at a time, the previous one was
+	// taken <interval> frames ago so this practically never blocks
+	WaitForPendingAdd();
+
+	pendingAdd = std::async(std::launch::async, [this, frameNum, syncChecksum, serializeTime, state = std::move(state)]() {
+		const spring_time addTime = spring_gettime();
+
+		store->Add(frameNum, syncChecksum, reinterpret_cast<const std::uint8_t*>(state.data()), state.size());
+
+		const CSnapshotStore::Snapshot& snapshot = store->GetSnapshots().back();
+		const char* fmt = "[SimSnapshotHandler::Update] frame %d (checksum %x): %.1fMB of state, %.1fKB added (%.1fMB in " _STPF_ " snapshots), serialized in %.1fms and stored in %.1fms";
+
+		LOG(fmt, frameNum, syncChecksum, snapshot.size / (1024.0f * 1024.0f), snapshot.numAddedBytes / 1024.0f, store->GetMemoryUsage() / (1024.0f * 1024.0f), store->GetSnapshots().size(), serializeTime, (spring_gettime() - addTime).toMilliSecsf());
+	});
+}
+
+
+bool CSimSnapshotHandler::SaveSnapshot(int frameNum, const std::string& fileName) const
+{
+	if (store == nullptr) {
+		LOG_L(L_WARNING, "[SimSnapshotHandler::%s] snapshots are disabled (see SimSnapshotInterval)", __func__);
+		return false;
+	}
+
+	WaitForPendingAdd();
+
+	const CSnapshotStore::Snapshot* snapshot = store->FindNearest(frameNum);
+
+	if (snapshot == nullptr) {
+		LOG_L(L_WARNING, "[SimSnapshotHandler::%s] no snapshot taken at or before frame %d", __func__, frameNum);
+		return false;
+	}
+
+	std::vector<std::uint8_t> state;
+
+	if (!store->Restore(*snapshot, state)) {
+		LOG_L(L_ERROR, "[SimSnapshotHandler::%s] could not restore snapshot of frame %d", __func__, snapshot->frameNum);
+		return false;
+	}
+
+	if (!FileSystem::CreateDirectory("Saves"))
+		return false;
+
+	// the state is already serialized, no need to compress it off the main thread
+	CSaveGameStreamWriter saveStream(dataDirsAccess.LocateFile(fileName, FileQueryFlags::WRITE), SAVEFILE_BLOCK_SIZE, SAVEFILE_COMPRESSION_LEVEL, 2);
+
+	if (!saveStream.IsOpen() || saveStream.sputn(reinterpret_cast<const char*>(state.data()), state.size()) != std::streamsize(state.size()) || !saveStream.Finish()) {
+		LOG_L(L_ERROR, "[SimSnapshotHandler::%s] could not write \"%s\"", __func__, fileName.c_str());
+		return false;
+	}
+
+	LOG("[SimSnapshotHandler::%s] saved snapshot of frame %d (checksum %x) to \"%s\"", __func__, snapshot->frameNum, snapshot->syncChecksum, fileName.c_str());
+	return true;
+}
+
+
+void CSimSnapshotHandler::PrintSnapshots() const
+{
+	if (store == nullptr) {
+		LOG("[SimSnapshotHandler::%s] snapshots are disabled (see SimSnapshotInterval)", __func__);
+		return;
+	}
+
+	WaitForPendingAdd();
+
+	for (const CSnapshotStore::Snapshot& snapshot: store->GetSnapshots()) {
+		LOG("\tframe %d, checksum %x: %.1fMB of state, %.1fKB added", snapshot.frameNum, snapshot.syncChecksum, snapshot.size / (1024.0f * 1024.0f), snapshot.numAddedBytes / 1024.0f);
+	}
+
+	LOG("[SimSnapshotHandler::%s] " _STPF_ " snapshots in " _STPF_ " chunks using %.1fMB", __func__, store->GetSnapshots().size(), store->GetNumChunks(), store->GetMemoryUsage() / (1024.0f * 1024.0f));
+}
@@ -0,0 +1,54 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef SIM_SNAPSHOT_HANDLER_H
+#define SIM_SNAPSHOT_HANDLER_H
+
+#include "SnapshotStore.h"
+
+#include <cinttypes>
+#include <future>
+#include <memory>
+#include <string>
+
+/**
+ * @brief Takes periodic in-memory snapshots of the synced game state
+ *
+ * Every SimSnapshotInterval frames the state is serialized as a creg savegame
+ * would be and added to a CSnapshotStore. Snapshots are only taken on frames
+ * at which the sync checksum was just reset, such that a client started from
+ * one (after saving it as a regular .ssf) computes the same checksums for the
+ * following frames as a client that simulated all of them; the checksums
+ * reported by the original players (e.g. recorded in a demo) validate it.
+ *
+ * Only the serialization runs on the sim thread, chunking and compressing the
+ * state into the store is done in the background.
+ */
+class CSimSnapshotHandler
+{
+public:
+	void Init();
+	void Kill();
+
+	bool IsEnabled() const { return (store != nullptr); }
+
+	/// called after every sim-frame, <syncChecksum> is that of the frame
+	void Update(int frameNum, std::uint32_t syncChecksum);
+
+	/// writes the latest snapshot taken at or before <frameNum> as savegame
+	bool SaveSnapshot(int frameNum, const std::string& fileName) const;
+	void PrintSnapshots() const;
+
+private:
+	/// blocks until the last snapshot has been added to the store
+	void WaitForPendingAdd() const;
+
+private:
+	std::unique_ptr<CSnapshotStore> store;
+	std::future<void> pendingAdd;
+
+	int interval = 0;
+};
+
+extern CSimSnapshotHandler simSnapshotHandler;
+
+#endif // SIM_SNAPSHOT_HANDLER_H
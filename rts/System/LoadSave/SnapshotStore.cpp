@@ -0,0 +1,219 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "SnapshotStore.h"
+#include "System/Threading/ThreadPool.h"
+
+#include "lib/xxhash/xxh3.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstring>
+
+
+// random value per byte for the rolling (gear) hash, generated by splitmix64
+static constexpr std::array<std::uint64_t, 256> GenGearTable()
+{
+	std::array<std::uint64_t, 256> table = {};
+	std::uint64_t state = 0x5350524e47534e50ull;
+
+	for (std::uint64_t& v: table) {
+		std::uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		v = z ^ (z >> 31);
+	}
+
+	return table;
+}
+
+static constexpr std::array<std::uint64_t, 256> GEAR_TABLE = GenGearTable();
+
+
+CSnapshotStore::CSnapshotStore(size_t maxMemory, int compressionLevel, bool compressMT)
+	: maxMemory(maxMemory)
+	, compressionLevel(compressionLevel)
+	, compressMT(compressMT)
+{}
+
+
+size_t CSnapshotStore::FindChunkEnd(const std::uint8_t* data, size_t size)
+{
+	if (size <= MIN_CHUNK_SIZE)
+		return size;
+
+	// every shift pushes the oldest byte further out, the top bits depend on the
+	// last 64 bytes; the low bits only on the last few so those are not tested
+	constexpr std::uint64_t mask = ~(~std::uint64_t(0) >> CHUNK_SIZE_BITS);
+
+	const size_t end = std::min(size, MAX_CHUNK_SIZE);
+	std::uint64_t hash = 0;
+
+	for (size_t i = MIN_CHUNK_SIZE; i < end; i++) {
+		hash = (hash << 1) + GEAR_TABLE[data[i]];
+
+		if ((hash & mask) == 0)
+			return (i + 1);
+	}
+
+	return end;
+}
+
+
+void CSnapshotStore::Add(int frameNum, std::uint32_t syncChecksum, const std::uint8_t* data, size_t size)
+{
+	struct NewChunk {
+		ChunkKey key;
+		const std::uint8_t* data;
+		size_t size;
+		Chunk chunk;
+	};
+
+	Snapshot& snapshot = snapshots.emplace_back();
+	snapshot.frameNum = frameNum;
+	snapshot.syncChecksum = syncChecksum;
+	snapshot.size = size;
+	snapshot.numAddedBytes = 0;
+
+	std::vector<NewChunk> newChunks;
+	spring::unordered_map<ChunkKey, size_t, ChunkKeyHash> newChunkIndices;
+
+	for (size_t offset = 0; offset < size; ) {
+		const size_t chunkSize = FindChunkEnd(data + offset, size - offset);
+		const XXH128_hash_t hash = XXH3_128bits(data + offset, chunkSize);
+		const ChunkKey key = {hash.low64, hash.high64};
+
+		snapshot.chunks.push_back(key);
+
+		const auto it = chunks.find(key);
+		const auto nit = newChunkIndices.find(key);
+
+		if (it != chunks.end()) {
+			it->second.numRefs += 1;
+		} else if (nit != newChunkIndices.end()) {
+			// repeated within this snapshot
+			newChunks[nit->second].chunk.numRefs += 1;
+		} else {
+			newChunkIndices.emplace(key, newChunks.size());
+			newChunks.push_back({key, data + offset, chunkSize, {{}, static_cast<std::uint32_t>(chunkSize), 1, false}});
+		}
+
+		offset += chunkSize;
+	}
+
+	const auto compressChunk = [&](const int i) {
+		NewChunk& nc = newChunks[i];
+		Chunk& chunk = nc.chunk;
+
+		uLongf compressedSize = compressBound(nc.size);
+		chunk.data.resize(compressedSize);
+
+		// keep chunks that do not compress as they are
+		if (compress2(chunk.data.data(), &compressedSize, nc.data, nc.size, compressionLevel) == Z_OK && compressedSize < nc.size) {
+			chunk.data.resize(compressedSize);
+			chunk.compressed = true;
+		} else {
+			chunk.data.assign(nc.data, nc.data + nc.size);
+		}
+
+		chunk.data.shrink_to_fit();
+	};
+
+	if (compressMT) {
+		for_mt(0, newChunks.size(), compressChunk);
+	} else {
+		for (size_t i = 0; i < newChunks.size(); i++) {
+			compressChunk(i);
+		}
+	}
+
+	for (NewChunk& nc: newChunks) {
+		snapshot.numAddedBytes += nc.chunk.data.size();
+		chunks.emplace(nc.key, std::move(nc.chunk));
+	}
+
+	memoryUsage += (snapshot.numAddedBytes + snapshot.chunks.size() * sizeof(ChunkKey));
+
+	// always keep the latest
+	while (memoryUsage > maxMemory && snapshots.size() > 1) {
+		PopFront();
+	}
+}
+
+
+void CSnapshotStore::PopFront()
+{
+	const Snapshot& snapshot = snapshots.front();
+
+	for (const ChunkKey& key: snapshot.chunks) {
+		const auto it = chunks.find(key);
+
+		assert(it != chunks.end());
+
+		if ((it->second.numRefs -= 1) > 0)
+			continue;
+
+		memoryUsage -= it->second.data.size();
+		chunks.erase(it);
+	}
+
+	memoryUsage -= (snapshot.chunks.size() * sizeof(ChunkKey));
+	snapshots.pop_front();
+}
+
+
+void CSnapshotStore::Clear()
+{
+	snapshots.clear();
+	chunks.clear();
+
+	memoryUsage = 0;
+}
+
+
+const CSnapshotStore::Snapshot* CSnapshotStore::FindNearest(int frameNum) const
+{
+	// snapshots are added in frame order
+	const auto iter = std::partition_point(snapshots.begin(), snapshots.end(), [&](const Snapshot& s) { return (s.frameNum <= frameNum); });
+
+	if (iter == snapshots.begin())
+		return nullptr;
+
+	return &*(iter - 1);
+}
+
+
+bool CSnapshotStore::Restore(const Snapshot& snapshot, std::vector<std::uint8_t>& data) const
+{
+	data.clear();
+	data.resize(snapshot.size);
+
+	size_t offset = 0;
+
+	for (const ChunkKey& key: snapshot.chunks) {
+		const auto it = chunks.find(key);
+
+		if (it == chunks.end())
+			return false;
+
+		const Chunk& chunk = it->second;
+
+		if ((offset + chunk.size) > data.size())
+			return false;
+
+		if (chunk.compressed) {
+			uLongf size = chunk.size;
+
+			if (uncompress(data.data() + offset, &size, chunk.data.data(), chunk.data.size()) != Z_OK || size != chunk.size)
+				return false;
+		} else {
+			std::memcpy(data.data() + offset, chunk.data.data(), chunk.size);
+		}
+
+		offset += chunk.size;
+	}
+
+	return (offset == data.size());
+}
@@ -0,0 +1,92 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef SNAPSHOT_STORE_H
+#define SNAPSHOT_STORE_H
+
+#include "System/UnorderedMap.hpp"
+
+#include <cinttypes>
+#include <deque>
+#include <vector>
+
+/**
+ * @brief Keeps a series of game state snapshots in memory
+ *
+ * Snapshots are cut into chunks at content-defined boundaries (a rolling hash
+ * over the last bytes decides where a chunk ends, so inserting or removing
+ * bytes only changes the chunks around the edit) and only the chunks that did
+ * not already occur in an earlier snapshot are compressed and stored; most of
+ * the state does not change between two snapshots, such that each one costs
+ * little more than its changes. When over the memory limit the oldest
+ * snapshots are dropped, along with the chunks no longer referenced.
+ */
+class CSnapshotStore
+{
+public:
+	static constexpr size_t MIN_CHUNK_SIZE = 2048;
+	static constexpr size_t MAX_CHUNK_SIZE = 65536;
+	/// chunks are 8kB long on average
+	static constexpr int CHUNK_SIZE_BITS = 13;
+
+	struct ChunkKey {
+		std::uint64_t lo;
+		std::uint64_t hi;
+
+		bool operator == (const ChunkKey& k) const { return (lo == k.lo && hi == k.hi); }
+	};
+
+	struct ChunkKeyHash {
+		std::uint32_t operator () (const ChunkKey& k) const { return static_cast<std::uint32_t>(k.lo); }
+	};
+
+	struct Snapshot {
+		int frameNum;
+		std::uint32_t syncChecksum;
+		std::uint64_t size;
+		/// compressed size of the chunks this snapshot added to the store
+		std::uint64_t numAddedBytes;
+
+		std::vector<ChunkKey> chunks;
+	};
+
+public:
+	/// <compressMT> spreads compression over the thread-pool, which must only be used from the main thread
+	CSnapshotStore(size_t maxMemory, int compressionLevel, bool compressMT = true);
+
+	void Add(int frameNum, std::uint32_t syncChecksum, const std::uint8_t* data, size_t size);
+	void Clear();
+
+	/// the latest snapshot taken at or before <frameNum>, nullptr if there is none
+	const Snapshot* FindNearest(int frameNum) const;
+	bool Restore(const Snapshot& snapshot, std::vector<std::uint8_t>& data) const;
+
+	const std::deque<Snapshot>& GetSnapshots() const { return snapshots; }
+	size_t GetNumChunks() const { return chunks.size(); }
+	size_t GetMemoryUsage() const { return memoryUsage; }
+
+	/// offset just past the end of the chunk starting at <data>
+	static size_t FindChunkEnd(const std::uint8_t* data, size_t size);
+
+private:
+	struct Chunk {
+		std::vector<std::uint8_t> data;
+		std::uint32_t size;
+		std::uint32_t numRefs;
+		bool compressed;
+	};
+
+	void PopFront();
+
+private:
+	std::deque<Snapshot> snapshots;
+	spring::unordered_map<ChunkKey, Chunk, ChunkKeyHash> chunks;
+
+	size_t maxMemory;
+	size_t memoryUsage = 0;
+
+	int compressionLevel;
+
+	bool compressMT;
+};
+
+#endif // SNAPSHOT_STORE_H
@@ -40,6 +40,7 @@
  *         CTeam::Statistics for each team.
  *       - Array of all CTeam::Statistics (total number of items is the
  *         sum of the elements in the array of dwords).
+ *     - Optional keyframe index, see DemoKeyFrameIndexHeader.
  *
  * The header is designed to be extensible: it contains a version field and a
  * headerSize field to support this. The version field is a major version number
@@ -115,6 +116,59 @@ struct DemoStreamChunkHeader
 	}
 };
 
+/** The first 16 bytes of the optional keyframe index. */
+#define DEMOFILE_KEYFRAME_INDEX_MAGIC "demo keyframes"
+
+/**
+ * @brief Spring demo keyframe index header
+ *
+ * Demos that were closed cleanly may end with an index of the chunks that
+ * start every keyFrameInterval'th frame, placed directly after the team
+ * statistics:
+ *
+ * - DemoKeyFrameIndexHeader
+ * - numKeyFrames DemoKeyFrame's, sorted by frameNum
+ *
+ * Readers that do not know about the index can ignore it, since it follows
+ * all chunks described by DemoFileHeader.
+ */
+struct DemoKeyFrameIndexHeader
+{
+	char magic[16];               ///< DEMOFILE_KEYFRAME_INDEX_MAGIC
+	int numKeyFrames;             ///< Number of DemoKeyFrame's following this header.
+	int keyFrameInterval;         ///< Number of frames between two keyframes.
+
+	/// Change structure from host endian to little endian or vice versa.
+	void swab() {
+		swabDWordInPlace(numKeyFrames);
+		swabDWordInPlace(keyFrameInterval);
+	}
+};
+
+/**
+ * @brief Spring demo keyframe index entry
+ *
+ * Locates the DemoStreamChunkHeader of a NETMSG_NEWFRAME or NETMSG_KEYFRAME
+ * packet. The compressed stream is fully flushed right before that chunk,
+ * so inflating can also be restarted at gzipOffset (as raw deflate data,
+ * without the preceding history) instead of from the start of the file.
+ */
+struct DemoKeyFrame
+{
+	int frameNum;                 ///< Frame started by the packet in this chunk, the first frame is 0.
+	float modGameTime;            ///< Gametime of the chunk.
+	int fileOffset;               ///< Offset of the chunk in the uncompressed file.
+	int gzipOffset;               ///< Offset of the flush point in the compressed file.
+
+	/// Change structure from host endian to little endian or vice versa.
+	void swab() {
+		swabDWordInPlace(frameNum);
+		swabFloatInPlace(modGameTime);
+		swabDWordInPlace(fileOffset);
+		swabDWordInPlace(gzipOffset);
+	}
+};
+
 #pragma pack(pop)
 
 #endif // DEMO_FILE_H
@@ -0,0 +1,239 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "UDPBatch.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#if defined(__linux__)
+#include <climits>
+#include <sys/uio.h>
+#endif
+
+
+namespace netcode
+{
+
+unsigned UDPRecvBatch::Receive(asio::ip::udp::socket& socket, asio::error_code& err)
+{
+	if (buffers.empty())
+		buffers.resize(MAX_MESSAGES * MAX_MESSAGE_SIZE, 0);
+
+#if defined(__linux__)
+	for (unsigned i = 0; i < MAX_MESSAGES; i++) {
+		iovecs[i].iov_base = &buffers[i * MAX_MESSAGE_SIZE];
+		iovecs[i].iov_len = MAX_MESSAGE_SIZE;
+
+		memset(&headers[i], 0, sizeof(headers[i]));
+		headers[i].msg_hdr.msg_name = endpoints[i].data();
+		headers[i].msg_hdr.msg_namelen = endpoints[i].capacity();
+		headers[i].msg_hdr.msg_iov = &iovecs[i];
+		headers[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	int numReceived = 0;
+
+	while ((numReceived = recvmmsg(socket.native_handle(), headers.data(), MAX_MESSAGES, MSG_DONTWAIT, nullptr)) < 0 && errno == EINTR);
+
+	if (numReceived < 0) {
+		if (errno != EAGAIN && errno != EWOULDBLOCK)
+			err = asio::error_code(errno, asio::system_category());
+
+		return 0;
+	}
+
+	unsigned numMessages = 0;
+
+	for (int i = 0; i < numReceived; i++) {
+		// truncated, can not be a valid packet
+		if ((headers[i].msg_hdr.msg_flags & MSG_TRUNC) != 0)
+			continue;
+
+		endpoints[i].resize(headers[i].msg_hdr.msg_namelen);
+
+		// compact s.t. the valid datagrams are [0, numMessages)
+		if (numMessages != unsigned(i)) {
+			memcpy(&buffers[numMessages * MAX_MESSAGE_SIZE], &buffers[i * MAX_MESSAGE_SIZE], headers[i].msg_len);
+			endpoints[numMessages] = endpoints[i];
+		}
+
+		sizes[numMessages++] = headers[i].msg_len;
+	}
+
+	return numMessages;
+#else
+	unsigned numMessages = 0;
+
+	while (numMessages < MAX_MESSAGES && socket.available(err) > 0 && !err) {
+		asio::ip::udp::socket::message_flags msgFlags = 0;
+
+		sizes[numMessages] = socket.receive_from(asio::buffer(&buffers[numMessages * MAX_MESSAGE_SIZE], MAX_MESSAGE_SIZE), endpoints[numMessages], msgFlags, err);
+
+		if (err)
+			break;
+
+		numMessages++;
+	}
+
+	return numMessages;
+#endif
+}
+
+
+unsigned UDPSendBatch::Add(asio::ip::udp::socket& socket, const std::vector<UDPSegment>& datagram, const asio::ip::udp::endpoint& addr, asio::error_code& err)
+{
+	if (!deferring)
+		return SendNow(socket, datagram, addr, err);
+
+	const bool gather = (datagram.size() <= MAX_SEGMENTS);
+	const size_t bufferSize = buffer.size();
+
+	messages.push_back({segments.size(), 0, addr});
+
+	for (const UDPSegment& s: datagram) {
+		if (gather && s.owner != nullptr) {
+			segments.push_back({s.data, 0, s.size});
+			owners.push_back(*s.owner);
+			continue;
+		}
+
+		// merge with the previous segment if that was copied as well
+		if (segments.size() > messages.back().firstSegment && segments.back().data == nullptr) {
+			segments.back().size += s.size;
+		} else {
+			segments.push_back({nullptr, buffer.size(), s.size});
+		}
+
+		buffer.insert(buffer.end(), s.data, s.data + s.size);
+	}
+
+	messages.back().numSegments = segments.size() - messages.back().firstSegment;
+	return (buffer.size() - bufferSize);
+}
+
+unsigned UDPSendBatch::SendNow(asio::ip::udp::socket& socket, const std::vector<UDPSegment>& datagram, const asio::ip::udp::endpoint& addr, asio::error_code& err)
+{
+	asio::ip::udp::socket::message_flags msgFlags = 0;
+
+	if (datagram.size() > MAX_SEGMENTS) {
+		copyBuffer.clear();
+
+		for (const UDPSegment& s: datagram) {
+			copyBuffer.insert(copyBuffer.end(), s.data, s.data + s.size);
+		}
+
+		socket.send_to(asio::buffer(copyBuffer), addr, msgFlags, err);
+		return copyBuffer.size();
+	}
+
+#if defined(__linux__)
+	iovecs.resize(datagram.size());
+
+	for (size_t i = 0; i < datagram.size(); i++) {
+		iovecs[i].iov_base = const_cast<std::uint8_t*>(datagram[i].data);
+		iovecs[i].iov_len = datagram[i].size;
+	}
+
+	msghdr header;
+	memset(&header, 0, sizeof(header));
+	header.msg_name = const_cast<asio::ip::udp::endpoint&>(addr).data();
+	header.msg_namelen = addr.size();
+	header.msg_iov = iovecs.data();
+	header.msg_iovlen = iovecs.size();
+
+	int ret = 0;
+
+	while ((ret = sendmsg(socket.native_handle(), &header, 0)) < 0 && errno == EINTR);
+
+	if (ret < 0)
+		err = asio::error_code(errno, asio::system_category());
+#else
+	gatherBuffers.clear();
+
+	for (const UDPSegment& s: datagram) {
+		gatherBuffers.emplace_back(s.data, s.size);
+	}
+
+	socket.send_to(gatherBuffers, addr, msgFlags, err);
+#endif
+
+	return 0;
+}
+
+void UDPSendBatch::Send(asio::ip::udp::socket& socket, asio::error_code& err)
+{
+	if (messages.empty())
+		return;
+
+	// resolve copied segments now that the buffer is final
+	for (QueuedSegment& s: segments) {
+		if (s.data == nullptr)
+			s.data = &buffer[s.offset];
+	}
+
+#if defined(__linux__)
+	headers.resize(messages.size());
+	iovecs.resize(segments.size());
+
+	for (size_t i = 0; i < segments.size(); i++) {
+		iovecs[i].iov_base = const_cast<std::uint8_t*>(segments[i].data);
+		iovecs[i].iov_len = segments[i].size;
+	}
+
+	for (size_t i = 0; i < messages.size(); i++) {
+		memset(&headers[i], 0, sizeof(headers[i]));
+		headers[i].msg_hdr.msg_name = messages[i].addr.data();
+		headers[i].msg_hdr.msg_namelen = messages[i].addr.size();
+		headers[i].msg_hdr.msg_iov = &iovecs[messages[i].firstSegment];
+		headers[i].msg_hdr.msg_iovlen = messages[i].numSegments;
+	}
+
+	for (size_t i = 0; i < messages.size(); ) {
+		const int numSent = sendmmsg(socket.native_handle(), &headers[i], std::min<size_t>(messages.size() - i, UIO_MAXIOV), 0);
+
+		if (numSent >= 0) {
+			i += numSent;
+			continue;
+		}
+
+		if (errno == EINTR)
+			continue;
+
+		// the socket buffer is full, the remaining datagrams would also fail
+		if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			err = asio::error::try_again;
+			break;
+		}
+
+		// datagrams are independent, skip the one that failed like send_to would
+		if (!err)
+			err = asio::error_code(errno, asio::system_category());
+
+		i += 1;
+	}
+#else
+	for (const Message& m: messages) {
+		asio::ip::udp::socket::message_flags msgFlags = 0;
+		asio::error_code sendErr;
+
+		gatherBuffers.clear();
+
+		for (size_t i = m.firstSegment; i < (m.firstSegment + m.numSegments); i++) {
+			gatherBuffers.emplace_back(segments[i].data, segments[i].size);
+		}
+
+		socket.send_to(gatherBuffers, m.addr, msgFlags, sendErr);
+
+		if (sendErr && !err)
+			err = sendErr;
+	}
+#endif
+
+	buffer.clear();
+	segments.clear();
+	messages.clear();
+	owners.clear();
+}
+
+}
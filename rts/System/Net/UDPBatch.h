@@ -0,0 +1,140 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef _UDP_BATCH_H
+#define _UDP_BATCH_H
+
+#include <array>
+#include <cinttypes>
+#include <memory>
+#include <vector>
+#include <asio/ip/udp.hpp>
+
+#if defined(__linux__)
+#include <climits>
+#include <sys/socket.h>
+#endif
+
+namespace netcode
+{
+class RawPacket;
+
+/**
+ * @brief Part of a datagram, gathered from wherever it lives at send time
+ * Segments with an owner are referenced (and their owner kept alive while
+ * queued), the bytes of those without one are copied if they need to be.
+ */
+struct UDPSegment {
+	const std::uint8_t* data;
+	unsigned size;
+	const std::shared_ptr<const RawPacket>* owner;
+};
+
+
+/**
+ * @brief Receives the datagrams pending on a socket in batches
+ * On Linux a batch is read with a single recvmmsg call into a pool of
+ * preallocated buffers, elsewhere with one receive_from call per datagram.
+ */
+class UDPRecvBatch
+{
+public:
+	static constexpr unsigned MAX_MESSAGES = 32;
+	/// datagrams larger than this (far above any sane MTU) are dropped
+	static constexpr unsigned MAX_MESSAGE_SIZE = 16384;
+
+	/**
+	 * @brief Receive up to MAX_MESSAGES datagrams without blocking
+	 * @return number of datagrams received, 0 if none were pending or on error
+	 */
+	unsigned Receive(asio::ip::udp::socket& socket, asio::error_code& err);
+
+	const std::uint8_t* GetData(unsigned i) const { return &buffers[i * MAX_MESSAGE_SIZE]; }
+	unsigned GetSize(unsigned i) const { return sizes[i]; }
+	const asio::ip::udp::endpoint& GetEndpoint(unsigned i) const { return endpoints[i]; }
+
+private:
+	// allocated by the first Receive, most connections share their socket
+	std::vector<std::uint8_t> buffers;
+
+	std::array<unsigned, MAX_MESSAGES> sizes;
+	std::array<asio::ip::udp::endpoint, MAX_MESSAGES> endpoints;
+
+#if defined(__linux__)
+	std::array<mmsghdr, MAX_MESSAGES> headers;
+	std::array<iovec, MAX_MESSAGES> iovecs;
+#endif
+};
+
+
+/**
+ * @brief Sends datagrams for all connections on a shared socket in batches
+ * While deferring (UDPListener::Update), datagrams are queued and later sent
+ * by Send with as few sendmmsg calls as possible on Linux; otherwise they are
+ * sent immediately, so flushes outside of a listener update are not delayed.
+ * Datagrams are gathered from their segments (scatter/gather I/O) by both.
+ */
+class UDPSendBatch
+{
+public:
+	/// datagrams consisting of more segments are copied into one
+#if defined(__linux__)
+	static constexpr unsigned MAX_SEGMENTS = IOV_MAX;
+#else
+	static constexpr unsigned MAX_SEGMENTS = 64;
+#endif
+
+	void SetDeferring(bool b) { deferring = b; }
+	bool IsDeferring() const { return deferring; }
+
+	/**
+	 * @brief Queue or send a single datagram gathered from <segments>
+	 * @param err only set if the datagram was sent immediately
+	 * @return number of bytes that had to be copied
+	 */
+	unsigned Add(asio::ip::udp::socket& socket, const std::vector<UDPSegment>& segments, const asio::ip::udp::endpoint& addr, asio::error_code& err);
+
+	/// send all queued datagrams, stops at the first error
+	void Send(asio::ip::udp::socket& socket, asio::error_code& err);
+
+	unsigned GetNumQueued() const { return messages.size(); }
+
+private:
+	unsigned SendNow(asio::ip::udp::socket& socket, const std::vector<UDPSegment>& segments, const asio::ip::udp::endpoint& addr, asio::error_code& err);
+
+private:
+	struct Message {
+		size_t firstSegment;
+		size_t numSegments;
+		asio::ip::udp::endpoint addr;
+	};
+
+	struct QueuedSegment {
+		// nullptr if copied to buffer at <offset>
+		const std::uint8_t* data;
+		size_t offset;
+		size_t size;
+	};
+
+	// copied segments, back to back
+	std::vector<std::uint8_t> buffer;
+	// datagrams with too many segments to gather, when sent immediately
+	std::vector<std::uint8_t> copyBuffer;
+	std::vector<QueuedSegment> segments;
+	std::vector<Message> messages;
+
+	// keep referenced segments alive until sent
+	std::vector< std::shared_ptr<const RawPacket> > owners;
+
+	std::vector<asio::const_buffer> gatherBuffers;
+
+#if defined(__linux__)
+	std::vector<mmsghdr> headers;
+	std::vector<iovec> iovecs;
+#endif
+
+	bool deferring = false;
+};
+
+}
+
+#endif // _UDP_BATCH_H
@@ -143,6 +143,10 @@ void Chunk::UpdateChecksum(CRC& crc) const {
 	if (!data.empty()) {
 		crc.Update(&data[0], data.size());
 	}
+
+	for (const Slice& slice: slices) {
+		crc.Update(slice.packet->data + slice.offset, slice.length);
+	}
 }
 
 
@@ -210,12 +214,24 @@ std::uint8_t Packet::GetChecksum() const
 	return (std::uint8_t)crc.GetDigest();
 }
 
-void Packet::Serialize(std::vector<std::uint8_t>& data)
+void Packet::Serialize(std::vector<std::uint8_t>& headers, std::vector<UDPSegment>& segments)
 {
-	data.clear();
-	data.reserve(GetSize());
+	// segments point into <headers>, which must not reallocate
+	headers.clear();
+	headers.reserve(headerSize + naks.size() + chunks.size() * Chunk::headerSize);
+	segments.clear();
+
+	size_t headersPos = 0;
 
-	Packer buf(data);
+	const auto AddHeaderSegment = [&]() {
+		if (headersPos == headers.size())
+			return;
+
+		segments.push_back({&headers[headersPos], unsigned(headers.size() - headersPos), nullptr});
+		headersPos = headers.size();
+	};
+
+	Packer buf(headers);
 	buf.Pack(lastContinuous);
 	buf.Pack(nakType);
 	buf.Pack(checksum);
@@ -224,17 +240,35 @@ void Packet::Serialize(std::vector<std::uint8_t>& data)
 	for (auto ci = chunks.begin(); ci != chunks.end(); ++ci) {
 		buf.Pack((*ci)->chunkNumber);
 		buf.Pack((*ci)->chunkSize);
-		buf.Pack((*ci)->data);
+
+		if ((*ci)->slices.empty() && (*ci)->data.empty())
+			continue;
+
+		AddHeaderSegment();
+
+		if (!(*ci)->data.empty())
+			segments.push_back({(*ci)->data.data(), unsigned((*ci)->data.size()), nullptr});
+
+		for (const Chunk::Slice& slice: (*ci)->slices) {
+			segments.push_back({slice.packet->data + slice.offset, slice.length, &slice.packet});
+		}
 	}
+
+	AddHeaderSegment();
 }
 
 
 
 
-UDPConnection::UDPConnection(std::shared_ptr<ip::udp::socket> netSocket, const ip::udp::endpoint& myAddr)
+UDPConnection::UDPConnection(
+	std::shared_ptr<ip::udp::socket> netSocket,
+	const ip::udp::endpoint& myAddr,
+	std::shared_ptr<UDPSendBatch> netSendBatch
+)
 	: addr(myAddr)
 	, sharedSocket(true)
 	, mySocket(netSocket)
+	, sendBatch((netSendBatch != nullptr)? netSendBatch: std::make_shared<UDPSendBatch>())
 {
 	Init();
 }
@@ -249,6 +283,8 @@ UDPConnection::UDPConnection(int sourcePort, const std::string& address, const u
 	std::shared_ptr<ip::udp::socket> tempSocket(new ip::udp::socket(
 			netcode::netservice, ip::udp::endpoint(sourceAddr, sourcePort)));
 	mySocket = tempSocket;
+	recvBatch.reset(new UDPRecvBatch());
+	sendBatch.reset(new UDPSendBatch());
 
 	Init();
 }
@@ -307,6 +343,10 @@ void UDPConnection::Init()
 	sentPackets = 0;
 	recvPackets = 0;
 	droppedChunks = 0;
+
+	numChunkAllocs = 0;
+	numCopiedBytes = 0;
+	numGatheredBytes = 0;
 	mtu = globalConfig.mtu;
 	reconnectTime = globalConfig.reconnectTimeout;
 
@@ -330,12 +370,13 @@ void UDPConnection::ReconnectTo(CConnection& conn) {
 }
 
 void UDPConnection::CopyConnection(UDPConnection &conn) {
-	conn.InitConnection(addr, mySocket);
+	conn.InitConnection(addr, mySocket, sendBatch);
 }
 
-void UDPConnection::InitConnection(ip::udp::endpoint address, std::shared_ptr<ip::udp::socket> socket) {
+void UDPConnection::InitConnection(ip::udp::endpoint address, std::shared_ptr<ip::udp::socket> socket, std::shared_ptr<UDPSendBatch> batch) {
 	addr = address;
 	mySocket = socket;
+	sendBatch = batch;
 }
 
 UDPConnection::~UDPConnection()
@@ -441,34 +482,28 @@ void UDPConnection::Update()
 		// duplicated code with UDPListener
 		netservice.poll();
 
-		size_t bytesAvailable = 0;
+		asio::error_code err;
+		unsigned numMessages = 0;
 
-		while ((bytesAvailable = mySocket->available()) > 0) {
-			recvBuffer.clear();
-			recvBuffer.resize(bytesAvailable, 0);
-
-			ip::udp::endpoint udpEndPoint;
-			ip::udp::socket::message_flags msgFlags = 0;
-			asio::error_code err;
-
-			const size_t bytesReceived = mySocket->receive_from(asio::buffer(recvBuffer), udpEndPoint, msgFlags, err);
-
-			if (CheckErrorCode(err))
-				break;
+		while ((numMessages = recvBatch->Receive(*mySocket, err)) > 0) {
+			for (unsigned i = 0; i < numMessages; i++) {
+				if (recvBatch->GetSize(i) < Packet::headerSize)
+					continue;
 
-			if (bytesReceived < Packet::headerSize)
-				continue;
+				if (!IsUsingAddress(recvBatch->GetEndpoint(i)))
+					continue;
 
-			Packet data(&recvBuffer[0], bytesReceived);
-
-			if (IsUsingAddress(udpEndPoint))
+				Packet data(recvBatch->GetData(i), recvBatch->GetSize(i));
 				ProcessRawPacket(data);
+			}
 
 			// not likely, but make sure we do not get stuck here
 			if ((spring_gettime() - curTime) > spring_msecs(10)) {
 				break;
 			}
 		}
+
+		CheckErrorCode(err);
 	}
 
 
@@ -714,12 +749,14 @@ void UDPConnection::Flush(const bool forced)
 	}
 
 	if (forced || (!waitMore && outgoingLength > requiredLength)) {
-		std::uint8_t buffer[udpMaxPacketSize];
 		unsigned pos = 0;
+		// offset of the next byte to send of the front packet
+		unsigned offset = 0;
 
 		// Manually fragment packets to respect configured UDP_MTU.
 		// This is an attempt to fix the bug where players drop out
 		// of the game if someone in the game gives a large order.
+		// Chunks only reference the (possibly broadcast) packets.
 		bool partialPacket = false;
 		bool sendMore = true;
 
@@ -728,7 +765,7 @@ void UDPConnection::Flush(const bool forced)
 			sendMore |= ((globalConfig.linkOutgoingBandwidth <= 0) || partialPacket || forced);
 
 			if (!outgoingData.empty() && sendMore) {
-				std::shared_ptr<const RawPacket>& packet = *(outgoingData.begin());
+				const std::shared_ptr<const RawPacket>& packet = *(outgoingData.begin());
 
 				if (!partialPacket && !ProtocolDef::GetInstance()->IsValidPacket(packet->data, packet->length)) {
 					LOG_L(L_ERROR,
@@ -737,27 +774,28 @@ void UDPConnection::Flush(const bool forced)
 					);
 					outgoingData.pop_front();
 				} else {
-					const unsigned numBytes = std::min((unsigned)maxChunkSize - pos, packet->length);
+					const unsigned numBytes = std::min((unsigned)maxChunkSize - pos, packet->length - offset);
 
 					assert(packet->length > 0);
-					memcpy(buffer + pos, packet->data, numBytes);
+					chunkSlices.push_back({packet, offset, numBytes});
 
 					pos += numBytes;
+					offset += numBytes;
 					sentOverhead += Packet::headerSize;
 
 					outgoing.DataSent(numBytes, true);
 
-					if ((partialPacket = (numBytes != packet->length))) {
-						// partially transfered
-						packet.reset(new RawPacket(packet->data + numBytes, packet->length - numBytes));
+					if ((partialPacket = (offset != packet->length))) {
+						// partially transfered, continue at offset
 					} else {
-						// full packet copied
+						// full packet referenced
 						outgoingData.pop_front();
+						offset = 0;
 					}
 				}
 			}
 			if ((pos > 0) && (outgoingData.empty() || (pos == maxChunkSize) || !sendMore)) {
-				CreateChunk(buffer, pos, currentPacketChunkNum++);
+				CreateChunk(pos, currentPacketChunkNum++);
 				pos = 0;
 			}
 		} while (!outgoingData.empty() && sendMore);
@@ -809,6 +847,7 @@ std::string UDPConnection::Statistics() const
 		"\t{%.3fx, %.3fx} relative protocol overhead {up, down}\n",
 		"\t%u incoming chunks dropped, %u outgoing chunks resent\n",
 		"\t%u incoming chunks processed\n",
+		"\t%u outgoing chunks allocated, %" PRIu64 " bytes copied and %" PRIu64 " referenced when sending\n",
 	};
 
 	std::string msg = "[UDPConnection::Statistics]\n";
@@ -817,6 +856,7 @@ std::string UDPConnection::Statistics() const
 	msg += spring::format(fmts[2], spring::SafeDivide(sentOverhead * 1.0f, dataSent * 1.0f), spring::SafeDivide(recvOverhead * 1.0f, dataRecv * 1.0f));
 	msg += spring::format(fmts[3], droppedChunks, resentChunks);
 	msg += spring::format(fmts[4], lastInOrder + 1);
+	msg += spring::format(fmts[5], numChunkAllocs, numCopiedBytes, numGatheredBytes);
 	return msg;
 }
 
@@ -832,15 +872,22 @@ void UDPConnection::SetMTU(unsigned mtu2)
 	}
 }
 
-void UDPConnection::CreateChunk(const unsigned char* data, const unsigned length, const int packetNum)
+void UDPConnection::CreateChunk(const unsigned length, const int packetNum)
 {
 	assert((length > 0) && (length < 255));
 	ChunkPtr buf(new Chunk);
 	buf->chunkNumber = packetNum;
 	buf->chunkSize = length;
-	std::copy(data, data + length, std::back_inserter(buf->data));
+	buf->slices.swap(chunkSlices);
+
+	if (!spareChunkSlices.empty()) {
+		chunkSlices.swap(spareChunkSlices.back());
+		spareChunkSlices.pop_back();
+	}
+
 	newChunks.push_back(buf);
 	lastChunkCreatedTime = spring_gettime();
+	numChunkAllocs += 1;
 }
 
 void UDPConnection::SendIfNecessary(bool flushed)
@@ -1048,28 +1095,51 @@ void UDPConnection::SendIfNecessary(bool flushed)
 
 void UDPConnection::SendPacket(Packet& pkt)
 {
-	pkt.Serialize(sendBuffer);
+	pkt.Serialize(sendBuffer, sendSegments);
+
+	const unsigned packetSize = pkt.GetSize();
 
-	outgoing.DataSent(sendBuffer.size());
+	outgoing.DataSent(packetSize);
 	lastPacketSendTime = spring_gettime();
 
-	ip::udp::socket::message_flags flags = 0;
 	asio::error_code err;
 
+	#if NETWORK_TEST
+	// EMULATE_LATENCY keeps its own copy
+	ip::udp::socket::message_flags flags = 0;
+	std::vector<std::uint8_t> data;
+
+	for (const UDPSegment& s: sendSegments) {
+		data.insert(data.end(), s.data, s.data + s.size);
+	}
+	#endif
+
+	// headers are always packed into sendBuffer, chunk payloads never are
+	numCopiedBytes += sendBuffer.size();
+	numGatheredBytes += (packetSize - sendBuffer.size());
+
 	EMULATE_LATENCY( !EMULATE_PACKET_LOSS( LOSS_COUNTER ) ) {
-		mySocket->send_to(buffer(sendBuffer), addr, flags, err);
+		numCopiedBytes += sendBatch->Add(*mySocket, sendSegments, addr, err);
 	}
 
 	if (CheckErrorCode(err))
 		return;
 
-	dataSent += sendBuffer.size();
+	dataSent += packetSize;
 	sentPackets += 1;
 }
 
 void UDPConnection::AckChunks(int lastAck)
 {
 	while (!unackedChunks.empty() && (lastAck >= (*unackedChunks.begin())->chunkNumber)) {
+		ChunkPtr& chunk = unackedChunks.front();
+
+		// keep the slice storage unless a resend request still holds the chunk
+		if (chunk.use_count() == 1 && chunk->slices.capacity() > 0) {
+			chunk->slices.clear();
+			spareChunkSlices.emplace_back(std::move(chunk->slices));
+		}
+
 		unackedChunks.pop_front();
 	}
 
@@ -8,6 +8,7 @@
 #include <deque>
 
 #include "Connection.h"
+#include "UDPBatch.h"
 #include "System/Misc/SpringTime.h"
 #include "System/UnorderedSet.hpp"
 
@@ -29,13 +30,23 @@ namespace netcode {
 class Chunk
 {
 public:
-	unsigned GetSize() const { return (data.size() + headerSize); }
+	/// part of an outgoing packet, which can be shared by all connections it was broadcast to
+	struct Slice {
+		std::shared_ptr<const RawPacket> packet;
+		std::uint32_t offset;
+		std::uint32_t length;
+	};
+
+	unsigned GetSize() const { return (chunkSize + headerSize); }
 	void UpdateChecksum(CRC& crc) const;
 	static constexpr unsigned maxSize = 254;
 	static constexpr unsigned headerSize = 5;
 	std::int32_t chunkNumber;
 	std::uint8_t chunkSize;
+	/// payload of received chunks
 	std::vector<std::uint8_t> data;
+	/// payload of created chunks, referenced instead of copied
+	std::vector<Slice> slices;
 };
 typedef std::shared_ptr<Chunk> ChunkPtr;
 
@@ -54,7 +65,8 @@ public:
 
 	std::uint8_t GetChecksum() const;
 
-	void Serialize(std::vector<std::uint8_t>& data);
+	/// packs the headers into <headers>, <segments> gathers them with the chunk payloads
+	void Serialize(std::vector<std::uint8_t>& headers, std::vector<UDPSegment>& segments);
 
 	std::int32_t lastContinuous;
 	/// if < 0, we lost -x packets since lastContinuous
@@ -81,7 +93,11 @@ public:
 class UDPConnection : public CConnection
 {
 public:
-	UDPConnection(std::shared_ptr<asio::ip::udp::socket> netSocket, const asio::ip::udp::endpoint& myAddr);
+	UDPConnection(
+		std::shared_ptr<asio::ip::udp::socket> netSocket,
+		const asio::ip::udp::endpoint& myAddr,
+		std::shared_ptr<UDPSendBatch> netSendBatch = nullptr
+	);
 	UDPConnection(int sourceport, const std::string& address, const unsigned port);
 	UDPConnection(CConnection& conn);
 	~UDPConnection();
@@ -136,7 +152,8 @@ public:
 
 private:
 	void InitConnection(asio::ip::udp::endpoint address,
-			std::shared_ptr<asio::ip::udp::socket> socket);
+			std::shared_ptr<asio::ip::udp::socket> socket,
+			std::shared_ptr<UDPSendBatch> batch);
 
 	void CopyConnection(UDPConnection& conn);
 
@@ -144,8 +161,8 @@ private:
 
 	void Init();
 
-	/// add header to data and send it
-	void CreateChunk(const unsigned char* data, const unsigned length, const int packetNum);
+	/// add header to the slices collected in chunkSlices and queue it for sending
+	void CreateChunk(const unsigned length, const int packetNum);
 	void SendIfNecessary(bool flushed);
 	void AckChunks(int lastAck);
 
@@ -203,7 +220,12 @@ private:
 	std::deque< std::shared_ptr<const RawPacket> > msgQueue;
 
 	std::vector<std::uint8_t> sendBuffer;
-	std::vector<std::uint8_t> recvBuffer;
+	std::vector<UDPSegment> sendSegments;
+	std::vector<Chunk::Slice> chunkSlices;
+	/// slice vectors of acked chunks, handed to the next chunks created
+	std::vector< std::vector<Chunk::Slice> > spareChunkSlices;
+	/// only used for a socket of our own, the listener receives for shared ones
+	std::unique_ptr<UDPRecvBatch> recvBatch;
 	std::vector<std::uint8_t> waitBuffer;
 
 	std::vector<int> droppedPackets;
@@ -221,6 +243,8 @@ private:
 
 	/// Our socket
 	std::shared_ptr<asio::ip::udp::socket> mySocket;
+	/// shared by all connections of a listener (which sends their packets per update), or our own
+	std::shared_ptr<UDPSendBatch> sendBatch;
 
 	RawPacket fragmentBuffer;
 
@@ -244,6 +268,11 @@ private:
 	unsigned int sentOverhead, recvOverhead;
 	unsigned int sentPackets, recvPackets;
 
+	/// outgoing chunks allocated, bytes copied and referenced when sending them
+	unsigned int numChunkAllocs;
+	std::uint64_t numCopiedBytes;
+	std::uint64_t numGatheredBytes;
+
 	class BandwidthUsage {
 	public:
 		BandwidthUsage() = default;
@@ -3,6 +3,7 @@
 #ifndef _UDP_LISTENER_H
 #define _UDP_LISTENER_H
 
+#include "UDPBatch.h"
 #include "System/Misc/NonCopyable.h"
 #include <memory>
 #include <asio/ip/udp.hpp>
@@ -51,7 +52,8 @@ public:
 	/**
 	 * @brief Run this from time to time
 	 * Recieve data from the socket and hand it to the associated UDPConnection,
-	 * or open a new UDPConnection. It also Updates all of its connections.
+	 * or open a new UDPConnection. It also Updates all of its connections and
+	 * sends the packets they created in one batch.
 	 */
 	void Update();
 
@@ -75,6 +77,9 @@ public:
 	void RejectConnection() { waiting.pop(); }
 	void UpdateConnections(); // Updates connections when the endpoint has been reconnected
 
+private:
+	void ProcessDatagram(const std::uint8_t* data, unsigned size, const asio::ip::udp::endpoint& udpEndPoint);
+
 private:
 	/**
 	 * @brief Do we accept packets from unknown sources?
@@ -85,7 +90,8 @@ private:
 	/// socket being listened on
 	std::shared_ptr<asio::ip::udp::socket> socket;
 
-	std::vector<std::uint8_t> recvBuffer;
+	UDPRecvBatch recvBatch;
+	std::shared_ptr<UDPSendBatch> sendBatch;
 
 	/// all connections
 	std::map< asio::ip::udp::endpoint, std::weak_ptr<UDPConnection> > connMap;
@@ -42,6 +42,7 @@
 #include "Game/UI/ScanCodes.h"
 #include "Game/UI/InfoConsole.h"
 #include "Game/UI/MouseHandler.h"
+#include "Lua/LuaBytecodeCache.h"
 #include "Lua/LuaOpenGL.h"
 #include "Lua/LuaVFSDownload.h"
 #include "Menu/LuaMenuController.h"
@@ -107,6 +108,7 @@
 CONFIG(unsigned, SetCoreAffinity).defaultValue(0).safemodeValue(1).description("Defines a bitmask indicating which CPU cores the main-thread should use.");
 CONFIG(unsigned, TextureMemPoolSize).defaultValue(512).minimumValue(0).description("Set to 0 to disable, otherwise specify a predefined memory to serve Bitmap allocation requests");
 CONFIG(bool, UseLuaMemPools).defaultValue(true).description("Whether Lua VM memory allocations are made from pools.");
+CONFIG(bool, UseLuaBytecodeCache).defaultValue(true).safemodeValue(false).description("Whether compiled Lua code is kept in the cache directory such that unchanged widgets, gadgets and defs are not parsed again on the next start.");
 CONFIG(bool, UseHighResTimer).defaultValue(false).description("On Windows, sets whether Spring will use low- or high-resolution timer functions for tasks like graphical interpolation between game frames.");
 CONFIG(bool, UseFontConfigLib).defaultValue(true).description("Whether the system fontconfig library (if present and enabled at compile-time) should be used for handling fonts.");
 CONFIG(int, MaxFontTries).defaultValue(5).description("Represents the maximum number of attempts to search for a glyph replacement using the FontConfig library (lower = foreign glyphs may fail to render, higher = searching for foreign glyphs can lag the game).");
@@ -265,6 +267,8 @@ bool SpringApp::Init()
 	if (!InitFileSystem())
 		return false;
 
+	LuaBytecodeCache::Init(configHandler->GetBool("UseLuaBytecodeCache"));
+
 	// Multithreading & Affinity
 	Threading::SetThreadName("spring-main"); // set default threadname for pstree
 	Threading::SetThreadScheduler();
@@ -977,6 +981,7 @@ void SpringApp::Kill(bool fromRun)
 	spring::SafeDelete(luaMenuController);
 
 	LuaMemPool::KillStatic();
+	LuaBytecodeCache::Kill();
 
 	LOG("[SpringApp::%s][3]", __func__);
 	spring::SafeDelete(clientNet);
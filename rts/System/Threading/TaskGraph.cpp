@@ -0,0 +1,165 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "TaskGraph.h"
+
+#include <utility>
+
+#include "System/Threading/ThreadPool.h"
+#include "System/Misc/TracyDefs.h"
+
+#ifndef UNIT_TEST
+#include "System/TimeProfiler.h"
+#include "System/StringHash.h"
+#endif
+
+
+void CTaskGraph::Clear()
+{
+	nodes.clear();
+	waveNodes.clear();
+
+	numWaves = 0;
+}
+
+int CTaskGraph::AddNode(
+	const char* name,
+	TaskFunc&& taskFunc,
+	ResourceMask reads,
+	ResourceMask writes,
+	bool callerThread,
+	AccessFunc&& accessFunc
+) {
+	Node& node = nodes.emplace_back();
+
+	node.name = name;
+	node.taskFunc = std::move(taskFunc);
+	node.accessFunc = std::move(accessFunc);
+	node.reads = reads;
+	node.writes = writes;
+	node.callerThread = callerThread;
+
+	#ifndef UNIT_TEST
+	node.nameHash = hashString(name);
+	CTimeProfiler::RegisterTimer(name);
+	#endif
+
+	return (nodes.size() - 1);
+}
+
+
+void CTaskGraph::Run(bool parallel)
+{
+	RECOIL_DETAILED_TRACY_ZONE;
+
+	numWaves = 0;
+
+	if (!parallel || !ThreadPool::HasThreads()) {
+		// reference order; nodes are never skipped here s.t. the
+		// result does not depend on the AccessFunc's being right
+		for (Node& node: nodes) {
+			node.active = true;
+			node.wave = -1;
+
+			RunNode(node);
+		}
+
+		return;
+	}
+
+	for (size_t i = 0, n = nodes.size(); i < n; ) {
+		ResourceMask waveReads = 0;
+		ResourceMask waveWrites = 0;
+
+		int callerNode = -1;
+
+		waveNodes.clear();
+
+		for (; i < n; ++i) {
+			Node& node = nodes[i];
+
+			// the AccessFunc result is only final once every earlier
+			// node writing what this one reads is done, i.e. not part
+			// of the current wave
+			if ((waveWrites & node.reads) != 0)
+				break;
+
+			node.curReads = node.reads;
+			node.curWrites = node.writes;
+			node.active = (node.accessFunc == nullptr || node.accessFunc(node.curReads, node.curWrites));
+			node.wave = -1;
+
+			// skipped nodes are no-ops and commute with everything
+			if (!node.active)
+				continue;
+
+			if (Conflicts(waveReads, waveWrites, node.curReads, node.curWrites))
+				break;
+
+			if (node.callerThread) {
+				if (callerNode >= 0)
+					break;
+
+				callerNode = i;
+			} else {
+				waveNodes.push_back(i);
+			}
+
+			node.wave = numWaves;
+
+			waveReads |= node.curReads;
+			waveWrites |= node.curWrites;
+		}
+
+		if (callerNode < 0 && waveNodes.empty())
+			continue;
+
+		RunWave(callerNode);
+
+		numWaves += 1;
+	}
+}
+
+void CTaskGraph::RunWave(int callerNode)
+{
+	RECOIL_DETAILED_TRACY_ZONE;
+
+	if (waveNodes.empty()) {
+		RunNode(nodes[callerNode]);
+		return;
+	}
+
+	if (callerNode < 0 && waveNodes.size() == 1) {
+		RunNode(nodes[waveNodes[0]]);
+		return;
+	}
+
+	for_mt_with_caller(0, waveNodes.size(), [&](const int k) {
+		RunNode(nodes[waveNodes[k]]);
+	}, [&]() {
+		if (callerNode >= 0)
+			RunNode(nodes[callerNode]);
+	});
+}
+
+void CTaskGraph::RunNode(Node& node)
+{
+	// one zone per stage like the SCOPED_TIMER's it replaces, on any thread
+	ZoneTransientN(nodeZone, node.name, true);
+
+	// a stage sees the flag as in the reference order whichever thread runs
+	// it (workers always have it raised), loops inside it raise it again
+	const bool wasInMultiThreadedSection = std::exchange(ThreadPool::inMultiThreadedSection, false);
+	const spring_time t0 = spring_now();
+
+	{
+		#ifndef UNIT_TEST
+		ScopedMtTimer timer(node.nameHash);
+		#endif
+
+		node.taskFunc();
+	}
+
+	node.lastTime = spring_now() - t0;
+
+	ThreadPool::inMultiThreadedSection = wasInMultiThreadedSection;
+}
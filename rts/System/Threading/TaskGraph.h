@@ -0,0 +1,104 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#ifndef TASK_GRAPH_H
+#define TASK_GRAPH_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "System/Misc/SpringTime.h"
+
+/**
+ * @brief graph of coarse-grained tasks executed once per Run
+ *
+ * Every node declares the resources it reads and writes as bitmasks. Nodes
+ * are added in their reference (serial) order and a node depends on each
+ * earlier node it conflicts with, i.e. when either one writes a resource the
+ * other reads or writes. Any schedule respecting those edges therefore has
+ * the same effect as the serial order.
+ *
+ * A parallel Run walks the nodes in that order and gathers consecutive ones
+ * into waves of mutually independent nodes, each wave then executes on the
+ * thread pool. Nodes that must stay on the calling thread (Lua, synced code)
+ * can be marked as such, at most one of them is part of any wave.
+ */
+class CTaskGraph
+{
+public:
+	typedef uint64_t ResourceMask;
+	typedef std::function<void()> TaskFunc;
+	// called during a parallel Run once all earlier nodes writing anything the
+	// node declared to read have finished; may narrow the node's access masks
+	// for this run or return false if the task would do nothing this time (in
+	// which case it is skipped), and must only look at state covered by those
+	// declared reads
+	typedef std::function<bool(ResourceMask& reads, ResourceMask& writes)> AccessFunc;
+
+	struct Node {
+		const char* name = "";
+		unsigned nameHash = 0;
+
+		TaskFunc taskFunc;
+		AccessFunc accessFunc;
+
+		ResourceMask reads = 0;
+		ResourceMask writes = 0;
+		// masks and wave of the current run
+		ResourceMask curReads = 0;
+		ResourceMask curWrites = 0;
+
+		int wave = -1;
+
+		bool callerThread = false;
+		bool active = false;
+
+		spring_time lastTime;
+	};
+
+public:
+	static bool Conflicts(ResourceMask readsA, ResourceMask writesA, ResourceMask readsB, ResourceMask writesB) {
+		return (((writesA & (readsB | writesB)) | (writesB & readsA)) != 0);
+	}
+
+	void Clear();
+
+	/**
+	 * @param name timer name, must be a literal (registered with the profiler)
+	 * @param callerThread if true the node always runs on the thread calling Run
+	 * @return index of the new node
+	 */
+	int AddNode(
+		const char* name,
+		TaskFunc&& taskFunc,
+		ResourceMask reads,
+		ResourceMask writes,
+		bool callerThread = false,
+		AccessFunc&& accessFunc = nullptr
+	);
+
+	/**
+	 * executes all nodes; serially in declaration order or wave by wave
+	 * with independent nodes overlapping on the worker threads
+	 */
+	void Run(bool parallel);
+
+	const std::vector<Node>& GetNodes() const { return nodes; }
+
+	size_t GetNumNodes() const { return nodes.size(); }
+	// number of waves executed by the last Run, zero if it was serial
+	size_t GetNumWaves() const { return numWaves; }
+
+private:
+	void RunWave(int callerNode);
+	void RunNode(Node& node);
+
+private:
+	std::vector<Node> nodes;
+	// indices of the current wave's nodes that may run on any thread
+	std::vector<int> waveNodes;
+
+	size_t numWaves = 0;
+};
+
+#endif
@@ -42,6 +42,7 @@
 
 #ifndef UNIT_TEST
 CONFIG(int, WorkerThreadCount).defaultValue(-1).safemodeValue(0).minimumValue(-1).description("Number of workers (including the main thread!) used by ThreadPool.");
+CONFIG(bool, WorkerThreadStealing).defaultValue(false).safemodeValue(false).description("Run parallel loops (for_mt) with a work-stealing scheduler using per-thread deques instead of shared task queues.");
 #endif
 
 
@@ -62,7 +63,7 @@ struct ThreadStats {
 static std::vector< spring::thread > extThreads;
 static std::vector< std::future<void> > extFutures;
 
-bool ThreadPool::inMultiThreadedSection;
+thread_local bool ThreadPool::inMultiThreadedSection = false;
 
 // global [idx = 0] and smaller per-thread [idx > 0] queues; the latter are
 // for tasks that want to execute on specific threads, e.g. parallel_reduce
@@ -80,6 +81,114 @@ static spring::signal newTasksSignal[2];
 
 static _threadlocal int threadnum(0);
 
+
+
+// Chase-Lev deque of loop ranges; only the owning thread pushes and takes
+// (at the bottom), any thread can steal (from the top, i.e. the ranges that
+// were split off first and are largest)
+// see "Correct and Efficient Work-Stealing for Weak Memory Models" (Le et al.)
+class WorkStealingDeque
+{
+public:
+	struct Range {
+		ThreadPool::WorkStealingJob* job;
+		int b;
+		int e;
+	};
+
+	bool Push(const Range& r) {
+		const int64_t b = bottom.load(std::memory_order_relaxed);
+		const int64_t t = top.load(std::memory_order_acquire);
+
+		// full, caller runs the range itself
+		if ((b - t) >= int64_t(slots.size()))
+			return false;
+
+		Slot& slot = slots[b & (slots.size() - 1)];
+		slot.job.store(r.job, std::memory_order_relaxed);
+		slot.b.store(r.b, std::memory_order_relaxed);
+		slot.e.store(r.e, std::memory_order_relaxed);
+
+		std::atomic_thread_fence(std::memory_order_release);
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	bool Take(Range& r) {
+		const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+
+		bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		int64_t t = top.load(std::memory_order_relaxed);
+
+		if (t > b) {
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return false;
+		}
+
+		Read(b, r);
+
+		// last element, race against thieves
+		if (t == b) {
+			const bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return won;
+		}
+
+		return true;
+	}
+
+	bool Steal(Range& r) {
+		int64_t t = top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const int64_t b = bottom.load(std::memory_order_acquire);
+
+		if (t >= b)
+			return false;
+
+		// slot might be overwritten after this, result is discarded then
+		Read(t, r);
+
+		return (top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed));
+	}
+
+	bool Empty() const {
+		return (top.load(std::memory_order_relaxed) >= bottom.load(std::memory_order_relaxed));
+	}
+
+private:
+	void Read(int64_t i, Range& r) const {
+		const Slot& slot = slots[i & (slots.size() - 1)];
+
+		r.job = slot.job.load(std::memory_order_relaxed);
+		r.b = slot.b.load(std::memory_order_relaxed);
+		r.e = slot.e.load(std::memory_order_relaxed);
+	}
+
+private:
+	struct Slot {
+		std::atomic<ThreadPool::WorkStealingJob*> job = {nullptr};
+		std::atomic<int> b = {0};
+		std::atomic<int> e = {0};
+	};
+
+	// each nesting level of a loop needs at most log2(numElems) slots
+	std::array<Slot, 1024> slots;
+
+	alignas(64) std::atomic<int64_t> top = {0};
+	alignas(64) std::atomic<int64_t> bottom = {0};
+};
+
+static std::array<WorkStealingDeque, ThreadPool::MAX_THREADS> workStealingDeques;
+
+// set for the synced workers and for the thread owning deque 0 (normally main)
+// while it runs a loop; async workers share thread numbers with synced ones
+static _threadlocal bool ownsDeque(false);
+static std::atomic_bool mainDequeInUse = {false};
+
+static bool workStealing = false;
+
 #ifndef UNITSYNC
 // if enabled, allows OpenGL calls from ThreadPool tasks
 // so certain logic (e.g. loading models) can be written
@@ -133,6 +242,61 @@ bool HasThreads() { return !workerThreads[false].empty(); }
 
 
 
+static void ExecuteWorkStealingRange(int tid, WorkStealingDeque::Range r)
+{
+	ThreadPool::WorkStealingJob* job = r.job;
+
+	assert(ownsDeque);
+
+	// keep the first half, leave the second for ourselves or thieves; stolen
+	// ranges are the largest ones, so splitting them matters most
+	while ((r.e - r.b) > job->grainSize && (r.e - r.b) >= (job->minSplitSize * 2)) {
+		const int m = r.b + (r.e - r.b) / 2;
+
+		if (!workStealingDeques[tid].Push({job, m, r.e}))
+			break;
+
+		r.e = m;
+	}
+
+	job->execFunc(job, r.b, r.e);
+
+	// job can be gone right after this
+	job->remaining.fetch_sub(r.e - r.b, std::memory_order_release);
+}
+
+static bool RunWorkStealingRange(int tid)
+{
+	WorkStealingDeque::Range r;
+
+	// a thread without a deque could not split what it steals and would
+	// run the largest ranges on its own, leave those to the deque owners
+	if (!ownsDeque)
+		return false;
+
+	if (workStealingDeques[tid].Take(r)) {
+		ExecuteWorkStealingRange(tid, r);
+		return true;
+	}
+
+	// start at a different victim per thread to spread out contention
+	const int numThreads = GetNumThreads();
+
+	for (int n = 1; n < numThreads; ++n) {
+		const int victim = (tid + n) % numThreads;
+
+		if (workStealingDeques[victim].Empty())
+			continue;
+		if (!workStealingDeques[victim].Steal(r))
+			continue;
+
+		ExecuteWorkStealingRange(tid, r);
+		return true;
+	}
+
+	return false;
+}
+
 static bool DoTask(int tid, bool async)
 {
 	#ifndef UNIT_TEST
@@ -141,6 +305,9 @@ static bool DoTask(int tid, bool async)
 
 	ITaskGroup* tg = nullptr;
 
+	if (!async && workStealing && RunWorkStealingRange(tid))
+		return true;
+
 	// any external thread calling WaitForFinished will have
 	// id=0 and *only* processes tasks from the global queue
 	for (int idx = 0; idx <= tid; idx += std::max(tid, 1)) {
@@ -210,6 +377,9 @@ static void WorkerLoop(int tid, bool async)
 {
 	assert(tid != 0);
 	SetThreadNum(tid);
+	ownsDeque = !async;
+	// sync workers only ever execute parallel loop bodies
+	inMultiThreadedSection = !async;
 	#ifndef UNIT_TEST
 	Threading::SetThreadName(IntToString(tid, "worker%i"));
 	#endif
@@ -294,6 +464,69 @@ void WaitForFinished(std::shared_ptr<ITaskGroup>&& taskGroup)
 }
 
 
+bool ExecuteWorkStealingJob(WorkStealingJob& job, int numElems)
+{
+	const int tid = GetThreadNum();
+
+	// deque 0 belongs to whichever thread with id 0 (main or external) gets it
+	// first, the other ones use the task-group path; nested loops keep it
+	const bool claimDeque = (tid == 0 && !ownsDeque);
+
+	if (claimDeque && mainDequeInUse.exchange(true))
+		return false;
+	if (!ownsDeque && !claimDeque)
+		return false;
+
+	ownsDeque = true;
+
+	{
+		#ifndef UNIT_TEST
+		SCOPED_MT_TIMER("ThreadPool::WaitFor");
+		#endif
+
+		job.remaining.store(numElems, std::memory_order_relaxed);
+
+		if (!workStealingDeques[tid].Push({&job, 0, numElems})) {
+			job.execFunc(&job, 0, numElems);
+			job.remaining.store(0, std::memory_order_relaxed);
+		} else {
+			NotifyWorkerThreads(false, false);
+		}
+
+		// help until all ranges of this job (including stolen ones) are done;
+		// when there is nothing left to take or steal the remaining ranges
+		// are running elsewhere, so back off instead of hammering the deques
+		for (int numIdle = 0; job.remaining.load(std::memory_order_acquire) > 0; ) {
+			if (RunWorkStealingRange(tid)) {
+				numIdle = 0;
+				continue;
+			}
+
+			if (numIdle < 6) {
+				for (int i = 0, n = 1 << numIdle; i < n; ++i) {
+					_mm_pause();
+				}
+
+				numIdle += 1;
+			} else {
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	if (claimDeque) {
+		assert(workStealingDeques[tid].Empty());
+		ownsDeque = false;
+		mainDequeInUse.store(false);
+	}
+
+	return true;
+}
+
+void SetWorkStealing(bool enable) { workStealing = enable; }
+bool UseWorkStealing() { return workStealing; }
+
+
 // WARNING:
 //   leaking the raw pointer *forces* caller to WaitForFinished
 //   otherwise task might get deleted while its pointer is still
@@ -475,6 +708,10 @@ void SetThreadCount(int wantedNumThreads)
 	if (workerThreads[false].empty()) {
 		assert(workerThreads[true].empty());
 
+		#ifndef UNIT_TEST
+		workStealing = configHandler->GetBool("WorkerThreadStealing");
+		#endif
+
 		#ifdef USE_BOOST_LOCKFREE_QUEUE
 		taskQueues[false][0].reserve(1024);
 		taskQueues[ true][0].reserve(1024);
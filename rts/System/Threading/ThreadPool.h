@@ -26,6 +26,8 @@ namespace ThreadPool {
 	static inline int GetNumThreads() { return 1; }
 	static inline void NotifyWorkerThreads(bool force, bool async) {}
 	static inline bool HasThreads() { return false; }
+	static inline void SetWorkStealing(bool enable) {}
+	static inline bool UseWorkStealing() { return false; }
 
 	static constexpr int MAX_THREADS = 1;
 }
@@ -50,6 +52,13 @@ static inline void for_mt_chunk(int b, int e, F&& f, int chunkSize = 0)
 	for_mt(b, e, f);
 }
 
+template <typename F, typename G>
+static inline void for_mt_with_caller(int start, int end, F&& f, G&& g)
+{
+	g();
+	for_mt(start, end, f);
+}
+
 
 static inline void parallel(const std::function<void()>&& f)
 {
@@ -75,6 +84,7 @@ static inline auto parallel_reduce(F&& f, G&& g) -> std::invoke_result_t<F>
 
 #undef gt
 #include <memory>
+#include <utility>
 
 #ifdef UNITSYNC
 	#undef SCOPED_MT_TIMER
@@ -109,7 +119,16 @@ namespace ThreadPool {
 	int GetNumThreads();
 	void NotifyWorkerThreads(bool force, bool async);
 
-	extern bool inMultiThreadedSection;
+	// selects the work-stealing scheduler for for_mt and for_mt_chunk; the
+	// config value is read when the pool is (re)created, changing it is only
+	// safe while no parallel loops are running
+	void SetWorkStealing(bool enable);
+	bool UseWorkStealing();
+
+	// true while this thread executes the body of a parallel loop; always
+	// set on the (non-async) workers, the calling thread raises it for the
+	// duration of for_mt and friends
+	extern thread_local bool inMultiThreadedSection;
 
 	static constexpr int MAX_THREADS = 32;
 }
@@ -670,16 +689,68 @@ struct TaskPool {
 };
 
 
+namespace ThreadPool {
+	// a parallel loop over the index range [0, numElems) run by the work-stealing
+	// scheduler; lives on the stack of the calling thread which helps executing
+	// ranges (its own or stolen ones) until no indices remain
+	struct WorkStealingJob {
+		void (*execFunc)(const WorkStealingJob* job, int b, int e);
+		void* userFunc;
+
+		int start;
+		int step;
+
+		// ranges are split in halves while larger than grainSize, as long
+		// as neither half becomes smaller than minSplitSize
+		int grainSize;
+		int minSplitSize;
+
+		std::atomic<int> remaining;
+	};
+
+	// returns false if the calling thread can not take part in work-stealing
+	// (e.g. async workers or a second external thread), caller then has to
+	// fall back to the task-group path
+	bool ExecuteWorkStealingJob(WorkStealingJob& job, int numElems);
+
+	template <typename F>
+	static inline bool ExecuteWorkStealingLoop(int start, int end, int step, F& f, int grainSize, int minSplitSize)
+	{
+		using FuncType = std::remove_reference_t<F>;
+
+		WorkStealingJob job;
+		job.execFunc = [](const WorkStealingJob* job, int b, int e) {
+			FuncType& func = *static_cast<FuncType*>(job->userFunc);
+
+			for (int k = b; k < e; ++k) {
+				func(job->start + job->step * k);
+			}
+		};
+		job.userFunc = const_cast<void*>(static_cast<const void*>(&f));
+		job.start = start;
+		job.step = step;
+		job.grainSize = grainSize;
+		job.minSplitSize = minSplitSize;
+
+		return (ExecuteWorkStealingJob(job, (end - start + step - 1) / step));
+	}
+}
+
+
 template <typename F>
 static inline void for_mt(int start, int end, int step, F&& f)
 {
-	ThreadPool::inMultiThreadedSection = true;
+	// nested loops (e.g. from within a worker) must not clear the outer loop's flag
+	const bool wasInMultiThreadedSection = std::exchange(ThreadPool::inMultiThreadedSection, true);
 
 	if (!ThreadPool::HasThreads() || ((end - start) < step)) {
 		for (int i = start; i < end; i += step) {
 			f(i);
 		}
 	}
+	else if (ThreadPool::UseWorkStealing() && ThreadPool::ExecuteWorkStealingLoop(start, end, step, f, std::max(1, ((end - start) / step) / (ThreadPool::GetNumThreads() * 4)), 1)) {
+		// handled by the work-stealing scheduler
+	}
 	else {
 		SCOPED_MT_TIMER("ThreadPool::AddTask");
 
@@ -706,7 +777,7 @@ static inline void for_mt(int start, int end, int step, F&& f)
 		ThreadPool::WaitForFinished(taskGroup);
 	}
 
-	ThreadPool::inMultiThreadedSection = false;
+	ThreadPool::inMultiThreadedSection = wasInMultiThreadedSection;
 }
 
 template <typename F>
@@ -734,6 +805,18 @@ static inline void for_mt_chunk(int b, int e, F&& f, int minChunkSize = 1, int m
 		return;
 	}
 
+	if (ThreadPool::UseWorkStealing()) {
+		// split ranges on demand instead of one fixed chunk per thread
+		const int grainSize = std::clamp(numElems / (maxThreads * 4), minChunkSize, maxChunkSize);
+
+		const bool wasInMultiThreadedSection = std::exchange(ThreadPool::inMultiThreadedSection, true);
+		const bool executed = ThreadPool::ExecuteWorkStealingLoop(b, e, 1, f, grainSize, minChunkSize);
+		ThreadPool::inMultiThreadedSection = wasInMultiThreadedSection;
+
+		if (executed)
+			return;
+	}
+
 	for_mt(0, numThreads, 1, [&f, b, e, chunkSize](const int jobId) {
 		const int bb = b + jobId * chunkSize;
 		const int ee = std::min(bb + chunkSize, e);
@@ -744,6 +827,51 @@ static inline void for_mt_chunk(int b, int e, F&& f, int minChunkSize = 1, int m
 }
 
 
+/**
+ * like for_mt, but the calling thread first runs <g> while the workers start
+ * on the loop and only then helps with the remaining indices; used when <g>
+ * has to execute on the calling thread (e.g. because it runs Lua or synced
+ * code) but may overlap with the loop body
+ */
+template <typename F, typename G>
+static inline void for_mt_with_caller(int start, int end, F&& f, G&& g)
+{
+	if (!ThreadPool::HasThreads() || start >= end) {
+		g();
+
+		const bool wasInMultiThreadedSection = std::exchange(ThreadPool::inMultiThreadedSection, true);
+
+		for (int i = start; i < end; ++i) {
+			f(i);
+		}
+
+		ThreadPool::inMultiThreadedSection = wasInMultiThreadedSection;
+		return;
+	}
+
+	SCOPED_MT_TIMER("ThreadPool::AddTask");
+
+	// static, so TaskGroup's are recycled
+	static TaskPool<ForTaskGroup, F> pool;
+	auto taskGroup = pool.GetTaskGroup();
+
+	taskGroup->Enqueue(start, end, 1, f);
+	taskGroup->UpdateId();
+
+	for (size_t i = 1; i < ThreadPool::GetNumThreads(); ++i) {
+		taskGroup->wantedThread.store(i);
+		ThreadPool::PushTaskGroup(taskGroup);
+	}
+
+	// <g> runs with the caller's own flag, i.e. exactly as it would serially
+	g();
+
+	const bool wasInMultiThreadedSection = std::exchange(ThreadPool::inMultiThreadedSection, true);
+	ThreadPool::WaitForFinished(taskGroup);
+	ThreadPool::inMultiThreadedSection = wasInMultiThreadedSection;
+}
+
+
 template <typename F>
 static inline void parallel(F&& f)
 {
@@ -19,4 +19,52 @@ struct PlusOp
 {
 	template <class X, class Y>
 	auto operator()(X&& x, Y&& y) -> decltype(x + y) { return x + y; }
-};
\ No newline at end of file
+};
+
+// data[i] += value for all i in [0, count), wrapping like the scalar add
+template<typename T>
+inline void SpanAdd(T* data, size_t count, T value)
+{
+	using BatchType = xsimd::simd_type<T>;
+	constexpr size_t batchSize = BatchType::size;
+
+	const BatchType vb(value);
+	size_t i = 0;
+
+	for (; i + batchSize <= count; i += batchSize) {
+		const BatchType b = xsimd::load_unaligned(data + i);
+		xsimd::store_unaligned(data + i, b + vb);
+	}
+	for (; i < count; ++i) {
+		data[i] += value;
+	}
+}
+
+// as SpanAdd, additionally calls func(i) in ascending order for each element
+// that equals value after the add (i.e. was zero before)
+template<typename T, typename Func>
+inline void SpanAdd(T* data, size_t count, T value, Func&& func)
+{
+	using BatchType = xsimd::simd_type<T>;
+	constexpr size_t batchSize = BatchType::size;
+
+	const BatchType vb(value);
+	size_t i = 0;
+
+	for (; i + batchSize <= count; i += batchSize) {
+		const BatchType b = xsimd::load_unaligned(data + i) + vb;
+		xsimd::store_unaligned(data + i, b);
+
+		if (!xsimd::any(b == vb))
+			continue;
+
+		for (size_t j = i; j < i + batchSize; ++j) {
+			if (data[j] == value)
+				func(j);
+		}
+	}
+	for (; i < count; ++i) {
+		if ((data[i] += value) == value)
+			func(i);
+	}
+}
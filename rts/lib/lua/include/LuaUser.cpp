@@ -18,6 +18,11 @@
 	#include "System/Threading/SpringThreading.h"
 #endif
 
+#if (ENABLE_LUA_ALLOC_TRACE != 0)
+	#include <cstdio>
+	#include "System/Threading/SpringThreading.h"
+#endif
+
 #include "System/Log/ILog.h"
 #include "System/Misc/SpringTime.h"
 
@@ -236,6 +241,22 @@ static constexpr const char* LUA_OOM_FMT_STR = "[%s][handle=%s][OOM] synced=%d {
 static SLuaAllocState gLuaAllocState = {{0}, {0}, {0}, {0}};
 static SLuaAllocError gLuaAllocError = {};
 
+#if (ENABLE_LUA_ALLOC_TRACE != 0)
+// one "<state> <ptr> <osize> <nsize> <result>" line per call, the input of test/other/benchmarkLuaMemPool
+static void spring_lua_alloc_trace(const void* ud, const void* ptr, size_t osize, size_t nsize, const void* mem)
+{
+	static FILE* traceFile = fopen("LuaAllocTrace.txt", "w");
+	static spring::mutex traceMutex;
+
+	const std::lock_guard<spring::mutex> lock(traceMutex);
+
+	if (traceFile != nullptr)
+		fprintf(traceFile, "%p %p " _STPF_ " " _STPF_ " %p\n", ud, ptr, osize, nsize, mem);
+}
+#else
+static void spring_lua_alloc_trace(const void*, const void*, size_t, size_t, const void*) {}
+#endif
+
 void spring_lua_alloc_log_error(const luaContextData* lcd)
 {
 	const CLuaHandle* lho = lcd->owner;
@@ -266,6 +287,7 @@ void* spring_lua_alloc(void* ud, void* ptr, size_t osize, size_t nsize)
 	if (nsize == 0) {
 		// deallocation; must return NULL
 		lmp->Free(ptr, osize);
+		spring_lua_alloc_trace(ud, ptr, osize, nsize, nullptr);
 		return nullptr;
 	}
 
@@ -289,6 +311,7 @@ void* spring_lua_alloc(void* ud, void* ptr, size_t osize, size_t nsize)
 	las->numLuaAllocs += 1;
 	las->luaAllocTime += (t1 - t0).toMicroSecsi();
 
+	spring_lua_alloc_trace(ud, ptr, osize, nsize, mem);
 	return mem;
 }
 
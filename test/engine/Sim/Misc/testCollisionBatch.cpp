@@ -0,0 +1,155 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Sim/Misc/CollisionHandler.h"
+#include "Sim/Misc/CollisionVolume.h"
+#include "System/Matrix44f.h"
+#include "System/float3.h"
+#include "System/SpringMath.h"
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include "lib/catch.hpp"
+
+
+static inline float randf()
+{
+	return rand() / float(RAND_MAX);
+}
+
+static inline float randf(float min, float max)
+{
+	return min + randf() * (max - min);
+}
+
+static inline float3 randfloat3(float min, float max)
+{
+	return {randf(min, max), randf(min, max), randf(min, max)};
+}
+
+static CollisionVolume RandomVolume()
+{
+	static constexpr char types[] = {'E', 'C', 'B', 'S'};
+	static constexpr char axes[] = {'X', 'Y', 'Z'};
+
+	const float3 scales = randfloat3(1.0f, 64.0f);
+	const float3 offsets = randfloat3(-8.0f, 8.0f) * (randf() < 0.5f);
+
+	return {types[rand() % 4], axes[rand() % 3], scales, offsets};
+}
+
+static CMatrix44f RandomTransform()
+{
+	CMatrix44f m;
+	m.Translate(randfloat3(-128.0f, 128.0f));
+
+	// axis-aligned volumes exercise the parallel-ray special cases
+	if (randf() < 0.75f) {
+		m.RotateY(randf(-math::PI, math::PI));
+		m.RotateX(randf(-math::PI, math::PI) * (randf() < 0.5f));
+	}
+
+	m.Translate(randfloat3(-8.0f, 8.0f));
+	return m;
+}
+
+static float3 RandomPoint()
+{
+	float3 p = randfloat3(-192.0f, 192.0f);
+
+	// axis-parallel segments
+	p.x *= (randf() >= 0.1f);
+	p.y *= (randf() >= 0.1f);
+	return p;
+}
+
+
+// the batched kernels must agree with testing every volume on its own
+TEST_CASE("CollisionBatch")
+{
+	srand(time(nullptr));
+
+	static constexpr int TEST_RUNS = 20000;
+	static constexpr int MAX_VOLUMES = 24;
+
+	std::vector<CollisionVolume> volumes;
+	std::vector<CMatrix44f> transforms;
+
+	CollisionVolumeBatch batch;
+
+	int numHits = 0;
+	int numMismatches = 0;
+
+	for (int n = 0; n < TEST_RUNS; ++n) {
+		const int numVolumes = 1 + rand() % MAX_VOLUMES;
+
+		volumes.clear();
+		transforms.clear();
+		batch.Clear();
+
+		for (int i = 0; i < numVolumes; ++i) {
+			volumes.push_back(RandomVolume());
+			transforms.push_back(RandomTransform());
+		}
+		for (int i = 0; i < numVolumes; ++i) {
+			batch.Add(&volumes[i], transforms[i], i);
+		}
+
+		float3 p0 = RandomPoint();
+		float3 p1 = RandomPoint();
+
+		// sometimes start inside or right next to a volume
+		if (randf() < 0.2f)
+			p0 = transforms[rand() % numVolumes].GetPos() + randfloat3(-4.0f, 4.0f);
+		// and sometimes degenerate
+		if (randf() < 0.01f)
+			p1 = p0;
+
+		// scalar reference
+		std::vector<int> hitIds;
+		CollisionQuery cq;
+		CollisionQuery nearestCQ;
+		int nearestId = -1;
+		float nearestDist = std::numeric_limits<float>::max();
+		const float3 dir = (p1 - p0).SafeNormalize();
+
+		for (int i = 0; i < numVolumes; ++i) {
+			cq.Reset();
+
+			if (!CCollisionHandler::Intersect(&volumes[i], transforms[i], p0, p1, &cq))
+				continue;
+
+			hitIds.push_back(i);
+
+			const float dist = cq.GetHitPosDist(p0, dir);
+
+			if (dist >= nearestDist)
+				continue;
+
+			nearestDist = dist;
+			nearestId = i;
+			nearestCQ = cq;
+		}
+
+		// batched
+		CollisionQuery batchCQ;
+
+		CHECK(CCollisionHandler::IntersectBatch(batch, p0, p1) == hitIds.size());
+		numMismatches += (batch.GetHitIds() != hitIds);
+
+		CHECK(CCollisionHandler::IntersectBatch(batch, p0, p1, &batchCQ) == nearestId);
+		CHECK(batch.GetHitIds() == hitIds);
+		CHECK(batchCQ.InsideHit() == nearestCQ.InsideHit());
+		CHECK(batchCQ.IngressHit() == nearestCQ.IngressHit());
+		CHECK(batchCQ.EgressHit() == nearestCQ.EgressHit());
+		CHECK(batchCQ.GetIngressPos().same(nearestCQ.GetIngressPos()));
+		CHECK(batchCQ.GetEgressPos().same(nearestCQ.GetEgressPos()));
+
+		numHits += hitIds.size();
+	}
+
+	INFO("hits: " << numHits);
+	CHECK(numMismatches == 0);
+	CHECK(numHits > 0);
+}
@@ -1,10 +1,13 @@
 /* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
 
 #include "Sim/Misc/QuadField.h"
+#include "System/ContainerUtil.h"
 #include "System/float3.h"
 #include "System/SpringMath.h"
 #include <stdlib.h>
 #include <time.h>
+#include <memory>
+#include <random>
 
 #define CATCH_CONFIG_MAIN
 #include "lib/catch.hpp"
@@ -102,3 +105,155 @@ TEST_CASE("QuadField")
 	INFO("Too little quads returned!");
 	CHECK_FALSE(fail);
 }
+
+
+
+namespace {
+	// stand-in for the CWorldObject fields the exact queries look at, padded
+	// s.t. objects are about as sparse in memory as real units and features
+	struct TestObject {
+		float3 pos;
+		float radius = 0.0f;
+		int tempNum = 0;
+		char pad[1024];
+	};
+
+	struct TestCell {
+		std::vector<TestObject*> objects;
+		std::vector<float4> spheres;
+	};
+}
+
+
+TEST_CASE("QuadFieldPackedCellOrder")
+{
+	// packed cells must keep the order VectorInsertUnique and VectorErase
+	// give the plain ones, query results depend on it
+	std::vector<std::unique_ptr<TestObject>> objects;
+	std::vector<TestObject*> plain;
+	TestCell cell;
+	std::mt19937 rng(123);
+
+	for (int i = 0; i < 64; ++i) {
+		objects.emplace_back(new TestObject());
+		objects.back()->pos = float3(i, 0.0f, -i);
+		objects.back()->radius = i * 0.5f;
+	}
+
+	for (int n = 0; n < 10000; ++n) {
+		TestObject* o = objects[rng() % objects.size()].get();
+
+		if ((n % 3) == 0) {
+			// moved within its cells, only the sphere changes
+			o->pos.x += 1.0f;
+			o->radius += 0.25f;
+
+			const bool inCell = (std::find(plain.begin(), plain.end(), o) != plain.end());
+			CHECK(CQuadField::Quad::UpdateObject(cell.objects, cell.spheres, o, {o->pos, o->radius}) == inCell);
+
+			if (!inCell)
+				continue;
+		} else if (std::find(plain.begin(), plain.end(), o) == plain.end()) {
+			spring::VectorInsertUnique(plain, o, false);
+			CQuadField::Quad::InsertObject(cell.objects, cell.spheres, o, {o->pos, o->radius});
+		} else {
+			CHECK(spring::VectorErase(plain, o));
+			CHECK(CQuadField::Quad::EraseObject(cell.objects, cell.spheres, o));
+		}
+
+		REQUIRE(plain == cell.objects);
+		REQUIRE(cell.objects.size() == cell.spheres.size());
+
+		for (size_t i = 0; i < cell.objects.size(); ++i) {
+			REQUIRE(cell.spheres[i].x == cell.objects[i]->pos.x);
+			REQUIRE(cell.spheres[i].w == cell.objects[i]->radius);
+		}
+	}
+
+	CHECK_FALSE(CQuadField::Quad::EraseObject(cell.objects, cell.spheres, static_cast<TestObject*>(nullptr)));
+}
+
+
+TEST_CASE("QuadFieldPackedQuery")
+{
+	// objects spread over a 32x32 map (default 128 elmo quads), queried through
+	// the packed filter of Get*Exact and the plain per-object one it replaces
+	static constexpr int NUM_OBJECTS = 2000;
+	static constexpr int NUM_QUERIES = 2000;
+	static constexpr int CELLS_X = 32;
+	static constexpr int CELL_SIZE = CQuadField::BASE_QUAD_SIZE;
+	static constexpr float MAP_SIZE = CELLS_X * CELL_SIZE;
+
+	std::mt19937 rng(456);
+	std::uniform_real_distribution<float> posDist(0.0f, MAP_SIZE);
+	std::uniform_real_distribution<float> radDist(4.0f, 40.0f);
+
+	std::vector<std::unique_ptr<TestObject>> objects(NUM_OBJECTS);
+	std::vector<TestCell> cells(CELLS_X * CELLS_X);
+
+	const auto CellIdx = [](float c) { return std::clamp(int(c / CELL_SIZE), 0, CELLS_X - 1); };
+
+	for (auto& o: objects) {
+		o.reset(new TestObject());
+		o->pos = float3(posDist(rng), 0.0f, posDist(rng));
+		o->radius = radDist(rng);
+
+		for (int z = CellIdx(o->pos.z - o->radius); z <= CellIdx(o->pos.z + o->radius); ++z) {
+			for (int x = CellIdx(o->pos.x - o->radius); x <= CellIdx(o->pos.x + o->radius); ++x) {
+				TestCell& cell = cells[z * CELLS_X + x];
+				CQuadField::Quad::InsertObject(cell.objects, cell.spheres, o.get(), {o->pos, o->radius});
+			}
+		}
+	}
+
+	int tempNum = 0;
+
+	std::vector<TestObject*> plainResult;
+	std::vector<TestObject*> packedResult;
+
+	for (int n = 0; n < NUM_QUERIES; ++n) {
+		const float3 pos = {posDist(rng), 0.0f, posDist(rng)};
+		const float radius = radDist(rng) * 8.0f;
+
+		plainResult.clear();
+		packedResult.clear();
+
+		const auto FirstVisit = [&](TestObject* o) {
+			if (o->tempNum == tempNum)
+				return false;
+
+			o->tempNum = tempNum;
+			return true;
+		};
+
+		tempNum += 1;
+
+		for (int z = CellIdx(pos.z - radius); z <= CellIdx(pos.z + radius); ++z) {
+			for (int x = CellIdx(pos.x - radius); x <= CellIdx(pos.x + radius); ++x) {
+				const TestCell& cell = cells[z * CELLS_X + x];
+
+				CQuadField::Quad::GetPackedObjects(cell.objects, cell.spheres, packedResult, [&](const float4& s) {
+					return (pos.SqDistance(s) < Square(radius + s.w));
+				}, FirstVisit);
+			}
+		}
+
+		tempNum += 1;
+
+		for (int z = CellIdx(pos.z - radius); z <= CellIdx(pos.z + radius); ++z) {
+			for (int x = CellIdx(pos.x - radius); x <= CellIdx(pos.x + radius); ++x) {
+				for (TestObject* o: cells[z * CELLS_X + x].objects) {
+					if (!FirstVisit(o))
+						continue;
+					if (pos.SqDistance(o->pos) >= Square(radius + o->radius))
+						continue;
+
+					plainResult.push_back(o);
+				}
+			}
+		}
+
+		// positions are fresh here, so both must return the same objects in the same order
+		REQUIRE(plainResult == packedResult);
+	}
+}
@@ -0,0 +1,392 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Map/MapInfo.h"
+#include "Map/ReadMap.h"
+#include "Sim/Misc/GlobalSynced.h"
+#include "Sim/Misc/ModInfo.h"
+#include "Sim/MoveTypes/MoveDefHandler.h"
+#include "Sim/MoveTypes/MoveMath/MoveMath.h"
+#include "Sim/Path/QTPFS/GoalSharing.h"
+#include "Sim/Path/QTPFS/Components/PathSpeedModInfo.h"
+#include "Sim/Path/QTPFS/Node.h"
+#include "Sim/Path/QTPFS/NodeLayer.h"
+#include "Sim/Path/QTPFS/Path.h"
+#include "Sim/Path/QTPFS/PathSearch.h"
+#include "Sim/Path/QTPFS/PathThreads.h"
+#include "System/Ecs/Utils/SystemGlobalUtils.h"
+#include "System/float3.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include "lib/catch.hpp"
+
+// Runs goal-shared searches the way PathManager::ExecuteSearch does, on a real
+// tesselated NodeLayer: the head of a chain searches to the goal on its own, a
+// later search from nearby loads the head's path and only searches until it
+// meets it. Each shared result is compared against an independent search from
+// the same source, it has to stay on passable ground and may only be longer by
+// the detour that GoalSharing allows for (or get rejected, s.t. the path is
+// searched again in full).
+namespace {
+	constexpr int MAP_SIZE = 64;
+	constexpr int ROOT_SIZE = 32;
+
+	// squares the test map blocks, read by the CMoveMath stubs below
+	std::vector<bool> blockedSquares;
+
+	bool IsBlockedSquare(int x, int z) {
+		return (x < 0 || z < 0 || x >= MAP_SIZE || z >= MAP_SIZE || blockedSquares[z * MAP_SIZE + x]);
+	}
+
+	void Block(int x1, int z1, int x2, int z2) {
+		for (int z = z1; z <= z2; z++) {
+			for (int x = x1; x <= x2; x++) {
+				blockedSquares[z * MAP_SIZE + x] = true;
+			}
+		}
+	}
+
+	float3 GetPos(int x, int z) { return {(x + 0.5f) * SQUARE_SIZE, 0.0f, (z + 0.5f) * SQUARE_SIZE}; }
+
+
+	// tesselates the whole map like PathManager::{InitNodeLayer,UpdateNodeLayer}
+	void InitNodeLayer(QTPFS::NodeLayer& nl) {
+		MoveDef* md = moveDefHandler.GetMoveDefByPathType(0);
+
+		nl.InitNodes(0, MAP_SIZE, MAP_SIZE);
+
+		constexpr int numRoots = (MAP_SIZE / ROOT_SIZE) * (MAP_SIZE / ROOT_SIZE);
+		constexpr uint32_t rootShift = 30 - 2;
+
+		for (int z = 0; z < MAP_SIZE; z += ROOT_SIZE) {
+			for (int x = 0; x < MAP_SIZE; x += ROOT_SIZE) {
+				nl.AllocPoolNode(nullptr, -1, x, z, x + ROOT_SIZE, z + ROOT_SIZE);
+				nl.IncreaseOpenNodeCounter();
+			}
+		}
+
+		nl.SetNumLeafNodes(numRoots);
+		nl.SetRootMask((~0) << rootShift);
+
+		QTPFS::QTNode::MAX_DEPTH = rootShift / QTPFS_NODE_NUMBER_SHIFT_STEP;
+
+		for (int i = 0; i < numRoots; i++) {
+			nl.GetPoolNode(i)->SetNodeNumber(i << rootShift);
+		}
+
+		nl.SetRootNodeCountAndDimensions(numRoots, MAP_SIZE / ROOT_SIZE, MAP_SIZE / ROOT_SIZE, ROOT_SIZE);
+
+		auto updateThreadData = std::make_unique<QTPFS::UpdateThreadData>();
+
+		for (int i = 0; i < numRoots; i++) {
+			QTPFS::INode* root = nl.GetPoolNode(i);
+			SRectangle r(root->xmin(), root->zmin(), root->xmax(), root->zmax());
+			SRectangle ur(r);
+
+			updateThreadData->InitUpdate(r, *root, *md, 0);
+			nl.Update(*updateThreadData);
+			root->PreTesselate(nl, r, ur, 0, updateThreadData.get());
+			nl.ExecNodeNeighborCacheUpdates(ur, *updateThreadData);
+		}
+
+		// see ScanForPathSpeedModInfo, A* scales its heuristic by the fastest node
+		auto& comp = QTPFS::systemGlobals.CreateSystemComponent<QTPFS::PathSpeedModInfoSystemComponent>();
+		comp.relSpeedModinfos[0].max = 0.0f;
+
+		for (unsigned int i = 0; i < nl.GetMaxNodesAlloced(); i++) {
+			const QTPFS::INode* node = nl.GetPoolNode(i);
+
+			if (node->IsLeaf())
+				comp.relSpeedModinfos[0].max = std::max(comp.relSpeedModinfos[0].max, node->GetSpeedMod());
+		}
+	}
+
+	struct TestPath {
+		QTPFS::IPath path;
+		bool found = false;
+		bool rejected = false;
+	};
+
+	// see PathManager::QueueSearch and PathManager::ExecuteSearch
+	std::unique_ptr<TestPath> ExecuteSearch(QTPFS::NodeLayer& nl, const float3& srcPos, const float3& goalPos, QTPFS::IPath* headPath) {
+		static QTPFS::SearchThreadData searchThreadData(0, 0);
+
+		auto testPath = std::make_unique<TestPath>();
+		QTPFS::IPath& path = testPath->path;
+
+		path.SetID(1);
+		path.AllocPoints(2);
+		path.AllocNodes(0);
+		path.SetSourcePoint(srcPos);
+		path.SetTargetPoint(goalPos);
+		path.SetGoalPosition(goalPos);
+		path.SetPathType(0);
+
+		QTPFS::PathSearch search(QTPFS::PATH_SEARCH_ASTAR);
+		search.SetID(path.GetID());
+		search.SetPathType(0);
+		search.SetGoalDistance(path.GetRadius());
+		search.allowPartialSearch = true;
+		search.synced = true;
+		search.Initialize(&nl, path.GetSourcePoint(), path.GetGoalPosition(), nullptr);
+		search.InitializeThread(&searchThreadData);
+
+		if (headPath != nullptr) {
+			search.doPartialSearch = true;
+			search.goalShared = true;
+			search.LoadPartialPath(headPath);
+		}
+
+		if (search.Execute()) {
+			search.Finalize(&path);
+
+			if (headPath != nullptr) {
+				const float srcDist = path.GetSourcePoint().distance2D(headPath->GetSourcePoint());
+
+				if (!QTPFS::GoalSharing::IsShortEnough(QTPFS::GoalSharing::GetPathLength(path), QTPFS::GoalSharing::GetPathLength(*headPath), srcDist))
+					search.RejectPartialResult();
+			}
+		}
+
+		testPath->found = search.PathWasFound() && path.IsFullPath();
+		testPath->rejected = search.rejectPartialSearch;
+		return testPath;
+	}
+
+	// starts at <srcPos>, reaches <goalPos> and never crosses a blocked square;
+	// points on the border between an open and a closed square are still valid
+	bool IsValidPath(const QTPFS::IPath& path, const float3& srcPos, const float3& goalPos) {
+		constexpr float STEP_SIZE = 0.5f;
+		constexpr float BORDER_SIZE = 0.1f;
+
+		if (path.NumPoints() < 2)
+			return false;
+		if (path.GetPoint(0).distance2D(srcPos) > 0.01f || path.GetPoint(path.NumPoints() - 1).distance2D(goalPos) > 0.01f)
+			return false;
+
+		const auto isBlocked = [](const float3& p) {
+			for (float dz: {-BORDER_SIZE, BORDER_SIZE}) {
+				for (float dx: {-BORDER_SIZE, BORDER_SIZE}) {
+					if (!IsBlockedSquare((p.x + dx) / SQUARE_SIZE, (p.z + dz) / SQUARE_SIZE))
+						return false;
+				}
+			}
+
+			return true;
+		};
+
+		for (unsigned int i = 1; i < path.NumPoints(); i++) {
+			const float3& p0 = path.GetPoint(i - 1);
+			const float3& p1 = path.GetPoint(i);
+			const int numSteps = std::max(1, int(p0.distance2D(p1) / STEP_SIZE));
+
+			for (int j = 0; j <= numSteps; j++) {
+				if (isBlocked(mix(p0, p1, j / float(numSteps))))
+					return false;
+			}
+		}
+
+		return true;
+	}
+
+	void CheckSharedPaths(int headX, int headZ, int goalX, int goalZ, float maxSrcDist) {
+		auto nl = std::make_unique<QTPFS::NodeLayer>();
+		InitNodeLayer(*nl);
+
+		const float3 headSrcPos = GetPos(headX, headZ);
+		const float3 goalPos = GetPos(goalX, goalZ);
+
+		std::unique_ptr<TestPath> head = ExecuteSearch(*nl, headSrcPos, goalPos, nullptr);
+
+		REQUIRE(head->found);
+		REQUIRE(IsValidPath(head->path, headSrcPos, goalPos));
+
+		int numShared = 0;
+
+		for (int z = 0; z < MAP_SIZE; z++) {
+			for (int x = 0; x < MAP_SIZE; x++) {
+				const float3 srcPos = GetPos(x, z);
+
+				if (IsBlockedSquare(x, z) || (x == headX && z == headZ))
+					continue;
+				if (!QTPFS::GoalSharing::CanShare(srcPos, headSrcPos, maxSrcDist))
+					continue;
+
+				std::unique_ptr<TestPath> own = ExecuteSearch(*nl, srcPos, goalPos, nullptr);
+				std::unique_ptr<TestPath> shared = ExecuteSearch(*nl, srcPos, goalPos, &head->path);
+
+				REQUIRE(own->found);
+				CHECK(IsValidPath(own->path, srcPos, goalPos));
+
+				if (shared->rejected)
+					continue;
+
+				const float srcDist = srcPos.distance2D(headSrcPos);
+				const float ownLength = QTPFS::GoalSharing::GetPathLength(own->path);
+				const float sharedLength = QTPFS::GoalSharing::GetPathLength(shared->path);
+
+				CAPTURE(x, z, ownLength, sharedLength, srcDist);
+				CHECK(shared->found);
+				CHECK(IsValidPath(shared->path, srcPos, goalPos));
+				// the head's path is at most srcDist longer than one from here, the
+				// shared one at most twice that longer than the head's (see IsShortEnough)
+				CHECK(sharedLength <= (ownLength + srcDist * 3.0f + SQUARE_SIZE * 2.0f));
+
+				numShared += 1;
+			}
+		}
+
+		CHECK(numShared > 1);
+	}
+
+
+	struct TestMap {
+		TestMap() {
+			mapDims.mapx = MAP_SIZE;
+			mapDims.mapy = MAP_SIZE;
+			mapDims.Initialize();
+
+			float3::maxxpos = MAP_SIZE * SQUARE_SIZE - 1;
+			float3::maxzpos = MAP_SIZE * SQUARE_SIZE - 1;
+
+			blockedSquares.assign(MAP_SIZE * MAP_SIZE, false);
+
+			moveDefHandler.Init(nullptr);
+			modInfo.qtGoalShareMaxSourceDist = 8.0f * SQUARE_SIZE;
+
+			// the map's qtpfsConstants, see the InitStatic's
+			QTPFS::QTNode::MIN_SIZE_X = 1;
+			QTPFS::QTNode::MIN_SIZE_Z = 1;
+			QTPFS::NodeLayer::NUM_SPEEDMOD_BINS = 10;
+			QTPFS::NodeLayer::MIN_SPEEDMOD_VALUE = 0.0f;
+			QTPFS::NodeLayer::MAX_SPEEDMOD_VALUE = 2.0f;
+			QTPFS::PathSearch::MAP_MAX_NODES_SEARCHED = 0;
+			QTPFS::PathSearch::MAP_RELATIVE_MAX_NODES_SEARCHED = 0.0f;
+		}
+	};
+}
+
+
+// the parts of the engine the searches read, for a flat map without features
+// whose only obstacles are the squares in blockedSquares
+CModInfo modInfo;
+MoveDefHandler moveDefHandler;
+MapDimensions mapDims;
+const CMapInfo* mapInfo = nullptr;
+
+CGlobalSynced globalSynced;
+CGlobalSynced* gs = &globalSynced;
+
+void CModInfo::ResetState() {
+	qtMaxNodesSearched = 8192;
+	qtRefreshPathMinDist = 512.0f;
+	qtMaxNodesSearchedRelativeToMapOpenNodes = 0.25f;
+	qtLowerQualityPaths = false;
+	qtGoalShareMaxSourceDist = 0.0f;
+}
+
+MoveDef::MoveDef() {}
+
+void MoveDefHandler::Init(LuaParser* defsParser) {
+	MoveDef& md = moveDefs[0];
+	md.pathType = 0;
+	md.xsize = md.zsize = 1;
+	md.xsizeh = md.zsizeh = 0;
+
+	mdCounter = 1;
+}
+
+// no exit-only areas, submersible movedefs or raw searches here
+bool MoveDef::IsInExitOnly(int x, int z) const { return false; }
+void MoveDef::UpdateCheckCollisionQuery(MoveTypes::CheckCollisionQuery& collider, MoveDefs::CollisionQueryStateTrack& state, const int2 pos) const {}
+
+bool MoveDef::DoRawSearch(
+	const CSolidObject* collider,
+	const MoveDef* md,
+	const float3 startPos,
+	const float3 endPos,
+	float goalRadius,
+	bool testTerrain,
+	bool testObjects,
+	bool centerOnly,
+	float* minSpeedModPtr,
+	int* maxBlockBitPtr,
+	int2* nearestSquare,
+	int thread
+) const {
+	return false;
+}
+
+CMoveMath::BlockType CMoveMath::RangeIsBlockedHashedMt(int xmin, int xmax, int zmin, int zmax, const MoveTypes::CheckCollisionQuery* collider, int magicNumber, int thread) {
+	return BLOCK_NONE;
+}
+
+float CMoveMath::GetPosSpeedMod(const MoveDef& moveDef, unsigned xSquare, unsigned zSquare) {
+	return (IsBlockedSquare(xSquare, zSquare)? 0.0f: 1.0f);
+}
+
+void CMoveMath::FloodFillRangeIsBlocked(const MoveDef& moveDef, const CSolidObject* collider, const SRectangle& areaToSample, std::vector<std::uint8_t>& results, int thread) {
+	results.resize(areaToSample.GetArea());
+
+	for (int z = areaToSample.z1; z < areaToSample.z2; z++) {
+		for (int x = areaToSample.x1; x < areaToSample.x2; x++) {
+			results[(z - areaToSample.z1) * areaToSample.GetWidth() + (x - areaToSample.x1)] = IsBlockedSquare(x, z)? BLOCK_STRUCTURE: BLOCK_NONE;
+		}
+	}
+}
+
+
+static const TestMap testMap;
+
+TEST_CASE("GoalSharingDisabledOrFar")
+{
+	const float3 headSrcPos = {100.0f, 0.0f, 100.0f};
+
+	CHECK_FALSE(QTPFS::GoalSharing::CanShare(headSrcPos, headSrcPos, 0.0f));
+	CHECK(QTPFS::GoalSharing::CanShare(headSrcPos + float3(60.0f, 0.0f, 80.0f), headSrcPos, 100.0f));
+	CHECK_FALSE(QTPFS::GoalSharing::CanShare(headSrcPos + float3(61.0f, 0.0f, 80.0f), headSrcPos, 100.0f));
+	// height differences do not count
+	CHECK(QTPFS::GoalSharing::CanShare(headSrcPos + float3(0.0f, 500.0f, 0.0f), headSrcPos, 1.0f));
+}
+
+TEST_CASE("GoalSharingRejectsDetours")
+{
+	CHECK(QTPFS::GoalSharing::IsShortEnough(1000.0f, 1000.0f, 0.0f));
+	CHECK(QTPFS::GoalSharing::IsShortEnough(1150.0f, 1000.0f, 100.0f));
+	CHECK_FALSE(QTPFS::GoalSharing::IsShortEnough(1250.0f, 1000.0f, 100.0f));
+
+	QTPFS::IPath path;
+	path.AllocPoints(3);
+	path.SetPoint(0, GetPos(0, 0));
+	path.SetPoint(1, GetPos(3, 0));
+	path.SetPoint(2, GetPos(3, 4));
+	CHECK(QTPFS::GoalSharing::GetPathLength(path) == Approx(7.0f * SQUARE_SIZE));
+}
+
+TEST_CASE("GoalSharedSearchesOpenMap")
+{
+	blockedSquares.assign(MAP_SIZE * MAP_SIZE, false);
+
+	CheckSharedPaths(8, 32, 56, 30, modInfo.qtGoalShareMaxSourceDist);
+}
+
+TEST_CASE("GoalSharedSearchesAroundWall")
+{
+	// the head has to go around the end of a wall, the goal is right behind it
+	blockedSquares.assign(MAP_SIZE * MAP_SIZE, false);
+	Block(0, 20, 50, 21);
+
+	CheckSharedPaths(8, 12, 8, 28, modInfo.qtGoalShareMaxSourceDist);
+}
+
+TEST_CASE("GoalSharedSearchesAcrossWall")
+{
+	// sources close to the head, some of them on the goal's side of a thin wall
+	blockedSquares.assign(MAP_SIZE * MAP_SIZE, false);
+	Block(0, 30, 40, 30);
+
+	CheckSharedPaths(10, 28, 10, 50, modInfo.qtGoalShareMaxSourceDist);
+}
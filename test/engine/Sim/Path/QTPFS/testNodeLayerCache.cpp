@@ -0,0 +1,370 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Sim/Path/QTPFS/NodeLayer.h"
+#include "Sim/Path/QTPFS/NodeLayerCache.h"
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include "lib/catch.hpp"
+
+// Restores and writes QTPFS::NodeLayer through its real ReadCache/WriteCache.
+// The tesselation itself needs the map, so layers are read from a cache built
+// here: 2x2 root nodes of which the first was split, with one of its children
+// split and merged again s.t. the free-list is not empty.
+namespace {
+	constexpr unsigned int MAP_SIZE = 16;
+	constexpr unsigned int ROOT_SIZE = 8;
+	constexpr size_t NUM_LAYERS = 3;
+
+	struct TestLayerData {
+		QTPFS::NodeLayerCache::LayerHeader header = {};
+
+		std::vector<QTPFS::INode::CacheData> nodes;
+		std::vector<QTPFS::INode::NeighbourPoints> neighbours;
+		std::vector<std::uint32_t> freeIndcs;
+		std::vector<QTPFS::SpeedModType> speedMods;
+		std::vector<QTPFS::SpeedBinType> speedBins;
+	};
+
+	QTPFS::INode::CacheData MakeNode(unsigned int idx, unsigned int x1, unsigned int z1, unsigned int size, unsigned int childBaseIndex) {
+		QTPFS::INode::CacheData data = {};
+		data.nodeNumber = idx * 8 + 1;
+		data.index = idx;
+		data.points = {{(unsigned short) x1, (unsigned short) (x1 + size), (unsigned short) z1, (unsigned short) (z1 + size)}};
+		data.moveCostAvg = 1.0f + idx * 0.25f;
+		data.childBaseIndex = childBaseIndex;
+		return data;
+	}
+
+	TestLayerData MakeLayerData(unsigned int seed) {
+		TestLayerData layer;
+
+		// roots 0-3, children of root 0 at 4-7, merged children of node 4 at 8-11
+		for (unsigned int i = 0; i < 4; i++) {
+			layer.nodes.push_back(MakeNode(i, (i % 2) * ROOT_SIZE, (i / 2) * ROOT_SIZE, ROOT_SIZE, (i == 0)? 4: -1u));
+		}
+		for (unsigned int i = 0; i < 4; i++) {
+			layer.nodes.push_back(MakeNode(4 + i, (i % 2) * ROOT_SIZE / 2, (i / 2) * ROOT_SIZE / 2, ROOT_SIZE / 2, -1u));
+		}
+		for (unsigned int i = 0; i < 4; i++) {
+			layer.nodes.push_back(MakeNode(8 + i, (i % 2) * ROOT_SIZE / 4, (i / 2) * ROOT_SIZE / 4, ROOT_SIZE / 4, -1u));
+			layer.freeIndcs.push_back(11 - i);
+		}
+
+		// leaves neighbour each other, the number differs per layer
+		for (QTPFS::INode::CacheData& node: layer.nodes) {
+			if (node.childBaseIndex != -1u || node.index >= 8)
+				continue;
+
+			node.numNeighbours = 1 + (node.index + seed) % 3;
+
+			for (unsigned int j = 0; j < node.numNeighbours; j++) {
+				QTPFS::INode::NeighbourPoints ngb = {};
+				ngb.nodeId = 1 + (node.index + j) % 7;
+				ngb.netpoints[0] = {float(node.index), float(j + seed)};
+
+				layer.neighbours.push_back(ngb);
+			}
+		}
+
+		for (unsigned int i = 0; i < MAP_SIZE * MAP_SIZE; i++) {
+			layer.speedMods.push_back((i + seed) % 7);
+			layer.speedBins.push_back((i * 3 + seed) % 5);
+		}
+
+		QTPFS::NodeLayerCache::LayerHeader& h = layer.header;
+		h.numLeafNodes = 7;
+		h.numOpenNodes = 6;
+		h.numClosedNodes = 1;
+		h.maxNodesAlloced = layer.nodes.size();
+		h.numRootNodes = 4;
+		h.xRootNodes = 2;
+		h.zRootNodes = 2;
+		h.rootNodeSize = ROOT_SIZE;
+		h.rootMask = 0x3;
+		h.numNeighbours = layer.neighbours.size();
+		h.numFreeIndcs = layer.freeIndcs.size();
+		h.numSquares = layer.speedMods.size();
+		return layer;
+	}
+
+	// same layout as NodeLayer::WriteCache
+	void WriteLayerData(std::vector<std::uint8_t>& buffer, const TestLayerData& layer) {
+		const size_t headerPos = buffer.size();
+
+		QTPFS::NodeLayerCache::AppendSection(buffer, &layer.header, sizeof(layer.header));
+		QTPFS::NodeLayerCache::AppendSection(buffer, layer.nodes.data(), layer.nodes.size() * sizeof(QTPFS::INode::CacheData));
+		QTPFS::NodeLayerCache::AppendSection(buffer, layer.neighbours.data(), layer.neighbours.size() * sizeof(QTPFS::INode::NeighbourPoints));
+		QTPFS::NodeLayerCache::AppendSection(buffer, layer.freeIndcs.data(), layer.freeIndcs.size() * sizeof(std::uint32_t));
+		QTPFS::NodeLayerCache::AppendSection(buffer, layer.speedMods.data(), layer.speedMods.size() * sizeof(QTPFS::SpeedModType));
+		QTPFS::NodeLayerCache::AppendSection(buffer, layer.speedBins.data(), layer.speedBins.size() * sizeof(QTPFS::SpeedBinType));
+		QTPFS::NodeLayerCache::SetPayloadChecksum(buffer, headerPos);
+	}
+
+	std::vector<std::uint8_t> GetLayerBuffer(const TestLayerData& layer) {
+		std::vector<std::uint8_t> buffer;
+		WriteLayerData(buffer, layer);
+		return buffer;
+	}
+
+	// NodeLayer is too large for the stack
+	std::unique_ptr<QTPFS::NodeLayer> MakeLayer(unsigned int layerNum) {
+		std::unique_ptr<QTPFS::NodeLayer> layer = std::make_unique<QTPFS::NodeLayer>();
+		layer->InitNodes(layerNum, MAP_SIZE, MAP_SIZE);
+		return layer;
+	}
+
+	std::vector<std::uint8_t> WriteLayer(const QTPFS::NodeLayer& layer) {
+		std::vector<std::uint8_t> buffer;
+		layer.WriteCache(buffer);
+		return buffer;
+	}
+
+	QTPFS::NodeLayerCache::Key GetKey() {
+		QTPFS::NodeLayerCache::Key key = {};
+		key.version = QTPFS_NODE_LAYER_CACHE_VERSION;
+		key.heightmapChecksum = 0x12345678;
+		key.moveDefChecksum = 0x9abcdef0;
+		key.numSpeedModBins = 16;
+		key.maxSpeedMod = 2.0f;
+		key.mapx = MAP_SIZE;
+		key.mapy = MAP_SIZE;
+		return key;
+	}
+
+	// same as PathManager::WriteNodeLayerCache
+	std::vector<std::uint8_t> WriteFile(const std::vector<std::unique_ptr<QTPFS::NodeLayer>>& layers) {
+		std::vector<std::uint8_t> buffer;
+
+		QTPFS::NodeLayerCache::WriteFileHeader(buffer, GetKey(), layers.size(), 7);
+
+		for (const auto& layer: layers) {
+			const size_t sizePos = QTPFS::NodeLayerCache::BeginLayer(buffer);
+			layer->WriteCache(buffer);
+			QTPFS::NodeLayerCache::EndLayer(buffer, sizePos);
+		}
+
+		return buffer;
+	}
+
+	// same as PathManager::ReadNodeLayerCache
+	bool ReadFile(const std::vector<std::uint8_t>& buffer, std::vector<std::unique_ptr<QTPFS::NodeLayer>>& layers) {
+		QTPFS::NodeLayerCache::FileHeader header;
+		std::vector<std::pair<const std::uint8_t*, size_t>> sections;
+
+		if (!QTPFS::NodeLayerCache::ReadFile(buffer, GetKey(), NUM_LAYERS, header, sections))
+			return false;
+
+		layers.clear();
+
+		for (size_t i = 0; i < sections.size(); i++) {
+			layers.push_back(MakeLayer(i));
+
+			if (!layers.back()->ReadCache(sections[i].first, sections[i].second))
+				return false;
+		}
+
+		return (header.maxDepth == 7);
+	}
+
+	std::vector<std::unique_ptr<QTPFS::NodeLayer>> MakeLayers() {
+		std::vector<std::unique_ptr<QTPFS::NodeLayer>> layers;
+
+		for (size_t i = 0; i < NUM_LAYERS; i++) {
+			const std::vector<std::uint8_t> buffer = GetLayerBuffer(MakeLayerData(i));
+
+			layers.push_back(MakeLayer(i));
+			REQUIRE(layers.back()->ReadCache(buffer.data(), buffer.size()));
+		}
+
+		return layers;
+	}
+}
+
+
+TEST_CASE("NodeLayerCacheRoundTrip")
+{
+	const TestLayerData data = MakeLayerData(1);
+	const std::vector<std::uint8_t> buffer = GetLayerBuffer(data);
+
+	std::unique_ptr<QTPFS::NodeLayer> layer = MakeLayer(0);
+
+	REQUIRE(layer->ReadCache(buffer.data(), buffer.size()));
+
+	CHECK(layer->GetMaxNodesAlloced() == 12);
+	CHECK(layer->GetNumLeafNodes() == 7);
+	CHECK(layer->GetNumOpenNodes() == 6);
+	CHECK(layer->GetNumClosedNodes() == 1);
+	CHECK(layer->GetRootNodeCount() == 4);
+	CHECK(layer->GetRootMask() == 0x3);
+	CHECK(layer->GetCurSpeedMods() == data.speedMods);
+	CHECK(layer->GetCurSpeedBins() == data.speedBins);
+
+	size_t ngbIndex = 0;
+
+	for (const QTPFS::INode::CacheData& nodeData: data.nodes) {
+		const QTPFS::INode* node = layer->GetPoolNode(nodeData.index);
+
+		CHECK(node->GetIndex() == nodeData.index);
+		CHECK(node->GetNodeNumber() == nodeData.nodeNumber);
+		CHECK(node->GetChildBaseIndex() == nodeData.childBaseIndex);
+		CHECK(node->GetMoveCost() == nodeData.moveCostAvg);
+		CHECK(node->xmin() == nodeData.points[0]);
+		CHECK(node->zmax() == nodeData.points[3]);
+		REQUIRE(node->GetNeighbours().size() == nodeData.numNeighbours);
+
+		for (const QTPFS::INode::NeighbourPoints& ngb: node->GetNeighbours()) {
+			CHECK(ngb.nodeId == data.neighbours[ngbIndex].nodeId);
+			CHECK(ngb.netpoints[0].x == data.neighbours[ngbIndex].netpoints[0].x);
+			CHECK(ngb.netpoints[0].y == data.neighbours[ngbIndex].netpoints[0].y);
+			ngbIndex += 1;
+		}
+	}
+
+	// leaf lookups walk the restored child indices
+	CHECK(layer->GetNode(1, 1)->GetIndex() == 4);
+	CHECK(layer->GetNode(ROOT_SIZE - 1, ROOT_SIZE - 1)->GetIndex() == 7);
+	CHECK(layer->GetNode(MAP_SIZE - 1, 0)->GetIndex() == 1);
+
+	// a restored layer writes exactly what it read, free-list order included
+	CHECK(WriteLayer(*layer) == buffer);
+}
+
+TEST_CASE("NodeLayerCacheFileRoundTrip")
+{
+	const std::vector<std::uint8_t> buffer = WriteFile(MakeLayers());
+
+	std::vector<std::unique_ptr<QTPFS::NodeLayer>> readLayers;
+
+	REQUIRE(ReadFile(buffer, readLayers));
+	REQUIRE(readLayers.size() == NUM_LAYERS);
+
+	for (size_t i = 0; i < NUM_LAYERS; i++) {
+		CHECK(WriteLayer(*readLayers[i]) == GetLayerBuffer(MakeLayerData(i)));
+	}
+}
+
+TEST_CASE("NodeLayerCacheKeyMismatch")
+{
+	const std::vector<std::uint8_t> buffer = WriteFile(MakeLayers());
+
+	QTPFS::NodeLayerCache::FileHeader header;
+	std::vector<std::pair<const std::uint8_t*, size_t>> sections;
+
+	QTPFS::NodeLayerCache::Key key = GetKey();
+	CHECK(QTPFS::NodeLayerCache::ReadFile(buffer, key, NUM_LAYERS, header, sections));
+	CHECK_FALSE(QTPFS::NodeLayerCache::ReadFile(buffer, key, NUM_LAYERS - 1, header, sections));
+
+	// keys differing in any field are told apart, even when their hashes would collide
+	key.typemapChecksum += 1;
+	CHECK_FALSE(QTPFS::NodeLayerCache::ReadFile(buffer, key, NUM_LAYERS, header, sections));
+	CHECK(key.GetHash() != GetKey().GetHash());
+}
+
+TEST_CASE("NodeLayerCacheTruncated")
+{
+	const std::vector<std::uint8_t> buffer = WriteFile(MakeLayers());
+
+	std::vector<std::unique_ptr<QTPFS::NodeLayer>> readLayers;
+
+	for (size_t size = 0; size < buffer.size(); size += 1 + (size > 256) * 61) {
+		CHECK_FALSE(ReadFile(std::vector<std::uint8_t>(buffer.begin(), buffer.begin() + size), readLayers));
+	}
+}
+
+TEST_CASE("NodeLayerCacheCorrupt")
+{
+	const TestLayerData data = MakeLayerData(2);
+
+	// a rejected cache must leave the layer exactly as it was
+	const auto ReadCorrupted = [&](const std::vector<std::uint8_t>& corrupt) {
+		std::unique_ptr<QTPFS::NodeLayer> layer = MakeLayer(0);
+		const std::vector<std::uint8_t> before = WriteLayer(*layer);
+
+		if (layer->ReadCache(corrupt.data(), corrupt.size()))
+			return true;
+
+		CHECK(WriteLayer(*layer) == before);
+		return false;
+	};
+
+	REQUIRE(ReadCorrupted(GetLayerBuffer(data)));
+
+	SECTION("payload bit flips fail the checksum") {
+		const std::vector<std::uint8_t> buffer = GetLayerBuffer(data);
+
+		for (size_t pos = sizeof(QTPFS::NodeLayerCache::LayerHeader); pos < buffer.size(); pos += 97) {
+			std::vector<std::uint8_t> corrupt = buffer;
+			corrupt[pos] ^= 0x10;
+			CHECK_FALSE(ReadCorrupted(corrupt));
+		}
+	}
+
+	// the remaining corruptions carry a matching checksum
+	SECTION("child index beyond the allocated nodes") {
+		TestLayerData d = data;
+		d.nodes[0].childBaseIndex = 10;
+		CHECK_FALSE(ReadCorrupted(GetLayerBuffer(d)));
+		d.nodes[0].childBaseIndex = QTPFS::NodeLayer::POOL_TOTAL_SIZE;
+		CHECK_FALSE(ReadCorrupted(GetLayerBuffer(d)));
+	}
+	SECTION("node id not matching its pool slot") {
+		TestLayerData d = data;
+		d.nodes[5].index = 6;
+		CHECK_FALSE(ReadCorrupted(GetLayerBuffer(d)));
+	}
+	SECTION("neighbour id beyond the allocated nodes") {
+		TestLayerData d = data;
+		d.neighbours.back().nodeId = 12;
+		CHECK_FALSE(ReadCorrupted(GetLayerBuffer(d)));
+		d.neighbours.back().nodeId = -1;
+		CHECK_FALSE(ReadCorrupted(GetLayerBuffer(d)));
+	}
+	SECTION("neighbour counts not adding up") {
+		TestLayerData d = data;
+		d.nodes[1].numNeighbours += 1;
+		CHECK_FALSE(ReadCorrupted(GetLayerBuffer(d)));
+	}
+	SECTION("free-list entries beyond the allocated nodes or twice") {
+		TestLayerData d = data;
+		d.freeIndcs[0] = 12;
+		CHECK_FALSE(ReadCorrupted(GetLayerBuffer(d)));
+		d.freeIndcs[0] = d.freeIndcs[1];
+		CHECK_FALSE(ReadCorrupted(GetLayerBuffer(d)));
+	}
+	SECTION("header counts") {
+		TestLayerData d = data;
+		d.header.maxNodesAlloced = QTPFS::NodeLayer::POOL_TOTAL_SIZE + 1;
+		CHECK_FALSE(ReadCorrupted(GetLayerBuffer(d)));
+		d.header.maxNodesAlloced = -1;
+		CHECK_FALSE(ReadCorrupted(GetLayerBuffer(d)));
+
+		d = data;
+		d.header.numNeighbours = 0xffffffffu;
+		CHECK_FALSE(ReadCorrupted(GetLayerBuffer(d)));
+
+		d = data;
+		d.header.numFreeIndcs = d.header.maxNodesAlloced + 1;
+		CHECK_FALSE(ReadCorrupted(GetLayerBuffer(d)));
+
+		d = data;
+		d.header.numSquares = MAP_SIZE * MAP_SIZE * 4;
+		CHECK_FALSE(ReadCorrupted(GetLayerBuffer(d)));
+
+		d = data;
+		d.header.xRootNodes = 3;
+		CHECK_FALSE(ReadCorrupted(GetLayerBuffer(d)));
+	}
+	SECTION("section size beyond the file") {
+		std::vector<std::uint8_t> corrupt = WriteFile(MakeLayers());
+		std::vector<std::unique_ptr<QTPFS::NodeLayer>> readLayers;
+
+		const std::uint64_t size = ~std::uint64_t(0) >> 1;
+		std::memcpy(corrupt.data() + sizeof(QTPFS::NodeLayerCache::FileHeader), &size, sizeof(size));
+		CHECK_FALSE(ReadFile(corrupt, readLayers));
+	}
+}
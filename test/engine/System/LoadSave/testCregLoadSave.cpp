@@ -2,6 +2,10 @@
 
 #include "System/creg/creg_cond.h"
 #include "System/creg/Serializer.h"
+#include "System/LoadSave/SaveGameStream.h"
+#include "System/LoadSave/SnapshotStore.h"
+#include "System/Misc/SpringTime.h"
+#include <cstdio>
 #include <fstream>
 #include <sstream>
 #include <string>
@@ -173,3 +177,294 @@ TEST_CASE("CregLoadSave")
 
 	delete root;
 }
+
+
+
+TEST_CASE("SaveGameStream")
+{
+	spring_clock::PushTickRate();
+	spring_time::setstarttime(spring_time::gettime(true));
+
+	const char* fileName = "testSaveGameStream.ssf";
+
+	// tiny blocks, s.t. the seeks below land in already compressed ones
+	constexpr size_t blockSize = 64;
+
+	std::stringstream expected(std::ios::in | std::ios::out | std::ios::binary);
+
+	{
+		CSaveGameStreamWriter writer(fileName, blockSize, 5, 2);
+		std::ostream os(&writer);
+
+		REQUIRE(writer.IsOpen());
+
+		for (std::ostream* s: {&os, static_cast<std::ostream*>(&expected)}) {
+			for (int i = 0; i < 1000; i++) {
+				s->put(char(i % 7));
+			}
+
+			const std::streampos end = s->tellp();
+
+			s->seekp(10);
+			s->write("patched", 7);
+			// crosses from a compressed block into the current one
+			s->seekp(int(end) - (blockSize + 8));
+			s->write("0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef0123456789", 74);
+			s->seekp(end);
+			s->write("end", 3);
+		}
+
+		CHECK(os.tellp() == expected.tellp());
+		CHECK(writer.GetNumPatches() == 2);
+		CHECK(writer.Finish());
+	}
+
+	{
+		CSaveGameStreamReader reader(fileName, 4);
+		std::istream is(&reader);
+
+		REQUIRE(reader.IsOpen());
+		CHECK(reader.GetStreamSize() == expected.str().size());
+
+		std::string data((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+		CHECK(data == expected.str());
+
+		// random access, as done by creg
+		is.clear();
+		is.seekg(500);
+		CHECK(is.tellg() == std::streampos(500));
+		CHECK(is.get() == expected.str()[500]);
+		is.seekg(0, std::ios::end);
+		CHECK(is.get() == std::char_traits<char>::eof());
+	}
+
+	{
+		CSaveGameStreamWriter writer(fileName, blockSize, 5, 2);
+		std::ostream os(&writer);
+
+		savetest(&os);
+		savetest(&os);
+		CHECK(writer.Finish());
+	}
+
+	{
+		CSaveGameStreamReader reader(fileName, 4);
+		std::istream is(&reader);
+
+		REQUIRE(reader.IsOpen());
+
+		for (int i = 0; i < 2; i++) {
+			TestObj* root = (TestObj*)loadtest(&is);
+
+			CHECK(test_creg_members(root));
+			CHECK(test_creg_pointers(root));
+
+			delete root;
+		}
+	}
+
+	{
+		// legacy saves are gzip streams
+		std::ofstream(fileName, std::ios::binary) << "\x1f\x8b not a save stream";
+
+		CSaveGameStreamReader reader(fileName, 4);
+		CHECK_FALSE(reader.IsOpen());
+	}
+
+	std::remove(fileName);
+}
+
+
+TEST_CASE("SnapshotStore")
+{
+	// state that changes a little between snapshots, including
+	// inserted bytes which shift everything behind them
+	std::vector<std::uint8_t> state(1 << 20);
+	std::uint32_t seed = 1;
+
+	for (std::uint8_t& b: state) {
+		b = (seed = seed * 1664525 + 1013904223) >> 24;
+	}
+
+	std::vector< std::vector<std::uint8_t> > states;
+	CSnapshotStore store(64 << 20, 1);
+
+	for (int i = 0; i < 4; i++) {
+		state[i * 100000] ^= 0xff;
+		state.insert(state.begin() + 300000 + i * 100000, 100, std::uint8_t(i));
+
+		store.Add((i + 1) * 4096, i, state.data(), state.size());
+		states.push_back(state);
+	}
+
+	REQUIRE(store.GetSnapshots().size() == 4);
+
+	// all but the first snapshot only add the chunks around their edits
+	CHECK(store.GetSnapshots()[0].numAddedBytes >= state.size() / 2);
+
+	for (size_t i = 1; i < 4; i++) {
+		CHECK(store.GetSnapshots()[i].numAddedBytes < 4 * CSnapshotStore::MAX_CHUNK_SIZE);
+	}
+
+	CHECK(store.FindNearest(4095) == nullptr);
+	CHECK(store.FindNearest(4096)->frameNum == 4096);
+	CHECK(store.FindNearest(3 * 4096 + 100)->frameNum == 3 * 4096);
+	CHECK(store.FindNearest(1 << 30)->frameNum == 4 * 4096);
+
+	std::vector<std::uint8_t> data;
+
+	for (size_t i = 0; i < 4; i++) {
+		CHECK(store.Restore(store.GetSnapshots()[i], data));
+		CHECK(data == states[i]);
+	}
+
+	{
+		// the oldest are dropped beyond the memory limit, along with their chunks
+		CSnapshotStore smallStore(states[0].size() + 32 * 1024, 1);
+
+		for (size_t i = 0; i < 4; i++) {
+			smallStore.Add(i, 0, states[i].data(), states[i].size());
+		}
+
+		CHECK(smallStore.GetSnapshots().size() < 4);
+		CHECK(smallStore.GetSnapshots().back().frameNum == 3);
+		CHECK(smallStore.GetMemoryUsage() <= states[0].size() + 32 * 1024);
+
+		CHECK(smallStore.Restore(smallStore.GetSnapshots().back(), data));
+		CHECK(data == states[3]);
+
+		smallStore.Clear();
+		CHECK(smallStore.GetNumChunks() == 0);
+		CHECK(smallStore.GetMemoryUsage() == 0);
+	}
+}
+
+
+
+// stand-in for the synced game state and its per-frame update, see CSimSnapshotHandler
+struct SimState {
+	CR_DECLARE_STRUCT(SimState);
+
+	int frameNum = 0;
+	std::uint32_t rngState = 1;
+
+	std::vector<int> health;
+	std::vector<float> pos;
+};
+
+CR_BIND(SimState, );
+CR_REG_METADATA(SimState, (
+	CR_MEMBER(frameNum),
+	CR_MEMBER(rngState),
+	CR_MEMBER(health),
+	CR_MEMBER(pos)
+));
+
+static void SimFrame(SimState& s, const std::vector< std::pair<int, int> >& commands)
+{
+	s.frameNum += 1;
+
+	// recorded input, applied on the frame it was issued for
+	for (const auto& [frameNum, unitIdx]: commands) {
+		if (frameNum == s.frameNum && unitIdx < int(s.health.size()))
+			s.health[unitIdx] += 100;
+	}
+
+	// spawn units now and then, s.t. later state shifts
+	if ((s.frameNum % 50) == 0) {
+		s.health.insert(s.health.begin(), 1000);
+		s.pos.insert(s.pos.begin(), 0.0f);
+	}
+
+	for (size_t i = 0; i < s.health.size(); i++) {
+		s.rngState = s.rngState * 1664525 + 1013904223;
+		s.pos[i] += ((s.rngState >> 16) & 0xff) * 0.01f - 1.0f;
+		s.health[i] -= (s.rngState >> 28);
+	}
+}
+
+static std::uint32_t SimChecksum(const SimState& s, std::uint32_t checksum)
+{
+	// order-dependent, like CSyncChecker
+	const auto add = [&](const void* p, size_t n) {
+		for (size_t i = 0; i < n; i++) {
+			checksum = (checksum ^ static_cast<const std::uint8_t*>(p)[i]) * 16777619u;
+		}
+	};
+
+	add(&s.rngState, sizeof(s.rngState));
+	add(s.health.data(), s.health.size() * sizeof(int));
+	add(s.pos.data(), s.pos.size() * sizeof(float));
+	return checksum;
+}
+
+TEST_CASE("SnapshotReplay")
+{
+	// frames between checksum resets and snapshots (4096 in the engine)
+	constexpr int checksumPeriod = 64;
+	constexpr int numFrames = 8 * checksumPeriod + 10;
+
+	std::vector< std::pair<int, int> > commands;
+
+	for (int i = 1; i < numFrames; i += 7) {
+		commands.emplace_back(i, i % 5);
+	}
+
+	// full replay, snapshots are taken right after the checksum reset
+	std::vector<std::uint32_t> replayChecksums(numFrames + 1, 0);
+	CSnapshotStore store(64 << 20, 1, false);
+
+	{
+		SimState state;
+		std::uint32_t checksum = 0;
+
+		for (int f = 1; f <= numFrames; f++) {
+			SimFrame(state, commands);
+			replayChecksums[f] = (checksum = SimChecksum(state, checksum));
+
+			if ((f % checksumPeriod) != 0)
+				continue;
+
+			checksum = 0;
+
+			std::stringstream ss(std::ios::in | std::ios::out | std::ios::binary);
+			creg::COutputStreamSerializer os;
+			os.SavePackage(&ss, &state, state.GetClass());
+
+			const std::string data = ss.str();
+			store.Add(f, replayChecksums[f], reinterpret_cast<const std::uint8_t*>(data.data()), data.size());
+		}
+	}
+
+	REQUIRE(store.GetSnapshots().size() == numFrames / checksumPeriod);
+
+	// resuming from any snapshot reports the same checksums as the full replay
+	for (const CSnapshotStore::Snapshot& snapshot: store.GetSnapshots()) {
+		std::vector<std::uint8_t> data;
+		REQUIRE(store.Restore(snapshot, data));
+
+		std::stringstream ss(std::string(data.begin(), data.end()), std::ios::in | std::ios::binary);
+		SimState* state = static_cast<SimState*>(loadtest(&ss));
+
+		REQUIRE(state != nullptr);
+		CHECK(state->frameNum == snapshot.frameNum);
+		CHECK(snapshot.syncChecksum == replayChecksums[snapshot.frameNum]);
+
+		std::uint32_t checksum = 0;
+		int numMismatches = 0;
+
+		for (int f = snapshot.frameNum + 1; f <= numFrames; f++) {
+			SimFrame(*state, commands);
+			checksum = SimChecksum(*state, checksum);
+			numMismatches += (checksum != replayChecksums[f]);
+
+			if ((f % checksumPeriod) == 0)
+				checksum = 0;
+		}
+
+		INFO("resumed from frame " << snapshot.frameNum);
+		CHECK(numMismatches == 0);
+
+		delete state;
+	}
+}
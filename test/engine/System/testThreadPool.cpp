@@ -1,12 +1,14 @@
 /* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
 
 #include "System/Threading/ThreadPool.h"
+#include "System/Threading/TaskGraph.h"
 #include "System/Log/ILog.h"
 #include "System/Threading/SpringThreading.h"
 #include "System/Misc/SpringTime.h"
 #include "System/SpringMath.h"
 #include "System/GlobalRNG.h"
 
+#include <algorithm>
 #include <vector>
 #include <atomic>
 #include <future>
@@ -184,6 +186,216 @@ TEST_CASE("test_null_for_mt")
 }
 
 
+TEST_CASE("test_work_stealing_for_mt")
+{
+	LOG("[%s::test_work_stealing_for_mt]", __func__);
+
+	ThreadPool::SetWorkStealing(true);
+	CHECK(ThreadPool::UseWorkStealing());
+
+	std::vector<std::atomic<int>> nums(NUM_RUNS);
+
+	for (auto& n: nums)
+		n = 0;
+
+	for_mt(0, NUM_RUNS, 2, [&](const int i) {
+		const int threadnum = ThreadPool::GetThreadNum();
+		SAFE_CHECK(threadnum < NUM_THREADS);
+		SAFE_CHECK(threadnum >= 0);
+		SAFE_CHECK(i < NUM_RUNS);
+		SAFE_CHECK(i >= 0);
+		nums[i]++;
+	});
+
+	for (int i = 0; i < NUM_RUNS; i++) {
+		CHECK(nums[i] == (1 - (i % 2)));
+	}
+
+	// every index exactly once, for all chunk size limits
+	for (const int2 chunkSizes: {int2(1, 1), int2(1, 7), int2(16, 16), int2(100, 10000), int2(NUM_RUNS, NUM_RUNS)}) {
+		for (auto& n: nums)
+			n = 0;
+
+		for_mt_chunk(3, NUM_RUNS, [&](const int i) {
+			nums[i]++;
+		}, chunkSizes.x, chunkSizes.y);
+
+		for (int i = 0; i < NUM_RUNS; i++) {
+			CHECK(nums[i] == (i >= 3));
+		}
+	}
+
+	ThreadPool::SetWorkStealing(false);
+}
+
+TEST_CASE("test_work_stealing_nested_for_mt")
+{
+	LOG("[%s::test_work_stealing_nested_for_mt]", __func__);
+
+	ThreadPool::SetWorkStealing(true);
+
+	std::atomic<int> cnt(0);
+
+	for_mt(0, 100, [&](const int y) {
+		for_mt(0, 100, [&](const int x) {
+			const int threadnum = ThreadPool::GetThreadNum();
+			SAFE_CHECK(threadnum < NUM_THREADS);
+			SAFE_CHECK(threadnum >= 0);
+			++cnt;
+		});
+
+		// the inner loop must not end the outer one's section
+		SAFE_CHECK(ThreadPool::inMultiThreadedSection);
+	});
+
+	CHECK(cnt == 100 * 100);
+	CHECK_FALSE(ThreadPool::inMultiThreadedSection);
+
+	// async tasks can not take part in work-stealing and fall back to task groups
+	auto future = ThreadPool::Enqueue([&]() {
+		std::atomic<int> asyncCnt(0);
+
+		for_mt(0, 100, [&](const int i) {
+			++asyncCnt;
+		});
+
+		return asyncCnt.load();
+	});
+
+	CHECK(future->get() == 100);
+
+	ThreadPool::SetWorkStealing(false);
+}
+
+TEST_CASE("test_for_mt_with_caller")
+{
+	LOG("[%s::test_for_mt_with_caller]", __func__);
+
+	std::atomic<int> cnt(0);
+	int callerThread = -1;
+	bool callerInSection = true;
+
+	for_mt_with_caller(0, 1000, [&](const int i) {
+		// the loop body always runs in a multi-threaded section
+		SAFE_CHECK(ThreadPool::inMultiThreadedSection);
+		++cnt;
+	}, [&]() {
+		callerThread = ThreadPool::GetThreadNum();
+		callerInSection = ThreadPool::inMultiThreadedSection;
+	});
+
+	CHECK(cnt == 1000);
+	CHECK(callerThread == 0);
+	// <g> runs as it would serially, e.g. synced code branching on the flag
+	CHECK_FALSE(callerInSection);
+	CHECK_FALSE(ThreadPool::inMultiThreadedSection);
+}
+
+TEST_CASE("test_task_graph_waves")
+{
+	LOG("[%s::test_task_graph_waves]", __func__);
+
+	CTaskGraph graph;
+	std::vector<int> order;
+
+	const auto AddNode = [&](const char* name, int id, CTaskGraph::ResourceMask reads, CTaskGraph::ResourceMask writes, bool callerThread, CTaskGraph::AccessFunc&& accessFunc = nullptr) {
+		graph.AddNode(name, [&, id]() {
+			std::lock_guard<spring::mutex> _(m);
+			order.push_back(id);
+		}, reads, writes, callerThread, std::move(accessFunc));
+	};
+
+	AddNode("A", 0, 0, 1 << 0, false);
+	AddNode("B", 1, 0, 1 << 1, false);
+	AddNode("C", 2, (1 << 0) | (1 << 1), 1 << 2, false);
+	AddNode("D", 3, 0, 1 << 3, true);
+	AddNode("E", 4, 0, 1 << 4, true);
+	// skipped, commutes with E although it declares to write what F reads
+	AddNode("F", 5, 0, 1 << 5, false, [](CTaskGraph::ResourceMask&, CTaskGraph::ResourceMask&) { return false; });
+	AddNode("G", 6, (1 << 2) | (1 << 5), 1 << 6, false);
+	// narrowed from writing everything to a single resource
+	AddNode("H", 7, 0, ~CTaskGraph::ResourceMask(0), false, [](CTaskGraph::ResourceMask& reads, CTaskGraph::ResourceMask& writes) { writes = 1 << 7; return true; });
+
+	graph.Run(true);
+
+	const auto& nodes = graph.GetNodes();
+
+	if (ThreadPool::HasThreads()) {
+		CHECK(graph.GetNumWaves() == 3);
+		CHECK(nodes[0].wave == 0);
+		CHECK(nodes[1].wave == 0);
+		CHECK(nodes[2].wave == 1);
+		CHECK(nodes[3].wave == 1);
+		CHECK(nodes[4].wave == 2);
+		CHECK(nodes[5].wave == -1);
+		CHECK(nodes[6].wave == 2);
+		CHECK(nodes[7].wave == 2);
+		CHECK(!nodes[5].active);
+		CHECK(order.size() == 7);
+	}
+
+	order.clear();
+	graph.Run(false);
+
+	// reference order runs every node, including skippable ones
+	CHECK(order == std::vector<int>{0, 1, 2, 3, 4, 5, 6, 7});
+	CHECK(graph.GetNumWaves() == 0);
+}
+
+TEST_CASE("test_task_graph_order")
+{
+	LOG("[%s::test_task_graph_order]", __func__);
+
+	static constexpr int NUM_NODES = 64;
+	static constexpr int NUM_RESOURCES = 8;
+
+	CGlobalUnsyncedRNG rng;
+	CTaskGraph graph;
+
+	std::vector<CTaskGraph::ResourceMask> reads(NUM_NODES);
+	std::vector<CTaskGraph::ResourceMask> writes(NUM_NODES);
+	std::vector<int> finishSeq(NUM_NODES, -1);
+	std::vector<int> startSeq(NUM_NODES, -1);
+	std::atomic<int> seq(0);
+
+	rng.Seed(NUM_NODES);
+
+	for (int i = 0; i < NUM_NODES; ++i) {
+		reads[i] = 1 << rng.NextInt(NUM_RESOURCES);
+		writes[i] = (1 << rng.NextInt(NUM_RESOURCES)) * (rng.NextInt(3) != 0);
+
+		const bool callerThread = (rng.NextInt(4) == 0);
+
+		graph.AddNode("Node", [&, i, callerThread]() {
+			startSeq[i] = seq++;
+
+			if (callerThread)
+				SAFE_CHECK(ThreadPool::GetThreadNum() == 0);
+
+			// nodes see the flag as in the reference order on any thread
+			SAFE_CHECK(!ThreadPool::inMultiThreadedSection);
+
+			// give overlapping nodes a chance to interleave
+			spring::this_thread::sleep_for(std::chrono::microseconds(100));
+			finishSeq[i] = seq++;
+		}, reads[i], writes[i], callerThread);
+	}
+
+	graph.Run(true);
+
+	for (int i = 0; i < NUM_NODES; ++i) {
+		for (int j = i + 1; j < NUM_NODES; ++j) {
+			if (!CTaskGraph::Conflicts(reads[i], writes[i], reads[j], writes[j]))
+				continue;
+
+			// conflicting nodes keep their reference order and never overlap
+			CHECK(finishSeq[i] < startSeq[j]);
+		}
+	}
+
+	CHECK(graph.GetNumWaves() <= NUM_NODES);
+}
+
 TEST_CASE("test_sse_for_mt")
 {
 	LOG("[%s::test_sse_for_mt]", __func__);
@@ -338,6 +550,105 @@ TEST_CASE("test_parallel_gtn_cost")
 	LOG("[%s::test_parallel_gtn_cost] %.6fms (avg)", __func__, totalCost / threads);
 }
 
+static void scheduler_kernel(const char* schedulerName, bool workStealing)
+{
+	LOG("\t[%s] %s", __func__, schedulerName);
+
+	ThreadPool::SetWorkStealing(workStealing);
+
+	const auto& ExecKernel = [](const spring_time t) {
+		const spring_time finish = spring_now() + t;
+		while (spring_now() < finish) {}
+	};
+
+	std::atomic<int> sink(0);
+
+	{
+		// many small loops per frame, typical for a dedicated server
+		constexpr int NUM_LOOPS = 20000;
+		constexpr int NUM_ELEMS = 64;
+
+		const spring_time start = spring_now();
+
+		for (int n = 0; n < NUM_LOOPS; ++n) {
+			for_mt(0, NUM_ELEMS, [&](const int i) {
+				sink += i;
+			});
+		}
+
+		const spring_time total = spring_now() - start;
+		LOG("\t\tsmall loops: %.4fms total, %.3fus per for_mt", total.toMilliSecsf(), total.toMilliSecsf() * 1000.0f / NUM_LOOPS);
+	}
+	{
+		// per-element cost grows with the index
+		const spring_time start = spring_now();
+
+		for (int n = 0; n < 20; ++n) {
+			for_mt(0, 256, [&](const int i) {
+				ExecKernel(spring_time::fromMicroSecs(i / 16));
+			});
+		}
+
+		LOG("\t\timbalanced loops: %.4fms", (spring_now() - start).toMilliSecsf());
+	}
+	{
+		const spring_time start = spring_now();
+
+		for (int n = 0; n < 20; ++n) {
+			for_mt_chunk(0, 100000, [&](const int i) {
+				sink += (i & 1);
+			}, 64);
+		}
+
+		LOG("\t\tchunked loops: %.4fms", (spring_now() - start).toMilliSecsf());
+	}
+	{
+		const spring_time start = spring_now();
+
+		for (int n = 0; n < 20; ++n) {
+			for_mt(0, 32, [&](const int y) {
+				for_mt(0, 32, [&](const int x) {
+					ExecKernel(spring_time::fromMicroSecs(5));
+				});
+			});
+		}
+
+		LOG("\t\tnested loops: %.4fms", (spring_now() - start).toMilliSecsf());
+	}
+	{
+		// time until the last element of a loop with one element per thread started
+		constexpr int NUM_LOOPS = 1000;
+
+		std::vector<float> startTimes(ThreadPool::GetNumThreads(), 0.0f);
+		float maxStartTime = 0.0f;
+
+		for (int n = 0; n < NUM_LOOPS; ++n) {
+			const spring_time start = spring_now();
+
+			for_mt(0, startTimes.size(), [&](const int i) {
+				startTimes[i] = (spring_now() - start).toMilliSecsf();
+				ExecKernel(spring_time::fromMicroSecs(20));
+			});
+
+			maxStartTime += *std::max_element(startTimes.begin(), startTimes.end());
+		}
+
+		LOG("\t\tlatency: %.6fms (avg)", maxStartTime / NUM_LOOPS);
+	}
+
+	ThreadPool::SetWorkStealing(false);
+}
+
+TEST_CASE("test_scheduler_throughput")
+{
+	LOG("[%s::test_scheduler_throughput]", __func__);
+
+	ThreadPool::SetThreadCount(ThreadPool::GetMaxThreads());
+
+	scheduler_kernel("task-groups", false);
+	scheduler_kernel("work-stealing", true);
+}
+
 TEST_CASE("Cleanup")
 {
 	ThreadPool::SetThreadCount(0);
@@ -0,0 +1,156 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace us {
+	#include "../tools/unitsync/unitsync_api.h"
+};
+
+// measures unitsync startup over a generated data-dir with thousands of
+// archives, cold (no ArchiveCache) and warm from the binary or Lua cache;
+// the base content is found through the regular SPRING_DATADIR if it is
+// set, BENCHMARK_ARCHIVE_COUNT overrides the number of generated archives
+namespace {
+	namespace fs = std::filesystem;
+
+	const fs::path& GetDataDir() {
+		static const fs::path dataDir = fs::temp_directory_path() / "spring-benchmark-archivescanner";
+		return dataDir;
+	}
+
+	void SetupDataDir() {
+		static bool initialized = false;
+
+		if (initialized)
+			return;
+
+		const char* countEnv = std::getenv("BENCHMARK_ARCHIVE_COUNT");
+		const int numArchives = (countEnv != nullptr)? std::atoi(countEnv): 4000;
+
+		const fs::path& dataDir = GetDataDir();
+		const char* dataDirEnv = std::getenv("SPRING_DATADIR");
+
+		fs::remove_all(dataDir);
+		fs::create_directories(dataDir / "games");
+
+		for (int i = 0; i < numArchives; i++) {
+			const std::string name = "game" + std::to_string(i);
+			const fs::path archiveDir = dataDir / "games" / (name + ".sdd");
+
+			fs::create_directories(archiveDir);
+
+			std::ofstream modInfo(archiveDir / "modinfo.lua");
+			modInfo << "return {\n";
+			modInfo << "\tname = \"" << name << "\",\n";
+			modInfo << "\tshortname = \"G" << i << "\",\n";
+			modInfo << "\tversion = \"v" << (i % 7) << "\",\n";
+			modInfo << "\tdescription = \"generated benchmark archive\",\n";
+			modInfo << "\tmodtype = 1,\n";
+
+			if (i > 0)
+				modInfo << "\tdepend = {\"game" << (i / 2) << ".sdd\"},\n";
+
+			modInfo << "}\n";
+		}
+
+		{
+			std::ofstream config(dataDir / "springsettings.cfg");
+			config << "ArchiveCacheExportLua = 1\n";
+		}
+
+		const std::string dataDirs = (dataDirEnv != nullptr)? (dataDir.string() + ":" + dataDirEnv): dataDir.string();
+
+		setenv("SPRING_WRITEDIR", dataDir.c_str(), 1);
+		setenv("SPRING_DATADIR", dataDirs.c_str(), 1);
+
+		initialized = true;
+	}
+
+	void RemoveCacheFiles(const char* extension) {
+		for (const auto& entry: fs::recursive_directory_iterator(GetDataDir() / "cache")) {
+			const fs::path& path = entry.path();
+
+			if (path.filename().string().rfind("ArchiveCache", 0) == 0 && path.extension() == extension)
+				fs::remove(path);
+		}
+	}
+
+	void InitUnitSync(benchmark::State& state) {
+		us::SetSpringConfigFile((GetDataDir() / "springsettings.cfg").c_str());
+
+		if (us::Init(false, 0) == 0)
+			state.SkipWithError(us::GetNextError());
+
+		state.counters["archives"] = us::GetPrimaryModCount();
+	}
+
+	// one untimed run to create the caches of the warm benchmarks
+	void CreateCacheFiles(benchmark::State& state) {
+		InitUnitSync(state);
+		us::UnInit();
+	}
+}
+
+
+static void BM_InitCold(benchmark::State& state) {
+	SetupDataDir();
+	CreateCacheFiles(state);
+
+	for (auto _ : state) {
+		state.PauseTiming();
+		RemoveCacheFiles(".bin");
+		RemoveCacheFiles(".lua");
+		state.ResumeTiming();
+
+		InitUnitSync(state);
+
+		state.PauseTiming();
+		us::UnInit();
+		state.ResumeTiming();
+	}
+}
+
+static void BM_InitWarmBinaryCache(benchmark::State& state) {
+	SetupDataDir();
+	CreateCacheFiles(state);
+
+	for (auto _ : state) {
+		InitUnitSync(state);
+
+		state.PauseTiming();
+		us::UnInit();
+		state.ResumeTiming();
+	}
+}
+
+// startup as before the binary cache existed; this also includes writing
+// the binary cache since a migrated Lua cache is always written back
+static void BM_InitWarmLuaCache(benchmark::State& state) {
+	SetupDataDir();
+	CreateCacheFiles(state);
+
+	for (auto _ : state) {
+		state.PauseTiming();
+		RemoveCacheFiles(".bin");
+		state.ResumeTiming();
+
+		InitUnitSync(state);
+
+		state.PauseTiming();
+		us::UnInit();
+		state.ResumeTiming();
+	}
+}
+
+BENCHMARK(BM_InitCold)->Unit(benchmark::kMillisecond)->Iterations(3);
+BENCHMARK(BM_InitWarmBinaryCache)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_InitWarmLuaCache)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
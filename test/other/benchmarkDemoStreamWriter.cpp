@@ -0,0 +1,193 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "System/LoadSave/DemoStreamWriter.h"
+#include "Sim/Misc/GlobalConstants.h"
+#include "System/Misc/SpringTime.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <zlib.h>
+
+// replays the packet stream of a demo through the recording path, either the
+// one of a real demo (point DEMO_FILE at it) or a synthetic one; as this runs
+// without pauses it measures the worst case for the writer thread to keep up
+namespace {
+	struct Packet {
+		float modGameTime;
+		std::string data;
+	};
+
+	struct PacketStream {
+		std::vector<Packet> packets;
+		size_t numBytes = 0;
+	};
+
+	bool ReadDemoStream(const char* fileName, PacketStream& stream) {
+		gzFile file = gzopen(fileName, "rb");
+
+		if (file == nullptr)
+			return false;
+
+		DemoFileHeader fileHeader;
+
+		if (gzread(file, &fileHeader, sizeof(fileHeader)) != sizeof(fileHeader) || memcmp(fileHeader.magic, DEMOFILE_MAGIC, sizeof(fileHeader.magic)) != 0) {
+			gzclose(file);
+			return false;
+		}
+
+		fileHeader.swab();
+		gzseek(file, fileHeader.headerSize + fileHeader.scriptSize, SEEK_SET);
+
+		// crashed demos have no stream size, read until the end then
+		int bytesRemaining = (fileHeader.demoStreamSize != 0)? fileHeader.demoStreamSize: std::numeric_limits<int>::max();
+
+		while (bytesRemaining > int(sizeof(DemoStreamChunkHeader))) {
+			DemoStreamChunkHeader chunkHeader;
+
+			if (gzread(file, &chunkHeader, sizeof(chunkHeader)) != sizeof(chunkHeader))
+				break;
+
+			chunkHeader.swab();
+
+			Packet packet = {chunkHeader.modGameTime, std::string(chunkHeader.length, '\0')};
+
+			if (gzread(file, packet.data.data(), chunkHeader.length) != int(chunkHeader.length))
+				break;
+
+			bytesRemaining -= (sizeof(chunkHeader) + chunkHeader.length);
+
+			stream.numBytes += (sizeof(chunkHeader) + chunkHeader.length);
+			stream.packets.push_back(std::move(packet));
+		}
+
+		gzclose(file);
+		return (!stream.packets.empty());
+	}
+
+	// a frame message followed by a burst of small, repetitive command packets
+	PacketStream GenerateStream(int numFrames) {
+		std::mt19937 rng(numFrames);
+		std::uniform_int_distribution<int> countDist(0, 12);
+		std::uniform_int_distribution<int> sizeDist(8, 96);
+		std::uniform_int_distribution<int> byteDist(0, 15);
+
+		PacketStream stream;
+
+		for (int frame = 0; frame < numFrames; frame++) {
+			const float modGameTime = frame / float(GAME_SPEED);
+
+			stream.packets.push_back({modGameTime, std::string(5, char(2))});
+
+			for (int i = 0, n = countDist(rng); i < n; i++) {
+				Packet packet = {modGameTime, std::string(sizeDist(rng), '\0')};
+
+				for (char& c: packet.data) {
+					c = byteDist(rng);
+				}
+
+				stream.packets.push_back(std::move(packet));
+			}
+		}
+
+		for (const Packet& packet: stream.packets) {
+			stream.numBytes += (sizeof(DemoStreamChunkHeader) + packet.data.size());
+		}
+
+		return stream;
+	}
+
+	const PacketStream& GetPacketStream() {
+		static PacketStream stream;
+
+		if (!stream.packets.empty())
+			return stream;
+
+		spring_clock::PushTickRate();
+		spring_time::setstarttime(spring_time::gettime(true));
+
+		const char* fileName = std::getenv("DEMO_FILE");
+
+		if (fileName == nullptr || !ReadDemoStream(fileName, stream))
+			stream = GenerateStream(GAME_SPEED * 60 * 30);
+
+		return stream;
+	}
+
+	DemoStreamChunkHeader GetChunkHeader(const Packet& packet) {
+		DemoStreamChunkHeader chunkHeader;
+		chunkHeader.modGameTime = packet.modGameTime;
+		chunkHeader.length = packet.data.size();
+		chunkHeader.swab();
+		return chunkHeader;
+	}
+}
+
+
+// baseline: compressing every packet synchronously on the recording thread
+static void BM_RecordSyncGzip(benchmark::State& state) {
+	const PacketStream& stream = GetPacketStream();
+	const std::string mode = "wb" + std::to_string(state.range(0));
+
+	for (auto _ : state) {
+		gzFile file = gzopen("benchmarkDemoStreamWriter.sdfz", mode.c_str());
+
+		for (const Packet& packet: stream.packets) {
+			const DemoStreamChunkHeader chunkHeader = GetChunkHeader(packet);
+
+			gzwrite(file, &chunkHeader, sizeof(chunkHeader));
+			gzwrite(file, packet.data.data(), packet.data.size());
+		}
+
+		gzclose(file);
+	}
+
+	state.SetBytesProcessed(state.iterations() * stream.numBytes);
+	std::remove("benchmarkDemoStreamWriter.sdfz");
+}
+
+// time spent on the recording thread only, the writer finishes after Finish
+static void BM_RecordStreamWriter(benchmark::State& state) {
+	const PacketStream& stream = GetPacketStream();
+
+	size_t numCompressedBytes = 0;
+
+	for (auto _ : state) {
+		state.PauseTiming();
+		CDemoStreamWriter* writer = new CDemoStreamWriter("benchmarkDemoStreamWriter.sdfz", sizeof(DemoFileHeader), state.range(1) * 1024, state.range(0));
+		std::thread writerThread([writer]() { writer->Run(); });
+		state.ResumeTiming();
+
+		for (const Packet& packet: stream.packets) {
+			const DemoStreamChunkHeader chunkHeader = GetChunkHeader(packet);
+
+			writer->Write(&chunkHeader, sizeof(chunkHeader));
+			writer->Write(packet.data.data(), packet.data.size());
+		}
+
+		writer->Finish(std::string(sizeof(DemoFileHeader), '\0'), {}, 0);
+
+		state.PauseTiming();
+		writerThread.join();
+		numCompressedBytes = writer->GetNumCompressedBytes();
+		delete writer;
+		state.ResumeTiming();
+	}
+
+	state.SetBytesProcessed(state.iterations() * stream.numBytes);
+	state.counters["ratio"] = stream.numBytes / std::max(1.0, double(numCompressedBytes));
+	std::remove("benchmarkDemoStreamWriter.sdfz");
+}
+
+BENCHMARK(BM_RecordSyncGzip)->Arg(1)->Arg(6)->Arg(9)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_RecordStreamWriter)->Args({1, 4096})->Args({6, 4096})->Args({9, 4096})->Args({9, 256})->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
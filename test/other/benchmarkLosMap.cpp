@@ -0,0 +1,138 @@
+#include "System/XSimdOps.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <random>
+#include <vector>
+
+namespace {
+	// LOS map of a 16x16 map at losMipLevel 1
+	constexpr int LOSMAP_SIZE = 512;
+
+	struct Span { int start; unsigned length; };
+
+	// per-scanline spans of the sight circles, as CLosMap::AddCircle and the
+	// RLE squares of CLosMap::AddRaycast would touch them
+	std::vector<std::vector<Span>> GenerateInstances(int minRadius, int maxRadius, size_t count) {
+		std::mt19937 rng(count);
+		std::uniform_int_distribution<int> posDist(0, LOSMAP_SIZE - 1);
+		std::uniform_int_distribution<int> radDist(minRadius, maxRadius);
+
+		std::vector<std::vector<Span>> instances(count);
+
+		for (auto& spans: instances) {
+			const int px = posDist(rng);
+			const int py = posDist(rng);
+			const int radius = radDist(rng);
+
+			for (int y = -radius; y <= radius; ++y) {
+				const int width = std::sqrt(float(radius * radius - y * y));
+				const int y_ = py + y;
+				const int sx = std::clamp(px - width,     0, LOSMAP_SIZE);
+				const int ex = std::clamp(px + width + 1, 0, LOSMAP_SIZE);
+
+				if (y_ < 0 || y_ >= LOSMAP_SIZE || sx == ex)
+					continue;
+
+				spans.push_back({y_ * LOSMAP_SIZE + sx, unsigned(ex - sx)});
+			}
+		}
+
+		return instances;
+	}
+
+	// mostly short-ranged sight, some radars and a few long-ranged sensors
+	std::vector<std::vector<Span>> GenerateMixedInstances(size_t count) {
+		auto instances = GenerateInstances( 4,  24, count * 8 / 10);
+		auto radars    = GenerateInstances(24,  80, count * 15 / 100);
+		auto sensors   = GenerateInstances(80, 160, count * 5 / 100);
+
+		instances.insert(instances.end(), radars.begin(), radars.end());
+		instances.insert(instances.end(), sensors.begin(), sensors.end());
+		return instances;
+	}
+}
+
+
+static void ScalarAdd(unsigned short* data, size_t count, unsigned short value) {
+	for (size_t i = 0; i < count; ++i) {
+		data[i] += value;
+	}
+}
+
+template<typename Func>
+static void ScalarAdd(unsigned short* data, size_t count, unsigned short value, Func&& func) {
+	for (size_t i = 0; i < count; ++i) {
+		data[i] += value;
+
+		if (data[i] == value)
+			func(i);
+	}
+}
+
+
+template<bool UseSimd, bool NotifyEntered>
+static void BenchLosMapAdd(benchmark::State& state, const std::vector<std::vector<Span>>& instances) {
+	std::vector<unsigned short> losmap(LOSMAP_SIZE * LOSMAP_SIZE, 0);
+	size_t numEntered = 0;
+	size_t numSquares = 0;
+
+	const auto OnEntered = [&](size_t i) { numEntered += i; };
+
+	for (auto _ : state) {
+		// add and remove every instance once, like a full round of unit moves
+		for (const unsigned short amount: {static_cast<unsigned short>(1), static_cast<unsigned short>(-1)}) {
+			for (const auto& spans: instances) {
+				for (const Span& span: spans) {
+					unsigned short* data = &losmap[span.start];
+
+					if constexpr (UseSimd) {
+						if (NotifyEntered && amount == 1) {
+							SpanAdd(data, span.length, amount, OnEntered);
+						} else {
+							SpanAdd(data, span.length, amount);
+						}
+					} else {
+						if (NotifyEntered && amount == 1) {
+							ScalarAdd(data, span.length, amount, OnEntered);
+						} else {
+							ScalarAdd(data, span.length, amount);
+						}
+					}
+
+					numSquares += span.length;
+				}
+			}
+		}
+
+		benchmark::DoNotOptimize(losmap.data());
+		benchmark::ClobberMemory();
+	}
+
+	benchmark::DoNotOptimize(numEntered);
+	state.SetItemsProcessed(numSquares);
+}
+
+
+static void BenchSmallScalar      (benchmark::State& state) { static const auto i = GenerateInstances(4, 24, 2000); BenchLosMapAdd<false, false>(state, i); }
+static void BenchSmallSimd        (benchmark::State& state) { static const auto i = GenerateInstances(4, 24, 2000); BenchLosMapAdd< true, false>(state, i); }
+static void BenchMixedScalar      (benchmark::State& state) { static const auto i = GenerateMixedInstances(2000);   BenchLosMapAdd<false, false>(state, i); }
+static void BenchMixedSimd        (benchmark::State& state) { static const auto i = GenerateMixedInstances(2000);   BenchLosMapAdd< true, false>(state, i); }
+static void BenchMixedEnterScalar (benchmark::State& state) { static const auto i = GenerateMixedInstances(2000);   BenchLosMapAdd<false,  true>(state, i); }
+static void BenchMixedEnterSimd   (benchmark::State& state) { static const auto i = GenerateMixedInstances(2000);   BenchLosMapAdd< true,  true>(state, i); }
+static void BenchRadarScalar      (benchmark::State& state) { static const auto i = GenerateInstances(80, 160, 200); BenchLosMapAdd<false, false>(state, i); }
+static void BenchRadarSimd        (benchmark::State& state) { static const auto i = GenerateInstances(80, 160, 200); BenchLosMapAdd< true, false>(state, i); }
+
+BENCHMARK(BenchSmallScalar);
+BENCHMARK(BenchSmallSimd);
+BENCHMARK(BenchMixedScalar);
+BENCHMARK(BenchMixedSimd);
+BENCHMARK(BenchMixedEnterScalar);
+BENCHMARK(BenchMixedEnterSimd);
+BENCHMARK(BenchRadarScalar);
+BENCHMARK(BenchRadarSimd);
+
+BENCHMARK_MAIN();
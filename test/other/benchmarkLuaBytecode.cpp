@@ -0,0 +1,113 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "lua.h"
+#include "lualib.h"
+#include "lauxlib.h"
+
+#include "lib/xxhash/xxh3.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// loads a generated gadget-sized chunk, once by parsing its source (what
+// luaL_loadbuffer does without the cache) and once by undumping the bytecode
+// LuaBytecodeCache would have stored for it; the cache lookup additionally
+// hashes the source and the bytecode, reading the file is not included
+namespace {
+	std::string GenerateSource(int numFunctions) {
+		std::string source = "local gadget = {}\nlocal spGetUnitPosition = Spring.GetUnitPosition\n";
+
+		for (int i = 0; i < numFunctions; i++) {
+			const std::string n = std::to_string(i);
+
+			source += "function gadget:Func" + n + "(unitID, params)\n";
+			source += "\tlocal x, y, z = spGetUnitPosition(unitID)\n";
+			source += "\tlocal t = {name = \"func" + n + "\", value = " + n + " * 0.5, list = {1, 2, 3}}\n";
+			source += "\tfor k, v in pairs(params) do\n";
+			source += "\t\tif (type(v) == \"number\" and v > " + n + ") then\n";
+			source += "\t\t\tt[k] = math.sqrt(v * x + z) .. \" units\"\n";
+			source += "\t\telseif (v == nil) then\n";
+			source += "\t\t\treturn nil\n";
+			source += "\t\tend\n";
+			source += "\tend\n";
+			source += "\treturn t, y\n";
+			source += "end\n\n";
+		}
+
+		return (source + "return gadget\n");
+	}
+
+	int Writer(lua_State*, const void* p, size_t size, void* ud) {
+		std::vector<char>* bytecode = static_cast<std::vector<char>*>(ud);
+		bytecode->insert(bytecode->end(), static_cast<const char*>(p), static_cast<const char*>(p) + size);
+		return 0;
+	}
+
+	void* Alloc(void*, void* ptr, size_t, size_t nsize) {
+		if (nsize == 0) {
+			std::free(ptr);
+			return nullptr;
+		}
+
+		return std::realloc(ptr, nsize);
+	}
+
+	struct LuaSetup {
+		LuaSetup(int numFunctions): source(GenerateSource(numFunctions)) {
+			L = lua_newstate(Alloc, nullptr);
+
+			if (luaL_loadbuffer(L, source.data(), source.size(), "LuaRules/Gadgets/bench.lua") != 0)
+				std::abort();
+			if (lua_dump(L, Writer, &bytecode) != 0)
+				std::abort();
+
+			lua_pop(L, 1);
+		}
+		~LuaSetup() { lua_close(L); }
+
+		lua_State* L;
+
+		std::string source;
+		std::vector<char> bytecode;
+	};
+}
+
+
+static void BenchLoadSource(benchmark::State& state) {
+	LuaSetup setup(state.range(0));
+	lua_State* L = setup.L;
+
+	for (auto _ : state) {
+		if (luaL_loadbuffer(L, setup.source.data(), setup.source.size(), "LuaRules/Gadgets/bench.lua") != 0)
+			std::abort();
+
+		lua_pop(L, 1);
+	}
+
+	state.SetBytesProcessed(state.iterations() * setup.source.size());
+}
+
+static void BenchLoadBytecode(benchmark::State& state) {
+	LuaSetup setup(state.range(0));
+	lua_State* L = setup.L;
+
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(XXH3_128bits(setup.source.data(), setup.source.size()));
+		benchmark::DoNotOptimize(XXH3_64bits(setup.bytecode.data(), setup.bytecode.size()));
+
+		if (luaL_loadbuffer(L, setup.bytecode.data(), setup.bytecode.size(), "LuaRules/Gadgets/bench.lua") != 0)
+			std::abort();
+
+		lua_pop(L, 1);
+	}
+
+	state.SetBytesProcessed(state.iterations() * setup.source.size());
+}
+
+BENCHMARK(BenchLoadSource)->Arg(10)->Arg(100)->Arg(1000);
+BENCHMARK(BenchLoadBytecode)->Arg(10)->Arg(100)->Arg(1000);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,196 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "lua.h"
+#include "lualib.h"
+#include "lauxlib.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <vector>
+
+// delivers N UnitDamaged events to a Lua handle, once as one call-in per event
+// (what CLuaHandle::UnitDamaged does) and once as a single UnitDamagedBatch
+// call-in passing one array per argument (CLuaHandle::RunUnitDamagedBatch);
+// the handle forwards call-ins to its gadgets the way LuaGadgets/gadgets.lua
+// does, the engine-side costs of a call-in (locking, timers) are not included
+namespace {
+	const char* HANDLE_SOURCE = R"(
+		local function r_ipairs(tbl)
+			local function r_iter(tbl, key)
+				if (key <= 1) then
+					return nil
+				end
+				return (key - 1), tbl[key - 1]
+			end
+			return r_iter, tbl, (1 + #tbl)
+		end
+
+		local gadgetHandler = {UnitDamagedList = {}, UnitDamagedBatchList = {}}
+
+		function gadgetHandler:UnitDamaged(unitID, unitDefID, unitTeam, damage, paralyzer, weaponDefID, projectileID, attackerID, attackerDefID, attackerTeam)
+			for _,g in r_ipairs(self.UnitDamagedList) do
+				g:UnitDamaged(unitID, unitDefID, unitTeam, damage, paralyzer, weaponDefID, projectileID, attackerID, attackerDefID, attackerTeam)
+			end
+		end
+
+		function gadgetHandler:UnitDamagedBatch(count, unitIDs, unitDefIDs, unitTeams, damages, paralyzers, weaponDefIDs, projectileIDs, attackerIDs, attackerDefIDs, attackerTeams)
+			for _,g in r_ipairs(self.UnitDamagedBatchList) do
+				g:UnitDamagedBatch(count, unitIDs, unitDefIDs, unitTeams, damages, paralyzers, weaponDefIDs, projectileIDs, attackerIDs, attackerDefIDs, attackerTeams)
+			end
+		end
+
+		-- two gadgets summing up damage per team
+		for i = 1, 2 do
+			local teamDamage = {}
+
+			local gadget = {}
+
+			function gadget:UnitDamaged(unitID, unitDefID, unitTeam, damage)
+				teamDamage[unitTeam] = (teamDamage[unitTeam] or 0) + damage
+			end
+
+			function gadget:UnitDamagedBatch(count, unitIDs, unitDefIDs, unitTeams, damages)
+				for j = 1, count do
+					local unitTeam = unitTeams[j]
+					teamDamage[unitTeam] = (teamDamage[unitTeam] or 0) + damages[j]
+				end
+			end
+
+			gadgetHandler.UnitDamagedList[i] = gadget
+			gadgetHandler.UnitDamagedBatchList[i] = gadget
+		end
+
+		-- see gadgetHandler:UpdateCallIn
+		for _,name in ipairs({"UnitDamaged", "UnitDamagedBatch"}) do
+			local selffunc = gadgetHandler[name]
+
+			_G[name] = function(...)
+				return selffunc(gadgetHandler, ...)
+			end
+		end
+	)";
+
+	struct DamageEvent {
+		int unitID;
+		int unitDefID;
+		int unitTeam;
+		float damage;
+		bool paralyzer;
+		int weaponDefID;
+		int projectileID;
+		int attackerID;
+		int attackerDefID;
+		int attackerTeam;
+	};
+
+	void* Alloc(void*, void* ptr, size_t, size_t nsize) {
+		if (nsize == 0) {
+			std::free(ptr);
+			return nullptr;
+		}
+
+		return std::realloc(ptr, nsize);
+	}
+
+	struct LuaSetup {
+		LuaSetup(int numEvents) {
+			L = lua_newstate(Alloc, nullptr);
+			luaL_openlibs(L);
+
+			if (luaL_loadstring(L, HANDLE_SOURCE) != 0 || lua_pcall(L, 0, 0, 0) != 0)
+				std::abort();
+
+			for (int i = 0; i < numEvents; i++) {
+				events.push_back({i, i % 100, i % 8, 10.0f + i, false, i % 50, 1000 + i, i % 3 == 0 ? -1 : 5000 + i, i % 3 == 0 ? -1 : i % 100, i % 3 == 0 ? -1 : (i + 1) % 8});
+			}
+		}
+		~LuaSetup() { lua_close(L); }
+
+		lua_State* L;
+		std::vector<DamageEvent> events;
+	};
+
+	template<typename F>
+	void PushArray(lua_State* L, const std::vector<DamageEvent>& events, F&& get) {
+		lua_createtable(L, events.size(), 0);
+
+		for (size_t i = 0; i < events.size(); i++) {
+			lua_pushnumber(L, get(events[i]));
+			lua_rawseti(L, -2, i + 1);
+		}
+	}
+}
+
+
+static void BenchPerEventCallIns(benchmark::State& state) {
+	LuaSetup setup(state.range(0));
+	lua_State* L = setup.L;
+
+	for (auto _ : state) {
+		for (const DamageEvent& e: setup.events) {
+			lua_getglobal(L, "UnitDamaged");
+			lua_pushnumber(L, e.unitID);
+			lua_pushnumber(L, e.unitDefID);
+			lua_pushnumber(L, e.unitTeam);
+			lua_pushnumber(L, e.damage);
+			lua_pushboolean(L, e.paralyzer);
+			lua_pushnumber(L, e.weaponDefID);
+			lua_pushnumber(L, e.projectileID);
+
+			if (e.attackerID >= 0) {
+				lua_pushnumber(L, e.attackerID);
+				lua_pushnumber(L, e.attackerDefID);
+				lua_pushnumber(L, e.attackerTeam);
+			} else {
+				lua_pushnil(L);
+				lua_pushnil(L);
+				lua_pushnil(L);
+			}
+
+			if (lua_pcall(L, 10, 0, 0) != 0)
+				std::abort();
+		}
+	}
+
+	state.SetItemsProcessed(state.iterations() * setup.events.size());
+}
+
+static void BenchBatchedCallIn(benchmark::State& state) {
+	LuaSetup setup(state.range(0));
+	lua_State* L = setup.L;
+
+	for (auto _ : state) {
+		const std::vector<DamageEvent>& events = setup.events;
+
+		lua_getglobal(L, "UnitDamagedBatch");
+		lua_pushnumber(L, events.size());
+		PushArray(L, events, [](const DamageEvent& e) { return e.unitID; });
+		PushArray(L, events, [](const DamageEvent& e) { return e.unitDefID; });
+		PushArray(L, events, [](const DamageEvent& e) { return e.unitTeam; });
+		PushArray(L, events, [](const DamageEvent& e) { return e.damage; });
+
+		lua_createtable(L, events.size(), 0);
+
+		for (size_t i = 0; i < events.size(); i++) {
+			lua_pushboolean(L, events[i].paralyzer);
+			lua_rawseti(L, -2, i + 1);
+		}
+
+		PushArray(L, events, [](const DamageEvent& e) { return e.weaponDefID; });
+		PushArray(L, events, [](const DamageEvent& e) { return e.projectileID; });
+		PushArray(L, events, [](const DamageEvent& e) { return e.attackerID; });
+		PushArray(L, events, [](const DamageEvent& e) { return e.attackerDefID; });
+		PushArray(L, events, [](const DamageEvent& e) { return e.attackerTeam; });
+
+		if (lua_pcall(L, 11, 0, 0) != 0)
+			std::abort();
+	}
+
+	state.SetItemsProcessed(state.iterations() * setup.events.size());
+}
+
+BENCHMARK(BenchPerEventCallIns)->Arg(16)->Arg(256)->Arg(4096);
+BENCHMARK(BenchBatchedCallIn)->Arg(16)->Arg(256)->Arg(4096);
+
+BENCHMARK_MAIN();
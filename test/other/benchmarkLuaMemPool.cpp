@@ -0,0 +1,260 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "lua.h"
+#include "lualib.h"
+#include "lauxlib.h"
+
+#include "Lua/LuaMemPool.h"
+#include "System/Misc/SpringTime.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// replays a trace of Lua (re)allocations against malloc (what lua's default
+// l_alloc does) and against one LuaMemPool per Lua state, releasing each pool
+// in bulk at the end as a handle reload does
+//
+// the trace is read from the file given as first argument, as written by an
+// engine built with ENABLE_LUA_ALLOC_TRACE=1 (see spring_lua_alloc) during a
+// game; without one, a trace is recorded from a workload resembling that of
+// a few widgets running for a number of frames
+namespace {
+	const char* WORKLOAD_SOURCE = R"lua(
+		local units = {}
+		local labels = {}
+		local history = {}
+
+		function Update(frame)
+			-- per-frame unit state queries, returned as fresh tables
+			for i = 1, 200 do
+				units[i] = {id = i, x = i * 0.5, y = frame, z = -i, health = 100 - (frame % 100), orders = {frame, i}}
+			end
+
+			-- string formatting for labels and tooltips
+			for i = 1, 50 do
+				labels[i] = string.format("%s #%d (%.1f%%)", "Unit", i, units[i].health) .. ((frame % 2 == 0) and " [idle]" or "")
+			end
+
+			-- closures passed to sorting and iteration helpers
+			table.sort(units, function(a, b) return a.health < b.health or (a.health == b.health and a.id < b.id) end)
+
+			-- growing and trimming a rolling history
+			history[#history + 1] = {frame = frame, count = #units}
+			if (#history > 300) then
+				history = {unpack(history, 150)}
+			end
+		end
+	)lua";
+
+	struct TraceOp {
+		uint32_t state;
+		uint32_t slot;
+		uint32_t osize;
+		uint32_t nsize;
+	};
+
+	struct Trace {
+		std::vector<TraceOp> ops;
+
+		uint32_t numStates = 0;
+		uint32_t numSlots = 0;
+	};
+
+	// turns (state, ptr, osize, nsize, result) calls into ops on dense slot indices
+	class TraceBuilder {
+	public:
+		void Add(const void* ud, const void* ptr, size_t osize, size_t nsize, const void* mem) {
+			const auto state = states.emplace(ud, states.size()).first->second;
+
+			if (ptr == nullptr && nsize == 0)
+				return;
+
+			uint32_t slot = 0;
+
+			if (ptr != nullptr) {
+				const auto iter = live.find(ptr);
+
+				// allocated before the trace started
+				if (iter == live.end())
+					return;
+
+				slot = iter->second;
+				live.erase(iter);
+			} else {
+				slot = trace.numSlots++;
+			}
+
+			if (nsize != 0)
+				live.emplace(mem, slot);
+
+			trace.ops.push_back({uint32_t(state), slot, uint32_t(osize), uint32_t(nsize)});
+			trace.numStates = states.size();
+		}
+
+		Trace& Get() { return trace; }
+
+	private:
+		Trace trace;
+
+		std::unordered_map<const void*, size_t> states;
+		std::unordered_map<const void*, uint32_t> live;
+	};
+
+	void* RecordingAlloc(void* ud, void* ptr, size_t osize, size_t nsize) {
+		void* mem = nullptr;
+
+		if (nsize != 0)
+			mem = std::realloc(ptr, nsize);
+		else
+			std::free(ptr);
+
+		static_cast<TraceBuilder*>(ud)->Add(ud, ptr, osize, nsize, mem);
+		return mem;
+	}
+
+	Trace RecordTrace() {
+		TraceBuilder builder;
+
+		lua_State* L = lua_newstate(RecordingAlloc, &builder);
+		luaL_openlibs(L);
+
+		if (luaL_loadstring(L, WORKLOAD_SOURCE) != 0 || lua_pcall(L, 0, 0, 0) != 0)
+			std::abort();
+
+		for (int frame = 0; frame < 300; frame++) {
+			lua_getglobal(L, "Update");
+			lua_pushnumber(L, frame);
+
+			if (lua_pcall(L, 1, 0, 0) != 0)
+				std::abort();
+
+			// incremental collection as the engine runs it between frames
+			lua_gc(L, LUA_GCSTEP, 100);
+		}
+
+		lua_close(L);
+		return std::move(builder.Get());
+	}
+
+	bool ReadTrace(const char* fileName, Trace& trace) {
+		FILE* file = std::fopen(fileName, "r");
+
+		if (file == nullptr)
+			return false;
+
+		TraceBuilder builder;
+
+		void* ud;
+		void* ptr;
+		void* mem;
+		unsigned long long osize;
+		unsigned long long nsize;
+
+		while (std::fscanf(file, "%p %p %llu %llu %p", &ud, &ptr, &osize, &nsize, &mem) == 5) {
+			builder.Add(ud, ptr, osize, nsize, mem);
+		}
+
+		std::fclose(file);
+
+		trace = std::move(builder.Get());
+		return (!trace.ops.empty());
+	}
+
+	Trace gTrace;
+}
+
+
+static void BenchReplayMalloc(benchmark::State& state) {
+	std::vector<void*> slots(gTrace.numSlots, nullptr);
+
+	for (auto _ : state) {
+		for (const TraceOp& op: gTrace.ops) {
+			void*& ptr = slots[op.slot];
+
+			if (op.nsize == 0) {
+				std::free(ptr);
+				ptr = nullptr;
+			} else {
+				ptr = std::realloc(ptr, op.nsize);
+			}
+		}
+
+		for (void*& ptr: slots) {
+			std::free(ptr);
+			ptr = nullptr;
+		}
+	}
+
+	state.SetItemsProcessed(state.iterations() * gTrace.ops.size());
+}
+
+static void BenchReplayLuaMemPool(benchmark::State& state) {
+	std::vector<void*> slots(gTrace.numSlots, nullptr);
+	std::vector<std::unique_ptr<LuaMemPool>> pools;
+
+	LuaMemPool::InitStatic(true);
+
+	for (uint32_t i = 0; i < gTrace.numStates; i++) {
+		pools.emplace_back(std::make_unique<LuaMemPool>(size_t(i)));
+	}
+
+	for (auto _ : state) {
+		for (const TraceOp& op: gTrace.ops) {
+			void*& ptr = slots[op.slot];
+
+			if (op.nsize == 0) {
+				pools[op.state]->Free(ptr, op.osize);
+				ptr = nullptr;
+			} else {
+				ptr = pools[op.state]->Realloc(ptr, op.nsize, op.osize);
+			}
+		}
+
+		// blocks still live at the end of the trace belong to open states
+		for (void*& ptr: slots) {
+			ptr = nullptr;
+		}
+		for (const auto& pool: pools) {
+			pool->Clear();
+		}
+	}
+
+	pools.clear();
+	LuaMemPool::KillStatic();
+
+	state.SetItemsProcessed(state.iterations() * gTrace.ops.size());
+}
+
+BENCHMARK(BenchReplayMalloc);
+BENCHMARK(BenchReplayLuaMemPool);
+
+
+int main(int argc, char** argv) {
+	benchmark::Initialize(&argc, argv);
+
+	spring_clock::PushTickRate();
+	spring_time::setstarttime(spring_time::gettime(true));
+
+	if (argc > 1) {
+		if (!ReadTrace(argv[1], gTrace)) {
+			std::fprintf(stderr, "could not read trace \"%s\"\n", argv[1]);
+			return EXIT_FAILURE;
+		}
+	} else {
+		gTrace = RecordTrace();
+	}
+
+	std::printf("replaying %zu (re)allocations in %u states\n", gTrace.ops.size(), gTrace.numStates);
+
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+	return EXIT_SUCCESS;
+}
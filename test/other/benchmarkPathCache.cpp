@@ -0,0 +1,302 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "Sim/Path/HAPFS/PathCache.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// replays the request stream of a HAPFS::CPathCache, either one recorded from
+// the engine (build it with RECORD_CACHE_REQUESTS and point PATHCACHE_TRACE at
+// the infolog) or a synthetic one
+namespace {
+	struct Request {
+		char type; // 'U'pdate, 'G'et or 'A'dd
+		bool addOnMiss;
+		int frame;
+		int2 strtBlock;
+		int2 goalBlock;
+		float goalRadius;
+		int pathType;
+		IPath::SearchResult result;
+		size_t pathIdx;
+	};
+
+	struct RequestStream {
+		int2 numBlocks;
+		std::vector<Request> requests;
+		std::vector<IPath::Path> paths;
+		std::map<std::pair<unsigned, unsigned>, size_t> pathIndices;
+
+		size_t GetPathIndex(unsigned numPoints, unsigned numSquares) {
+			const auto key = std::make_pair(numPoints, numSquares);
+			const auto iter = pathIndices.find(key);
+
+			if (iter != pathIndices.end())
+				return iter->second;
+
+			paths.emplace_back();
+			paths.back().path.resize(numPoints, float3(1.0f, 2.0f, 3.0f));
+			paths.back().squares.resize(numSquares, int2(4, 5));
+
+			return (pathIndices[key] = paths.size() - 1);
+		}
+	};
+
+	// only the requests of the first cache created in the log are kept
+	bool ReadRecordedStream(const char* fileName, RequestStream& stream) {
+		std::ifstream file(fileName);
+		std::string line;
+		std::string cacheID;
+
+		while (std::getline(file, line)) {
+			const size_t tagPos = line.find("[CPathCache][");
+
+			if (tagPos == std::string::npos)
+				continue;
+
+			const size_t idPos = tagPos + std::strlen("[CPathCache][");
+			const size_t idEnd = line.find(']', idPos);
+
+			if (idEnd == std::string::npos || (idEnd + 2) >= line.size())
+				continue;
+
+			const std::string id = line.substr(idPos, idEnd - idPos);
+			const char* args = line.c_str() + idEnd + 2;
+
+			if (cacheID.empty()) {
+				if (std::sscanf(args, "C %d %d", &stream.numBlocks.x, &stream.numBlocks.y) == 2)
+					cacheID = id;
+
+				continue;
+			}
+
+			if (id != cacheID)
+				continue;
+
+			Request r = {args[0], false, 0, {}, {}, 0.0f, 0, IPath::Error, 0};
+
+			switch (r.type) {
+				case 'U': {
+					std::sscanf(args, "U %d", &r.frame);
+				} break;
+				case 'G': {
+					std::sscanf(args, "G %d %d %d %d %d %f %d", &r.frame, &r.strtBlock.x, &r.strtBlock.y, &r.goalBlock.x, &r.goalBlock.y, &r.goalRadius, &r.pathType);
+				} break;
+				case 'A': {
+					int result = 0;
+					unsigned numPoints = 0;
+					unsigned numSquares = 0;
+
+					std::sscanf(args, "A %d %d %d %d %d %f %d %d %u %u", &r.frame, &r.strtBlock.x, &r.strtBlock.y, &r.goalBlock.x, &r.goalBlock.y, &r.goalRadius, &r.pathType, &result, &numPoints, &numSquares);
+
+					r.result = IPath::SearchResult(result);
+					r.pathIdx = stream.GetPathIndex(numPoints, numSquares);
+				} break;
+				default: {
+					continue;
+				} break;
+			}
+
+			stream.requests.push_back(r);
+		}
+
+		return (!stream.requests.empty());
+	}
+
+	// groups of units commute between a few hotspots and look up their paths
+	// every few frames, a miss is followed by adding the freshly searched path
+	RequestStream GenerateStream(int numFrames) {
+		constexpr int NUM_BLOCKS = 64;
+		constexpr int NUM_UNITS = 400;
+		constexpr int NUM_HOTSPOTS = 6;
+		constexpr int NUM_REQUESTS_PER_FRAME = 24;
+
+		std::mt19937 rng(numFrames);
+		std::uniform_int_distribution<int> blockDist(0, NUM_BLOCKS - 1);
+		std::uniform_int_distribution<int> spotDist(0, NUM_HOTSPOTS - 1);
+		std::uniform_int_distribution<int> unitDist(0, NUM_UNITS - 1);
+		std::uniform_int_distribution<int> jitterDist(-2, 2);
+		std::uniform_int_distribution<int> typeDist(0, 3);
+
+		RequestStream stream;
+		stream.numBlocks = {NUM_BLOCKS, NUM_BLOCKS};
+
+		std::vector<int2> hotspots(NUM_HOTSPOTS);
+		std::vector<std::pair<int2, int>> units(NUM_UNITS);
+
+		for (int2& spot: hotspots) {
+			spot = {blockDist(rng), blockDist(rng)};
+		}
+		for (auto& unit: units) {
+			unit = {hotspots[spotDist(rng)], typeDist(rng)};
+		}
+
+		const auto Clamp = [](int v) { return std::clamp(v, 0, NUM_BLOCKS - 1); };
+
+		for (int frame = 0; frame < numFrames; frame++) {
+			stream.requests.push_back({'U', false, frame, {}, {}, 0.0f, 0, IPath::Error, 0});
+
+			for (int i = 0; i < NUM_REQUESTS_PER_FRAME; i++) {
+				auto& unit = units[unitDist(rng)];
+
+				const int2 strtBlock = {Clamp(unit.first.x + jitterDist(rng)), Clamp(unit.first.y + jitterDist(rng))};
+				const int2 goalBlock = hotspots[spotDist(rng)];
+				const int length = std::abs(goalBlock.x - strtBlock.x) + std::abs(goalBlock.y - strtBlock.y) + 1;
+
+				Request r = {'G', true, frame, strtBlock, goalBlock, 8.0f * (i & 1), unit.second, IPath::Ok, 0};
+
+				// a few searches fail and get cached for a shorter time
+				if ((length % 17) == 0)
+					r.result = IPath::Error;
+
+				r.pathIdx = stream.GetPathIndex(length, length);
+				stream.requests.push_back(r);
+
+				unit.first = goalBlock;
+			}
+		}
+
+		return stream;
+	}
+
+	const RequestStream& GetRequestStream() {
+		static RequestStream stream;
+
+		if (!stream.requests.empty())
+			return stream;
+
+		const char* fileName = std::getenv("PATHCACHE_TRACE");
+
+		if (fileName == nullptr || !ReadRecordedStream(fileName, stream))
+			stream = GenerateStream(30 * 60 * 5);
+
+		return stream;
+	}
+
+
+	// the container layout CPathCache used before, as a baseline
+	class CLegacyPathCache {
+	public:
+		CLegacyPathCache(int blocksX, int blocksZ): numBlocksX(blocksX), numBlocks(blocksX * blocksZ) {
+			cachedPaths.reserve(4096);
+		}
+
+		void Update(int frameNum) {
+			while (!cacheQue.empty() && cacheQue.front().first < frameNum) {
+				cachedPaths.erase(cacheQue.front().second);
+				cacheQue.pop_front();
+			}
+		}
+
+		bool AddPath(const IPath::Path* path, IPath::SearchResult result, int2 strtBlock, int2 goalBlock, float goalRadius, int pathType, int frameNum) {
+			if (cacheQue.size() > 200) {
+				cachedPaths.erase(cacheQue.front().second);
+				cacheQue.pop_front();
+			}
+
+			const std::uint64_t hash = GetHash(strtBlock, goalBlock, goalRadius, pathType);
+
+			if (cachedPaths.find(hash) != cachedPaths.end())
+				return false;
+
+			cachedPaths[hash] = HAPFS::CPathCache::CacheItem{result, *path, strtBlock, goalBlock, goalRadius, pathType};
+			cacheQue.emplace_back(frameNum + ((result == IPath::Ok)? 180: 90), hash);
+			return false;
+		}
+
+		bool GetCachedPath(int2 strtBlock, int2 goalBlock, float goalRadius, int pathType, HAPFS::CPathCache::CacheItem& ci) {
+			const auto iter = cachedPaths.find(GetHash(strtBlock, goalBlock, goalRadius, pathType));
+
+			if (iter == cachedPaths.end() || iter->second.strtBlock != strtBlock || iter->second.goalBlock != goalBlock || iter->second.pathType != pathType)
+				return false;
+
+			ci = iter->second;
+			return true;
+		}
+
+	private:
+		std::uint64_t GetHash(int2 strtBlk, int2 goalBlk, std::uint32_t goalRadius, std::int32_t pathType) const {
+			const std::uint64_t index = (strtBlk.y * numBlocksX + strtBlk.x) + (goalBlk.y * numBlocksX + goalBlk.x) * numBlocks;
+			const std::uint64_t offset = pathType * numBlocks * numBlocks + std::max<std::uint32_t>(1, goalRadius) * numBlocks * numBlocks * numBlocks;
+			return (index + offset);
+		}
+
+		std::deque<std::pair<int, std::uint64_t>> cacheQue;
+		std::unordered_map<std::uint64_t, HAPFS::CPathCache::CacheItem> cachedPaths;
+
+		std::uint64_t numBlocksX;
+		std::uint64_t numBlocks;
+	};
+
+
+	template<typename CacheType>
+	size_t ReplayStream(const RequestStream& stream, CacheType& cache, HAPFS::CPathCache::CacheItem& ci) {
+		size_t numHits = 0;
+
+		for (const Request& r: stream.requests) {
+			switch (r.type) {
+				case 'U': {
+					cache.Update(r.frame);
+				} break;
+				case 'G': {
+					if (cache.GetCachedPath(r.strtBlock, r.goalBlock, r.goalRadius, r.pathType, ci)) {
+						numHits += 1;
+						break;
+					}
+					if (r.addOnMiss)
+						cache.AddPath(&stream.paths[r.pathIdx], r.result, r.strtBlock, r.goalBlock, r.goalRadius, r.pathType, r.frame);
+				} break;
+				case 'A': {
+					cache.AddPath(&stream.paths[r.pathIdx], r.result, r.strtBlock, r.goalBlock, r.goalRadius, r.pathType, r.frame);
+				} break;
+			}
+		}
+
+		return numHits;
+	}
+
+	template<typename CacheType>
+	void BenchReplay(benchmark::State& state) {
+		const RequestStream& stream = GetRequestStream();
+		HAPFS::CPathCache::CacheItem ci;
+
+		size_t numHits = 0;
+
+		for (auto _ : state) {
+			state.PauseTiming();
+			CacheType* cache = new CacheType(stream.numBlocks.x, stream.numBlocks.y);
+			state.ResumeTiming();
+
+			numHits = ReplayStream(stream, *cache, ci);
+			benchmark::DoNotOptimize(ci);
+
+			state.PauseTiming();
+			delete cache;
+			state.ResumeTiming();
+		}
+
+		state.SetItemsProcessed(state.iterations() * stream.requests.size());
+		state.counters["hits"] = numHits;
+	}
+}
+
+
+static void BM_ReplayLegacyPathCache(benchmark::State& state) { BenchReplay<CLegacyPathCache>(state); }
+static void BM_ReplayPathCache(benchmark::State& state) { BenchReplay<HAPFS::CPathCache>(state); }
+
+BENCHMARK(BM_ReplayLegacyPathCache);
+BENCHMARK(BM_ReplayPathCache);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,248 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+// N projectiles vs M units, mirroring the detection done by
+// CProjectileHandler::CheckUnitFeatureCollisions{,MT}: a quadfield-like
+// broad-phase, then the batched narrow-phase. The windowed variant adds
+// the MT pass' re-detection after every hit (which would have side-effects
+// in the engine), so its gain over the serial pass shrinks as hits get denser.
+
+#include "Sim/Misc/CollisionHandler.h"
+#include "Sim/Misc/CollisionVolume.h"
+#include "System/Matrix44f.h"
+#include "System/SpringMath.h"
+#include "System/float3.h"
+#include "System/Threading/ThreadPool.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <array>
+#include <random>
+#include <vector>
+
+namespace {
+	constexpr float MAP_SIZE = 8192.0f;
+	constexpr float QUAD_SIZE = 128.0f;
+	constexpr int NUM_QUADS = int(MAP_SIZE / QUAD_SIZE);
+
+	struct Unit {
+		CollisionVolume volume;
+		CMatrix44f transform;
+		float3 pos;
+	};
+
+	struct Projectile {
+		float3 pos;
+		float3 speed;
+		float radius;
+	};
+
+	struct Scene {
+		std::vector<Unit> units;
+		std::vector<Projectile> projectiles;
+		std::vector<std::vector<int>> quads;
+	};
+
+	// per-thread scratch, like the QueryVectorCache slots and mtTempNum
+	struct ThreadState {
+		std::vector<int> candidates;
+		std::vector<int> tempNums;
+		int tempNum = 0;
+
+		CollisionVolumeBatch batch;
+	};
+
+	std::array<ThreadState, ThreadPool::MAX_THREADS> threadStates;
+
+
+	Scene GenerateScene(int numProjectiles, int numUnits) {
+		std::mt19937 rng(numProjectiles ^ (numUnits << 16));
+		std::uniform_real_distribution<float> posDist(0.0f, MAP_SIZE);
+		std::uniform_real_distribution<float> sizeDist(16.0f, 64.0f);
+		std::uniform_real_distribution<float> dirDist(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> speedDist(5.0f, 30.0f);
+
+		Scene scene;
+		scene.units.reserve(numUnits);
+		scene.quads.resize(NUM_QUADS * NUM_QUADS);
+
+		for (int i = 0; i < numUnits; i++) {
+			const float3 pos = {posDist(rng), 0.0f, posDist(rng)};
+			const float3 scales = {sizeDist(rng), sizeDist(rng) * 0.5f, sizeDist(rng)};
+
+			CMatrix44f m;
+			m.Translate(pos);
+			m.RotateY(dirDist(rng) * math::PI);
+
+			scene.units.push_back({{(i & 1)? 'B': 'E', 'Z', scales, ZeroVector}, m, pos});
+
+			const float r = scene.units.back().volume.GetBoundingRadius();
+			const int x0 = std::clamp(int((pos.x - r) / QUAD_SIZE), 0, NUM_QUADS - 1);
+			const int x1 = std::clamp(int((pos.x + r) / QUAD_SIZE), 0, NUM_QUADS - 1);
+			const int z0 = std::clamp(int((pos.z - r) / QUAD_SIZE), 0, NUM_QUADS - 1);
+			const int z1 = std::clamp(int((pos.z + r) / QUAD_SIZE), 0, NUM_QUADS - 1);
+
+			for (int z = z0; z <= z1; z++) {
+				for (int x = x0; x <= x1; x++) {
+					scene.quads[z * NUM_QUADS + x].push_back(i);
+				}
+			}
+		}
+
+		for (int i = 0; i < numProjectiles; i++) {
+			const float3 pos = {posDist(rng), sizeDist(rng) * 0.5f, posDist(rng)};
+			const float3 dir = float3(dirDist(rng), dirDist(rng) * 0.2f, dirDist(rng)).SafeNormalize();
+
+			scene.projectiles.push_back({pos, dir * speedDist(rng), 2.0f});
+		}
+
+		for (ThreadState& ts: threadStates) {
+			ts.tempNums.assign(numUnits, 0);
+		}
+
+		return scene;
+	}
+
+	// returns the index of the unit hit first, -1 if none
+	int DetectHit(const Scene& scene, const Projectile& p, ThreadState& ts) {
+		const float3 ppos0 = p.pos;
+		const float3 ppos1 = p.pos + p.speed;
+		const float radius = p.speed.Length() + p.radius;
+
+		const int x0 = std::clamp(int((ppos0.x - radius) / QUAD_SIZE), 0, NUM_QUADS - 1);
+		const int x1 = std::clamp(int((ppos0.x + radius) / QUAD_SIZE), 0, NUM_QUADS - 1);
+		const int z0 = std::clamp(int((ppos0.z - radius) / QUAD_SIZE), 0, NUM_QUADS - 1);
+		const int z1 = std::clamp(int((ppos0.z + radius) / QUAD_SIZE), 0, NUM_QUADS - 1);
+
+		ts.candidates.clear();
+		ts.tempNum += 1;
+
+		for (int z = z0; z <= z1; z++) {
+			for (int x = x0; x <= x1; x++) {
+				for (const int ui: scene.quads[z * NUM_QUADS + x]) {
+					if (ts.tempNums[ui] == ts.tempNum)
+						continue;
+
+					ts.tempNums[ui] = ts.tempNum;
+
+					const float totRad = radius + scene.units[ui].volume.GetBoundingRadius();
+
+					if (ppos0.SqDistance(scene.units[ui].pos) >= (totRad * totRad))
+						continue;
+
+					ts.candidates.push_back(ui);
+				}
+			}
+		}
+
+		if (ts.candidates.empty())
+			return -1;
+
+		ts.batch.Clear();
+
+		for (const int ui: ts.candidates) {
+			ts.batch.Add(&scene.units[ui].volume, scene.units[ui].transform, ui);
+		}
+
+		CollisionQuery cq;
+		return CCollisionHandler::IntersectBatch(ts.batch, ppos0, ppos1, &cq);
+	}
+}
+
+
+static void BM_DetectSerial(benchmark::State& state) {
+	const Scene scene = GenerateScene(state.range(0), state.range(1));
+	int numHits = 0;
+
+	for (auto _: state) {
+		numHits = 0;
+
+		for (const Projectile& p: scene.projectiles) {
+			numHits += (DetectHit(scene, p, threadStates[0]) >= 0);
+		}
+
+		benchmark::DoNotOptimize(numHits);
+	}
+
+	state.counters["hits"] = numHits;
+	state.SetItemsProcessed(state.iterations() * scene.projectiles.size());
+}
+
+// upper bound, as if no hit had side-effects
+static void BM_DetectParallel(benchmark::State& state) {
+	const Scene scene = GenerateScene(state.range(0), state.range(1));
+	std::vector<int> hits(scene.projectiles.size());
+
+	for (auto _: state) {
+		for_mt_chunk(0, scene.projectiles.size(), [&](const int i) {
+			hits[i] = DetectHit(scene, scene.projectiles[i], threadStates[ThreadPool::GetThreadNum()]);
+		});
+
+		benchmark::DoNotOptimize(hits.data());
+	}
+
+	state.SetItemsProcessed(state.iterations() * scene.projectiles.size());
+}
+
+// detects in windows and restarts the window after every hit, see
+// CProjectileHandler::CheckUnitFeatureCollisionsMT
+static void BM_DetectWindowed(benchmark::State& state) {
+	constexpr size_t MIN_WINDOW_SIZE = 64;
+	constexpr size_t MAX_WINDOW_SIZE = 8192;
+
+	const Scene scene = GenerateScene(state.range(0), state.range(1));
+	const size_t numTests = scene.projectiles.size();
+
+	std::vector<int> hits(numTests);
+	size_t windowSize = MIN_WINDOW_SIZE;
+	size_t numWindows = 0;
+
+	for (auto _: state) {
+		numWindows = 0;
+
+		for (size_t idxBeg = 0; idxBeg < numTests; ) {
+			const size_t idxWin = idxBeg;
+			const size_t idxEnd = std::min(numTests, idxBeg + windowSize);
+
+			for_mt_chunk(idxBeg, idxEnd, [&](const int i) {
+				hits[i] = DetectHit(scene, scene.projectiles[i], threadStates[ThreadPool::GetThreadNum()]);
+			});
+
+			bool hit = false;
+
+			while (idxBeg < idxEnd && !hit) {
+				hit = (hits[idxBeg++] >= 0);
+			}
+
+			windowSize = std::clamp((idxBeg - idxWin) * 2, MIN_WINDOW_SIZE, MAX_WINDOW_SIZE);
+			numWindows += 1;
+		}
+
+		benchmark::DoNotOptimize(hits.data());
+	}
+
+	state.counters["windows"] = numWindows;
+	state.SetItemsProcessed(state.iterations() * numTests);
+}
+
+
+// {projectiles, units}; sparse, artillery duel, large battle
+#define PROJECTILE_COLLISION_ARGS \
+	->Args({ 1000,  500}) \
+	->Args({ 5000, 2000}) \
+	->Args({20000, 5000})
+
+BENCHMARK(BM_DetectSerial)   PROJECTILE_COLLISION_ARGS;
+BENCHMARK(BM_DetectParallel) PROJECTILE_COLLISION_ARGS;
+BENCHMARK(BM_DetectWindowed) PROJECTILE_COLLISION_ARGS;
+
+int main(int argc, char** argv) {
+	ThreadPool::SetThreadCount(ThreadPool::GetMaxThreads());
+
+	benchmark::Initialize(&argc, argv);
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+
+	ThreadPool::SetThreadCount(0);
+	return 0;
+}
@@ -0,0 +1,200 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+// radius queries over quadfield cells, filtering on the objects themselves
+// (the default Get*Exact path) vs on the packed spheres stored per cell
+// (quadFieldPackedPositions), plus the per-frame cost of keeping the
+// packed spheres current as every object moves
+
+#include "Sim/Misc/QuadField.h"
+#include "System/float3.h"
+#include "System/float4.h"
+#include "System/SpringMath.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+	constexpr int CELLS_X = 64;
+	constexpr int CELL_SIZE = CQuadField::BASE_QUAD_SIZE;
+	constexpr float MAP_SIZE = CELLS_X * CELL_SIZE;
+	constexpr int NUM_QUERIES = 1000;
+
+	// stand-in for the CWorldObject fields the exact queries look at, padded
+	// s.t. objects are about as sparse in memory as real units and features
+	struct Object {
+		float3 pos;
+		float radius = 0.0f;
+		int tempNum = 0;
+		char pad[1024];
+	};
+
+	struct Cell {
+		std::vector<Object*> objects;
+		std::vector<float4> spheres;
+	};
+
+	struct Query {
+		float3 pos;
+		float radius;
+	};
+
+	struct Scene {
+		std::vector<std::unique_ptr<Object>> objects;
+		std::vector<std::vector<int>> objectCells;
+		std::vector<Cell> cells;
+		std::vector<Query> queries;
+		int tempNum = 0;
+	};
+
+
+	int CellIdx(float c) { return std::clamp(int(c / CELL_SIZE), 0, CELLS_X - 1); }
+
+	Scene GenerateScene(int numObjects) {
+		std::mt19937 rng(numObjects);
+		std::uniform_real_distribution<float> posDist(0.0f, MAP_SIZE);
+		std::uniform_real_distribution<float> radDist(8.0f, 48.0f);
+
+		Scene scene;
+		scene.objects.resize(numObjects);
+		scene.objectCells.resize(numObjects);
+		scene.cells.resize(CELLS_X * CELLS_X);
+
+		for (int i = 0; i < numObjects; ++i) {
+			Object* o = (scene.objects[i] = std::make_unique<Object>()).get();
+			o->pos = {posDist(rng), 0.0f, posDist(rng)};
+			o->radius = radDist(rng);
+
+			for (int z = CellIdx(o->pos.z - o->radius); z <= CellIdx(o->pos.z + o->radius); ++z) {
+				for (int x = CellIdx(o->pos.x - o->radius); x <= CellIdx(o->pos.x + o->radius); ++x) {
+					Cell& cell = scene.cells[z * CELLS_X + x];
+					CQuadField::Quad::InsertObject(cell.objects, cell.spheres, o, {o->pos, o->radius});
+					scene.objectCells[i].push_back(z * CELLS_X + x);
+				}
+			}
+		}
+
+		// weapon-range sized queries
+		for (int i = 0; i < NUM_QUERIES; ++i) {
+			scene.queries.push_back({{posDist(rng), 0.0f, posDist(rng)}, radDist(rng) * 10.0f});
+		}
+
+		return scene;
+	}
+
+	template<typename CellFunc>
+	void VisitCells(const Query& q, CellFunc&& cellFunc) {
+		for (int z = CellIdx(q.pos.z - q.radius); z <= CellIdx(q.pos.z + q.radius); ++z) {
+			for (int x = CellIdx(q.pos.x - q.radius); x <= CellIdx(q.pos.x + q.radius); ++x) {
+				cellFunc(z * CELLS_X + x);
+			}
+		}
+	}
+}
+
+
+static void BM_QueryPlain(benchmark::State& state) {
+	Scene scene = GenerateScene(state.range(0));
+	std::vector<Object*> result;
+	size_t numFound = 0;
+
+	for (auto _: state) {
+		numFound = 0;
+
+		for (const Query& q: scene.queries) {
+			result.clear();
+			scene.tempNum += 1;
+
+			VisitCells(q, [&](int ci) {
+				for (Object* o: scene.cells[ci].objects) {
+					if (o->tempNum == scene.tempNum)
+						continue;
+
+					o->tempNum = scene.tempNum;
+
+					if (q.pos.SqDistance(o->pos) >= Square(q.radius + o->radius))
+						continue;
+
+					result.push_back(o);
+				}
+			});
+
+			numFound += result.size();
+		}
+
+		benchmark::DoNotOptimize(numFound);
+	}
+
+	state.counters["found"] = numFound;
+	state.SetItemsProcessed(state.iterations() * scene.queries.size());
+}
+
+static void BM_QueryPacked(benchmark::State& state) {
+	Scene scene = GenerateScene(state.range(0));
+	std::vector<Object*> result;
+	size_t numFound = 0;
+
+	for (auto _: state) {
+		numFound = 0;
+
+		for (const Query& q: scene.queries) {
+			result.clear();
+			scene.tempNum += 1;
+
+			VisitCells(q, [&](int ci) {
+				CQuadField::Quad::GetPackedObjects(scene.cells[ci].objects, scene.cells[ci].spheres, result, [&](const float4& s) {
+					return (q.pos.SqDistance(s) < Square(q.radius + s.w));
+				}, [&](Object* o) {
+					if (o->tempNum == scene.tempNum)
+						return false;
+
+					o->tempNum = scene.tempNum;
+					return true;
+				});
+			});
+
+			numFound += result.size();
+		}
+
+		benchmark::DoNotOptimize(numFound);
+	}
+
+	state.counters["found"] = numFound;
+	state.SetItemsProcessed(state.iterations() * scene.queries.size());
+}
+
+// what CQuadField::UpdateUnitSphere and MovedProjectile add per frame
+// when every object moves without leaving its cells
+static void BM_RefreshPacked(benchmark::State& state) {
+	Scene scene = GenerateScene(state.range(0));
+
+	for (auto _: state) {
+		for (size_t i = 0; i < scene.objects.size(); ++i) {
+			Object* o = scene.objects[i].get();
+
+			for (const int ci: scene.objectCells[i]) {
+				CQuadField::Quad::UpdateObject(scene.cells[ci].objects, scene.cells[ci].spheres, o, {o->pos, o->radius});
+			}
+		}
+
+		benchmark::ClobberMemory();
+	}
+
+	state.SetItemsProcessed(state.iterations() * scene.objects.size());
+}
+
+
+// {objects}; 64x64 quads, i.e. a 16x16 map
+#define QUADFIELD_ARGS \
+	->Arg( 1000) \
+	->Arg( 5000) \
+	->Arg(20000)
+
+BENCHMARK(BM_QueryPlain)    QUADFIELD_ARGS;
+BENCHMARK(BM_QueryPacked)   QUADFIELD_ARGS;
+BENCHMARK(BM_RefreshPacked) QUADFIELD_ARGS;
+
+BENCHMARK_MAIN();
@@ -0,0 +1,154 @@
+/* This file is part of the Spring engine (GPL v2 or later), see LICENSE.html */
+
+#include "System/Net/UDPBatch.h"
+
+#include <benchmark/benchmark.h>
+
+#include <asio/io_service.hpp>
+#include <asio/ip/udp.hpp>
+
+#include <memory>
+#include <vector>
+
+// a server socket exchanging one datagram per tick with each of N clients over
+// loopback, as the autohost does with players and spectators; only the server
+// side (receiving all client packets, then sending one to every client) is timed
+namespace {
+	constexpr unsigned CLIENT_PACKET_SIZE = 64;
+	constexpr unsigned SERVER_PACKET_SIZE = 256;
+
+	struct LoopbackSetup {
+		LoopbackSetup(unsigned numClients): server(service) {
+			const asio::ip::udp::endpoint loopback(asio::ip::address_v4::loopback(), 0);
+
+			server.open(asio::ip::udp::v4());
+			server.bind(loopback);
+			server.non_blocking(true);
+			server.set_option(asio::socket_base::receive_buffer_size(4 * 1024 * 1024));
+
+			for (unsigned i = 0; i < numClients; i++) {
+				clients.emplace_back(new asio::ip::udp::socket(service));
+				clients.back()->open(asio::ip::udp::v4());
+				clients.back()->bind(loopback);
+				clients.back()->non_blocking(true);
+
+				clientAddrs.push_back(clients.back()->local_endpoint());
+			}
+		}
+
+		void SendClientPackets() {
+			for (auto& client: clients) {
+				client->send_to(asio::buffer(clientPacket), server.local_endpoint());
+			}
+		}
+
+		void DrainClients() {
+			asio::error_code err;
+
+			for (auto& client: clients) {
+				while (client->available(err) > 0) {
+					asio::ip::udp::endpoint sender;
+					client->receive_from(asio::buffer(drainBuffer), sender, 0, err);
+				}
+			}
+		}
+
+		asio::io_service service;
+		asio::ip::udp::socket server;
+
+		std::vector<std::unique_ptr<asio::ip::udp::socket>> clients;
+		std::vector<asio::ip::udp::endpoint> clientAddrs;
+
+		std::vector<std::uint8_t> clientPacket = std::vector<std::uint8_t>(CLIENT_PACKET_SIZE, 1);
+		std::vector<std::uint8_t> serverPacket = std::vector<std::uint8_t>(SERVER_PACKET_SIZE, 2);
+		std::vector<std::uint8_t> drainBuffer = std::vector<std::uint8_t>(65536);
+	};
+
+	void SetCounters(benchmark::State& state, unsigned numClients) {
+		state.SetItemsProcessed(state.iterations() * numClients * 2);
+		state.counters["cpu/client"] = benchmark::Counter(state.iterations() * numClients, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+	}
+}
+
+
+// one available + receive_from and one send_to call per datagram, as before
+static void BM_ServerTickPerPacket(benchmark::State& state) {
+	const unsigned numClients = state.range(0);
+
+	LoopbackSetup setup(numClients);
+	std::vector<std::uint8_t> recvBuffer;
+
+	for (auto _ : state) {
+		state.PauseTiming();
+		setup.SendClientPackets();
+		state.ResumeTiming();
+
+		asio::error_code err;
+
+		for (unsigned numReceived = 0; numReceived < numClients; ) {
+			size_t bytesAvailable = 0;
+
+			while ((bytesAvailable = setup.server.available(err)) > 0) {
+				recvBuffer.clear();
+				recvBuffer.resize(bytesAvailable, 0);
+
+				asio::ip::udp::endpoint sender;
+				setup.server.receive_from(asio::buffer(recvBuffer), sender, 0, err);
+
+				numReceived += 1;
+			}
+		}
+
+		for (const asio::ip::udp::endpoint& addr: setup.clientAddrs) {
+			setup.server.send_to(asio::buffer(setup.serverPacket), addr, 0, err);
+		}
+
+		state.PauseTiming();
+		setup.DrainClients();
+		state.ResumeTiming();
+	}
+
+	SetCounters(state, numClients);
+}
+
+static void BM_ServerTickBatched(benchmark::State& state) {
+	const unsigned numClients = state.range(0);
+
+	LoopbackSetup setup(numClients);
+	netcode::UDPRecvBatch recvBatch;
+	netcode::UDPSendBatch sendBatch;
+
+	const std::vector<netcode::UDPSegment> serverSegments = {{setup.serverPacket.data(), SERVER_PACKET_SIZE, nullptr}};
+
+	for (auto _ : state) {
+		state.PauseTiming();
+		setup.SendClientPackets();
+		state.ResumeTiming();
+
+		asio::error_code err;
+
+		for (unsigned numReceived = 0; numReceived < numClients; ) {
+			numReceived += recvBatch.Receive(setup.server, err);
+		}
+
+		sendBatch.SetDeferring(true);
+
+		for (const asio::ip::udp::endpoint& addr: setup.clientAddrs) {
+			sendBatch.Add(setup.server, serverSegments, addr, err);
+		}
+
+		sendBatch.SetDeferring(false);
+		sendBatch.Send(setup.server, err);
+
+		state.PauseTiming();
+		setup.DrainClients();
+		state.ResumeTiming();
+	}
+
+	SetCounters(state, numClients);
+}
+
+BENCHMARK(BM_ServerTickPerPacket)->Arg(16)->Arg(116);
+BENCHMARK(BM_ServerTickBatched)->Arg(16)->Arg(116);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,59 @@
+#!/bin/sh
+
+# replays a recorded demo once per value of a boolean config switch and checks
+# that every frame's sync checksum matches the one recorded in the demo (which
+# CGame compares for us, logging a [DESYNC WARNING] per mismatching frame)
+#
+# example: test/validation/run-demo-sync.sh /path/to/spring-headless demo.sdfz UpdateUnitsMT
+
+set -e # abort on error
+
+if [ $# -lt 3 ]; then
+	echo "Usage: $0 /path/to/spring-headless /path/to/demo.sdfz ConfigVar [timeout-seconds]"
+	exit 1
+fi
+
+HEADLESS="$1"
+DEMO="$2"
+CONFIGVAR="$3"
+MAXTIME="${4:-900}"
+
+if [ ! -x "$HEADLESS" ]; then
+	echo "Parameter 1 $HEADLESS isn't executable!"
+	exit 1
+fi
+
+if [ ! -s "$DEMO" ]; then
+	echo "Parameter 2 $DEMO doesn't exist!"
+	exit 1
+fi
+
+WORKDIR=$(mktemp -d)
+trap 'rm -rf "$WORKDIR"' EXIT
+
+EXIT=0
+
+for VALUE in 0 1;
+do
+	CONFIG="$WORKDIR/springsettings-$VALUE.cfg"
+	LOG="$WORKDIR/infolog-$VALUE.txt"
+
+	echo "$CONFIGVAR = $VALUE" > "$CONFIG"
+
+	echo "Replaying $DEMO with $CONFIGVAR=$VALUE"
+	set +e
+	timeout "$MAXTIME" "$HEADLESS" --nocolor --config "$CONFIG" "$DEMO" > "$LOG" 2>&1
+	set -e
+
+	NUMFRAMES=$(grep -c "DESYNC WARNING" "$LOG" || true)
+
+	if [ "$NUMFRAMES" -ne 0 ]; then
+		echo "$CONFIGVAR=$VALUE: $NUMFRAMES frame(s) with mismatching sync checksums"
+		grep "DESYNC WARNING" "$LOG" | head -n 20
+		EXIT=1
+	else
+		echo "$CONFIGVAR=$VALUE: all checksums match"
+	fi
+done
+
+exit $EXIT
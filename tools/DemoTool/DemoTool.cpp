@@ -32,9 +32,11 @@ no console output (you still could use this.exe > z.tzt though).
 	DEFINE_bool  (teamstats,    false, "Print teamstats");
 	DEFINE_int32 (team,         -1,    "Select team");
 	DEFINE_string(teamsstatcsv, "",    "Write teamstats in a csv file");
+	DEFINE_bool  (keyframes,    false, "Print the keyframe index");
+	DEFINE_int32 (fromframe,    -1,    "Start the dump at the nearest indexed frame before this one");
 
 
-void TrafficDump(CDemoReader& reader, bool trafficStats);
+void TrafficDump(CDemoReader& reader, bool trafficStats, int fromFrame);
 void WriteTeamstatHistory(CDemoReader& reader, unsigned team, const std::string& file);
 
 int main (int argc, char* argv[])
@@ -56,7 +58,7 @@ int main (int argc, char* argv[])
 	reader.LoadStats();
 	if (FLAGS_dump)
 	{
-		TrafficDump(reader, true);
+		TrafficDump(reader, true, FLAGS_fromframe);
 		return 0;
 	}
 	if (!FLAGS_teamsstatcsv.empty())
@@ -75,6 +77,16 @@ int main (int argc, char* argv[])
 		buf << reader.GetFileHeader();
 		std::wcout << buf.str();
 	}
+	if (FLAGS_keyframes)
+	{
+		const std::vector<DemoKeyFrame>& keyFrames = reader.GetKeyFrames();
+		std::cout << "Keyframes: " << keyFrames.size() << " Interval: " << reader.GetKeyFrameInterval() << std::endl;
+		for (const DemoKeyFrame& keyFrame: keyFrames)
+		{
+			std::cout << "Frame: " << keyFrame.frameNum << " Time: " << keyFrame.modGameTime;
+			std::cout << " Offset: " << keyFrame.fileOffset << " GzipOffset: " << keyFrame.gzipOffset << std::endl;
+		}
+	}
 	if (FLAGS_playerstats || FLAGS_stats)
 	{
 		const std::vector<PlayerStatistics> statvec = reader.GetPlayerStats();
@@ -191,12 +203,20 @@ void PrintBinary(const unsigned char* const buf, int len)
 	std::cout << std::dec; //reset to decimal
 }
 
-void TrafficDump(CDemoReader& reader, bool trafficStats)
+void TrafficDump(CDemoReader& reader, bool trafficStats, int fromFrame)
 {
 	InitCommandNames();
 	std::vector<unsigned> trafficCounter(NETMSG_LAST, 0);
 	int frame = -1;
 	int cmdId = 0;
+	if (fromFrame >= 0)
+	{
+		const int keyFrameNum = reader.SeekToKeyFrame(fromFrame);
+		if (keyFrameNum >= 0)
+			frame = keyFrameNum - 1;
+		else
+			std::cout << "No keyframe before frame " << fromFrame << ", dumping from the start" << std::endl;
+	}
 	while (!reader.ReachedEnd())
 	{
 		netcode::RawPacket* packet;